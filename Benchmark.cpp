@@ -0,0 +1,153 @@
+// Computron x86 PC Emulator
+// Copyright (C) 2003-2020 Andreas Kling <kling@serenityos.org>
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY ANDREAS KLING ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL ANDREAS KLING OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "Benchmark.h"
+#include "CPU.h"
+#include "Common.h"
+#include "Scheduler.h"
+#include "TestSuite.h"
+#include "debug.h"
+#include "machine.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <errno.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct BenchmarkResult {
+    u64 instructions { 0 };
+    qint64 host_nanoseconds { 0 };
+};
+
+// Runs in the forked child. Never returns.
+static void run_benchmark_worker(const QString& binary_path, u64 instruction_count, int result_fd)
+{
+    g_default_options.novlog = true;
+    set_vlog_channel_mask(0);
+
+    auto machine = Machine::create_for_benchmark(binary_path);
+    if (!machine)
+        _exit(1);
+
+    auto& cpu = machine->cpu();
+    u64 start_cycle = cpu.cycle();
+    QElapsedTimer timer;
+
+    machine->scheduler().schedule(instruction_count, [&] {
+        BenchmarkResult result;
+        result.host_nanoseconds = timer.nsecsElapsed();
+        result.instructions = cpu.cycle() - start_cycle;
+        bool ok = write(result_fd, &result, sizeof(result)) == sizeof(result);
+        _exit(ok ? 0 : 1);
+    });
+
+    timer.start();
+    cpu.main_loop();
+    _exit(1);
+}
+
+static bool run_benchmark(const QString& binary_path, u64 instruction_count, BenchmarkResult& result)
+{
+    int result_pipe[2];
+    if (pipe(result_pipe) < 0)
+        return false;
+
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(result_pipe[0]);
+        close(result_pipe[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        close(result_pipe[0]);
+        run_benchmark_worker(binary_path, instruction_count, result_pipe[1]);
+    }
+
+    close(result_pipe[1]);
+
+    size_t nread = 0;
+    while (nread < sizeof(result)) {
+        ssize_t rc = read(result_pipe[0], reinterpret_cast<char*>(&result) + nread, sizeof(result) - nread);
+        if (rc < 0 && errno == EINTR)
+            continue;
+        if (rc <= 0)
+            break;
+        nread += rc;
+    }
+    close(result_pipe[0]);
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    return nread == sizeof(result) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int run_benchmarks(const QString& directory, u64 instruction_count)
+{
+    QDir dir(directory);
+    auto file_names = dir.entryList({ "*.asm" }, QDir::Files, QDir::Name);
+    if (file_names.isEmpty()) {
+        fprintf(stderr, "%s: No benchmarks found\n", qPrintable(directory));
+        return 1;
+    }
+
+    build_opcode_tables_if_needed();
+
+    QString binary_path = QString("%1/computron-bench-%2.bin").arg(QDir::tempPath()).arg(getpid());
+    int failure_count = 0;
+
+    // Benchmarks run one at a time so they don't compete for the host.
+    printf("{\n    \"instruction_count\": %llu,\n    \"benchmarks\": [", (unsigned long long)instruction_count);
+    for (int i = 0; i < file_names.size(); ++i) {
+        QString name = QFileInfo(file_names[i]).completeBaseName();
+        printf("%s\n        { \"name\": \"%s\", ", i ? "," : "", qPrintable(name));
+
+        BenchmarkResult result;
+        if (!assemble_with_nasm(dir.filePath(file_names[i]), binary_path)) {
+            printf("\"error\": \"failed to assemble\" }");
+            ++failure_count;
+            continue;
+        }
+        if (!run_benchmark(binary_path, instruction_count, result)) {
+            printf("\"error\": \"did not complete\" }");
+            ++failure_count;
+            continue;
+        }
+
+        double mips = result.host_nanoseconds ? (double)result.instructions * 1000 / result.host_nanoseconds : 0;
+        printf("\"instructions\": %llu, \"host_nanoseconds\": %lld, \"mips\": %.2f }",
+            (unsigned long long)result.instructions, (long long)result.host_nanoseconds, mips);
+    }
+    printf("\n    ]\n}\n");
+
+    QFile::remove(binary_path);
+    return failure_count ? 1 : 0;
+}
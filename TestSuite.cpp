@@ -0,0 +1,349 @@
+// Computron x86 PC Emulator
+// Copyright (C) 2003-2020 Andreas Kling <kling@serenityos.org>
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY ANDREAS KLING ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL ANDREAS KLING OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "TestSuite.h"
+#include "CPU.h"
+#include "Common.h"
+#include "Instruction.h"
+#include "debug.h"
+#include "machine.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QList>
+#include <QPair>
+#include <QThread>
+#include <QVector>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// A test that hasn't executed VKILL by then is considered hung.
+static const qint64 test_timeout_in_milliseconds = 60000;
+
+// Exit code used by a worker whose test didn't assemble.
+static const int assembly_failed_exit_code = 125;
+
+struct TestCase {
+    QString name;
+    QString source_path;
+    QString expected_path;
+
+    pid_t pid { -1 };
+    int output_fd { -1 };
+    int console_fd { -1 };
+    QByteArray output;
+    QByteArray console;
+    QElapsedTimer timer;
+    qint64 elapsed_in_milliseconds { 0 };
+    int status { 0 };
+    bool timed_out { false };
+};
+
+bool assemble_with_nasm(const QString& source_path, const QString& binary_path)
+{
+    pid_t pid = fork();
+    if (pid < 0)
+        return false;
+    if (pid == 0) {
+        // Let sources %include files that sit next to them.
+        QString include_path = QFileInfo(source_path).absolutePath() + "/";
+        execlp("nasm", "nasm", "-f", "bin", "-i", qPrintable(include_path), "-o", qPrintable(binary_path), qPrintable(source_path), nullptr);
+        _exit(127);
+    }
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR)
+            return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Runs in the forked child. Never returns.
+static void run_worker(const TestCase& test, int output_fd, int console_fd)
+{
+    dup2(output_fd, STDOUT_FILENO);
+    dup2(console_fd, STDERR_FILENO);
+    close(output_fd);
+    close(console_fd);
+
+    QString binary_path = QString("%1/computron-suite-%2.bin").arg(QDir::tempPath()).arg(getpid());
+    if (!assemble_with_nasm(test.source_path, binary_path)) {
+        QFile::remove(binary_path);
+        _exit(assembly_failed_exit_code);
+    }
+
+    // vlog() goes to stdout and would end up in the trace.
+    g_default_options.novlog = true;
+    set_vlog_channel_mask(0);
+    g_default_options.debug_port_to_stderr = true;
+
+    auto machine = Machine::create_for_autotest(binary_path);
+    QFile::remove(binary_path);
+    if (!machine)
+        _exit(1);
+
+    // The test ends with VKILL, which exits the process.
+    machine->cpu().main_loop();
+    fflush(stdout);
+    _exit(0);
+}
+
+static bool start_test(TestCase& test)
+{
+    int output_pipe[2];
+    int console_pipe[2];
+    if (pipe(output_pipe) < 0)
+        return false;
+    if (pipe(console_pipe) < 0) {
+        close(output_pipe[0]);
+        close(output_pipe[1]);
+        return false;
+    }
+
+    // Don't let the child inherit buffered output of ours.
+    fflush(stdout);
+    fflush(stderr);
+
+    test.timer.start();
+    test.pid = fork();
+    if (test.pid < 0) {
+        for (int fd : { output_pipe[0], output_pipe[1], console_pipe[0], console_pipe[1] })
+            close(fd);
+        return false;
+    }
+
+    if (test.pid == 0) {
+        close(output_pipe[0]);
+        close(console_pipe[0]);
+        run_worker(test, output_pipe[1], console_pipe[1]);
+    }
+
+    close(output_pipe[1]);
+    close(console_pipe[1]);
+    test.output_fd = output_pipe[0];
+    test.console_fd = console_pipe[0];
+    return true;
+}
+
+static void drain(int& fd, QByteArray& buffer)
+{
+    char data[65536];
+    ssize_t nread = read(fd, data, sizeof(data));
+    if (nread > 0) {
+        buffer.append(data, nread);
+        return;
+    }
+    if (nread < 0 && errno == EINTR)
+        return;
+    close(fd);
+    fd = -1;
+}
+
+static QByteArray first_difference(const QByteArray& expected, const QByteArray& actual)
+{
+    auto expected_lines = expected.split('\n');
+    auto actual_lines = actual.split('\n');
+    int line_count = qMax(expected_lines.size(), actual_lines.size());
+    for (int i = 0; i < line_count; ++i) {
+        QByteArray expected_line = i < expected_lines.size() ? expected_lines[i] : "<end of output>";
+        QByteArray actual_line = i < actual_lines.size() ? actual_lines[i] : "<end of output>";
+        if (expected_line != actual_line)
+            return QString("    line %1:\n    - %2\n    + %3\n").arg(i + 1).arg(QString::fromLatin1(expected_line)).arg(QString::fromLatin1(actual_line)).toLatin1();
+    }
+    return QByteArray();
+}
+
+enum class Verdict {
+    Pass,
+    Fail,
+    New,
+};
+
+static Verdict finish_test(TestCase& test)
+{
+    test.elapsed_in_milliseconds = test.timer.elapsed();
+
+    QByteArray reason;
+    if (test.timed_out)
+        reason = "    timed out\n";
+    else if (WIFSIGNALED(test.status))
+        reason = QString("    killed by signal %1\n").arg(WTERMSIG(test.status)).toLatin1();
+    else if (WIFEXITED(test.status) && WEXITSTATUS(test.status) == assembly_failed_exit_code)
+        reason = "    failed to assemble\n";
+    else if (!WIFEXITED(test.status) || WEXITSTATUS(test.status) != 0)
+        reason = QString("    exited with status %1\n").arg(WEXITSTATUS(test.status)).toLatin1();
+
+    Verdict verdict;
+    QFile expected_file(test.expected_path);
+    if (!reason.isEmpty()) {
+        verdict = Verdict::Fail;
+    } else if (expected_file.open(QIODevice::ReadOnly)) {
+        reason = first_difference(expected_file.readAll(), test.output);
+        verdict = reason.isEmpty() ? Verdict::Pass : Verdict::Fail;
+    } else {
+        if (expected_file.open(QIODevice::WriteOnly))
+            expected_file.write(test.output);
+        verdict = Verdict::New;
+    }
+
+    switch (verdict) {
+    case Verdict::Pass:
+        printf("\033[32;1mPASS\033[0m: ");
+        break;
+    case Verdict::Fail:
+        printf("\033[31;1mFAIL\033[0m: ");
+        break;
+    case Verdict::New:
+        printf("\033[33;1mNEW\033[0m: ");
+        break;
+    }
+    printf("%s (%lld ms)\n", qPrintable(test.name), test.elapsed_in_milliseconds);
+
+    if (verdict == Verdict::Fail) {
+        fputs(reason.constData(), stdout);
+        if (!test.console.isEmpty())
+            printf("    console output:\n%s\n", test.console.constData());
+    }
+    fflush(stdout);
+    return verdict;
+}
+
+int run_test_suite(const QString& directory)
+{
+    QDir dir(directory);
+    if (!dir.exists()) {
+        fprintf(stderr, "%s: No such directory\n", qPrintable(directory));
+        return 1;
+    }
+
+    QList<TestCase> tests;
+    for (auto& file_name : dir.entryList({ "*.asm" }, QDir::Files, QDir::Name)) {
+        TestCase test;
+        test.name = file_name;
+        test.source_path = dir.filePath(file_name);
+        test.expected_path = dir.filePath(QFileInfo(file_name).completeBaseName() + ".expected");
+        tests.append(test);
+    }
+
+    if (tests.isEmpty()) {
+        fprintf(stderr, "%s: No tests found\n", qPrintable(directory));
+        return 1;
+    }
+
+    // Do the one-time setup before forking so the workers inherit it.
+    build_opcode_tables_if_needed();
+
+    int job_count = qMax(1, QThread::idealThreadCount());
+
+    QElapsedTimer suite_timer;
+    suite_timer.start();
+
+    int next_test = 0;
+    int pass_count = 0;
+    int fail_count = 0;
+    int new_count = 0;
+    QList<TestCase*> running;
+
+    while (next_test < tests.size() || !running.isEmpty()) {
+        while (next_test < tests.size() && running.size() < job_count) {
+            auto& test = tests[next_test++];
+            if (!start_test(test)) {
+                fprintf(stderr, "%s: Failed to start worker: %s\n", qPrintable(test.name), strerror(errno));
+                ++fail_count;
+                continue;
+            }
+            running.append(&test);
+        }
+
+        QVector<pollfd> fds;
+        QVector<QPair<TestCase*, bool>> owners;
+        for (auto* test : running) {
+            if (test->output_fd >= 0) {
+                fds.append({ test->output_fd, POLLIN, 0 });
+                owners.append({ test, false });
+            }
+            if (test->console_fd >= 0) {
+                fds.append({ test->console_fd, POLLIN, 0 });
+                owners.append({ test, true });
+            }
+        }
+
+        if (!fds.isEmpty() && poll(fds.data(), fds.size(), 100) > 0) {
+            for (int i = 0; i < fds.size(); ++i) {
+                if (!fds[i].revents)
+                    continue;
+                auto* test = owners[i].first;
+                if (owners[i].second)
+                    drain(test->console_fd, test->console);
+                else
+                    drain(test->output_fd, test->output);
+            }
+        }
+
+        for (int i = 0; i < running.size();) {
+            auto* test = running[i];
+            if (!test->timed_out && test->timer.elapsed() > test_timeout_in_milliseconds) {
+                kill(test->pid, SIGKILL);
+                test->timed_out = true;
+            }
+            // Both pipes hit EOF once the worker (and anything it spawned) is gone.
+            if (test->output_fd >= 0 || test->console_fd >= 0) {
+                ++i;
+                continue;
+            }
+            while (waitpid(test->pid, &test->status, 0) < 0 && errno == EINTR) {
+            }
+            switch (finish_test(*test)) {
+            case Verdict::Pass:
+                ++pass_count;
+                break;
+            case Verdict::Fail:
+                ++fail_count;
+                break;
+            case Verdict::New:
+                ++new_count;
+                break;
+            }
+            running.removeAt(i);
+        }
+    }
+
+    const TestCase* slowest = nullptr;
+    for (auto& test : tests) {
+        if (!slowest || test.elapsed_in_milliseconds > slowest->elapsed_in_milliseconds)
+            slowest = &test;
+    }
+
+    printf("\n%d passed, %d failed, %d new in %lld ms with %d workers (slowest: %s, %lld ms)\n",
+        pass_count, fail_count, new_count, suite_timer.elapsed(), job_count,
+        qPrintable(slowest->name), slowest->elapsed_in_milliseconds);
+
+    return fail_count ? 1 : 0;
+}
@@ -0,0 +1,26 @@
+[bits 16]
+
+; Register-to-register arithmetic and logic.
+
+cli
+mov eax, 0x12345678
+mov ebx, 0x9abcdef0
+mov ecx, 0x0f0f0f0f
+mov edx, 0x13579bdf
+
+bench:
+add eax, ebx
+adc ecx, edx
+sub ebx, ecx
+sbb edx, eax
+and eax, 0xfff0fff0
+or ebx, ecx
+xor ecx, eax
+cmp edx, ebx
+inc eax
+dec ebx
+neg ecx
+test edx, eax
+add ax, bx
+xor cl, dl
+jmp bench
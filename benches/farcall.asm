@@ -0,0 +1,20 @@
+[bits 16]
+
+; Far calls (direct, indirect and near-called) returning with RETF.
+
+cli
+mov word [far_pointer], callee
+mov word [far_pointer + 2], cs
+
+bench:
+call 0x1000:callee
+call far [far_pointer]
+push cs
+call callee
+jmp bench
+
+callee:
+retf
+
+far_pointer:
+dd 0
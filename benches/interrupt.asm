@@ -0,0 +1,20 @@
+[bits 16]
+
+; Software interrupts and IRET through the real mode IVT.
+
+cli
+xor ax, ax
+mov es, ax
+mov word [es:0x80 * 4], handler
+mov word [es:0x80 * 4 + 2], cs
+
+bench:
+int 0x80
+int 0x80
+pushf
+push cs
+call handler
+jmp bench
+
+handler:
+iret
@@ -0,0 +1,38 @@
+%include "pmode.inc"
+
+; Memory accesses with paging enabled, spread over 64 pages.
+
+; Identity map the first 4 MB with the page directory at 0x20000 and the page table at 0x21000.
+mov edi, 0x20000
+mov eax, 0x21000 | 3
+stosd
+xor eax, eax
+mov ecx, 1023
+rep stosd
+mov eax, 3
+mov ecx, 1024
+map:
+stosd
+add eax, 0x1000
+loop map
+
+mov eax, 0x20000
+mov cr3, eax
+mov eax, cr0
+or eax, 0x80000000
+mov cr0, eax
+jmp paging_enabled
+
+paging_enabled:
+mov esi, 0x40000
+
+bench:
+mov eax, [esi]
+add eax, ecx
+mov [esi + 8], eax
+mov ebx, [esi + 0x2004]
+add [esi + 0x1000], ebx
+add esi, 0x1010
+and esi, 0x3ffff
+or esi, 0x40000
+jmp bench
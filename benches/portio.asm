@@ -0,0 +1,17 @@
+[bits 16]
+
+; Port I/O against a few cheap device registers (PIC mask, CMOS, port 0x61, VGA sequencer).
+
+cli
+
+bench:
+in al, 0x21
+out 0x21, al
+mov al, 0x0f
+out 0x70, al
+in al, 0x71
+in al, 0x61
+mov dx, 0x3c4
+in al, dx
+out dx, al
+jmp bench
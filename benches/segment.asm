@@ -0,0 +1,18 @@
+%include "pmode.inc"
+
+; Protected mode segment register loads.
+
+bench:
+mov ax, 0x18
+mov ds, ax
+mov es, ax
+mov ax, 0x10
+mov fs, ax
+mov gs, ax
+mov ds, ax
+mov es, ax
+push ds
+pop fs
+push es
+pop gs
+jmp bench
@@ -0,0 +1,22 @@
+[bits 16]
+
+; Shifts and rotates, by immediate, by one and by CL.
+
+cli
+mov eax, 0x80000001
+mov ebx, 0x12345678
+mov cl, 5
+
+bench:
+shl eax, 3
+shr ebx, 1
+sar eax, cl
+rol ebx, 7
+ror eax, cl
+rcl ebx, 1
+rcr eax, 2
+shld eax, ebx, 4
+shrd ebx, eax, cl
+shl bx, 1
+rol al, cl
+jmp bench
@@ -0,0 +1,32 @@
+[bits 16]
+
+; String instructions, both single and with a short REP.
+
+cli
+mov ax, 0x2000
+mov ds, ax
+mov es, ax
+cld
+
+bench:
+xor si, si
+mov di, 0x1000
+mov cx, 64
+rep movsd
+xor di, di
+mov eax, 0x55aa55aa
+stosd
+stosd
+stosw
+stosb
+xor si, si
+lodsd
+lodsw
+lodsb
+xor si, si
+mov di, 0x1000
+cmpsd
+cmpsw
+movsb
+movsw
+jmp bench
@@ -554,9 +554,9 @@ _bios_init_data:
 ; EQUIPMENT LIST ---------------------------------------
 ;                                 v DMA (1 if not)
 ;   mov     word [0x0410], 0000000100100000b
-;                                  xx     x   floppies
+;                                  xx    xx   floppies, FPU
     mov     cx, 0000000100100000b
-    mov     cx, 0000000100100101b
+    mov     cx, 0000000100100111b
     ; No DMA
     ; 80x25 color
 ; ------------------------------------------------------
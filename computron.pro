@@ -43,9 +43,11 @@ HEADERS += gui/machinewidget.h \
            gui/screen.h \
            gui/worker.h \
            gui/Renderer.h \
+           hw/BochsVBE.h \
            hw/DMA.h \
            hw/MemoryProvider.h \
            hw/ROM.h \
+           hw/Scheduler.h \
            hw/SimpleMemoryProvider.h \
            hw/DiskDrive.h \
            hw/fdc.h \
@@ -58,6 +60,7 @@ HEADERS += gui/machinewidget.h \
            hw/pit.h \
            hw/vga.h \
            hw/PS2.h \
+           hw/MathCoprocessor.h \
            hw/busmouse.h \
            hw/MouseObserver.h \
            hw/ThreadedTimer.h \
@@ -67,18 +70,29 @@ HEADERS += gui/machinewidget.h \
            include/machine.h \
            include/settings.h \
            include/templates.h \
+           include/Benchmark.h \
            include/Common.h \
            include/OwnPtr.h \
+           include/SPSCQueue.h \
+           include/TripleBuffer.h \
+           include/TestSuite.h \
            x86/CPU.h \
            x86/Descriptor.h \
+           x86/FPU.h \
            x86/Instruction.h \
-           x86/Tasking.h
+           x86/OpcodeProfiler.h \
+           x86/SamplingProfiler.h \
+           x86/Tasking.h \
+           x86/TraceFormat.h \
+           x86/TraceWriter.h
 
-SOURCES += debug.cpp \
+SOURCES += Benchmark.cpp \
+           debug.cpp \
            debugger.cpp \
            dump.cpp \
            machine.cpp \
            settings.cpp \
+           TestSuite.cpp \
            vmcalls.cpp \
            x86/bcd.cpp \
            x86/bitwise.cpp \
@@ -93,10 +107,13 @@ SOURCES += debug.cpp \
            x86/math.cpp \
            x86/modrm.cpp \
            x86/mov.cpp \
+           x86/OpcodeProfiler.cpp \
            x86/pmode.cpp \
+           x86/SamplingProfiler.cpp \
            x86/stack.cpp \
            x86/string.cpp \
            x86/Tasking.cpp \
+           x86/TraceWriter.cpp \
            gui/machinewidget.cpp \
            gui/main.cpp \
            gui/mainwindow.cpp \
@@ -105,6 +122,7 @@ SOURCES += debug.cpp \
            gui/screen.cpp \
            gui/worker.cpp \
            gui/Renderer.cpp \
+           hw/BochsVBE.cpp \
            hw/DMA.cpp \
            hw/busmouse.cpp \
            hw/fdc.cpp \
@@ -117,8 +135,10 @@ SOURCES += debug.cpp \
            hw/iodevice.cpp \
            hw/cmos.cpp \
            hw/PS2.cpp \
+           hw/MathCoprocessor.cpp \
            hw/MemoryProvider.cpp \
            hw/ROM.cpp \
+           hw/Scheduler.cpp \
            hw/SimpleMemoryProvider.cpp \
            hw/DiskDrive.cpp \
            hw/MouseObserver.cpp \
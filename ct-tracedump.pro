@@ -0,0 +1,43 @@
+# Offline decoder for binary traces written by "computron --trace-file".
+# Only the decoder is linked in; the emulator itself is not part of this target.
+CONFIG += debug_and_release
+TEMPLATE = app
+TARGET = ct-tracedump
+DEPENDPATH += . x86 include tools
+INCLUDEPATH += . include gui hw x86 ../serenity
+QMAKE_CXXFLAGS += -std=c++17 -g -W -Wall -Wimplicit-fallthrough -fno-rtti
+
+QMAKE_CXXFLAGS_RELEASE += -O3
+QMAKE_CXXFLAGS_DEBUG += -O0
+
+CONFIG += c++1z
+
+DEFINES += CT_TRACE
+DEFINES += CT_DECODER_ONLY
+CONFIG += silent
+CONFIG += debug
+CONFIG += console
+QT = core
+
+CONFIG -= app_bundle
+
+unix {
+    DEFINES += HAVE_USLEEP
+}
+
+OBJECTS_DIR = .obj-tracedump
+RCC_DIR = .rcc-tracedump
+MOC_DIR = .moc-tracedump
+UI_DIR = .ui-tracedump
+
+HEADERS += include/Common.h \
+           include/debug.h \
+           include/types.h \
+           x86/CPU.h \
+           x86/Instruction.h \
+           x86/TraceFormat.h
+
+SOURCES += debug.cpp \
+           tools/tracedump.cpp \
+           x86/Instruction.cpp \
+           x86/modrm.cpp
@@ -27,130 +27,346 @@
 #include "Common.h"
 #include "debugger.h"
 #include "machine.h"
+#include <QMutex>
+#include <QThread>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 //#define LOG_TO_FILE
 
+std::atomic<u32> g_vlog_channel_mask { 0xffffffff };
+
+// Must be a power of two, so that the free-running positions wrap cleanly.
+static const u32 log_queue_capacity = 4096;
+static const size_t max_log_message_length = 512;
+
+struct LogMessage {
+    std::atomic<u32> sequence { 0 };
+    VLogChannel channel;
+    bool has_cpu;
+    bool x32;
+    bool show_cycle;
+    u16 cs;
+    u32 eip;
+    u64 cycle;
+#ifdef DEBUG_SERENITY
+    bool show_serenity;
+    u32 serenity_value;
+#endif
+    char text[max_log_message_length];
+};
+
+class Logger final : public QThread {
+public:
+    Logger();
+
+    bool enqueue(LogMessage*&, u32& position);
+    void publish(LogMessage&, u32 position);
+    void flush();
+    void write_now(const LogMessage&);
+
+    std::atomic<u64> dropped { 0 };
+
+private:
+    virtual void run() override;
+    bool write_pending();
+    void write(const LogMessage&);
+
+    // Bounded MPSC queue: a slot is free for position p when its sequence is p, and full when it's p + 1.
+    LogMessage* m_slots { nullptr };
+    std::atomic<u32> m_enqueue_position { 0 };
+    u32 m_dequeue_position { 0 };
+    std::atomic<u32> m_written_position { 0 };
+
+    // Serializes the logger thread with write_now().
+    QMutex m_write_lock;
+
+    // A forked child inherits the queue but not the thread draining it.
+    pid_t m_pid { getpid() };
+
 #ifdef LOG_TO_FILE
-static FILE* s_logfile = 0L;
+    FILE* m_logfile { nullptr };
 #endif
+};
 
-void vlog(VLogChannel channel, const char* format, ...)
+Logger::Logger()
 {
-    if (options.novlog)
+    m_slots = new LogMessage[log_queue_capacity];
+    for (u32 i = 0; i < log_queue_capacity; ++i)
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+bool Logger::enqueue(LogMessage*& slot, u32& position)
+{
+    position = m_enqueue_position.load(std::memory_order_relaxed);
+    for (;;) {
+        slot = &m_slots[position & (log_queue_capacity - 1)];
+        i32 difference = (i32)(slot->sequence.load(std::memory_order_acquire) - position);
+        if (difference == 0) {
+            if (m_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                return true;
+        } else if (difference < 0) {
+            return false;
+        } else {
+            position = m_enqueue_position.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void Logger::publish(LogMessage& slot, u32 position)
+{
+    slot.sequence.store(position + 1, std::memory_order_release);
+}
+
+void Logger::flush()
+{
+    if (QThread::currentThread() == this || getpid() != m_pid)
         return;
+    u32 target = m_enqueue_position.load(std::memory_order_acquire);
+    while ((i32)(m_written_position.load(std::memory_order_acquire) - target) < 0)
+        QThread::yieldCurrentThread();
+}
 
-    va_list ap;
-    const char* prefix = 0L;
+void Logger::write_now(const LogMessage& message)
+{
+    flush();
+    QMutexLocker locker(&m_write_lock);
+    write(message);
+    fflush(stdout);
+#ifdef LOG_TO_FILE
+    if (m_logfile)
+        fflush(m_logfile);
+#endif
+}
+
+bool Logger::write_pending()
+{
+    QMutexLocker locker(&m_write_lock);
+    bool wrote_anything = false;
+    for (;;) {
+        auto& slot = m_slots[m_dequeue_position & (log_queue_capacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != m_dequeue_position + 1)
+            break;
+        write(slot);
+        slot.sequence.store(m_dequeue_position + log_queue_capacity, std::memory_order_release);
+        ++m_dequeue_position;
+        wrote_anything = true;
+    }
+
+    u64 dropped_count = dropped.exchange(0);
+    if (dropped_count) {
+        printf("[\033[31;1m%8s\033[0m] %llu messages dropped\n", "vlog", (unsigned long long)dropped_count);
+        wrote_anything = true;
+    }
+
+    if (wrote_anything) {
+        fflush(stdout);
+#ifdef LOG_TO_FILE
+        if (m_logfile)
+            fflush(m_logfile);
+#endif
+    }
+    m_written_position.store(m_dequeue_position, std::memory_order_release);
+    return wrote_anything;
+}
+
+void Logger::write(const LogMessage& message)
+{
+    const char* prefix = vlog_channel_name(message.channel);
+
+#ifdef LOG_TO_FILE
+    if (!m_logfile)
+        m_logfile = fopen("log.txt", "a");
+    if (m_logfile) {
+        fprintf(m_logfile, "(%8s) ", prefix);
+        if (message.has_cpu)
+            fprintf(m_logfile, "[%04x:%08x] ", message.cs, message.eip);
+        fprintf(m_logfile, "%s\n", message.text);
+    }
+#endif
+
+    if (message.show_cycle)
+        printf("\033[30;1m%20llu\033[0m ", (unsigned long long)message.cycle);
+    printf("[\033[31;1m%8s\033[0m] ", prefix);
+    if (message.has_cpu) {
+#ifdef DEBUG_SERENITY
+        if (message.show_serenity)
+            printf("<%08x> ", message.serenity_value);
+#endif
+        printf("(\033[37;1m%u\033[0m)\033[32;1m%04x:%08x\033[0m ", message.x32 ? 32 : 16, message.cs, message.eip);
+    }
+    puts(message.text);
+}
 
+void Logger::run()
+{
+    for (;;) {
+        if (!write_pending())
+            QThread::usleep(1000);
+    }
+}
+
+static std::atomic<Logger*> s_logger;
+
+static Logger& logger()
+{
+    // Deliberately leaked; the thread runs until the process exits.
+    static Logger* logger = [] {
+        auto* logger = new Logger;
+        logger->start();
+        s_logger = logger;
+        atexit(vlog_flush);
+        return logger;
+    }();
+    return *logger;
+}
+
+const char* vlog_channel_name(VLogChannel channel)
+{
     switch (channel) {
     case LogInit:
-        prefix = "init";
-        break;
+        return "init";
+    case LogError:
+        return "error";
     case LogExit:
-        prefix = "exit";
-        break;
+        return "exit";
     case LogDisk:
-        prefix = "disk";
-        break;
+        return "disk";
     case LogIO:
-        prefix = "i/o";
-        break;
+        return "i/o";
     case LogAlert:
-        prefix = "alert";
-        break;
+        return "alert";
     case LogVGA:
-        prefix = "vga";
-        break;
+        return "vga";
     case LogConfig:
-        prefix = "config";
-        break;
+        return "config";
     case LogCPU:
-        prefix = "cpu";
-        break;
+        return "cpu";
     case LogMouse:
-        prefix = "mouse";
-        break;
+        return "mouse";
     case LogPIC:
-        prefix = "pic";
-        break;
+        return "pic";
     case LogKeyboard:
-        prefix = "keyb";
-        break;
+        return "keyb";
     case LogFDC:
-        prefix = "fdc";
-        break;
+        return "fdc";
     case LogDump:
-        prefix = "dump";
-        break;
+        return "dump";
     case LogVomCtl:
-        prefix = "vomctl";
-        break;
+        return "vomctl";
     case LogCMOS:
-        prefix = "cmos";
-        break;
+        return "cmos";
     case LogIDE:
-        prefix = "ide";
-        break;
+        return "ide";
     case LogScreen:
-        prefix = "screen";
-        break;
+        return "screen";
     case LogFPU:
-        prefix = "fpu";
-        break;
+        return "fpu";
     case LogTimer:
-        prefix = "timer";
-        break;
+        return "timer";
     case LogDMA:
-        prefix = "dma";
-        break;
+        return "dma";
 #ifdef DEBUG_SERENITY
     case LogSerenity:
-        prefix = "serenity";
-        break;
+        return "serenity";
 #endif
     default:
         ASSERT_NOT_REACHED();
+        return "";
     }
+}
 
-#ifdef LOG_TO_FILE
-    if (!s_logfile) {
-        s_logfile = fopen("log.txt", "a");
-        if (!s_logfile)
-            return;
+bool vlog_channel_from_name(const QString& name, VLogChannel& channel)
+{
+    for (int i = 0; i < VLogChannelCount; ++i) {
+        if (name == vlog_channel_name(static_cast<VLogChannel>(i))) {
+            channel = static_cast<VLogChannel>(i);
+            return true;
+        }
     }
+    return false;
+}
 
-    if (prefix)
-        fprintf(s_logfile, "(%8s) ", prefix);
+void set_vlog_channel_enabled(VLogChannel channel, bool enabled)
+{
+    if (enabled)
+        g_vlog_channel_mask.fetch_or(1u << channel);
+    else
+        g_vlog_channel_mask.fetch_and(~(1u << channel));
+}
 
-    if (g_cpu) {
-        fprintf(s_logfile, "[%04x:%08x] ", g_cpu->get_base_cs(), g_cpu->current_base_instruction_pointer());
-    }
+void set_vlog_channel_mask(u32 mask)
+{
+    g_vlog_channel_mask = mask;
+}
 
-    va_start(ap, format);
-    vfprintf(s_logfile, format, ap);
-    va_end(ap);
-#endif
+// These usually come right before an abort, which never gives the logger thread a chance to catch up.
+static bool vlog_channel_is_synchronous(VLogChannel channel)
+{
+    return channel == LogError || channel == LogExit || channel == LogAlert;
+}
 
-    if (g_cpu && options.vlogcycle)
-        printf("\033[30;1m%20zu\033[0m ", g_cpu->cycle());
-    if (prefix)
-        printf("[\033[31;1m%8s\033[0m] ", prefix);
+static void fill_message(LogMessage& message, VLogChannel channel, const RuntimeOptions& options, const char* format, va_list ap)
+{
+    message.channel = channel;
+    message.has_cpu = g_cpu;
+    message.show_cycle = g_cpu && options.vlogcycle;
     if (g_cpu) {
+        message.x32 = g_cpu->x32();
+        message.cs = g_cpu->get_base_cs();
+        message.eip = g_cpu->current_base_instruction_pointer();
+        message.cycle = g_cpu->cycle();
 #ifdef DEBUG_SERENITY
+        message.show_serenity = options.serenity;
         if (options.serenity)
-            printf("<%08x> ", g_cpu->read_physical_memory<u32>(PhysicalAddress(0x1000)));
+            message.serenity_value = g_cpu->read_physical_memory<u32>(PhysicalAddress(0x1000));
 #endif
-        printf("(\033[37;1m%u\033[0m)\033[32;1m%04x:%08x\033[0m ", g_cpu->x32() ? 32 : 16, g_cpu->get_base_cs(), g_cpu->current_base_instruction_pointer());
     }
+#ifdef DEBUG_SERENITY
+    else {
+        message.show_serenity = false;
+    }
+#endif
+
+    vsnprintf(message.text, sizeof(message.text), format, ap);
+}
+
+void vlog_impl(VLogChannel channel, const char* format, ...)
+{
+    const RuntimeOptions& options = g_cpu ? g_cpu->options() : g_default_options;
+    if (options.novlog)
+        return;
+
+    auto& the_logger = logger();
+    va_list ap;
     va_start(ap, format);
-    vprintf(format, ap);
+
+    if (vlog_channel_is_synchronous(channel)) {
+        LogMessage message;
+        fill_message(message, channel, options, format, ap);
+        va_end(ap);
+        the_logger.write_now(message);
+        return;
+    }
+
+    LogMessage* message;
+    u32 position;
+    if (!the_logger.enqueue(message, position)) {
+        va_end(ap);
+        ++the_logger.dropped;
+        return;
+    }
+
+    fill_message(*message, channel, options, format, ap);
     va_end(ap);
-    puts("");
 
-#ifdef LOG_TO_FILE
-    fputc('\n', s_logfile);
-    fflush(s_logfile);
-#endif
+    the_logger.publish(*message, position);
+}
+
+void vlog_flush()
+{
+    if (auto* logger = s_logger.load())
+        logger->flush();
 }
@@ -25,6 +25,9 @@
 #include "debugger.h"
 #include "CPU.h"
 #include "Common.h"
+#include "DiskDrive.h"
+#include "OpcodeProfiler.h"
+#include "SamplingProfiler.h"
 #include "debug.h"
 #include "machine.h"
 #include "pic.h"
@@ -72,6 +75,9 @@ static QString do_prompt(const CPU& cpu)
     else
         s.sprintf("%04X:%04X", cpu.get_cs(), cpu.get_ip());
 
+    // Don't let queued log output land on top of the prompt.
+    vlog_flush();
+
     QString prompt = bright_magenta % QLatin1Literal("CT ") % bright_cyan % s % default_color % QLatin1Literal("> ");
 
 #ifdef HAVE_EDITLINE
@@ -163,6 +169,9 @@ void Debugger::handle_command(const QString& raw_command)
     if (lower_command == "b")
         return handle_breakpoint(arguments);
 
+    if (lower_command == "watch")
+        return handle_watch(arguments);
+
     if (lower_command == "sel")
         return handle_selector(arguments);
 
@@ -236,22 +245,22 @@ void Debugger::handle_command(const QString& raw_command)
     }
 
     if (lower_command == "slon") {
-        options.stacklog = true;
+        cpu().options().stacklog = true;
         return;
     }
 
     if (lower_command == "sloff") {
-        options.stacklog = false;
+        cpu().options().stacklog = false;
         return;
     }
 
     if (lower_command == "pt1") {
-        options.log_page_translations = true;
+        cpu().options().log_page_translations = true;
         return;
     }
 
     if (lower_command == "pt0") {
-        options.log_page_translations = false;
+        cpu().options().log_page_translations = false;
         return;
     }
 
@@ -260,13 +269,25 @@ void Debugger::handle_command(const QString& raw_command)
         return;
     }
 
+    if (lower_command == "disks")
+        return handle_disks(arguments);
+
+    if (lower_command == "profile")
+        return handle_profile(arguments);
+
+    if (lower_command == "sample")
+        return handle_sample(arguments);
+
+    if (lower_command == "log")
+        return handle_log(arguments);
+
 #ifdef DISASSEMBLE_EVERYTHING
     if (lower_command == "de1") {
-        options.disassemble_everything = true;
+        cpu().options().disassemble_everything = true;
         return;
     }
     if (lower_command == "de0") {
-        options.disassemble_everything = false;
+        cpu().options().disassemble_everything = false;
         return;
     }
 #endif
@@ -281,13 +302,13 @@ void Debugger::handle_irq(const QStringList& arguments)
 
     if (arguments[0] == "off") {
         printf("Ignoring all IRQs\n");
-        PIC::set_ignore_all_irqs(true);
+        cpu().machine().master_pic().set_ignore_all_irqs(true);
         return;
     }
 
     if (arguments[0] == "on") {
         printf("Allowing all IRQs\n");
-        PIC::set_ignore_all_irqs(false);
+        cpu().machine().master_pic().set_ignore_all_irqs(false);
         return;
     }
 
@@ -295,6 +316,203 @@ usage:
     printf("usage: irq <on|off>\n");
 }
 
+void Debugger::handle_disks(const QStringList& arguments)
+{
+    if (arguments.size() > 1)
+        goto usage;
+
+    if (arguments.isEmpty()) {
+        cpu().machine().for_each_disk_drive([](DiskDrive& drive) {
+            if (!drive.present())
+                return;
+            u64 lookups = drive.cache_hits() + drive.cache_misses();
+            printf("%-8s hits: %llu, misses: %llu (%.1f%% hit rate), read-ahead: %llu, cached: %u/%u, dirty: %u\n",
+                qPrintable(drive.name()),
+                (unsigned long long)drive.cache_hits(),
+                (unsigned long long)drive.cache_misses(),
+                lookups ? (drive.cache_hits() * 100.0) / lookups : 0.0,
+                (unsigned long long)drive.read_ahead_sectors(),
+                drive.cached_sector_count(),
+                drive.cache_capacity(),
+                drive.dirty_sector_count());
+        });
+        return;
+    }
+
+    if (arguments[0] == "flush") {
+        cpu().machine().flush_disk_drives();
+        return;
+    }
+
+    if (arguments[0] == "reset") {
+        cpu().machine().for_each_disk_drive([](DiskDrive& drive) {
+            drive.reset_cache_statistics();
+        });
+        return;
+    }
+
+usage:
+    printf("usage: disks [flush|reset]\n");
+}
+
+void Debugger::handle_profile(const QStringList& arguments)
+{
+    static const int default_top_count = 20;
+
+    if (arguments.isEmpty() || arguments[0] == "top") {
+        if (arguments.size() > 2)
+            goto usage;
+        if (!cpu().opcode_profiler()) {
+            printf("Opcode profiling has never been enabled\n");
+            return;
+        }
+        int count = default_top_count;
+        if (arguments.size() == 2) {
+            bool ok;
+            count = arguments[1].toInt(&ok);
+            if (!ok || count <= 0)
+                goto usage;
+        }
+        printf("Opcode profiling is %s\n", cpu().is_opcode_profiling_enabled() ? "on" : "off");
+        cpu().opcode_profiler()->dump_top(count);
+        return;
+    }
+
+    if (arguments[0] == "on") {
+        if (arguments.size() > 2 || (arguments.size() == 2 && arguments[1] != "cycles"))
+            goto usage;
+        cpu().set_opcode_profiling_enabled(true);
+        cpu().opcode_profiler()->set_measures_host_cycles(arguments.size() == 2);
+        printf("Opcode profiling enabled%s\n", arguments.size() == 2 ? " (with host cycles)" : "");
+        return;
+    }
+
+    if (arguments.size() == 1 && arguments[0] == "off") {
+        cpu().set_opcode_profiling_enabled(false);
+        return;
+    }
+
+    if (arguments.size() == 1 && arguments[0] == "reset") {
+        if (cpu().opcode_profiler())
+            cpu().opcode_profiler()->reset();
+        return;
+    }
+
+    if (arguments.size() == 2 && arguments[0] == "csv") {
+        if (!cpu().opcode_profiler()) {
+            printf("Opcode profiling has never been enabled\n");
+            return;
+        }
+        if (!cpu().opcode_profiler()->write_csv(arguments[1]))
+            printf("Failed to write %s\n", qPrintable(arguments[1]));
+        return;
+    }
+
+usage:
+    printf("usage: profile [on [cycles]|off|reset|top [count]|csv <file>]\n");
+}
+
+void Debugger::handle_log(const QStringList& arguments)
+{
+    if (arguments.isEmpty()) {
+        for (int i = 0; i < VLogChannelCount; ++i) {
+            auto channel = static_cast<VLogChannel>(i);
+            printf("%-10s %s\n", vlog_channel_name(channel), vlog_enabled(channel) ? "on" : "off");
+        }
+        return;
+    }
+
+    if (arguments.size() == 2 && (arguments[1] == "on" || arguments[1] == "off")) {
+        bool enabled = arguments[1] == "on";
+        if (arguments[0] == "all") {
+            set_vlog_channel_mask(enabled ? 0xffffffff : 0);
+            return;
+        }
+        VLogChannel channel;
+        if (!vlog_channel_from_name(arguments[0], channel)) {
+            printf("Unknown log channel: %s\n", qPrintable(arguments[0]));
+            return;
+        }
+        set_vlog_channel_enabled(channel, enabled);
+        return;
+    }
+
+    printf("usage: log [<channel>|all on|off]\n");
+}
+
+void Debugger::handle_sample(const QStringList& arguments)
+{
+    auto& profiler = cpu().sampling_profiler();
+
+    if (arguments.isEmpty()) {
+        printf("Sampling is %s, every %llu instructions, %u/%u samples (%llu taken), %d symbols\n",
+            profiler.is_running() ? "on" : "off",
+            (unsigned long long)profiler.interval(),
+            profiler.sample_count(),
+            profiler.capacity(),
+            (unsigned long long)profiler.samples_taken(),
+            profiler.symbol_count());
+        return;
+    }
+
+    if (arguments[0] == "start") {
+        if (arguments.size() > 3)
+            goto usage;
+        bool ok = true;
+        u64 interval = SamplingProfiler::default_interval;
+        unsigned capacity = SamplingProfiler::default_capacity;
+        if (arguments.size() >= 2)
+            interval = arguments[1].toULongLong(&ok);
+        if (ok && arguments.size() == 3)
+            capacity = arguments[2].toUInt(&ok);
+        if (!ok || !interval || !capacity)
+            goto usage;
+        profiler.start(interval, capacity);
+        return;
+    }
+
+    if (arguments.size() == 1 && arguments[0] == "stop") {
+        profiler.stop();
+        return;
+    }
+
+    if (arguments.size() == 1 && arguments[0] == "clear") {
+        profiler.clear();
+        return;
+    }
+
+    if (arguments[0] == "top") {
+        if (arguments.size() > 2)
+            goto usage;
+        int count = 20;
+        if (arguments.size() == 2) {
+            bool ok;
+            count = arguments[1].toInt(&ok);
+            if (!ok || count <= 0)
+                goto usage;
+        }
+        profiler.dump_top(count);
+        return;
+    }
+
+    if (arguments.size() == 2 && arguments[0] == "symbols") {
+        if (!profiler.load_symbols(arguments[1]))
+            printf("Failed to load symbols from %s\n", qPrintable(arguments[1]));
+        else
+            printf("Loaded %d symbols\n", profiler.symbol_count());
+        return;
+    }
+
+    if (arguments.size() == 2 && arguments[0] == "folded") {
+        if (!profiler.write_folded_stacks(arguments[1]))
+            printf("Failed to write %s\n", qPrintable(arguments[1]));
+        return;
+    }
+
+usage:
+    printf("usage: sample [start [interval [capacity]]|stop|clear|top [count]|symbols <file>|folded <file>]\n");
+}
+
 void Debugger::handle_breakpoint(const QStringList& arguments)
 {
     if (arguments.size() < 2) {
@@ -337,13 +555,62 @@ void Debugger::handle_breakpoint(const QStringList& arguments)
     LogicalAddress address(selector, offset);
     if (arguments[0] == "add") {
         printf("add breakpoint: %04x:%08x\n", selector, offset);
-        cpu().breakpoints().insert(address);
+        cpu().add_breakpoint(address);
     }
     if (arguments[0] == "del") {
         printf("delete breakpoint: %04x:%08x\n", selector, offset);
-        cpu().breakpoints().erase(address);
+        cpu().remove_breakpoint(address);
     }
-    cpu().recompute_main_loop_needs_slow_stuff();
+}
+
+void Debugger::handle_watch(const QStringList& arguments)
+{
+    if (arguments.isEmpty()) {
+        for (auto& watch : cpu().watches())
+            printf("    %08x [%-16s] %u-bit%s\n", watch.address.get(), qPrintable(watch.name), (unsigned)watch.size, watch.break_on_change ? ", break on change" : "");
+        return;
+    }
+
+    if (arguments.size() < 2)
+        goto usage;
+
+    {
+        bool ok;
+        u32 address = arguments[1].toUInt(&ok, 16);
+        if (!ok)
+            goto usage;
+
+        if (arguments[0] == "del") {
+            if (arguments.size() != 2)
+                goto usage;
+            if (!cpu().remove_watch(PhysicalAddress(address)))
+                printf("No watch at %08x\n", address);
+            return;
+        }
+
+        if (arguments[0] != "add" || arguments.size() > 4)
+            goto usage;
+
+        ValueSize size = ByteSize;
+        bool break_on_change = false;
+        for (int i = 2; i < arguments.size(); ++i) {
+            if (arguments[i] == "b")
+                size = ByteSize;
+            else if (arguments[i] == "w")
+                size = WordSize;
+            else if (arguments[i] == "d")
+                size = DWordSize;
+            else if (arguments[i] == "break")
+                break_on_change = true;
+            else
+                goto usage;
+        }
+        cpu().add_watch(WatchedAddress(arguments[1], address, size, break_on_change));
+        return;
+    }
+
+usage:
+    printf("usage: watch [add <physical address> [b|w|d] [break]|del <physical address>]\n");
 }
 
 void Debugger::do_console()
@@ -465,7 +732,7 @@ void Debugger::handle_tracing(const QStringList& arguments)
 {
     if (arguments.size() == 1) {
         unsigned value = arguments.at(0).toUInt(0, 16);
-        options.trace = value != 0;
+        cpu().options().trace = value != 0;
         cpu().recompute_main_loop_needs_slow_stuff();
         return;
     }
@@ -138,101 +138,9 @@ void CPU::dump_selector(const char* prefix, SegmentRegisterIndex segreg)
         dump_descriptor(descriptor, prefix);
 }
 
-const char* CPU::register_name(SegmentRegisterIndex index)
-{
-    switch (index) {
-    case SegmentRegisterIndex::CS:
-        return "cs";
-    case SegmentRegisterIndex::DS:
-        return "ds";
-    case SegmentRegisterIndex::ES:
-        return "es";
-    case SegmentRegisterIndex::SS:
-        return "ss";
-    case SegmentRegisterIndex::FS:
-        return "fs";
-    case SegmentRegisterIndex::GS:
-        return "gs";
-    default:
-        ASSERT_NOT_REACHED();
-        return nullptr;
-    }
-}
-
-const char* CPU::register_name(CPU::RegisterIndex8 register_index)
-{
-    switch (register_index) {
-    case CPU::RegisterAL:
-        return "al";
-    case CPU::RegisterBL:
-        return "bl";
-    case CPU::RegisterCL:
-        return "cl";
-    case CPU::RegisterDL:
-        return "dl";
-    case CPU::RegisterAH:
-        return "ah";
-    case CPU::RegisterBH:
-        return "bh";
-    case CPU::RegisterCH:
-        return "ch";
-    case CPU::RegisterDH:
-        return "dh";
-    }
-    ASSERT_NOT_REACHED();
-    return nullptr;
-}
-
-const char* CPU::register_name(CPU::RegisterIndex16 register_index)
-{
-    switch (register_index) {
-    case CPU::RegisterAX:
-        return "ax";
-    case CPU::RegisterBX:
-        return "bx";
-    case CPU::RegisterCX:
-        return "cx";
-    case CPU::RegisterDX:
-        return "dx";
-    case CPU::RegisterBP:
-        return "bp";
-    case CPU::RegisterSP:
-        return "sp";
-    case CPU::RegisterSI:
-        return "si";
-    case CPU::RegisterDI:
-        return "di";
-    }
-    ASSERT_NOT_REACHED();
-    return nullptr;
-}
-
-const char* CPU::register_name(CPU::RegisterIndex32 register_index)
-{
-    switch (register_index) {
-    case CPU::RegisterEAX:
-        return "eax";
-    case CPU::RegisterEBX:
-        return "ebx";
-    case CPU::RegisterECX:
-        return "ecx";
-    case CPU::RegisterEDX:
-        return "edx";
-    case CPU::RegisterEBP:
-        return "ebp";
-    case CPU::RegisterESP:
-        return "esp";
-    case CPU::RegisterESI:
-        return "esi";
-    case CPU::RegisterEDI:
-        return "edi";
-    }
-    ASSERT_NOT_REACHED();
-    return nullptr;
-}
-
 void CPU::dump_watches()
 {
+    // Called after every write to a watched page, so this may be in the middle of an instruction.
     for (WatchedAddress& watch : m_watches) {
         if (watch.size == ByteSize) {
             auto data = read_physical_memory<u8>(watch.address);
@@ -240,7 +148,7 @@ void CPU::dump_watches()
                 vlog(LogDump, "\033[32;1m%08X\033[0m [%-16s] %02X", watch.address, qPrintable(watch.name), data);
                 watch.last_seen_value = data;
                 if (cycle() > 1 && watch.break_on_change)
-                    debugger().enter();
+                    queue_command(EnterDebugger);
             }
         } else if (watch.size == WordSize) {
             auto data = read_physical_memory<u16>(watch.address);
@@ -248,7 +156,7 @@ void CPU::dump_watches()
                 vlog(LogDump, "\033[32;1m%08X\033[0m [%-16s] %04X", watch.address, qPrintable(watch.name), data);
                 watch.last_seen_value = data;
                 if (cycle() > 1 && watch.break_on_change)
-                    debugger().enter();
+                    queue_command(EnterDebugger);
             }
         } else if (watch.size == DWordSize) {
             auto data = read_physical_memory<u32>(watch.address);
@@ -256,7 +164,7 @@ void CPU::dump_watches()
                 vlog(LogDump, "\033[32;1m%08X\033[0m [%-16s] %08X", watch.address, qPrintable(watch.name), data);
                 watch.last_seen_value = data;
                 if (cycle() > 1 && watch.break_on_change)
-                    debugger().enter();
+                    queue_command(EnterDebugger);
             }
         }
     }
@@ -23,12 +23,17 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "Renderer.h"
+#include "BochsVBE.h"
 #include "CPU.h"
 #include "Common.h"
 #include "machine.h"
 #include "screen.h"
 #include "vga.h"
 #include <QPainter>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 struct fontcharbitmap_t {
     u8 data[16];
@@ -46,19 +51,75 @@ const VGA& Renderer::vga() const
 
 BufferedRenderer::BufferedRenderer(Screen& screen, int width, int height, int scale)
     : Renderer(screen)
-    , m_buffer(width, height, QImage::Format_Indexed8)
+    , m_width(width)
+    , m_height(height)
     , m_scale(scale)
+    , m_indices(width * height, 0)
 {
-    m_buffer.fill(0);
+    ASSERT(scale == 1 || scale == 2);
+    for (auto& color : m_palette)
+        color = QColor(Qt::black).rgb();
+    m_frames.for_each_slot([&](QImage& frame) {
+        frame = QImage(width * scale, height * scale, QImage::Format_RGB32);
+        frame.fill(QColor(Qt::black).rgb());
+    });
+}
+
+static void expand_scan_line(u32* out, const u8* in, int width, const u32* palette)
+{
+    for (int x = 0; x < width; ++x)
+        out[x] = palette[in[x]];
+}
+
+static void expand_scan_line_2x(u32* out, const u8* in, int width, const u32* palette)
+{
+    int x = 0;
+#ifdef __SSE2__
+    for (; x + 4 <= width; x += 4, out += 8) {
+        __m128i pixels = _mm_setr_epi32(palette[in[x]], palette[in[x + 1]], palette[in[x + 2]], palette[in[x + 3]]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi32(pixels, pixels));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4), _mm_unpackhi_epi32(pixels, pixels));
+    }
+#endif
+    for (; x < width; ++x) {
+        *(out++) = palette[in[x]];
+        *(out++) = palette[in[x]];
+    }
+}
+
+void BufferedRenderer::publish_frame()
+{
+    auto& frame = m_frames.back();
+    const u8* in = m_indices.constData();
+    for (int y = 0; y < m_height; ++y, in += m_width) {
+        auto* out = reinterpret_cast<u32*>(frame.scanLine(y * m_scale));
+        if (m_scale == 1) {
+            expand_scan_line(out, in, m_width, m_palette);
+            continue;
+        }
+        expand_scan_line_2x(out, in, m_width, m_palette);
+        memcpy(frame.scanLine(y * m_scale + 1), out, m_width * m_scale * sizeof(u32));
+    }
+    m_frames.publish();
 }
 
 Mode04Renderer::Mode04Renderer(Screen& screen)
     : BufferedRenderer(screen, 320, 200, 2)
 {
-    m_buffer.setColor(0, QColor(Qt::black).rgb());
-    m_buffer.setColor(1, QColor(Qt::cyan).rgb());
-    m_buffer.setColor(2, QColor(Qt::magenta).rgb());
-    m_buffer.setColor(3, QColor(Qt::white).rgb());
+    set_color(0, QColor(Qt::black).rgb());
+    set_color(1, QColor(Qt::cyan).rgb());
+    set_color(2, QColor(Qt::magenta).rgb());
+    set_color(3, QColor(Qt::white).rgb());
+}
+
+TextRenderer::TextRenderer(Screen& screen)
+    : Renderer(screen)
+{
+    m_frames.for_each_slot([&](Frame& frame) {
+        frame.cells.fill(0, m_rows * m_columns);
+        for (auto& color : frame.colors)
+            color = QColor(Qt::black).rgb();
+    });
 }
 
 void TextRenderer::put_character(QPainter& p, int row, int column, u8 color, u8 character)
@@ -74,112 +135,95 @@ void TextRenderer::put_character(QPainter& p, int row, int column, u8 color, u8
 
 void Mode04Renderer::render()
 {
-    const u8* video_memory = vga().text_memory() + vga().start_address();
-    for (unsigned scan_line = 0; scan_line < 200; ++scan_line) {
-        u8* out = m_buffer.scanLine(scan_line);
-        const u8* in = video_memory;
-        if ((scan_line & 1))
-            in += 0x2000;
-        in += (scan_line / 2) * 80;
-        for (unsigned i = 0; i < 80; ++i) {
-            *(out++) = (in[i] >> 6) & 3;
-            *(out++) = (in[i] >> 4) & 3;
-            *(out++) = (in[i] >> 2) & 3;
-            *(out++) = (in[i] >> 0) & 3;
+    const u32* planes = vga().planes();
+    u16 start_address = vga().start_address();
+    for (int y = 0; y < 200; ++y) {
+        u8* out = scan_line(y);
+        u16 offset = start_address + (y / 2) * 80;
+        if ((y & 1))
+            offset += 0x2000;
+        for (unsigned i = 0; i < 80; ++i, ++offset) {
+            u8 in = planes[offset];
+            *(out++) = (in >> 6) & 3;
+            *(out++) = (in >> 4) & 3;
+            *(out++) = (in >> 2) & 3;
+            *(out++) = (in >> 0) & 3;
         }
     }
 }
 
-void Mode12Renderer::render()
+// Gathers bit `bit` of all four plane lanes into a 4-bit color.
+static ALWAYS_INLINE u8 planar_pixel(u32 lanes, int bit)
+{
+    u32 bits = (lanes >> bit) & 0x01010101;
+    return (bits | (bits >> 7) | (bits >> 14) | (bits >> 21)) & 0xf;
+}
+
+static void render_planar(u8* bits, const u32* planes, u16 start_address, int width, int height)
 {
-    const u8* p0 = vga().plane(0);
-    const u8* p1 = vga().plane(1);
-    const u8* p2 = vga().plane(2);
-    const u8* p3 = vga().plane(3);
-
-    int offset = 0;
-
-    u8* bits = buffer_bits();
-    for (int y = 0; y < 480; ++y) {
-        u8* px = &bits[y * 640];
-
-        for (int x = 0; x < 640; x += 8, ++offset) {
-#define D(i) ((p0[offset] >> i) & 1) | (((p1[offset] >> i) & 1) << 1) | (((p2[offset] >> i) & 1) << 2) | (((p3[offset] >> i) & 1) << 3)
-            *(px++) = D(7);
-            *(px++) = D(6);
-            *(px++) = D(5);
-            *(px++) = D(4);
-            *(px++) = D(3);
-            *(px++) = D(2);
-            *(px++) = D(1);
-            *(px++) = D(0);
+    u16 offset = start_address;
+    for (int y = 0; y < height; ++y) {
+        u8* px = &bits[y * width];
+        for (int x = 0; x < width; x += 8, ++offset) {
+            u32 lanes = planes[offset];
+            *(px++) = planar_pixel(lanes, 7);
+            *(px++) = planar_pixel(lanes, 6);
+            *(px++) = planar_pixel(lanes, 5);
+            *(px++) = planar_pixel(lanes, 4);
+            *(px++) = planar_pixel(lanes, 3);
+            *(px++) = planar_pixel(lanes, 2);
+            *(px++) = planar_pixel(lanes, 1);
+            *(px++) = planar_pixel(lanes, 0);
         }
     }
 }
 
-void Mode0DRenderer::render()
+void Mode12Renderer::render()
 {
-    const u8* p0 = vga().plane(0);
-    const u8* p1 = vga().plane(1);
-    const u8* p2 = vga().plane(2);
-    const u8* p3 = vga().plane(3);
-
-    u16 start_address = vga().start_address();
-    p0 += start_address;
-    p1 += start_address;
-    p2 += start_address;
-    p3 += start_address;
-
-    u8* bits = buffer_bits();
-    int offset = 0;
+    render_planar(buffer_bits(), vga().planes(), 0, 640, 480);
+}
 
-    for (int y = 0; y < 200; ++y) {
-        u8* px = &bits[y * 320];
-#define A0D(i) ((p0[offset] >> i) & 1) | (((p1[offset] >> i) & 1) << 1) | (((p2[offset] >> i) & 1) << 2) | (((p3[offset] >> i) & 1) << 3)
-        for (int x = 0; x < 320; x += 8, ++offset) {
-            *(px++) = D(7);
-            *(px++) = D(6);
-            *(px++) = D(5);
-            *(px++) = D(4);
-            *(px++) = D(3);
-            *(px++) = D(2);
-            *(px++) = D(1);
-            *(px++) = D(0);
-        }
-    }
+void Mode0DRenderer::render()
+{
+    render_planar(buffer_bits(), vga().planes(), vga().start_address(), 320, 200);
 }
 
 void BufferedRenderer::will_become_active()
 {
-    const_cast<Screen&>(screen()).set_screen_size(m_buffer.width() * m_scale, m_buffer.height() * m_scale);
+    const_cast<Screen&>(screen()).set_screen_size(m_width * m_scale, m_height * m_scale);
 }
 
 void BufferedRenderer::paint(QPainter& p)
 {
-    p.drawImage(QRect(0, 0, m_buffer.width() * m_scale, m_buffer.height() * m_scale), m_buffer);
+    m_frames.acquire();
+    p.drawImage(0, 0, m_frames.front());
 }
 
 void Mode0DRenderer::synchronize_colors()
 {
     for (unsigned i = 0; i < 16; ++i)
-        m_buffer.setColor(i, vga().palette_color(i).rgb());
+        set_color(i, vga().palette_color(i).rgb());
 }
 
 void Mode12Renderer::synchronize_colors()
 {
     for (unsigned i = 0; i < 16; ++i)
-        m_buffer.setColor(i, vga().palette_color(i).rgb());
+        set_color(i, vga().palette_color(i).rgb());
 }
 
 void Mode13Renderer::synchronize_colors()
 {
     for (unsigned i = 0; i < 256; ++i)
-        m_buffer.setColor(i, vga().color(i).rgb());
+        set_color(i, vga().color(i).rgb());
 }
 
 void Mode13Renderer::render()
 {
-    const u8* video_memory = vga().plane(0) + vga().start_address();
+    const u8* video_memory = reinterpret_cast<const u8*>(vga().planes());
+    u16 start_address = vga().start_address();
+    auto pixel = [&](u8 plane, u32 offset) {
+        return video_memory[((start_address + offset) & 0xffff) * 4 + plane];
+    };
 
     ValueSize mode;
     u32 line_offset = vga().read_register(0x13);
@@ -202,24 +246,21 @@ void Mode13Renderer::render()
         for (unsigned y = 0; y < 200; ++y) {
             for (unsigned x = 0; x < 320; ++x) {
                 u8 plane = x % 4;
-                u32 byte_offset = (plane * 65536) + (y * line_offset) + (x >> 2);
-                *(bit++) = video_memory[byte_offset];
+                *(bit++) = pixel(plane, (y * line_offset) + (x >> 2));
             }
         }
     } else if (mode == WordSize) {
         for (unsigned y = 0; y < 200; ++y) {
             for (unsigned x = 0; x < 320; ++x) {
                 u8 plane = x % 4;
-                u32 byte_offset = (plane * 65536) + (y * line_offset) + ((x >> 1) & ~1);
-                *(bit++) = video_memory[byte_offset];
+                *(bit++) = pixel(plane, (y * line_offset) + ((x >> 1) & ~1));
             }
         }
     } else if (mode == DWordSize) {
         for (unsigned y = 0; y < 200; ++y) {
             for (unsigned x = 0; x < 320; ++x) {
                 u8 plane = x % 4;
-                u32 byte_offset = (plane * 65536) + (y * line_offset) + (x & ~3);
-                *(bit++) = video_memory[byte_offset];
+                *(bit++) = pixel(plane, (y * line_offset) + (x & ~3));
             }
         }
     }
@@ -230,41 +271,64 @@ void TextRenderer::will_become_active()
     const_cast<Screen&>(screen()).set_screen_size(m_character_width * m_columns, m_character_height * m_rows);
 }
 
+void TextRenderer::render()
+{
+    auto& frame = m_frames.back();
+    const u32* planes = vga().planes();
+    u16 offset = vga().start_address() * 2;
+    for (auto& cell : frame.cells) {
+        u8 character = planes[offset++];
+        u8 attribute = planes[offset++];
+        cell = character | (attribute << 8);
+    }
+
+    frame.cursor_enabled = vga().cursor_enabled();
+    if (frame.cursor_enabled) {
+        u16 raw_cursor = vga().cursor_location() - vga().start_address();
+        u16 screen_columns = screen().current_column_count();
+        frame.cursor_row = screen_columns ? (raw_cursor / screen_columns) : 0;
+        frame.cursor_column = screen_columns ? (raw_cursor % screen_columns) : 0;
+        frame.cursor_start = vga().cursor_start_scanline();
+        frame.cursor_end = vga().cursor_end_scanline();
+    }
+}
+
 void TextRenderer::paint(QPainter& p)
 {
-    auto* text_ptr = vga().text_memory() + vga().start_address() * 2;
+    m_frames.acquire();
+    auto& frame = m_frames.front();
+
+    for (int i = 0; i < 16; ++i) {
+        if (m_color[i].isValid() && m_color[i].rgb() == frame.colors[i])
+            continue;
+        m_color[i] = QColor(frame.colors[i]);
+        m_brush[i] = QBrush(m_color[i]);
+    }
 
     // Repaint everything
+    const u16* cell = frame.cells.constData();
     for (int y = 0; y < m_rows; ++y) {
         for (int x = 0; x < m_columns; ++x) {
-            put_character(p, y, x, text_ptr[1], text_ptr[0]);
-            text_ptr += 2;
+            put_character(p, y, x, *cell >> 8, *cell & 0xff);
+            ++cell;
         }
     }
 
-    if (vga().cursor_enabled()) {
-        u16 raw_cursor = vga().cursor_location() - vga().start_address();
-        u16 screen_columns = screen().current_column_count();
-        u16 row = screen_columns ? (raw_cursor / screen_columns) : 0;
-        u16 column = screen_columns ? (raw_cursor % screen_columns) : 0;
-        u8 cursor_start = vga().cursor_start_scanline();
-        u8 cursor_end = vga().cursor_end_scanline();
-
+    if (frame.cursor_enabled) {
         p.fillRect(
-            column * m_character_width,
-            row * m_character_height + cursor_start,
+            frame.cursor_column * m_character_width,
+            frame.cursor_row * m_character_height + frame.cursor_start,
             m_character_width,
-            cursor_end - cursor_start,
+            frame.cursor_end - frame.cursor_start,
             m_brush[14]);
     }
 }
 
 void TextRenderer::synchronize_colors()
 {
-    for (int i = 0; i < 16; ++i) {
-        m_color[i] = vga().palette_color(i);
-        m_brush[i] = QBrush(m_color[i]);
-    }
+    auto& frame = m_frames.back();
+    for (int i = 0; i < 16; ++i)
+        frame.colors[i] = vga().palette_color(i).rgb();
 }
 
 void TextRenderer::synchronize_font()
@@ -276,3 +340,135 @@ void TextRenderer::synchronize_font()
     for (int i = 0; i < 256; ++i)
         m_character[i] = QBitmap::fromData(QSize(m_character_width, m_character_height), fbmp[i].data, QImage::Format_Mono);
 }
+
+bool VBERenderer::Layout::operator==(const Layout& other) const
+{
+    return width == other.width
+        && height == other.height
+        && bits_per_pixel == other.bits_per_pixel
+        && bytes_per_line == other.bytes_per_line
+        && display_start == other.display_start;
+}
+
+VBERenderer::VBERenderer(Screen& screen)
+    : Renderer(screen)
+{
+    for (auto& color : m_palette)
+        color = QColor(Qt::black).rgb();
+}
+
+void VBERenderer::will_become_active()
+{
+    auto& vbe = screen().machine().vbe();
+    const_cast<Screen&>(screen()).set_screen_size(vbe.width(), vbe.height());
+}
+
+void VBERenderer::synchronize_colors()
+{
+    bool changed = false;
+    for (unsigned i = 0; i < 256; ++i) {
+        QRgb color = vga().color(i).rgb();
+        if (m_palette[i] == color)
+            continue;
+        m_palette[i] = color;
+        changed = true;
+    }
+    if (changed && m_layout.bits_per_pixel == 8)
+        ++m_format_generation;
+}
+
+static inline u8 expand5(u16 component)
+{
+    return (component << 3) | (component >> 2);
+}
+
+static inline u8 expand6(u16 component)
+{
+    return (component << 2) | (component >> 4);
+}
+
+void VBERenderer::convert_line(u32* out, const u8* in) const
+{
+    switch (m_layout.bits_per_pixel) {
+    case 8:
+        for (unsigned x = 0; x < m_layout.width; ++x)
+            out[x] = m_palette[in[x]];
+        break;
+    case 15:
+        for (unsigned x = 0; x < m_layout.width; ++x, in += 2) {
+            u16 pixel = in[0] | (in[1] << 8);
+            out[x] = qRgb(expand5((pixel >> 10) & 0x1f), expand5((pixel >> 5) & 0x1f), expand5(pixel & 0x1f));
+        }
+        break;
+    case 16:
+        for (unsigned x = 0; x < m_layout.width; ++x, in += 2) {
+            u16 pixel = in[0] | (in[1] << 8);
+            out[x] = qRgb(expand5(pixel >> 11), expand6((pixel >> 5) & 0x3f), expand5(pixel & 0x1f));
+        }
+        break;
+    case 24:
+        for (unsigned x = 0; x < m_layout.width; ++x, in += 3)
+            out[x] = qRgb(in[2], in[1], in[0]);
+        break;
+    case 32:
+        // Already BGRX in memory, which is RGB32 once the unused byte is forced opaque.
+        for (unsigned x = 0; x < m_layout.width; ++x, in += 4)
+            out[x] = 0xff000000 | in[0] | (in[1] << 8) | (in[2] << 16);
+        break;
+    }
+}
+
+void VBERenderer::render()
+{
+    auto& vbe = screen().machine().vbe();
+    if (!vbe.is_enabled())
+        return;
+
+    Layout layout { vbe.width(), vbe.height(), vbe.bits_per_pixel(), vbe.bytes_per_line(), vbe.display_start() };
+    if (layout != m_layout) {
+        m_layout = layout;
+        m_line_generation.fill(0, layout.height);
+        ++m_format_generation;
+    }
+
+    u32 line_size = m_layout.width * ((m_layout.bits_per_pixel + 7) / 8);
+    auto line_fits = [&](int y) {
+        return m_layout.display_start + y * m_layout.bytes_per_line + line_size <= BochsVBE::video_memory_size;
+    };
+
+    vbe.take_dirty_pages(m_dirty_pages);
+    for (int y = 0; y < m_layout.height && line_fits(y); ++y) {
+        u32 first = m_layout.display_start + y * m_layout.bytes_per_line;
+        u32 last = first + line_size - 1;
+        for (u32 page = first >> 12; page <= last >> 12; ++page) {
+            if (m_dirty_pages[page / 64] & (1ULL << (page % 64))) {
+                ++m_line_generation[y];
+                break;
+            }
+        }
+    }
+
+    auto& frame = m_frames.back();
+    bool convert_everything = frame.format_generation != m_format_generation;
+    if (convert_everything) {
+        if (frame.image.width() != m_layout.width || frame.image.height() != m_layout.height)
+            frame.image = QImage(m_layout.width, m_layout.height, QImage::Format_RGB32);
+        frame.image.fill(QColor(Qt::black).rgb());
+        frame.line_generation.fill(0, m_layout.height);
+        frame.format_generation = m_format_generation;
+    }
+
+    const u8* video_memory = vbe.video_memory() + m_layout.display_start;
+    for (int y = 0; y < m_layout.height && line_fits(y); ++y) {
+        if (!convert_everything && frame.line_generation[y] == m_line_generation[y])
+            continue;
+        convert_line(reinterpret_cast<u32*>(frame.image.scanLine(y)), video_memory + y * m_layout.bytes_per_line);
+        frame.line_generation[y] = m_line_generation[y];
+    }
+}
+
+void VBERenderer::paint(QPainter& p)
+{
+    m_frames.acquire();
+    p.drawImage(0, 0, m_frames.front().image);
+}
@@ -24,14 +24,19 @@
 
 #pragma once
 
+#include "TripleBuffer.h"
 #include "types.h"
 #include <QBitmap>
 #include <QBrush>
 #include <QImage>
+#include <QVector>
 
 class Screen;
 class VGA;
 
+// Renderers convert guest video memory into frames on the render thread (synchronize_colors,
+// render, publish_frame), and the GUI thread paints the latest published frame. The remaining
+// hooks run on the GUI thread.
 class Renderer {
 public:
     const Screen& screen() const;
@@ -41,6 +46,7 @@ public:
     virtual void synchronize_colors() = 0;
     virtual void will_become_active() = 0;
     virtual void render() = 0;
+    virtual void publish_frame() = 0;
     virtual void paint(QPainter&) = 0;
 
 protected:
@@ -55,18 +61,27 @@ private:
 
 class TextRenderer final : public Renderer {
 public:
-    explicit TextRenderer(Screen& screen)
-        : Renderer(screen)
-    {
-    }
+    explicit TextRenderer(Screen& screen);
 
     virtual void synchronize_font() override;
     virtual void synchronize_colors() override;
     virtual void will_become_active() override;
-    virtual void render() override { }
+    virtual void render() override;
+    virtual void publish_frame() override { m_frames.publish(); }
     virtual void paint(QPainter&) override;
 
 private:
+    struct Frame {
+        // Character in the low byte, attribute in the high byte.
+        QVector<u16> cells;
+        QRgb colors[16];
+        bool cursor_enabled { false };
+        int cursor_row { 0 };
+        int cursor_column { 0 };
+        u8 cursor_start { 0 };
+        u8 cursor_end { 0 };
+    };
+
     void put_character(QPainter&, int row, int column, u8 color, u8 character);
 
     int m_rows { 25 };
@@ -74,6 +89,8 @@ private:
     int m_character_width { 8 };
     int m_character_height { 16 };
 
+    TripleBuffer<Frame> m_frames;
+
     QBitmap m_character[256];
     QBrush m_brush[16];
     QColor m_color[16];
@@ -90,6 +107,7 @@ public:
     virtual void synchronize_colors() override { }
     virtual void will_become_active() override { }
     virtual void render() override { }
+    virtual void publish_frame() override { }
     virtual void paint(QPainter&) override { }
 };
 
@@ -97,13 +115,23 @@ class BufferedRenderer : public Renderer {
 public:
     virtual void paint(QPainter&) override;
     virtual void will_become_active() override;
+    virtual void publish_frame() override;
 
 protected:
+    // Renderers write palette indices; publish_frame() expands them into a pre-scaled RGB32 frame.
     explicit BufferedRenderer(Screen&, int width, int height, int scale = 1);
-    u8* buffer_bits() { return m_buffer.bits(); }
+    u8* buffer_bits() { return m_indices.data(); }
+    u8* scan_line(int y) { return m_indices.data() + y * m_width; }
+    void set_color(int index, QRgb color) { m_palette[index] = color; }
 
-    QImage m_buffer;
+    int m_width { 0 };
+    int m_height { 0 };
     int m_scale { 1 };
+
+private:
+    QVector<u8> m_indices;
+    u32 m_palette[256];
+    TripleBuffer<QImage> m_frames;
 };
 
 class Mode04Renderer final : public BufferedRenderer {
@@ -150,3 +178,46 @@ public:
     virtual void synchronize_colors() override;
     virtual void render() override;
 };
+
+// Converts the Bochs VBE linear framebuffer, re-converting only scan lines whose pages were written.
+class VBERenderer final : public Renderer {
+public:
+    explicit VBERenderer(Screen&);
+
+    virtual void synchronize_font() override { }
+    virtual void synchronize_colors() override;
+    virtual void will_become_active() override;
+    virtual void render() override;
+    virtual void publish_frame() override { m_frames.publish(); }
+    virtual void paint(QPainter&) override;
+
+private:
+    struct Layout {
+        u16 width { 0 };
+        u16 height { 0 };
+        u8 bits_per_pixel { 0 };
+        u32 bytes_per_line { 0 };
+        u32 display_start { 0 };
+
+        bool operator==(const Layout&) const;
+        bool operator!=(const Layout& other) const { return !(*this == other); }
+    };
+
+    struct Frame {
+        QImage image;
+        // Which version of each line this frame holds, compared against m_line_generation.
+        QVector<u32> line_generation;
+        u32 format_generation { 0 };
+    };
+
+    void convert_line(u32* out, const u8* in) const;
+
+    Layout m_layout;
+    u32 m_palette[256];
+    // Bumped on any layout or palette change, forcing a full conversion of every frame.
+    u32 m_format_generation { 1 };
+    QVector<u32> m_line_generation;
+    QVector<u64> m_dirty_pages;
+
+    TripleBuffer<Frame> m_frames;
+};
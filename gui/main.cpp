@@ -22,8 +22,11 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include "Benchmark.h"
 #include "CPU.h"
 #include "Common.h"
+#include "TestSuite.h"
+#include "debug.h"
 #include "debugger.h"
 #include "iodevice.h"
 #include "machine.h"
@@ -36,16 +39,21 @@
 
 static void parse_arguments(const QStringList& arguments);
 
-RuntimeOptions options;
+RuntimeOptions g_default_options;
 
 static void sigint_handler(int)
 {
-    ASSERT(g_cpu);
-    g_cpu->debugger().enter();
+    Machine::for_each_machine([](Machine& machine) {
+        machine.cpu().queue_command(CPU::EnterDebugger);
+    });
 }
 
 void hard_exit(int exit_code)
 {
+    Machine::for_each_machine([](Machine& machine) {
+        machine.flush_disk_drives();
+        machine.cpu().flush_trace();
+    });
     exit(exit_code);
 }
 
@@ -54,7 +62,8 @@ int main(int argc, char** argv)
     OwnPtr<QCoreApplication> app;
 
     for (int i = 1; i < argc; ++i) {
-        if (QString::fromLatin1(argv[i]) == "--no-gui") {
+        auto argument = QString::fromLatin1(argv[i]);
+        if (argument == "--no-gui" || argument == "--run-suite" || argument == "--bench") {
             app = make<QCoreApplication>(argc, argv);
             break;
         }
@@ -67,14 +76,20 @@ int main(int argc, char** argv)
 
     parse_arguments(app->arguments());
 
+    if (!g_default_options.suite_path.isEmpty())
+        return run_test_suite(g_default_options.suite_path);
+
+    if (!g_default_options.bench_path.isEmpty())
+        return run_benchmarks(g_default_options.bench_path, g_default_options.bench_instruction_count);
+
     signal(SIGINT, sigint_handler);
 
     OwnPtr<Machine> machine;
 
-    if (options.autotest_path.length()) {
-        machine = Machine::create_for_autotest(options.autotest_path);
-    } else if (options.config_path.length()) {
-        machine = Machine::create_from_file(options.config_path);
+    if (g_default_options.autotest_path.length()) {
+        machine = Machine::create_for_autotest(g_default_options.autotest_path);
+    } else if (g_default_options.config_path.length()) {
+        machine = Machine::create_from_file(g_default_options.config_path);
     } else {
         machine = Machine::create_from_file(QLatin1String("default.vmf"));
     }
@@ -82,7 +97,7 @@ int main(int argc, char** argv)
     if (!machine)
         return 1;
 
-    if (options.start_in_debug)
+    if (g_default_options.start_in_debug)
         machine->cpu().debugger().enter();
 
     QFile::remove("log.txt");
@@ -109,44 +124,46 @@ void parse_arguments(const QStringList& arguments)
     for (auto it = arguments.begin(); it != arguments.end();) {
         const auto& argument = *it;
         if (argument == "--disklog")
-            options.disklog = true;
+            g_default_options.disklog = true;
 #ifdef DEBUG_SERENITY
         else if (argument == "--serenity")
-            options.serenity = true;
+            g_default_options.serenity = true;
 #endif
         else if (argument == "--trapint")
-            options.trapint = true;
+            g_default_options.trapint = true;
         else if (argument == "--memdebug")
-            options.memdebug = true;
+            g_default_options.memdebug = true;
         else if (argument == "--vlog-cycle")
-            options.vlogcycle = true;
+            g_default_options.vlogcycle = true;
         else if (argument == "--crash-on-pf")
-            options.crash_on_page_fault = true;
+            g_default_options.crash_on_page_fault = true;
         else if (argument == "--crash-on-gpf")
-            options.crash_on_general_protection_fault = true;
+            g_default_options.crash_on_general_protection_fault = true;
         else if (argument == "--crash-on-exception")
-            options.crash_on_exception = true;
+            g_default_options.crash_on_exception = true;
         else if (argument == "--pedebug")
-            options.pedebug = true;
+            g_default_options.pedebug = true;
         else if (argument == "--vgadebug")
-            options.vgadebug = true;
+            g_default_options.vgadebug = true;
         else if (argument == "--iopeek")
-            options.iopeek = true;
+            g_default_options.iopeek = true;
         else if (argument == "--trace")
-            options.trace = true;
+            g_default_options.trace = true;
         else if (argument == "--debug")
-            options.start_in_debug = true;
-        else if (argument == "--no-vlog")
-            options.novlog = true;
+            g_default_options.start_in_debug = true;
+        else if (argument == "--no-vlog") {
+            g_default_options.novlog = true;
+            set_vlog_channel_mask(0);
+        }
         else if (argument == "--no-log-exceptions")
-            options.log_exceptions = false;
+            g_default_options.log_exceptions = false;
         else if (argument == "--config") {
             ++it;
             if (it == arguments.end()) {
                 fprintf(stderr, "usage: computron --config [filename]\n");
                 hard_exit(1);
             }
-            options.config_path = (*it);
+            g_default_options.config_path = (*it);
             continue;
         } else if (argument == "--run") {
             ++it;
@@ -154,14 +171,66 @@ void parse_arguments(const QStringList& arguments)
                 fprintf(stderr, "usage: computron --run [filename]\n");
                 hard_exit(1);
             }
-            options.autotest_path = (*it);
+            g_default_options.autotest_path = (*it);
+            continue;
+        } else if (argument == "--vlog-channels") {
+            ++it;
+            if (it == arguments.end()) {
+                fprintf(stderr, "usage: computron --vlog-channels [channel,channel,...]\n");
+                hard_exit(1);
+            }
+            u32 mask = 0;
+            for (auto& name : (*it).split(QLatin1Char(','))) {
+                VLogChannel channel;
+                if (!vlog_channel_from_name(name, channel)) {
+                    fprintf(stderr, "Unknown log channel: %s\n", qPrintable(name));
+                    hard_exit(1);
+                }
+                mask |= 1u << channel;
+            }
+            set_vlog_channel_mask(mask);
+            continue;
+        } else if (argument == "--trace-file") {
+            ++it;
+            if (it == arguments.end()) {
+                fprintf(stderr, "usage: computron --trace-file [filename]\n");
+                hard_exit(1);
+            }
+            g_default_options.trace = true;
+            g_default_options.trace_path = (*it);
+            continue;
+        } else if (argument == "--run-suite") {
+            ++it;
+            if (it == arguments.end()) {
+                fprintf(stderr, "usage: computron --run-suite [directory]\n");
+                hard_exit(1);
+            }
+            g_default_options.suite_path = (*it);
+            continue;
+        } else if (argument == "--bench") {
+            ++it;
+            if (it == arguments.end()) {
+                fprintf(stderr, "usage: computron --bench [directory]\n");
+                hard_exit(1);
+            }
+            g_default_options.bench_path = (*it);
+            continue;
+        } else if (argument == "--bench-instructions") {
+            ++it;
+            bool ok = false;
+            if (it != arguments.end())
+                g_default_options.bench_instruction_count = it->toULongLong(&ok);
+            if (!ok || !g_default_options.bench_instruction_count) {
+                fprintf(stderr, "usage: computron --bench-instructions [count]\n");
+                hard_exit(1);
+            }
             continue;
         }
         ++it;
     }
 
 #ifndef CT_TRACE
-    if (options.trace) {
+    if (g_default_options.trace) {
         fprintf(stderr, "Rebuild with #define CT_TRACE if you want --trace to work.\n");
         hard_exit(1);
     }
@@ -23,6 +23,7 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "screen.h"
+#include "BochsVBE.h"
 #include "CPU.h"
 #include "Common.h"
 #include "Renderer.h"
@@ -34,8 +35,9 @@
 #include "vga.h"
 #include <QtCore/QDebug>
 #include <QtCore/QMutex>
-#include <QtCore/QQueue>
+#include <QtCore/QThread>
 #include <QtCore/QTimer>
+#include <QtCore/QWaitCondition>
 #include <QtGui/QBitmap>
 #include <QtGui/QPaintEvent>
 #include <QtGui/QPainter>
@@ -44,14 +46,31 @@ struct fontcharbitmap_t {
     u8 data[16];
 };
 
-static Screen* s_self = 0L;
+// Converts guest video memory into frames off the GUI thread. Each request renders one frame
+// with the given renderer, publishes it and asks the screen to repaint.
+class ScreenRenderThread final : public QThread {
+public:
+    explicit ScreenRenderThread(Screen& screen)
+        : m_screen(screen)
+    {
+    }
+    virtual ~ScreenRenderThread() override;
 
-struct Screen::Private {
-    QMutex key_queue_lock;
+    void request_frame(Renderer&, u8 video_mode);
 
-    QQueue<u16> key_queue;
-    QQueue<u8> raw_queue;
+private:
+    virtual void run() override;
+    void render_frame(Renderer&, u8 video_mode);
+
+    Screen& m_screen;
+    QMutex m_lock;
+    QWaitCondition m_wakeup;
+    Renderer* m_pending_renderer { nullptr };
+    u8 m_pending_video_mode { 0 };
+    bool m_should_stop { false };
+};
 
+struct Screen::Private {
     QTimer refresh_timer;
     QTimer periodic_refresh_timer;
 
@@ -60,7 +79,16 @@ struct Screen::Private {
     OwnPtr<Mode0DRenderer> mode0D_renderer;
     OwnPtr<Mode12Renderer> mode12_renderer;
     OwnPtr<Mode13Renderer> mode13_renderer;
+    OwnPtr<VBERenderer> vbe_renderer;
     OwnPtr<DummyRenderer> dummy_renderer;
+
+    u32 vbe_mode_generation_in_last_refresh { 0 };
+
+    // The renderer whose frames paintEvent() shows. Only touched on the GUI thread.
+    Renderer* active_renderer { nullptr };
+
+    // Must be last, so that the thread is stopped before the renderers go away.
+    OwnPtr<ScreenRenderThread> render_thread;
 };
 
 Screen::Screen(Machine& m)
@@ -68,14 +96,17 @@ Screen::Screen(Machine& m)
     , d(make<Private>())
     , m_machine(m)
 {
-    s_self = this;
-
     d->text_renderer = make<TextRenderer>(*this);
     d->mode04_renderer = make<Mode04Renderer>(*this);
     d->mode0D_renderer = make<Mode0DRenderer>(*this);
     d->mode12_renderer = make<Mode12Renderer>(*this);
     d->mode13_renderer = make<Mode13Renderer>(*this);
+    d->vbe_renderer = make<VBERenderer>(*this);
     d->dummy_renderer = make<DummyRenderer>(*this);
+    d->active_renderer = d->dummy_renderer.ptr();
+
+    d->render_thread = make<ScreenRenderThread>(*this);
+    d->render_thread->start();
 
     init();
 
@@ -135,39 +166,88 @@ inline bool is_video_mode_using_vga_memory(u8 video_mode)
     return video_mode == 0x0D || video_mode == 0x12 || video_mode == 0x13;
 }
 
-void Screen::refresh()
+ScreenRenderThread::~ScreenRenderThread()
 {
-    RefreshGuard guard(machine());
+    {
+        QMutexLocker locker(&m_lock);
+        m_should_stop = true;
+        m_wakeup.wakeOne();
+    }
+    wait();
+}
 
-    u8 video_mode = current_video_mode();
-    bool video_mode_changed = false;
+void ScreenRenderThread::request_frame(Renderer& renderer, u8 video_mode)
+{
+    QMutexLocker locker(&m_lock);
+    m_pending_renderer = &renderer;
+    m_pending_video_mode = video_mode;
+    m_wakeup.wakeOne();
+}
 
-    if (m_video_mode_in_last_refresh != video_mode) {
-        vlog(LogScreen, "Video mode changed to %02X", video_mode);
-        m_video_mode_in_last_refresh = video_mode;
-        video_mode_changed = true;
+void ScreenRenderThread::run()
+{
+    for (;;) {
+        Renderer* renderer;
+        u8 video_mode;
+        {
+            QMutexLocker locker(&m_lock);
+            while (!m_pending_renderer && !m_should_stop)
+                m_wakeup.wait(&m_lock);
+            if (m_should_stop)
+                return;
+            renderer = m_pending_renderer;
+            video_mode = m_pending_video_mode;
+            m_pending_renderer = nullptr;
+        }
+        render_frame(*renderer, video_mode);
     }
+}
 
-    if (video_mode_changed) {
-        renderer().will_become_active();
-    }
+// This reads VGA planes, VBE memory and registers while the CPU thread may be writing them, without
+// any locking. Like real hardware scanning out mid-update, a frame may be torn or mix old and new
+// registers; the next refresh corrects it. Locking every guest video write isn't worth that.
+void ScreenRenderThread::render_frame(Renderer& renderer, u8 video_mode)
+{
+    auto& machine = m_screen.machine();
+    RefreshGuard guard(machine);
 
     if (is_video_mode_using_vga_memory(video_mode)) {
-        if (machine().vga().is_palette_dirty()) {
-            renderer().synchronize_colors();
-            machine().vga().set_palette_dirty(false);
+        if (machine.vga().is_palette_dirty()) {
+            renderer.synchronize_colors();
+            machine.vga().set_palette_dirty(false);
         }
     }
 
-    renderer().synchronize_font();
-    renderer().synchronize_colors();
-    renderer().render();
+    renderer.synchronize_colors();
+    renderer.render();
+    renderer.publish_frame();
 
-    update();
+    QMetaObject::invokeMethod(&m_screen, "update", Qt::QueuedConnection);
+}
+
+void Screen::refresh()
+{
+    u8 video_mode = current_video_mode();
+    u32 vbe_mode_generation = machine().vbe().mode_generation();
+
+    if (m_video_mode_in_last_refresh != video_mode || d->vbe_mode_generation_in_last_refresh != vbe_mode_generation) {
+        vlog(LogScreen, "Video mode changed to %02X", video_mode);
+        m_video_mode_in_last_refresh = video_mode;
+        d->vbe_mode_generation_in_last_refresh = vbe_mode_generation;
+        d->active_renderer = &renderer();
+        d->active_renderer->will_become_active();
+    }
+
+    // Fonts become QBitmaps, which may only be created on the GUI thread.
+    d->active_renderer->synchronize_font();
+    d->render_thread->request_frame(*d->active_renderer, video_mode);
 }
 
 Renderer& Screen::renderer()
 {
+    if (machine().vbe().is_enabled())
+        return *d->vbe_renderer;
+
     switch (current_video_mode()) {
     case 0x03:
         return *d->text_renderer;
@@ -206,7 +286,7 @@ void Screen::resizeEvent(QResizeEvent* e)
 void Screen::paintEvent(QPaintEvent*)
 {
     QPainter p(this);
-    renderer().paint(p);
+    d->active_renderer->paint(p);
 }
 
 u8 Screen::current_video_mode() const
@@ -268,7 +348,6 @@ void Screen::mouseReleaseEvent(QMouseEvent* e)
 #include <QDebug>
 #include <QHash>
 #include <QKeyEvent>
-#include <QMutexLocker>
 
 static QHash<QString, u16> normals;
 static QHash<QString, u16> shifts;
@@ -514,19 +593,19 @@ void Screen::keyPressEvent(QKeyEvent* event)
     else if (key_name == "F12")
         releaseMouse();
 
-    QMutexLocker locker(&d->key_queue_lock);
+    auto& keyboard = machine().keyboard();
 
     if (scancode != 0) {
-        d->key_queue.enqueue(scancode);
+        keyboard.enqueue_key(scancode);
         //printf("Queued %04X (%s)\n", scancode, qPrintable(key_name));
     }
 
     if (extended[key_name])
-        d->raw_queue.enqueue(0xE0);
+        keyboard.enqueue_raw(0xE0);
 
-    d->raw_queue.enqueue(make_code[key_name]);
+    keyboard.enqueue_raw(make_code[key_name]);
 
-    machine().keyboard().did_enqueue_data();
+    keyboard.did_enqueue_data();
 }
 
 void Screen::keyReleaseEvent(QKeyEvent* event)
@@ -542,87 +621,20 @@ void Screen::keyReleaseEvent(QKeyEvent* event)
         return;
     }
 
-    QMutexLocker l(&d->key_queue_lock);
     QString key_name = key_name_from_key_event(event);
+    auto& keyboard = machine().keyboard();
 
     if (extended[key_name])
-        d->raw_queue.enqueue(0xE0);
+        keyboard.enqueue_raw(0xE0);
 
-    d->raw_queue.enqueue(break_code[key_name]);
-    machine().keyboard().did_enqueue_data();
+    keyboard.enqueue_raw(break_code[key_name]);
+    keyboard.did_enqueue_data();
     event->ignore();
 }
 
-u16 Screen::next_key()
-{
-    QMutexLocker l(&d->key_queue_lock);
-
-    d->raw_queue.clear();
-    if (!d->key_queue.isEmpty())
-        return d->key_queue.dequeue();
-
-    return 0;
-}
-
-u16 Screen::peek_key()
-{
-    QMutexLocker l(&d->key_queue_lock);
-
-    d->raw_queue.clear();
-    if (!d->key_queue.isEmpty())
-        return d->key_queue.head();
-
-    return 0;
-}
-
-u8 Screen::pop_key_data()
-{
-    QMutexLocker l(&d->key_queue_lock);
-
-    u8 key = 0;
-    if (!d->raw_queue.isEmpty())
-        key = d->raw_queue.dequeue();
-    return key;
-}
-
-bool Screen::has_raw_key()
-{
-    QMutexLocker l(&d->key_queue_lock);
-    return !d->raw_queue.isEmpty();
-}
-
 void Screen::flush_key_buffer()
 {
-    QMutexLocker l(&d->key_queue_lock);
-
-    if (!d->raw_queue.isEmpty() && machine().cpu().get_if())
+    // Keep nudging the CPU thread while the guest hasn't picked up everything yet.
+    if (machine().keyboard().has_raw_data())
         machine().keyboard().did_enqueue_data();
 }
-
-bool kbd_has_data()
-{
-    if (!s_self)
-        return false;
-    return s_self->has_raw_key();
-}
-
-u16 kbd_getc()
-{
-    if (!s_self)
-        return 0x0000;
-    return s_self->next_key();
-}
-
-u16 kbd_hit()
-{
-    if (!s_self)
-        return 0x0000;
-    return s_self->peek_key();
-}
-
-u8 kbd_pop_raw()
-{
-    if (!s_self)
-        return 0x00;
-    return s_self->pop_key_data();
-}
@@ -49,11 +49,6 @@ public:
     u8 current_row_count() const;
     u8 current_column_count() const;
 
-    u16 next_key();
-    u16 peek_key();
-    u8 pop_key_data();
-    bool has_raw_key();
-
     void set_screen_size(int width, int height);
 
 protected:
@@ -41,6 +41,11 @@ void Worker::run()
     m_machine.make_cpu(Badge<Worker>());
     m_machine.make_devices(Badge<Worker>());
     m_machine.did_initialize_worker(Badge<Worker>());
+
+    // Autotest machines are driven by the thread that created them.
+    if (m_machine.is_for_autotest())
+        return;
+
     while (true) {
         m_machine.cpu().main_loop();
         msleep(50);
@@ -0,0 +1,323 @@
+// Computron x86 PC Emulator
+// Copyright (C) 2003-2018 Andreas Kling <awesomekling@gmail.com>
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY ANDREAS KLING ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL ANDREAS KLING OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "BochsVBE.h"
+#include "CPU.h"
+#include "debug.h"
+#include "machine.h"
+#include <algorithm>
+#include <string.h>
+
+//#define VBE_DEBUG
+
+enum DispiRegister {
+    Id = 0,
+    XResolution,
+    YResolution,
+    BitsPerPixel,
+    Enable,
+    Bank,
+    VirtualWidth,
+    VirtualHeight,
+    XOffset,
+    YOffset,
+    VideoMemory64K,
+    RegisterCount
+};
+
+enum DispiEnable {
+    Enabled = 0x01,
+    GetCapabilities = 0x02,
+    DAC8Bit = 0x20,
+    LinearFramebufferEnabled = 0x40,
+    NoClearMemory = 0x80,
+};
+
+static const u16 dispi_id0 = 0xb0c0;
+static const u16 dispi_id5 = 0xb0c5;
+
+struct BochsVBE::Private {
+    u16 register_index { 0 };
+    u16 reg[RegisterCount];
+};
+
+BochsVBE::BochsVBE(Machine& machine)
+    : IODevice("BochsVBE", machine)
+    , MemoryProvider(PhysicalAddress(linear_framebuffer_address), video_memory_size)
+    , d(make<Private>())
+{
+    // Slack at the end so that a direct multi-byte read of the last byte stays in bounds.
+    m_memory = new u8[video_memory_size + sizeof(u32)];
+    m_pointer_for_direct_read_access = m_memory;
+
+    machine.cpu().register_memory_provider(*this);
+
+    listen<BochsVBE>(0x1ce, IODevice::ReadWrite);
+    listen<BochsVBE>(0x1cf, IODevice::ReadWrite);
+
+    reset();
+}
+
+BochsVBE::~BochsVBE()
+{
+    delete[] m_memory;
+}
+
+void BochsVBE::reset()
+{
+    d->register_index = 0;
+    memset(d->reg, 0, sizeof(d->reg));
+    d->reg[Id] = dispi_id5;
+    d->reg[XResolution] = 640;
+    d->reg[YResolution] = 480;
+    d->reg[BitsPerPixel] = 8;
+    d->reg[VideoMemory64K] = video_memory_size / 65536;
+
+    memset(m_memory, 0, video_memory_size + sizeof(u32));
+    for (auto& word : m_dirty_pages)
+        word.store(0, std::memory_order_relaxed);
+
+    m_enabled = false;
+    did_change_mode();
+}
+
+static bool is_supported_bits_per_pixel(u16 bpp)
+{
+    return bpp == 8 || bpp == 15 || bpp == 16 || bpp == 24 || bpp == 32;
+}
+
+// How many lines of `bytes_per_line` fit in video memory. The register is only 16 bits wide,
+// and narrow 8 bpp modes fit more lines than that.
+static u16 virtual_height_for(u32 bytes_per_line)
+{
+    if (!bytes_per_line)
+        return 0;
+    return std::min<u32>(BochsVBE::video_memory_size / bytes_per_line, 0xffff);
+}
+
+u16 BochsVBE::width() const
+{
+    return d->reg[XResolution];
+}
+
+u16 BochsVBE::height() const
+{
+    return d->reg[YResolution];
+}
+
+u8 BochsVBE::bits_per_pixel() const
+{
+    return d->reg[BitsPerPixel];
+}
+
+u32 BochsVBE::bytes_per_line() const
+{
+    return d->reg[VirtualWidth] * ((d->reg[BitsPerPixel] + 7) / 8);
+}
+
+u32 BochsVBE::display_start() const
+{
+    return d->reg[YOffset] * bytes_per_line() + d->reg[XOffset] * ((d->reg[BitsPerPixel] + 7) / 8);
+}
+
+void BochsVBE::did_change_mode()
+{
+    m_mode_generation.fetch_add(1, std::memory_order_release);
+    machine().notify_screen();
+}
+
+u16 BochsVBE::in16(u16 port)
+{
+    if (port == 0x1ce)
+        return d->register_index;
+
+    ASSERT(port == 0x1cf);
+    if (d->register_index >= RegisterCount) {
+        vlog(LogVGA, "DISPI: Read from invalid register %u", d->register_index);
+        return 0;
+    }
+
+    if (d->reg[Enable] & GetCapabilities) {
+        switch (d->register_index) {
+        case XResolution:
+            return max_width;
+        case YResolution:
+            return max_height;
+        case BitsPerPixel:
+            return 32;
+        }
+    }
+    return d->reg[d->register_index];
+}
+
+void BochsVBE::out16(u16 port, u16 data)
+{
+    if (port == 0x1ce) {
+        d->register_index = data;
+        return;
+    }
+
+    ASSERT(port == 0x1cf);
+#ifdef VBE_DEBUG
+    vlog(LogVGA, "DISPI: Register %u <- %04x", d->register_index, data);
+#endif
+
+    switch (d->register_index) {
+    case Id:
+        if (data >= dispi_id0 && data <= dispi_id5)
+            d->reg[Id] = data;
+        break;
+    case XResolution:
+    case YResolution:
+    case BitsPerPixel:
+        if (m_enabled) {
+            vlog(LogVGA, "DISPI: Ignoring write to register %u while enabled", d->register_index);
+            break;
+        }
+        d->reg[d->register_index] = data;
+        break;
+    case Enable: {
+        bool enable = data & Enabled;
+        if (enable && !m_enabled) {
+            if (!is_supported_bits_per_pixel(bits_per_pixel()) || !width() || !height() || width() > max_width || height() > max_height) {
+                vlog(LogVGA, "DISPI: Unsupported mode %ux%ux%u", width(), height(), bits_per_pixel());
+                d->reg[Enable] = data & ~Enabled;
+                break;
+            }
+            d->reg[VirtualWidth] = width();
+            d->reg[VirtualHeight] = virtual_height_for(bytes_per_line());
+            d->reg[XOffset] = 0;
+            d->reg[YOffset] = 0;
+            d->reg[Bank] = 0;
+            if (!(data & NoClearMemory))
+                memset(m_memory, 0, video_memory_size);
+            vlog(LogVGA, "DISPI: Enabled %ux%ux%u", width(), height(), bits_per_pixel());
+        }
+        // The DAC only does 6 bits per component; guests probe for this by reading the bit back.
+        d->reg[Enable] = data & ~DAC8Bit;
+        if (enable != m_enabled) {
+            m_enabled = enable;
+            did_change_mode();
+        }
+        break;
+    }
+    case Bank:
+        if (data >= video_memory_size / 65536) {
+            vlog(LogVGA, "DISPI: Invalid bank %u", data);
+            break;
+        }
+        d->reg[Bank] = data;
+        break;
+    case VirtualWidth:
+        if (data < width() || (u32)data * ((bits_per_pixel() + 7) / 8) * height() > video_memory_size) {
+            vlog(LogVGA, "DISPI: Invalid virtual width %u", data);
+            break;
+        }
+        d->reg[VirtualWidth] = data;
+        d->reg[VirtualHeight] = virtual_height_for(bytes_per_line());
+        machine().notify_screen();
+        break;
+    case XOffset:
+    case YOffset:
+        d->reg[d->register_index] = data;
+        if (display_start() + (height() - 1) * bytes_per_line() + width() * ((bits_per_pixel() + 7) / 8) > video_memory_size) {
+            vlog(LogVGA, "DISPI: Display offset %u,%u out of range", d->reg[XOffset], d->reg[YOffset]);
+            d->reg[d->register_index] = 0;
+        }
+        machine().notify_screen();
+        break;
+    case VirtualHeight:
+    case VideoMemory64K:
+        break;
+    default:
+        vlog(LogVGA, "DISPI: Write to invalid register %u <- %04x", d->register_index, data);
+        break;
+    }
+}
+
+ALWAYS_INLINE void BochsVBE::mark_dirty(u32 offset, u32 size)
+{
+    // The data is stored before the bit is checked; a write racing with take_dirty_pages()
+    // shows up with the next write to the same page at the latest.
+    for (u32 page = offset >> 12; page <= (offset + size - 1) >> 12; ++page) {
+        auto& word = m_dirty_pages[page / 64];
+        u64 bit = 1ULL << (page % 64);
+        if (LIKELY(word.load(std::memory_order_relaxed) & bit))
+            continue;
+        word.fetch_or(bit, std::memory_order_release);
+        machine().notify_screen();
+    }
+}
+
+void BochsVBE::take_dirty_pages(QVector<u64>& pages)
+{
+    constexpr int word_count = sizeof(m_dirty_pages) / sizeof(m_dirty_pages[0]);
+    pages.resize(word_count);
+    for (int i = 0; i < word_count; ++i)
+        pages[i] = m_dirty_pages[i].exchange(0, std::memory_order_acquire);
+}
+
+template<typename T>
+ALWAYS_INLINE void BochsVBE::write_video_memory(u32 offset, T data)
+{
+    if (offset > video_memory_size - sizeof(T))
+        return;
+    memcpy(&m_memory[offset], &data, sizeof(T));
+    mark_dirty(offset, sizeof(T));
+}
+
+const u8* BochsVBE::memory_pointer(u32 address) const
+{
+    return &m_memory[address - base_address().get()];
+}
+
+u8 BochsVBE::read_memory8(u32 address)
+{
+    return m_memory[address - base_address().get()];
+}
+
+void BochsVBE::write_memory8(u32 address, u8 data)
+{
+    write_video_memory(address - base_address().get(), data);
+}
+
+void BochsVBE::write_memory16(u32 address, u16 data)
+{
+    write_video_memory(address - base_address().get(), data);
+}
+
+void BochsVBE::write_memory32(u32 address, u32 data)
+{
+    write_video_memory(address - base_address().get(), data);
+}
+
+u8 BochsVBE::read_banked(u32 offset)
+{
+    return m_memory[d->reg[Bank] * 65536 + (offset & 0xffff)];
+}
+
+void BochsVBE::write_banked(u32 offset, u8 data)
+{
+    write_video_memory<u8>(d->reg[Bank] * 65536 + (offset & 0xffff), data);
+}
@@ -0,0 +1,89 @@
+// Computron x86 PC Emulator
+// Copyright (C) 2003-2018 Andreas Kling <awesomekling@gmail.com>
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY ANDREAS KLING ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL ANDREAS KLING OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "MemoryProvider.h"
+#include "OwnPtr.h"
+#include "iodevice.h"
+#include <QVector>
+#include <atomic>
+
+// Bochs/QEMU "DISPI" display interface. Port 1CEh selects a register and 1CFh accesses it.
+// Video memory is mapped as a linear framebuffer above RAM, and in 64 KiB banks at A0000h.
+class BochsVBE final : public IODevice
+    , public MemoryProvider {
+public:
+    static constexpr u32 linear_framebuffer_address = 0xe0000000;
+    static constexpr u32 video_memory_size = 16 * 1048576;
+    static constexpr u16 max_width = 1920;
+    static constexpr u16 max_height = 1200;
+
+    explicit BochsVBE(Machine&);
+    virtual ~BochsVBE();
+
+    // IODevice
+    virtual void reset() override;
+    virtual u16 in16(u16 port) override;
+    virtual void out16(u16 port, u16 data) override;
+
+    // MemoryProvider
+    virtual const u8* memory_pointer(u32 address) const override;
+    virtual u8 read_memory8(u32 address) override;
+    virtual void write_memory8(u32 address, u8) override;
+    virtual void write_memory16(u32 address, u16) override;
+    virtual void write_memory32(u32 address, u32) override;
+
+    bool is_enabled() const { return m_enabled; }
+
+    u8 read_banked(u32 offset);
+    void write_banked(u32 offset, u8);
+
+    // Bumped whenever the guest enables, disables or reconfigures the display.
+    u32 mode_generation() const { return m_mode_generation.load(std::memory_order_acquire); }
+
+    u16 width() const;
+    u16 height() const;
+    u8 bits_per_pixel() const;
+    u32 bytes_per_line() const;
+    u32 display_start() const;
+    const u8* video_memory() const { return m_memory; }
+
+    // Moves the set of 4 KiB pages written since the previous call into `pages`.
+    void take_dirty_pages(QVector<u64>& pages);
+
+private:
+    template<typename T>
+    void write_video_memory(u32 offset, T);
+    void mark_dirty(u32 offset, u32 size);
+    void did_change_mode();
+
+    u8* m_memory { nullptr };
+    bool m_enabled { false };
+    std::atomic<u32> m_mode_generation { 0 };
+    std::atomic<u64> m_dirty_pages[video_memory_size / 4096 / 64];
+
+    struct Private;
+    OwnPtr<Private> d;
+};
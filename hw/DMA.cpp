@@ -23,20 +23,86 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "DMA.h"
+#include "CPU.h"
+#include "machine.h"
+#include <string.h>
+
+//#define DMA_DEBUG
+
+// Spec: Intel 8237A High Performance Programmable DMA Controller
+
+enum DMAModeBits {
+    TransferTypeMask = 0x0c,
+    VerifyTransfer = 0x00,
+    WriteTransfer = 0x04,
+    ReadTransfer = 0x08,
+    AutoInitialize = 0x10,
+    AddressDecrement = 0x20,
+};
+
+struct DMAChannel {
+    u16 base_address { 0 };
+    u16 base_count { 0 };
+    u16 current_address { 0 };
+    u16 current_count { 0 };
+    u8 page { 0 };
+    u8 mode { 0 };
+    bool masked { true };
+    bool reached_terminal_count { false };
+};
+
+struct DMAController {
+    DMAChannel channel[4];
+    bool flip_flop { false };
+    u8 status { 0 };
+    u8 command { 0 };
+    u8 request { 0 };
+
+    void master_clear()
+    {
+        flip_flop = false;
+        status = 0;
+        command = 0;
+        request = 0;
+        for (auto& c : channel)
+            c.masked = true;
+    }
+};
 
 struct DMA::Private {
+    // Controller 0 handles 8-bit channels 0-3, controller 1 handles 16-bit channels 4-7.
+    DMAController controller[2];
+    u8 page_register_scratch[16];
+
+    DMAController& controller_for_channel(u8 channel) { return controller[channel >> 2]; }
+    DMAChannel& channel(u8 channel) { return controller_for_channel(channel).channel[channel & 3]; }
+    const DMAChannel& channel(u8 channel) const { return controller[channel >> 2].channel[channel & 3]; }
 };
 
+// Page register port offsets (from 0x80) for channels 0-7.
+static const u8 page_register_for_channel[8] = { 0x7, 0x3, 0x1, 0x2, 0xf, 0xb, 0x9, 0xa };
+
+static int channel_for_page_register(u8 offset)
+{
+    for (unsigned i = 0; i < 8; ++i) {
+        if (page_register_for_channel[i] == offset)
+            return i;
+    }
+    return -1;
+}
+
 DMA::DMA(Machine& machine)
     : IODevice("DMA", machine)
     , d(make<Private>())
 {
     for (size_t i = 0; i <= 0xf; ++i)
-        listen(i, IODevice::ReadWrite);
+        listen<DMA>(i, IODevice::ReadWrite);
     for (size_t i = 0x80; i <= 0x8f; ++i)
-        listen(i, IODevice::ReadWrite);
+        listen<DMA>(i, IODevice::ReadWrite);
     for (size_t i = 0xc0; i <= 0xde; i += 2)
-        listen(i, IODevice::ReadWrite);
+        listen<DMA>(i, IODevice::ReadWrite);
+
+    reset();
 }
 
 DMA::~DMA()
@@ -45,6 +111,149 @@ DMA::~DMA()
 
 void DMA::reset()
 {
+    for (auto& controller : d->controller) {
+        controller.master_clear();
+        for (auto& channel : controller.channel)
+            channel = DMAChannel();
+    }
+    memset(d->page_register_scratch, 0, sizeof(d->page_register_scratch));
+}
+
+bool DMA::is_channel_masked(u8 channel) const
+{
+    ASSERT(channel < 8);
+    return d->channel(channel).masked;
+}
+
+bool DMA::has_reached_terminal_count(u8 channel) const
+{
+    ASSERT(channel < 8);
+    return d->channel(channel).reached_terminal_count;
+}
+
+unsigned DMA::write_to_memory(u8 channel, const u8* data, unsigned size)
+{
+    return transfer(channel, Direction::ToMemory, const_cast<u8*>(data), size);
+}
+
+unsigned DMA::read_from_memory(u8 channel, u8* data, unsigned size)
+{
+    return transfer(channel, Direction::FromMemory, data, size);
+}
+
+unsigned DMA::transfer(u8 channel_index, Direction direction, u8* data, unsigned size)
+{
+    ASSERT(channel_index < 8);
+    auto& controller = d->controller_for_channel(channel_index);
+    auto& channel = d->channel(channel_index);
+    bool is_16bit = channel_index >= 4;
+    unsigned unit_size = is_16bit ? 2 : 1;
+
+    if (channel.masked) {
+        vlog(LogDMA, "Transfer on masked channel %u", channel_index);
+        return 0;
+    }
+
+    u8 type = channel.mode & TransferTypeMask;
+    if (type != VerifyTransfer && type != (direction == Direction::ToMemory ? WriteTransfer : ReadTransfer)) {
+        vlog(LogDMA, "Channel %u programmed for the wrong direction (mode %02x)", channel_index, channel.mode);
+        return 0;
+    }
+
+#ifdef DMA_DEBUG
+    vlog(LogDMA, "Channel %u %s %u bytes @ page %02x, address %04x, count %04x",
+        channel_index, direction == Direction::ToMemory ? "writing" : "reading", size, channel.page, channel.current_address, channel.current_count);
+#endif
+
+    channel.reached_terminal_count = false;
+
+    unsigned transferred = 0;
+    while (transferred + unit_size <= size) {
+        PhysicalAddress address = is_16bit
+            ? PhysicalAddress(((channel.page & 0xfe) << 16) | (channel.current_address << 1))
+            : PhysicalAddress((channel.page << 16) | channel.current_address);
+
+        if (type == WriteTransfer) {
+            if (is_16bit)
+                machine().cpu().write_physical_memory<u16>(address, data[transferred] | (data[transferred + 1] << 8));
+            else
+                machine().cpu().write_physical_memory<u8>(address, data[transferred]);
+        } else if (type == ReadTransfer) {
+            if (is_16bit) {
+                u16 value = machine().cpu().read_physical_memory<u16>(address);
+                data[transferred] = value & 0xff;
+                data[transferred + 1] = value >> 8;
+            } else {
+                data[transferred] = machine().cpu().read_physical_memory<u8>(address);
+            }
+        }
+        transferred += unit_size;
+
+        // The address wraps within the 64K (or 128K) page, just like the real thing.
+        if (channel.mode & AddressDecrement)
+            --channel.current_address;
+        else
+            ++channel.current_address;
+
+        if (channel.current_count--)
+            continue;
+
+        // Terminal count.
+        controller.status |= 1 << (channel_index & 3);
+        channel.reached_terminal_count = true;
+        if (channel.mode & AutoInitialize) {
+            channel.current_address = channel.base_address;
+            channel.current_count = channel.base_count;
+        } else {
+            channel.masked = true;
+        }
+        break;
+    }
+    return transferred;
+}
+
+u8 DMA::in8(u16 port)
+{
+    if (port >= 0x80 && port <= 0x8f) {
+        int channel = channel_for_page_register(port - 0x80);
+        if (channel != -1)
+            return d->channel(channel).page;
+        return d->page_register_scratch[port - 0x80];
+    }
+
+    bool is_secondary = port >= 0xc0;
+    auto& controller = d->controller[is_secondary];
+    u8 reg = is_secondary ? (port - 0xc0) >> 1 : port;
+    u8 data = 0;
+
+    if (reg < 8) {
+        auto& channel = controller.channel[reg >> 1];
+        u16 value = (reg & 1) ? channel.current_count : channel.current_address;
+        data = controller.flip_flop ? (value >> 8) : (value & 0xff);
+        controller.flip_flop = !controller.flip_flop;
+    } else {
+        switch (reg) {
+        case 0x8:
+            data = controller.status | (controller.request << 4);
+            // Reading the status register clears the terminal count bits.
+            controller.status = 0;
+            break;
+        case 0xf:
+            for (unsigned i = 0; i < 4; ++i)
+                data |= controller.channel[i].masked << i;
+            data |= 0xf0;
+            break;
+        default:
+            vlog(LogDMA, "Read from unsupported register %04x", port);
+            data = IODevice::JunkValue;
+            break;
+        }
+    }
+
+#ifdef DMA_DEBUG
+    vlog(LogDMA, "in %04x = %02x", port, data);
+#endif
+    return data;
 }
 
 void DMA::out8(u16 port, u8 data)
@@ -54,11 +263,65 @@ void DMA::out8(u16 port, u8 data)
         return;
     }
 
+#ifdef DMA_DEBUG
     vlog(LogDMA, "out %04x <- %02x", port, data);
-}
+#endif
 
-u8 DMA::in8(u16 port)
-{
-    vlog(LogDMA, "in %04x", port);
-    return 0;
+    if (port >= 0x81 && port <= 0x8f) {
+        int channel = channel_for_page_register(port - 0x80);
+        if (channel != -1)
+            d->channel(channel).page = data;
+        else
+            d->page_register_scratch[port - 0x80] = data;
+        return;
+    }
+
+    bool is_secondary = port >= 0xc0;
+    auto& controller = d->controller[is_secondary];
+    u8 reg = is_secondary ? (port - 0xc0) >> 1 : port;
+
+    if (reg < 8) {
+        auto& channel = controller.channel[reg >> 1];
+        u16& base = (reg & 1) ? channel.base_count : channel.base_address;
+        u16& current = (reg & 1) ? channel.current_count : channel.current_address;
+        if (controller.flip_flop)
+            base = (base & 0x00ff) | (data << 8);
+        else
+            base = (base & 0xff00) | data;
+        current = base;
+        controller.flip_flop = !controller.flip_flop;
+        return;
+    }
+
+    switch (reg) {
+    case 0x8:
+        controller.command = data;
+        break;
+    case 0x9:
+        if (data & 4)
+            controller.request |= 1 << (data & 3);
+        else
+            controller.request &= ~(1 << (data & 3));
+        break;
+    case 0xa:
+        controller.channel[data & 3].masked = data & 4;
+        break;
+    case 0xb:
+        controller.channel[data & 3].mode = data;
+        break;
+    case 0xc:
+        controller.flip_flop = false;
+        break;
+    case 0xd:
+        controller.master_clear();
+        break;
+    case 0xe:
+        for (auto& channel : controller.channel)
+            channel.masked = false;
+        break;
+    case 0xf:
+        for (unsigned i = 0; i < 4; ++i)
+            controller.channel[i].masked = data & (1 << i);
+        break;
+    }
 }
@@ -36,7 +36,21 @@ public:
     virtual u8 in8(u16 port) override;
     virtual void out8(u16 port, u8 data) override;
 
+    // Device side of a transfer on one of the 8 channels.
+    // These return the number of bytes moved, which comes up short if the channel reaches terminal count.
+    unsigned write_to_memory(u8 channel, const u8* data, unsigned size);
+    unsigned read_from_memory(u8 channel, u8* data, unsigned size);
+
+    bool is_channel_masked(u8 channel) const;
+    bool has_reached_terminal_count(u8 channel) const;
+
 private:
+    enum class Direction {
+        ToMemory,
+        FromMemory,
+    };
+    unsigned transfer(u8 channel, Direction, u8* data, unsigned size);
+
     struct Private;
     OwnPtr<Private> d;
 };
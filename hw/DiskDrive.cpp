@@ -23,6 +23,13 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "DiskDrive.h"
+#include "Common.h"
+#include "debug.h"
+#include <QVector>
+#include <algorithm>
+#include <string.h>
+
+//#define DISK_CACHE_DEBUG
 
 DiskDrive::DiskDrive(const QString& name)
     : m_name(name)
@@ -31,16 +38,263 @@ DiskDrive::DiskDrive(const QString& name)
 
 DiskDrive::~DiskDrive()
 {
+    flush();
+    close_image();
 }
 
 void DiskDrive::set_configuration(Configuration config)
 {
+    flush();
+    close_image();
+    invalidate_cache();
     m_config = std::move(config);
     m_present = !m_config.image_path.isEmpty();
 }
 
 void DiskDrive::set_image_path(const QString& path)
 {
+    flush();
+    close_image();
+    invalidate_cache();
     m_config.image_path = path;
     m_present = !m_config.image_path.isEmpty();
 }
+
+void DiskDrive::set_cache_size_in_kilobytes(unsigned size)
+{
+    m_cache_size_in_kilobytes = size;
+    evict_if_needed();
+}
+
+void DiskDrive::reset_cache_statistics()
+{
+    m_cache_hits = 0;
+    m_cache_misses = 0;
+    m_read_ahead_sectors = 0;
+}
+
+bool DiskDrive::open_image_if_needed()
+{
+    if (m_file)
+        return true;
+    if (!present())
+        return false;
+    m_read_only = false;
+    m_file = fopen(qPrintable(image_path()), "rb+");
+    if (!m_file) {
+        m_read_only = true;
+        m_file = fopen(qPrintable(image_path()), "rb");
+    }
+    if (!m_file) {
+        vlog(LogDisk, "%s: Could not open image %s", qPrintable(name()), qPrintable(image_path()));
+        return false;
+    }
+    if (m_read_only)
+        vlog(LogDisk, "%s: Image %s is read-only", qPrintable(name()), qPrintable(image_path()));
+    return true;
+}
+
+void DiskDrive::close_image()
+{
+    if (!m_file)
+        return;
+    fclose(m_file);
+    m_file = nullptr;
+}
+
+void DiskDrive::invalidate_cache()
+{
+    ASSERT(!m_dirty_count);
+    m_cache.clear();
+    m_lru.clear();
+    m_next_sequential_lba = 0xffffffff;
+}
+
+DiskDrive::CachedSector* DiskDrive::cached_sector(u32 lba)
+{
+    auto it = m_cache.find(lba);
+    if (it == m_cache.end())
+        return nullptr;
+    m_lru.splice(m_lru.begin(), m_lru, it->lru_position);
+    return &it.value();
+}
+
+DiskDrive::CachedSector& DiskDrive::insert_sector(u32 lba, const u8* data)
+{
+    ASSERT(!m_cache.contains(lba));
+    m_lru.push_front(lba);
+    auto& sector = m_cache[lba];
+    sector.data = QByteArray(reinterpret_cast<const char*>(data), bytes_per_sector());
+    sector.lru_position = m_lru.begin();
+    return sector;
+}
+
+bool DiskDrive::write_back(u32 lba, const CachedSector& sector)
+{
+    ASSERT(m_file);
+    if (fseek(m_file, (long)lba * bytes_per_sector(), SEEK_SET) < 0
+        || fwrite(sector.data.constData(), bytes_per_sector(), 1, m_file) != 1) {
+        vlog(LogDisk, "%s: Failed to write back sector %u", qPrintable(name()), lba);
+        return false;
+    }
+    return true;
+}
+
+void DiskDrive::evict_if_needed()
+{
+    while ((unsigned)m_cache.size() > cache_capacity()) {
+        u32 lba = m_lru.back();
+        auto it = m_cache.find(lba);
+        ASSERT(it != m_cache.end());
+        if (it->dirty) {
+            write_back(lba, *it);
+            --m_dirty_count;
+        }
+        m_cache.erase(it);
+        m_lru.pop_back();
+    }
+}
+
+bool DiskDrive::fill_from_image(u32 lba, unsigned count)
+{
+    if (!open_image_if_needed())
+        return false;
+
+    QByteArray data(count * bytes_per_sector(), 0);
+    if (fseek(m_file, (long)lba * bytes_per_sector(), SEEK_SET) < 0) {
+        vlog(LogDisk, "%s: Failed to seek to sector %u", qPrintable(name()), lba);
+        return false;
+    }
+    // A short read just means the image is smaller than the drive geometry; the rest reads as zeroes.
+    fread(data.data(), bytes_per_sector(), count, m_file);
+
+    for (unsigned i = 0; i < count; ++i) {
+        if (!m_cache.contains(lba + i))
+            insert_sector(lba + i, reinterpret_cast<const u8*>(data.constData()) + i * bytes_per_sector());
+    }
+    return true;
+}
+
+bool DiskDrive::read_sectors(u32 lba, unsigned count, u8* buffer)
+{
+    if (!open_image_if_needed())
+        return false;
+
+    bool is_sequential = lba == m_next_sequential_lba;
+    m_next_sequential_lba = lba + count;
+
+    unsigned capacity = cache_capacity();
+    if (!capacity) {
+        m_cache_misses += count;
+        memset(buffer, 0, count * bytes_per_sector());
+        if (fseek(m_file, (long)lba * bytes_per_sector(), SEEK_SET) < 0)
+            return false;
+        fread(buffer, bytes_per_sector(), count, m_file);
+        return true;
+    }
+
+    // Sectors of this request that the last fill brought in. They were misses, even though they're cached by the time we get to them.
+    unsigned filled_sectors_remaining = 0;
+
+    for (unsigned i = 0; i < count; ++i) {
+        u32 current_lba = lba + i;
+        auto* sector = cached_sector(current_lba);
+        if (sector) {
+            if (filled_sectors_remaining) {
+                --filled_sectors_remaining;
+                ++m_cache_misses;
+            } else {
+                ++m_cache_hits;
+            }
+        } else {
+            ++m_cache_misses;
+
+            // Fetch the whole run of missing sectors with a single read.
+            unsigned run = 1;
+            while (i + run < count && run < capacity && !m_cache.contains(current_lba + run))
+                ++run;
+            filled_sectors_remaining = run - 1;
+
+            // If the guest is streaming through the disk, grab what it's likely to ask for next.
+            if (is_sequential && i + run == count) {
+                unsigned read_ahead = std::min(read_ahead_sector_count, capacity / 4);
+                unsigned extended = 0;
+                while (extended < read_ahead && run + extended < capacity && current_lba + run + extended < sectors() && !m_cache.contains(current_lba + run + extended))
+                    ++extended;
+                run += extended;
+                m_read_ahead_sectors += extended;
+            }
+
+#ifdef DISK_CACHE_DEBUG
+            vlog(LogDisk, "%s: Cache miss at LBA %u, reading %u sectors", qPrintable(name()), current_lba, run);
+#endif
+            if (!fill_from_image(current_lba, run))
+                return false;
+            sector = cached_sector(current_lba);
+            ASSERT(sector);
+        }
+        memcpy(buffer + i * bytes_per_sector(), sector->data.constData(), bytes_per_sector());
+        evict_if_needed();
+    }
+    return true;
+}
+
+bool DiskDrive::write_sectors(u32 lba, unsigned count, const u8* buffer)
+{
+    if (!open_image_if_needed())
+        return false;
+
+    if (m_read_only) {
+        vlog(LogDisk, "%s: Refusing write to read-only image", qPrintable(name()));
+        return false;
+    }
+
+    if (!cache_capacity()) {
+        if (fseek(m_file, (long)lba * bytes_per_sector(), SEEK_SET) < 0)
+            return false;
+        return fwrite(buffer, bytes_per_sector(), count, m_file) == count;
+    }
+
+    for (unsigned i = 0; i < count; ++i) {
+        const u8* data = buffer + i * bytes_per_sector();
+        auto* sector = cached_sector(lba + i);
+        if (sector)
+            memcpy(sector->data.data(), data, bytes_per_sector());
+        else
+            sector = &insert_sector(lba + i, data);
+        if (!sector->dirty) {
+            sector->dirty = true;
+            ++m_dirty_count;
+        }
+        evict_if_needed();
+    }
+    return true;
+}
+
+void DiskDrive::flush()
+{
+    if (!m_dirty_count)
+        return;
+
+    ASSERT(m_file);
+
+    QVector<u32> dirty_sectors;
+    dirty_sectors.reserve(m_dirty_count);
+    for (auto it = m_cache.constBegin(); it != m_cache.constEnd(); ++it) {
+        if (it->dirty)
+            dirty_sectors.append(it.key());
+    }
+    std::sort(dirty_sectors.begin(), dirty_sectors.end());
+
+#ifdef DISK_CACHE_DEBUG
+    vlog(LogDisk, "%s: Flushing %d dirty sectors", qPrintable(name()), dirty_sectors.size());
+#endif
+
+    for (u32 lba : dirty_sectors) {
+        auto& sector = m_cache[lba];
+        write_back(lba, sector);
+        sector.dirty = false;
+    }
+    m_dirty_count = 0;
+    fflush(m_file);
+}
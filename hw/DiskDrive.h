@@ -25,7 +25,11 @@
 #pragma once
 
 #include "types.h"
+#include <QByteArray>
+#include <QHash>
 #include <QString>
+#include <list>
+#include <stdio.h>
 
 class DiskDrive {
 public:
@@ -38,6 +42,8 @@ public:
         u8 floppy_type_for_cmos { 0 };
     };
 
+    static const unsigned default_cache_size_in_kilobytes = 1024;
+
     explicit DiskDrive(const QString& name);
     ~DiskDrive();
 
@@ -60,8 +66,60 @@ public:
     unsigned bytes_per_sector() const { return m_config.bytes_per_sector; }
     u8 floppy_type_for_cmos() const { return m_config.floppy_type_for_cmos; }
 
+    // All guest-visible disk I/O (IDE, FDC and the BIOS INT 13h calls) goes through these,
+    // so that every path shares the same sector cache.
+    bool read_sectors(u32 lba, unsigned count, u8* buffer);
+    bool write_sectors(u32 lba, unsigned count, const u8* buffer);
+
+    // Write all dirty sectors back to the image file.
+    void flush();
+
+    void set_cache_size_in_kilobytes(unsigned);
+    unsigned cache_capacity() const { return bytes_per_sector() ? (m_cache_size_in_kilobytes * 1024) / bytes_per_sector() : 0; }
+    unsigned cached_sector_count() const { return m_cache.size(); }
+    unsigned dirty_sector_count() const { return m_dirty_count; }
+    u64 cache_hits() const { return m_cache_hits; }
+    u64 cache_misses() const { return m_cache_misses; }
+    u64 read_ahead_sectors() const { return m_read_ahead_sectors; }
+    void reset_cache_statistics();
+
     //private:
     Configuration m_config;
     QString m_name;
     bool m_present { false };
+
+private:
+    struct CachedSector {
+        QByteArray data;
+        std::list<u32>::iterator lru_position;
+        bool dirty { false };
+    };
+
+    bool open_image_if_needed();
+    void close_image();
+    void invalidate_cache();
+    CachedSector* cached_sector(u32 lba);
+    CachedSector& insert_sector(u32 lba, const u8* data);
+    bool fill_from_image(u32 lba, unsigned count);
+    bool write_back(u32 lba, const CachedSector&);
+    void evict_if_needed();
+
+    // How far past a sequential read we fetch from the image in one go.
+    static const unsigned read_ahead_sector_count = 32;
+
+    FILE* m_file { nullptr };
+    bool m_read_only { false };
+
+    // Most recently used sectors are at the front.
+    std::list<u32> m_lru;
+    QHash<u32, CachedSector> m_cache;
+    unsigned m_cache_size_in_kilobytes { default_cache_size_in_kilobytes };
+    unsigned m_dirty_count { 0 };
+
+    // LBA following the most recent read, used to detect sequential access.
+    u32 m_next_sequential_lba { 0xffffffff };
+
+    u64 m_cache_hits { 0 };
+    u64 m_cache_misses { 0 };
+    u64 m_read_ahead_sectors { 0 };
 };
@@ -59,7 +59,7 @@ void ROM::write_memory8(u32 address, u8 data)
 {
     vlog(LogAlert, "Write to ROM address %08x, data %02x", address, data);
 #ifdef DEBUG_SERENITY
-    if (options.serenity)
+    if (g_cpu && g_cpu->options().serenity)
         g_cpu->debugger().enter();
 #endif
 }
@@ -0,0 +1,99 @@
+// Computron x86 PC Emulator
+// Copyright (C) 2003-2020 Andreas Kling <kling@serenityos.org>
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY ANDREAS KLING ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL ANDREAS KLING OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "Scheduler.h"
+#include "CPU.h"
+#include <algorithm>
+
+Scheduler::Scheduler(CPU& cpu)
+    : m_cpu(cpu)
+{
+}
+
+Scheduler::~Scheduler()
+{
+}
+
+u64 Scheduler::now() const
+{
+    return m_cpu.cycle();
+}
+
+Scheduler::EventID Scheduler::schedule(u64 delay_in_cycles, Callback callback)
+{
+    Event event;
+    event.id = m_next_event_id++;
+    if (!m_next_event_id)
+        m_next_event_id = 1;
+    event.deadline = now() + delay_in_cycles;
+    event.callback = std::move(callback);
+    m_events.append(std::move(event));
+    update_next_deadline();
+    return m_events.last().id;
+}
+
+void Scheduler::cancel(EventID id)
+{
+    for (int i = 0; i < m_events.size(); ++i) {
+        if (m_events[i].id == id) {
+            m_events.remove(i);
+            update_next_deadline();
+            return;
+        }
+    }
+}
+
+void Scheduler::clear()
+{
+    m_events.clear();
+    update_next_deadline();
+}
+
+void Scheduler::run_due_events()
+{
+    // Callbacks may schedule or cancel events, so pick them off one at a time.
+    for (;;) {
+        int due_index = -1;
+        for (int i = 0; i < m_events.size(); ++i) {
+            if (m_events[i].deadline > now())
+                continue;
+            if (due_index == -1 || m_events[i].deadline < m_events[due_index].deadline)
+                due_index = i;
+        }
+        if (due_index == -1)
+            break;
+        Callback callback = std::move(m_events[due_index].callback);
+        m_events.remove(due_index);
+        callback();
+    }
+    update_next_deadline();
+}
+
+void Scheduler::update_next_deadline()
+{
+    u64 deadline = CPU::no_pending_event;
+    for (auto& event : m_events)
+        deadline = std::min(deadline, event.deadline);
+    m_cpu.set_next_event_cycle(deadline);
+}
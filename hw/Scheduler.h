@@ -0,0 +1,70 @@
+// Computron x86 PC Emulator
+// Copyright (C) 2003-2020 Andreas Kling <kling@serenityos.org>
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY ANDREAS KLING ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL ANDREAS KLING OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "types.h"
+#include <QVector>
+#include <functional>
+
+class CPU;
+
+// Events on the machine's virtual timeline, measured in CPU cycles.
+// Everything here runs on the CPU thread.
+class Scheduler {
+public:
+    using EventID = u32;
+    using Callback = std::function<void()>;
+
+    // Nominal guest speed used to turn device delays into cycles.
+    static const u64 cycles_per_microsecond = 10;
+    static u64 microseconds_to_cycles(u64 microseconds) { return microseconds * cycles_per_microsecond; }
+
+    explicit Scheduler(CPU&);
+    ~Scheduler();
+
+    u64 now() const;
+
+    EventID schedule(u64 delay_in_cycles, Callback);
+    void cancel(EventID);
+    void clear();
+
+    bool has_pending_events() const { return !m_events.isEmpty(); }
+
+    // Called by the CPU once its cycle counter reaches the earliest deadline.
+    void run_due_events();
+
+private:
+    struct Event {
+        EventID id { 0 };
+        u64 deadline { 0 };
+        Callback callback;
+    };
+
+    void update_next_deadline();
+
+    CPU& m_cpu;
+    QVector<Event> m_events;
+    EventID m_next_event_id { 1 };
+};
@@ -27,15 +27,15 @@
 #include "CPU.h"
 #include "Common.h"
 #include "debug.h"
+#include "machine.h"
 #include "pic.h"
-#include <QtCore/QMutexLocker>
 
 BusMouse::BusMouse(Machine& machine)
     : IODevice("BusMouse", machine, 5)
 {
-    listen(0x23c, IODevice::ReadWrite);
-    listen(0x23d, IODevice::ReadOnly);
-    listen(0x23e, IODevice::ReadWrite);
+    listen<BusMouse>(0x23c, IODevice::ReadWrite);
+    listen<BusMouse>(0x23d, IODevice::ReadOnly);
+    listen<BusMouse>(0x23e, IODevice::ReadWrite);
 
     reset();
 }
@@ -87,64 +87,60 @@ void BusMouse::out8(u16 port, u8 data)
     }
 }
 
-void BusMouse::move_event(u16 x, u16 y)
+void BusMouse::enqueue(const Event& event)
 {
-    {
-        QMutexLocker locker(&m_mutex);
-        m_currentX = x;
-        m_currentY = y;
+    if (!m_event_queue.try_push(event)) {
+        vlog(LogMouse, "Event queue full, dropping event");
+        return;
     }
+    machine().cpu().queue_command(CPU::DrainInputQueues);
+}
 
-    m_deltaX = m_currentX - m_lastX;
-    m_deltaY = m_currentY - m_lastY;
-
-    //vlog(LogMouse, "BusMouse::moveEvent(): dX = %d, dY = %d", m_deltaX, m_deltaY);
-
-    if (m_interrupts)
-        raise_irq();
+void BusMouse::move_event(u16 x, u16 y)
+{
+    enqueue({ Event::Move, MouseButton::Left, x, y });
 }
 
 void BusMouse::button_press_event(u16 x, u16 y, MouseButton button)
 {
-    {
-        QMutexLocker locker(&m_mutex);
-        if (button == MouseButton::Left)
-            m_buttons &= ~(1 << 7);
-        else
-            m_buttons &= ~(1 << 5);
-
-        m_currentX = x;
-        m_currentY = y;
-    }
-
-    m_lastX = m_currentX;
-    m_lastY = m_currentY;
-    m_deltaX = 0;
-    m_deltaY = 0;
-
-    if (m_interrupts)
-        raise_irq();
+    enqueue({ Event::Press, button, x, y });
 }
 
 void BusMouse::button_release_event(u16 x, u16 y, MouseButton button)
 {
-    {
-        QMutexLocker locker(&m_mutex);
-        if (button == MouseButton::Left)
-            m_buttons |= (1 << 7);
+    enqueue({ Event::Release, button, x, y });
+}
+
+void BusMouse::drain_input()
+{
+    Event event;
+    bool any = false;
+    while (m_event_queue.try_pop(event)) {
+        any = true;
+        m_currentX = event.x;
+        m_currentY = event.y;
+
+        if (event.type == Event::Move) {
+            m_deltaX = m_currentX - m_lastX;
+            m_deltaY = m_currentY - m_lastY;
+            continue;
+        }
+
+        u8 bit = event.button == MouseButton::Left ? (1 << 7) : (1 << 5);
+        if (event.type == Event::Press)
+            m_buttons &= ~bit;
         else
-            m_buttons |= (1 << 5);
+            m_buttons |= bit;
 
-        m_currentX = x;
-        m_currentY = y;
+        m_lastX = m_currentX;
+        m_lastY = m_currentY;
+        m_deltaX = 0;
+        m_deltaY = 0;
     }
 
-    m_lastX = m_currentX;
-    m_lastY = m_currentY;
-    m_deltaX = 0;
-    m_deltaY = 0;
+    //vlog(LogMouse, "BusMouse::drain_input(): dX = %d, dY = %d", m_deltaX, m_deltaY);
 
-    if (m_interrupts)
+    if (any && m_interrupts)
         raise_irq();
 }
 
@@ -154,8 +150,6 @@ u8 BusMouse::in8(u16 port)
 
     u8 ret = 0;
 
-    QMutexLocker locker(&m_mutex);
-
     switch (port) {
     case 0x23c:
         switch (m_command) {
@@ -25,8 +25,8 @@
 #pragma once
 
 #include "MouseObserver.h"
+#include "SPSCQueue.h"
 #include "iodevice.h"
-#include <QtCore/QMutex>
 
 class BusMouse final : public IODevice
     , public MouseObserver {
@@ -42,9 +42,28 @@ public:
     virtual void button_press_event(u16 x, u16 y, MouseButton) override;
     virtual void button_release_event(u16 x, u16 y, MouseButton) override;
 
+    // Applies the events queued by the GUI thread. CPU thread only.
+    void drain_input();
+
     static BusMouse* the();
 
 private:
+    struct Event {
+        enum Type : u8 {
+            Move,
+            Press,
+            Release,
+        };
+        Type type;
+        MouseButton button;
+        u16 x;
+        u16 y;
+    };
+
+    void enqueue(const Event&);
+
+    SPSCQueue<Event, 256> m_event_queue;
+
     bool m_interrupts { true };
     u8 m_command { 0 };
     u8 m_buttons { 0 };
@@ -55,6 +74,4 @@ private:
     u16 m_lastY { 0 };
     u16 m_deltaX { 0 };
     u16 m_deltaY { 0 };
-
-    QMutex m_mutex;
 };
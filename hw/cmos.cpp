@@ -36,8 +36,8 @@ CMOS::CMOS(Machine& machine)
     : IODevice("CMOS", machine)
 {
     m_rtc_timer = make<ThreadedTimer>(*this, 250);
-    listen(0x70, IODevice::WriteOnly);
-    listen(0x71, IODevice::ReadWrite);
+    listen<CMOS>(0x70, IODevice::WriteOnly);
+    listen<CMOS>(0x71, IODevice::ReadWrite);
     reset();
 }
 
@@ -24,7 +24,9 @@
 
 #include "fdc.h"
 #include "Common.h"
+#include "DMA.h"
 #include "DiskDrive.h"
+#include "Scheduler.h"
 #include "debug.h"
 #include "machine.h"
 #include "pic.h"
@@ -46,6 +48,22 @@
 
 #define DATA_REGISTER_READY 0x80
 
+// ST0 bits
+#define FDC_ST0_ABNORMAL_TERMINATION 0x40
+#define FDC_ST0_NOT_READY 0x08
+
+// ST1 bits
+#define FDC_ST1_END_OF_CYLINDER 0x80
+#define FDC_ST1_OVERRUN 0x10
+#define FDC_ST1_NO_DATA 0x04
+#define FDC_ST1_NOT_WRITABLE 0x02
+
+// The floppy controller is hardwired to this DMA channel.
+static const u8 fdc_dma_channel = 2;
+
+// How long seeks and data transfers take on the virtual timeline.
+static const u64 command_delay_in_microseconds = 100;
+
 enum FDCCommand {
     SenseInterruptStatus = 0x08,
     SpecifyStepAndHeadLoad = 0x03,
@@ -117,6 +135,7 @@ struct FDC::Private {
     u8 perpendicular_mode_config { 0 };
     bool lock { false };
     u8 expected_sense_interrupt_count { 0 };
+    Scheduler::EventID pending_command_event { 0 };
 
     FDCDrive& current_drive()
     {
@@ -129,12 +148,12 @@ FDC::FDC(Machine& machine)
     : IODevice("FDC", machine, 6)
     , d(make<Private>())
 {
-    listen(0x3F0, IODevice::ReadOnly);
-    listen(0x3F1, IODevice::ReadOnly);
-    listen(0x3F2, IODevice::WriteOnly);
-    listen(0x3F4, IODevice::ReadWrite);
-    listen(0x3F5, IODevice::ReadWrite);
-    listen(0x3F7, IODevice::ReadWrite);
+    listen<FDC>(0x3F0, IODevice::ReadOnly);
+    listen<FDC>(0x3F1, IODevice::ReadOnly);
+    listen<FDC>(0x3F2, IODevice::WriteOnly);
+    listen<FDC>(0x3F4, IODevice::ReadWrite);
+    listen<FDC>(0x3F5, IODevice::ReadWrite);
+    listen<FDC>(0x3F7, IODevice::ReadWrite);
 
     reset();
 }
@@ -217,6 +236,7 @@ void FDC::reset_controller(ResetSource reset_source)
 
 void FDC::reset()
 {
+    cancel_pending_command();
     reset_controller(ResetSource::Hardware);
 }
 
@@ -284,6 +304,16 @@ static bool is_read_data_command(u8 b)
     return (b & 0x1f) == 0x06;
 }
 
+static bool is_write_data_command(u8 b)
+{
+    return (b & 0x3f) == 0x05;
+}
+
+static bool has_execution_phase(u8 b)
+{
+    return is_read_data_command(b) || is_write_data_command(b) || b == SeekToTrack || b == Recalibrate;
+}
+
 void FDC::out8(u16 port, u8 data)
 {
 #ifdef FDC_DEBUG
@@ -323,11 +353,16 @@ void FDC::out8(u16 port, u8 data)
     case 0x3F5: {
         vlog(LogFDC, "Command byte: %02X", data);
 
+        if (d->pending_command_event) {
+            vlog(LogFDC, "Command byte %02X written while busy, ignoring", data);
+            break;
+        }
+
         if (d->command.isEmpty()) {
             d->main_status_register &= FDC_MSR_DIO;
             d->main_status_register |= FDC_MSR_RQM | FDC_MSR_CMDBSY;
             // Determine the command length
-            if (is_read_data_command(data)) {
+            if (is_read_data_command(data) || is_write_data_command(data)) {
                 d->command_size = 9;
             } else {
                 switch (data) {
@@ -386,37 +421,165 @@ void FDC::out8(u16 port, u8 data)
 
 void FDC::reset_controller_soon()
 {
+    cancel_pending_command();
     d->has_pending_reset = true;
     d->main_status_register &= FDC_MSR_NONDMA;
     execute_command_soon();
 }
 
-void FDC::execute_read_data_command()
+void FDC::cancel_pending_command()
 {
+    if (!d->pending_command_event)
+        return;
+    machine().scheduler().cancel(d->pending_command_event);
+    d->pending_command_event = 0;
+}
+
+void FDC::execute_data_transfer_command()
+{
+    bool is_write = is_write_data_command(d->command[0]);
+    bool multi_track = d->command[0] & 0x80;
+
     d->drive_index = d->command[1] & 3;
-    d->current_drive().head = (d->command[1] >> 2) & 1;
-    d->current_drive().cylinder = d->command[2];
-    d->current_drive().head = d->command[3];
-    d->current_drive().sector = d->command[4];
-    d->current_drive().bytes_per_sector = d->command[5];
-    d->current_drive().end_of_track = d->command[6];
-    d->current_drive().gap3_length = d->command[7];
-    d->current_drive().data_length = d->command[8];
-    vlog(LogFDC, "ReadData { drive:%u, C:%u H:%u, S:%u / bpS:%u, EOT:%u, g3l:%u, dl:%u }",
+    u8 st0 = d->drive_index | (d->command[1] & 0x04);
+    u8 st1 = 0;
+    u8 st2 = 0;
+
+    d->command_result.clear();
+
+    if (d->drive_index >= 2) {
+        vlog(LogFDC, "%s on nonexistent drive %u", is_write ? "WriteData" : "ReadData", d->drive_index);
+        st0 |= FDC_ST0_ABNORMAL_TERMINATION | FDC_ST0_NOT_READY;
+        d->status_register[0] = st0;
+        d->command_result << st0 << st1 << st2 << d->command[2] << d->command[3] << d->command[4] << d->command[5];
+        raise_irq();
+        return;
+    }
+
+    auto& fdc_drive = d->current_drive();
+    fdc_drive.cylinder = d->command[2];
+    fdc_drive.head = d->command[3];
+    fdc_drive.sector = d->command[4];
+    fdc_drive.bytes_per_sector = d->command[5];
+    fdc_drive.end_of_track = d->command[6];
+    fdc_drive.gap3_length = d->command[7];
+    fdc_drive.data_length = d->command[8];
+    vlog(LogFDC, "%s { drive:%u, C:%u H:%u, S:%u / bpS:%u, EOT:%u, g3l:%u, dl:%u }",
+        is_write ? "WriteData" : "ReadData",
         d->drive_index,
-        d->current_drive().cylinder,
-        d->current_drive().head,
-        d->current_drive().sector,
-        128 << d->current_drive().bytes_per_sector,
-        d->current_drive().end_of_track,
-        d->current_drive().gap3_length,
-        d->current_drive().data_length);
+        fdc_drive.cylinder,
+        fdc_drive.head,
+        fdc_drive.sector,
+        128 << fdc_drive.bytes_per_sector,
+        fdc_drive.end_of_track,
+        fdc_drive.gap3_length,
+        fdc_drive.data_length);
+
+    DiskDrive& drive = d->drive_index ? machine().floppy1() : machine().floppy0();
+    unsigned sector_size = 128 << fdc_drive.bytes_per_sector;
+    auto& dma = machine().dma();
+
+    if (!drive.present()) {
+        st0 |= FDC_ST0_ABNORMAL_TERMINATION | FDC_ST0_NOT_READY;
+    } else if (!using_dma()) {
+        // FIXME: Support PIO transfers through the data register.
+        vlog(LogFDC, "Non-DMA data transfer not supported");
+        st0 |= FDC_ST0_ABNORMAL_TERMINATION;
+        st1 |= FDC_ST1_OVERRUN;
+    } else if (sector_size != drive.bytes_per_sector()) {
+        st0 |= FDC_ST0_ABNORMAL_TERMINATION;
+        st1 |= FDC_ST1_NO_DATA;
+    } else {
+        QByteArray buffer(sector_size, 0);
+        u8* data = reinterpret_cast<u8*>(buffer.data());
+        for (;;) {
+            if (!fdc_drive.sector || fdc_drive.sector > drive.sectors_per_track() || fdc_drive.head >= drive.heads()) {
+                st0 |= FDC_ST0_ABNORMAL_TERMINATION;
+                st1 |= FDC_ST1_NO_DATA;
+                break;
+            }
+            u32 lba = drive.to_lba(fdc_drive.cylinder, fdc_drive.head, fdc_drive.sector);
+            if (lba >= drive.sectors()) {
+                st0 |= FDC_ST0_ABNORMAL_TERMINATION;
+                st1 |= FDC_ST1_NO_DATA;
+                break;
+            }
+
+            unsigned transferred;
+            if (is_write) {
+                memset(data, 0, sector_size);
+                transferred = dma.read_from_memory(fdc_dma_channel, data, sector_size);
+                if (transferred && !drive.write_sectors(lba, 1, data)) {
+                    st0 |= FDC_ST0_ABNORMAL_TERMINATION;
+                    st1 |= FDC_ST1_NOT_WRITABLE;
+                    break;
+                }
+            } else {
+                if (!drive.read_sectors(lba, 1, data)) {
+                    st0 |= FDC_ST0_ABNORMAL_TERMINATION;
+                    st1 |= FDC_ST1_NO_DATA;
+                    break;
+                }
+                transferred = dma.write_to_memory(fdc_dma_channel, data, sector_size);
+            }
+
+            if (!transferred) {
+                // DMA channel masked or misprogrammed.
+                st0 |= FDC_ST0_ABNORMAL_TERMINATION;
+                st1 |= FDC_ST1_OVERRUN;
+                break;
+            }
+
+            // Step to the next sector; the result phase reports where we stopped.
+            bool end_of_cylinder = false;
+            if (fdc_drive.sector == fdc_drive.end_of_track) {
+                fdc_drive.sector = 1;
+                if (multi_track && fdc_drive.head == 0) {
+                    fdc_drive.head = 1;
+                } else {
+                    if (multi_track)
+                        fdc_drive.head = 0;
+                    ++fdc_drive.cylinder;
+                    end_of_cylinder = true;
+                }
+            } else {
+                ++fdc_drive.sector;
+            }
+
+            if (dma.has_reached_terminal_count(fdc_dma_channel))
+                break;
+
+            if (end_of_cylinder) {
+                st0 |= FDC_ST0_ABNORMAL_TERMINATION;
+                st1 |= FDC_ST1_END_OF_CYLINDER;
+                break;
+            }
+        }
+    }
+
+    d->status_register[0] = st0;
+    d->status_register[1] = st1;
+    d->status_register[2] = st2;
+    d->command_result << st0 << st1 << st2 << fdc_drive.cylinder << fdc_drive.head << fdc_drive.sector << fdc_drive.bytes_per_sector;
+    raise_irq();
 }
 
 void FDC::execute_command_soon()
 {
-    // FIXME: Don't do this immediately, do it "soon"!
-    execute_command();
+    // Commands without an execution phase complete immediately.
+    if (!d->has_pending_reset && !has_execution_phase(d->command[0])) {
+        execute_command();
+        return;
+    }
+
+    // The rest finish a little later on the virtual timeline, and the controller is busy until then.
+    d->main_status_register &= ~FDC_MSR_RQM;
+    d->main_status_register |= FDC_MSR_CMDBSY;
+    cancel_pending_command();
+    d->pending_command_event = machine().scheduler().schedule(Scheduler::microseconds_to_cycles(command_delay_in_microseconds), [this] {
+        d->pending_command_event = 0;
+        execute_command();
+    });
 }
 
 void FDC::execute_command()
@@ -450,8 +613,8 @@ void FDC::execute_command_internal()
     vlog(LogFDC, "Executing command %02x", d->command[0]);
     d->command_result.clear();
 
-    if (is_read_data_command(d->command[0]))
-        return execute_read_data_command();
+    if (is_read_data_command(d->command[0]) || is_write_data_command(d->command[0]))
+        return execute_data_transfer_command();
 
     switch (d->command[0]) {
     case SpecifyStepAndHeadLoad:
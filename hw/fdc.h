@@ -58,7 +58,8 @@ private:
     void execute_command_soon();
     void execute_command();
     void execute_command_internal();
-    void execute_read_data_command();
+    void execute_data_transfer_command();
+    void cancel_pending_command();
 
     struct Private;
     OwnPtr<Private> d;
@@ -86,16 +86,9 @@ void IDEController::read_sectors(IDE& ide)
 #ifdef IDE_DEBUG
     vlog(LogIDE, "ide%u: Read sectors (LBA: %u, count: %u)", controller_index, lba(), sector_count);
 #endif
-    FILE* f = fopen(qPrintable(drive().image_path()), "rb");
-    RELEASE_ASSERT(f);
     m_read_buffer.resize(drive().bytes_per_sector() * sector_count);
-    int result;
-    result = fseek(f, lba() * drive().bytes_per_sector(), SEEK_SET);
-    ASSERT(result != -1);
-    result = fread(m_read_buffer.data(), drive().bytes_per_sector(), sector_count, f);
-    ASSERT(result != -1);
-    result = fclose(f);
-    ASSERT(result != -1);
+    if (!drive().read_sectors(lba(), sector_count, reinterpret_cast<u8*>(m_read_buffer.data())))
+        vlog(LogIDE, "ide%u: Read failed (LBA: %u, count: %u)", controller_index, lba(), sector_count);
     m_read_buffer_index = 0;
     ide.raise_irq();
 }
@@ -124,16 +117,9 @@ void IDEController::write_to_sector_buffer(IDE& ide, T data)
     m_write_buffer_index += sizeof(T);
     if (m_write_buffer_index < m_write_buffer.size())
         return;
-    vlog(LogIDE, "ide%u: Got all sector data, flushing to disk!", controller_index);
-    FILE* f = fopen(qPrintable(drive().image_path()), "rb+");
-    RELEASE_ASSERT(f);
-    int result;
-    result = fseek(f, lba() * drive().bytes_per_sector(), SEEK_SET);
-    ASSERT(result != -1);
-    result = fwrite(m_write_buffer.data(), drive().bytes_per_sector(), sector_count, f);
-    ASSERT(result != -1);
-    result = fclose(f);
-    ASSERT(result != -1);
+    vlog(LogIDE, "ide%u: Got all sector data, writing to disk!", controller_index);
+    if (!drive().write_sectors(lba(), sector_count, reinterpret_cast<const u8*>(m_write_buffer.data())))
+        vlog(LogIDE, "ide%u: Write failed (LBA: %u, count: %u)", controller_index, lba(), sector_count);
     ide.raise_irq();
 }
 
@@ -164,24 +150,24 @@ IDE::IDE(Machine& machine)
     : IODevice("IDE", machine, 14)
     , d(make<Private>())
 {
-    listen(0x170, IODevice::ReadWrite);
-    listen(0x171, IODevice::ReadOnly);
-    listen(0x172, IODevice::ReadWrite);
-    listen(0x173, IODevice::ReadWrite);
-    listen(0x174, IODevice::ReadWrite);
-    listen(0x175, IODevice::ReadWrite);
-    listen(0x176, IODevice::ReadWrite);
-    listen(0x177, IODevice::ReadWrite);
-    listen(0x1F0, IODevice::ReadWrite);
-    listen(0x1F1, IODevice::ReadOnly);
-    listen(0x1F2, IODevice::ReadWrite);
-    listen(0x1F3, IODevice::ReadWrite);
-    listen(0x1F4, IODevice::ReadWrite);
-    listen(0x1F5, IODevice::ReadWrite);
-    listen(0x1F6, IODevice::ReadWrite);
-    listen(0x1F7, IODevice::ReadWrite);
-
-    listen(0x3f6, IODevice::ReadOnly);
+    listen<IDE>(0x170, IODevice::ReadWrite);
+    listen<IDE>(0x171, IODevice::ReadOnly);
+    listen<IDE>(0x172, IODevice::ReadWrite);
+    listen<IDE>(0x173, IODevice::ReadWrite);
+    listen<IDE>(0x174, IODevice::ReadWrite);
+    listen<IDE>(0x175, IODevice::ReadWrite);
+    listen<IDE>(0x176, IODevice::ReadWrite);
+    listen<IDE>(0x177, IODevice::ReadWrite);
+    listen<IDE>(0x1F0, IODevice::ReadWrite);
+    listen<IDE>(0x1F1, IODevice::ReadOnly);
+    listen<IDE>(0x1F2, IODevice::ReadWrite);
+    listen<IDE>(0x1F3, IODevice::ReadWrite);
+    listen<IDE>(0x1F4, IODevice::ReadWrite);
+    listen<IDE>(0x1F5, IODevice::ReadWrite);
+    listen<IDE>(0x1F6, IODevice::ReadWrite);
+    listen<IDE>(0x1F7, IODevice::ReadWrite);
+
+    listen<IDE>(0x3f6, IODevice::ReadOnly);
 
     reset();
 }
@@ -387,6 +373,12 @@ void IDE::execute_command(IDEController& controller, u8 command)
     case 0x30:
         controller.write_sectors();
         break;
+    case 0xE7:
+    case 0xEA:
+        // FLUSH CACHE / FLUSH CACHE EXT
+        controller.drive().flush();
+        raise_irq();
+        break;
     case 0xEC:
         controller.identify(*this);
         break;
@@ -31,8 +31,6 @@
 //#define IODEVICE_DEBUG
 //#define IRQ_DEBUG
 
-QSet<u16> IODevice::s_ignored_ports;
-
 IODevice::IODevice(const char* name, Machine& machine, int irq)
     : m_machine(machine)
     , m_name(name)
@@ -46,17 +44,91 @@ IODevice::~IODevice()
     m_machine.unregister_device(Badge<IODevice>(), *this);
 }
 
-void IODevice::listen(u16 port, ListenMask mask)
+void IODevice::listen(u16 port, ListenMask mask, const IOPortHandler& handler)
 {
     if (mask & ReadOnly)
-        machine().register_input_device(Badge<IODevice>(), port, *this);
+        machine().register_input_device(Badge<IODevice>(), port, *this, handler);
 
     if (mask & WriteOnly)
-        machine().register_output_device(Badge<IODevice>(), port, *this);
+        machine().register_output_device(Badge<IODevice>(), port, *this, handler);
 
     m_ports.append(port);
 }
 
+u16 IODevice::split_in16(IODevice* device, u16 port)
+{
+    auto& machine = device->machine();
+    return weld<u16>(machine.io_port_handler(port + 1).in<u8>(port + 1), machine.io_port_handler(port).in<u8>(port));
+}
+
+u32 IODevice::split_in32(IODevice* device, u16 port)
+{
+    auto& machine = device->machine();
+    return weld<u32>(machine.io_port_handler(port + 2).in<u16>(port + 2), machine.io_port_handler(port).in<u16>(port));
+}
+
+void IODevice::split_out16(IODevice* device, u16 port, u16 data)
+{
+    auto& machine = device->machine();
+    machine.io_port_handler(port).out<u8>(port, least_significant<u8>(data));
+    machine.io_port_handler(port + 1).out<u8>(port + 1, most_significant<u8>(data));
+}
+
+void IODevice::split_out32(IODevice* device, u16 port, u32 data)
+{
+    auto& machine = device->machine();
+    machine.io_port_handler(port).out<u16>(port, least_significant<u16>(data));
+    machine.io_port_handler(port + 2).out<u16>(port + 2, most_significant<u16>(data));
+}
+
+template<typename T>
+static T unhandled_in(IODevice*, u16 port)
+{
+    vlog(LogAlert, "Unhandled I/O read from port %03x", port);
+    return IODevice::JunkValue;
+}
+
+template<typename T>
+static void unhandled_out(IODevice*, u16 port, T data)
+{
+    vlog(LogAlert, "Unhandled I/O write to port %03x, data %x", port, data);
+}
+
+template<typename T>
+static T ignored_in(IODevice*, u16)
+{
+    return IODevice::JunkValue;
+}
+
+template<typename T>
+static void ignored_out(IODevice*, u16, T)
+{
+}
+
+IOPortHandler IODevice::unhandled_port_handler()
+{
+    IOPortHandler handler;
+    handler.in8 = &unhandled_in<u8>;
+    handler.in16 = &unhandled_in<u16>;
+    handler.in32 = &unhandled_in<u32>;
+    handler.out8 = &unhandled_out<u8>;
+    handler.out16 = &unhandled_out<u16>;
+    handler.out32 = &unhandled_out<u32>;
+    return handler;
+}
+
+IOPortHandler IODevice::ignored_port_handler()
+{
+    IOPortHandler handler;
+    handler.in8 = &ignored_in<u8>;
+    handler.in16 = &ignored_in<u16>;
+    handler.in32 = &ignored_in<u32>;
+    handler.out8 = &ignored_out<u8>;
+    handler.out16 = &ignored_out<u16>;
+    handler.out32 = &ignored_out<u32>;
+    return handler;
+}
+
 QList<u16> IODevice::ports() const
 {
     return m_ports;
@@ -114,16 +186,6 @@ u32 IODevice::in32(u16 port)
     return weld<u32>(in16(port + 2), in16(port));
 }
 
-void IODevice::ignore_port(u16 port)
-{
-    s_ignored_ports.insert(port);
-}
-
-bool IODevice::should_ignore_port(u16 port)
-{
-    return s_ignored_ports.contains(port);
-}
-
 void IODevice::raise_irq()
 {
     ASSERT(m_irq != -1);
@@ -27,9 +27,29 @@
 #include "debug.h"
 #include "types.h"
 #include <QList>
+#include <type_traits>
 
+class IODevice;
 class Machine;
 
+// One entry per I/O port in Machine's dispatch table. Every width has its own handler,
+// so an IN or OUT resolves with a single indexed indirect call.
+struct IOPortHandler {
+    IODevice* input_device { nullptr };
+    IODevice* output_device { nullptr };
+    u8 (*in8)(IODevice*, u16) { nullptr };
+    u16 (*in16)(IODevice*, u16) { nullptr };
+    u32 (*in32)(IODevice*, u16) { nullptr };
+    void (*out8)(IODevice*, u16, u8) { nullptr };
+    void (*out16)(IODevice*, u16, u16) { nullptr };
+    void (*out32)(IODevice*, u16, u32) { nullptr };
+
+    template<typename T>
+    T in(u16 port) const;
+    template<typename T>
+    void out(u16 port, T data) const;
+};
+
 class IODevice {
 public:
     IODevice(const char* name, Machine&, int irq = -1);
@@ -56,8 +76,9 @@ public:
     virtual void out16(u16 port, u16 data);
     virtual void out32(u16 port, u32 data);
 
-    static bool should_ignore_port(u16 port);
-    static void ignore_port(u16 port);
+    // Unclaimed ports log every access, unless the machine has chosen to ignore them.
+    static IOPortHandler unhandled_port_handler();
+    static IOPortHandler ignored_port_handler();
 
     QList<u16> ports() const;
 
@@ -69,17 +90,87 @@ protected:
         WriteOnly = 2,
         ReadWrite = 3
     };
-    virtual void listen(u16 port, ListenMask mask);
+    template<typename DeviceType>
+    void listen(u16 port, ListenMask mask);
 
 private:
+    void listen(u16 port, ListenMask mask, const IOPortHandler&);
+
+    template<typename DeviceType>
+    static u8 dispatch_in8(IODevice* device, u16 port) { return static_cast<DeviceType*>(device)->DeviceType::in8(port); }
+    template<typename DeviceType>
+    static u16 dispatch_in16(IODevice* device, u16 port) { return static_cast<DeviceType*>(device)->DeviceType::in16(port); }
+    template<typename DeviceType>
+    static u32 dispatch_in32(IODevice* device, u16 port) { return static_cast<DeviceType*>(device)->DeviceType::in32(port); }
+    template<typename DeviceType>
+    static void dispatch_out8(IODevice* device, u16 port, u8 data) { static_cast<DeviceType*>(device)->DeviceType::out8(port, data); }
+    template<typename DeviceType>
+    static void dispatch_out16(IODevice* device, u16 port, u16 data) { static_cast<DeviceType*>(device)->DeviceType::out16(port, data); }
+    template<typename DeviceType>
+    static void dispatch_out32(IODevice* device, u16 port, u32 data) { static_cast<DeviceType*>(device)->DeviceType::out32(port, data); }
+
+    static u16 split_in16(IODevice*, u16 port);
+    static u32 split_in32(IODevice*, u16 port);
+    static void split_out16(IODevice*, u16 port, u16 data);
+    static void split_out32(IODevice*, u16 port, u32 data);
+
     Machine& m_machine;
     const char* m_name { nullptr };
     int m_irq { 0 };
     QList<u16> m_ports;
-
-    static QSet<u16> s_ignored_ports;
 };
 
+template<typename DeviceType>
+inline void IODevice::listen(u16 port, ListenMask mask)
+{
+    static_assert(std::is_base_of<IODevice, DeviceType>::value, "listen<DeviceType>() needs the concrete device type");
+
+    // Wide accesses to a device that only implements in8/out8 are split into byte accesses
+    // through the port table, so that each byte reaches whichever device owns that port.
+    IOPortHandler handler;
+    handler.in8 = &dispatch_in8<DeviceType>;
+    handler.out8 = &dispatch_out8<DeviceType>;
+    if constexpr (std::is_same<decltype(&DeviceType::in16), decltype(&IODevice::in16)>::value)
+        handler.in16 = &split_in16;
+    else
+        handler.in16 = &dispatch_in16<DeviceType>;
+    if constexpr (std::is_same<decltype(&DeviceType::in32), decltype(&IODevice::in32)>::value)
+        handler.in32 = &split_in32;
+    else
+        handler.in32 = &dispatch_in32<DeviceType>;
+    if constexpr (std::is_same<decltype(&DeviceType::out16), decltype(&IODevice::out16)>::value)
+        handler.out16 = &split_out16;
+    else
+        handler.out16 = &dispatch_out16<DeviceType>;
+    if constexpr (std::is_same<decltype(&DeviceType::out32), decltype(&IODevice::out32)>::value)
+        handler.out32 = &split_out32;
+    else
+        handler.out32 = &dispatch_out32<DeviceType>;
+    listen(port, mask, handler);
+}
+
+template<typename T>
+inline T IOPortHandler::in(u16 port) const
+{
+    if constexpr (sizeof(T) == 1)
+        return in8(input_device, port);
+    else if constexpr (sizeof(T) == 2)
+        return in16(input_device, port);
+    else
+        return in32(input_device, port);
+}
+
+template<typename T>
+inline void IOPortHandler::out(u16 port, T data) const
+{
+    if constexpr (sizeof(T) == 1)
+        out8(output_device, port, data);
+    else if constexpr (sizeof(T) == 2)
+        out16(output_device, port, data);
+    else
+        out32(output_device, port, data);
+}
+
 template<typename T>
 inline T IODevice::in(u16 port)
 {
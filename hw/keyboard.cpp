@@ -28,6 +28,7 @@
 #include "debug.h"
 #include "machine.h"
 #include "pic.h"
+#include "pit.h"
 
 //#define KBD_DEBUG
 
@@ -55,14 +56,12 @@
 #define CMD_DISABLE_KBD 0xAD
 #define CMD_ENABLE_KBD 0xAE
 
-extern bool kbd_has_data();
-
 Keyboard::Keyboard(Machine& machine)
     : IODevice("Keyboard", machine, 1)
 {
-    listen(0x60, IODevice::ReadWrite);
-    listen(0x61, IODevice::ReadWrite);
-    listen(0x64, IODevice::ReadWrite);
+    listen<Keyboard>(0x60, IODevice::ReadWrite);
+    listen<Keyboard>(0x61, IODevice::ReadWrite);
+    listen<Keyboard>(0x64, IODevice::ReadWrite);
 
     reset();
 }
@@ -91,7 +90,6 @@ void Keyboard::reset()
 
 u8 Keyboard::in8(u16 port)
 {
-    extern u8 kbd_pop_raw();
     u8 data = 0;
 
     if (port == 0x60) {
@@ -103,7 +101,8 @@ u8 Keyboard::in8(u16 port)
         } else if (m_last_was_command && m_command == CMD_SET_LEDS) {
             data = 0xFA; // ACK
         } else {
-            u8 key = kbd_pop_raw();
+            u8 key = 0;
+            m_raw_queue.try_pop(key);
 #ifdef KBD_DEBUG
             vlog(LogKeyboard, "keyboard_data = %02X", key);
 #endif
@@ -113,19 +112,21 @@ u8 Keyboard::in8(u16 port)
         // POST completed successfully.
         u8 status = (m_ram[0] & ATKBD_SYSTEM_FLAG);
         status |= m_last_was_command ? ATKBD_CMD_DATA : 0;
-        if (kbd_has_data())
+        if (!m_raw_queue.is_empty())
             status |= ATKBD_OUTPUT_STATUS;
         if (is_enabled())
             status |= ATKBD_UNLOCKED;
         //vlog(LogKeyboard, "Keyboard status queried (%02X)", status);
         data = status;
     } else if (port == 0x61) {
-        // HACK: This should be implemented properly in the 8254 emulation.
+        // HACK: Bit 4 should follow the refresh requests from PIT counter 1.
         if (m_system_control_port_data & 0x10)
             m_system_control_port_data &= ~0x10;
         else
             m_system_control_port_data |= 0x10;
-        data = m_system_control_port_data;
+        data = m_system_control_port_data & ~0x20;
+        if (machine().pit().output(2))
+            data |= 0x20;
     }
 
 #ifdef KBD_DEBUG
@@ -143,6 +144,7 @@ void Keyboard::out8(u16 port, u8 data)
     if (port == 0x61) {
         //vlog(LogKeyboard, "System control port <- %02X", data);
         m_system_control_port_data = data;
+        machine().pit().set_gate(2, data & 1);
         return;
     }
 
@@ -220,8 +222,41 @@ void Keyboard::out8(u16 port, u8 data)
     IODevice::out8(port, data);
 }
 
+void Keyboard::enqueue_key(u16 key)
+{
+    if (!m_key_queue.try_push(key))
+        vlog(LogKeyboard, "Key queue full, dropping %04x", key);
+}
+
+void Keyboard::enqueue_raw(u8 data)
+{
+    if (!m_raw_queue.try_push(data))
+        vlog(LogKeyboard, "Scancode queue full, dropping %02x", data);
+}
+
 void Keyboard::did_enqueue_data()
 {
-    if (m_ram[0] & CCB_KEYBOARD_INTERRUPT_ENABLE)
+    machine().cpu().queue_command(CPU::DrainInputQueues);
+}
+
+void Keyboard::drain_input()
+{
+    if (!m_raw_queue.is_empty() && (m_ram[0] & CCB_KEYBOARD_INTERRUPT_ENABLE))
         raise_irq();
 }
+
+u16 Keyboard::next_key()
+{
+    m_raw_queue.clear();
+    u16 key = 0;
+    m_key_queue.try_pop(key);
+    return key;
+}
+
+u16 Keyboard::peek_key()
+{
+    m_raw_queue.clear();
+    u16 key = 0;
+    m_key_queue.try_peek(key);
+    return key;
+}
@@ -24,6 +24,7 @@
 
 #pragma once
 
+#include "SPSCQueue.h"
 #include "iodevice.h"
 
 class Keyboard final : public QObject
@@ -45,7 +46,17 @@ public:
 
     bool is_enabled() const { return m_enabled; }
 
+    // Producer side, called on the GUI thread. Queued data reaches the guest once the CPU thread
+    // drains it, which did_enqueue_data() asks for.
+    void enqueue_key(u16 key);
+    void enqueue_raw(u8 data);
     void did_enqueue_data();
+    bool has_raw_data() const { return !m_raw_queue.is_empty(); }
+
+    // Consumer side, CPU thread only.
+    void drain_input();
+    u16 next_key();
+    u16 peek_key();
 
 signals:
     void leds_changed(int);
@@ -58,4 +69,8 @@ private:
     bool m_last_was_command;
     u8 m_leds { 0 };
     bool m_enabled { true };
+
+    // Keys for the BIOS VM call interface, and raw scancodes for port 0x60.
+    SPSCQueue<u16, 64> m_key_queue;
+    SPSCQueue<u8, 1024> m_raw_queue;
 };
@@ -30,28 +30,24 @@
 
 //#define PIC_DEBUG
 
-// FIXME: This should not be global.
-std::atomic<u16> PIC::s_pending_requests;
-static bool s_ignoringIRQs = false;
-
-bool PIC::is_ignoring_all_irqs()
-{
-    return s_ignoringIRQs;
-}
-
 void PIC::set_ignore_all_irqs(bool b)
 {
-    s_ignoringIRQs = b;
+    ASSERT(m_is_master);
+    m_ignoring_all_irqs = b;
+    update_pending_requests(machine());
 }
 
 void PIC::update_pending_requests(Machine& machine)
 {
-    u16 masterRequests = (machine.master_pic().get_irr() & ~machine.master_pic().get_imr());
+    auto& master = machine.master_pic();
+    u16 masterRequests = (master.get_irr() & ~master.get_imr());
     u16 slaveRequests = (machine.slave_pic().get_irr() & ~machine.slave_pic().get_imr());
-    s_pending_requests = masterRequests | (slaveRequests << 8);
+    master.m_pending_requests = masterRequests | (slaveRequests << 8);
+    // This is the INTR line going into the CPU.
+    machine.cpu().set_has_pending_irq({}, master.m_pending_requests && !master.m_ignoring_all_irqs);
 #ifdef PIC_DEBUG
     if (machine.cpu().state() != CPU::Halted)
-        vlog(LogPIC, "Pending requests: %04x", (WORD)s_pendingRequests);
+        vlog(LogPIC, "Pending requests: %04x", (u16)master.m_pending_requests);
 #endif
 }
 
@@ -62,8 +58,8 @@ PIC::PIC(bool isMaster, Machine& machine)
     , m_irq_base(isMaster ? 0 : 8)
     , m_is_master(isMaster)
 {
-    listen(m_base_address, IODevice::ReadWrite);
-    listen(m_base_address + 1, IODevice::ReadWrite);
+    listen<PIC>(m_base_address, IODevice::ReadWrite);
+    listen<PIC>(m_base_address + 1, IODevice::ReadWrite);
 
     reset();
 }
@@ -81,7 +77,11 @@ void PIC::reset()
     m_icw4_expected = false;
     m_read_isr = false;
     m_special_mask_mode = false;
-    s_pending_requests = 0;
+
+    // The slave gets constructed after the master, so it can't go through master() here.
+    PIC& master_pic = m_is_master ? *this : machine().master_pic();
+    master_pic.m_pending_requests = 0;
+    machine().cpu().set_has_pending_irq({}, false);
 }
 
 void PIC::dump_mask()
@@ -251,15 +251,15 @@ bool PIC::is_irq_raised(Machine& machine, u8 num)
 
 void PIC::service_irq(CPU& cpu)
 {
-    if (s_ignoringIRQs)
+    Machine& machine = cpu.machine();
+
+    if (machine.master_pic().m_ignoring_all_irqs)
         return;
 
-    u16 pendingRequestsCopy = s_pending_requests;
+    u16 pendingRequestsCopy = machine.master_pic().m_pending_requests;
     if (!pendingRequestsCopy)
         return;
 
-    Machine& machine = cpu.machine();
-
     u8 irqToService = 0xFF;
 
     for (u8 i = 0; i < 16; ++i) {
@@ -25,6 +25,7 @@
 #pragma once
 
 #include "iodevice.h"
+#include <atomic>
 
 class CPU;
 
@@ -51,9 +52,10 @@ public:
     static void raise_irq(Machine&, u8 num);
     static void lower_irq(Machine&, u8 num);
     static bool is_irq_raised(Machine&, u8 num);
-    static bool is_ignoring_all_irqs();
-    static void set_ignore_all_irqs(bool);
-    static bool has_pending_irq() { return s_pending_requests; }
+
+    // Only meaningful on the master PIC.
+    bool is_ignoring_all_irqs() const { return m_ignoring_all_irqs; }
+    void set_ignore_all_irqs(bool);
 
     PIC& master() const;
     PIC& slave() const;
@@ -78,5 +80,7 @@ private:
     bool m_special_mask_mode { false };
     bool m_is_master { false };
 
-    static std::atomic<u16> s_pending_requests;
+    // These live on the master PIC and cover both chips.
+    std::atomic<u16> m_pending_requests { 0 };
+    bool m_ignoring_all_irqs { false };
 };
@@ -24,57 +24,202 @@
 
 #include "pit.h"
 #include "Common.h"
+#include "Scheduler.h"
 #include "debug.h"
+#include "machine.h"
 #include "pic.h"
-#include <QElapsedTimer>
-#include <math.h>
 
 //#define PIT_DEBUG
 
-static const double base_frequency = 1193.1816666; // 1.193182 MHz
+// The 8254 is clocked at 1.193182 MHz. Counter state is derived on demand from the
+// machine's virtual timeline, so reading a counter is just a bit of integer math.
+static const u64 pit_frequency = 1193182;
+static const u64 cycles_per_second = Scheduler::cycles_per_microsecond * 1000000;
+
+static u64 ticks_for_cycles(u64 cycles)
+{
+    return (cycles / cycles_per_second) * pit_frequency + ((cycles % cycles_per_second) * pit_frequency) / cycles_per_second;
+}
+
+// Rounds up, so that ticks_for_cycles(cycles_for_ticks(t)) >= t.
+static u64 cycles_for_ticks(u64 ticks)
+{
+    return (ticks / pit_frequency) * cycles_per_second + ((ticks % pit_frequency) * cycles_per_second + pit_frequency - 1) / pit_frequency;
+}
 
 enum DecrementMode {
     DecrementBinary = 0,
     DecrementBCD = 1
 };
-enum CounterAccessState {
-    ReadLatchedLSB,
-    ReadLatchedMSB,
-    AccessMSBOnly,
-    AccessLSBOnly,
-    AccessLSBThenMSB,
-    AccessMSBThenLSB
+
+enum AccessMode {
+    AccessLatch = 0,
+    AccessLSBOnly = 1,
+    AccessMSBOnly = 2,
+    AccessLSBThenMSB = 3,
 };
 
+static u16 to_bcd(u16 value)
+{
+    return (value % 10) | ((value / 10 % 10) << 4) | ((value / 100 % 10) << 8) | ((value / 1000 % 10) << 12);
+}
+
+static u16 from_bcd(u16 value)
+{
+    return (value & 0xf) + ((value >> 4) & 0xf) * 10 + ((value >> 8) & 0xf) * 100 + ((value >> 12) & 0xf) * 1000;
+}
+
 struct CounterInfo {
-    u16 start_value { 0xffff };
-    u16 reload { 0xffff };
-    u16 value();
     u8 mode { 0 };
     DecrementMode decrement_mode { DecrementBinary };
-    u16 latched_value { 0xffff };
-    CounterAccessState access_state { ReadLatchedLSB };
-    u8 format { 0 };
-    QElapsedTimer qtimer;
+    AccessMode access_mode { AccessLSBThenMSB };
+
+    // The count as written by the guest (BCD already decoded), 0 meaning the maximum.
+    u16 count { 0 };
+    u16 count_register { 0 };
+    bool null_count { true };
+
+    bool gate { true };
+    bool triggered { false };
+    bool running { false };
+
+    // Ticks counted before the last (re)start, and when that was.
+    u64 elapsed_base { 0 };
+    u64 resume_tick { 0 };
+
+    bool read_msb_next { false };
+    bool write_msb_next { false };
+    bool count_latched { false };
+    u16 latched_count { 0 };
+    bool status_latched { false };
+    u8 latched_status { 0 };
+
+    u32 modulus() const { return decrement_mode == DecrementBCD ? 10000 : 65536; }
+    u32 effective_count() const { return count ? count : modulus(); }
+    u64 elapsed(u64 now) const { return elapsed_base + ((running && now > resume_tick) ? now - resume_tick : 0); }
+
+    void start(u64 now)
+    {
+        elapsed_base = 0;
+        resume_tick = now;
+        running = true;
+    }
 
-    void check(PIT&);
-    bool rolled_over { false };
+    u16 value(u64 now) const;
+    bool output(u64 now) const;
+    bool next_irq_tick(u64 now, u64& tick) const;
 };
 
+u16 CounterInfo::value(u64 now) const
+{
+    if (null_count || (!running && !elapsed_base))
+        return count;
+
+    u64 e = elapsed(now);
+    u32 n = effective_count();
+    u32 value = 0;
+
+    switch (mode) {
+    case 0:
+    case 1:
+    case 4:
+    case 5:
+        // One-shot modes keep counting down (and wrapping) after terminal count.
+        value = (n + modulus() - (e % modulus())) % modulus();
+        break;
+    case 2:
+        value = n - (e % n);
+        break;
+    case 3: {
+        // Decrements by two, with the output high for the first (larger) half of each period.
+        u32 phase = e % n;
+        u32 high_ticks = (n + 1) / 2;
+        u32 position = phase < high_ticks ? phase : phase - high_ticks;
+        value = (n & ~1u) - 2 * position;
+        if (!value)
+            value = 2;
+        break;
+    }
+    }
+
+    if (value == modulus())
+        value = 0;
+    return value;
+}
+
+bool CounterInfo::output(u64 now) const
+{
+    if (null_count)
+        return mode != 0;
+
+    u64 e = elapsed(now);
+    u32 n = effective_count();
+
+    switch (mode) {
+    case 0:
+        return e >= n;
+    case 1:
+        return !triggered || e >= n;
+    case 2:
+        return !running || (e % n) != n - 1;
+    case 3:
+        return !running || (e % n) < (n + 1) / 2;
+    case 4:
+        return e != n;
+    case 5:
+        return !triggered || e != n;
+    }
+    return true;
+}
+
+// Finds the next tick at which the output has a rising edge, i.e. when IRQ0 fires.
+bool CounterInfo::next_irq_tick(u64 now, u64& tick) const
+{
+    if (null_count || !running)
+        return false;
+
+    u64 e = elapsed(now);
+    u64 n = effective_count();
+    u64 target;
+
+    switch (mode) {
+    case 0:
+    case 1:
+        if (e >= n)
+            return false;
+        target = n;
+        break;
+    case 2:
+    case 3:
+        target = (e / n + 1) * n;
+        break;
+    case 4:
+    case 5:
+        if (e > n)
+            return false;
+        target = n + 1;
+        break;
+    default:
+        return false;
+    }
+
+    tick = resume_tick + (target - elapsed_base);
+    return true;
+}
+
 struct PIT::Private {
     CounterInfo counter[3];
-    int frequency { 0 };
-    OwnPtr<ThreadedTimer> threaded_timer;
+    Scheduler::EventID irq_event { 0 };
 };
 
 PIT::PIT(Machine& machine)
     : IODevice("PIT", machine, 0)
     , d(make<Private>())
 {
-    listen(0x40, IODevice::ReadWrite);
-    listen(0x41, IODevice::ReadWrite);
-    listen(0x42, IODevice::ReadWrite);
-    listen(0x43, IODevice::ReadWrite);
+    listen<PIT>(0x40, IODevice::ReadWrite);
+    listen<PIT>(0x41, IODevice::ReadWrite);
+    listen<PIT>(0x42, IODevice::ReadWrite);
+    listen<PIT>(0x43, IODevice::ReadWrite);
 
     reset();
 }
@@ -85,100 +230,177 @@ PIT::~PIT()
 
 void PIT::reset()
 {
-    d->frequency = 0;
+    if (d->irq_event) {
+        machine().scheduler().cancel(d->irq_event);
+        d->irq_event = 0;
+    }
     d->counter[0] = CounterInfo();
     d->counter[1] = CounterInfo();
     d->counter[2] = CounterInfo();
+
+    // Channel 2 is gated by bit 0 of port 0x61, which starts out low.
+    d->counter[2].gate = false;
+
+    // FIXME: This should be done by the BIOS instead.
+    mode_control(0, 0x36); // Counter 0, LSB then MSB, mode 3
+    write_counter(0, 0);
+    write_counter(0, 0);
+    mode_control(0, 0x54); // Counter 1, LSB only, mode 2
+    write_counter(1, 18);
+    mode_control(0, 0xb6); // Counter 2, LSB then MSB, mode 3
+    write_counter(2, 0);
+    write_counter(2, 0);
 }
 
-u16 CounterInfo::value()
+u64 PIT::current_tick() const
 {
-    double nsec = qtimer.nsecsElapsed() / 1000;
-    int ticks = floor(nsec * base_frequency);
-
-    int current_value = start_value - ticks;
-    if (current_value >= reload) {
-        vlog(LogTimer, "Current value{%d} >= reload{%d}", current_value, reload);
-        if (reload == 0)
-            current_value = 0;
-        else
-            current_value %= reload;
-        rolled_over = true;
-    } else if (current_value < 0) {
-        if (reload == 0)
-            current_value = 0;
-        else
-            current_value = current_value % reload + reload;
-        rolled_over = true;
+    return ticks_for_cycles(machine().scheduler().now());
+}
+
+void PIT::update_irq_deadline()
+{
+    auto& scheduler = machine().scheduler();
+    if (d->irq_event) {
+        scheduler.cancel(d->irq_event);
+        d->irq_event = 0;
     }
 
-#ifdef PIT_DEBUG
-    vlog(LogTimer, "nsec elapsed: %g, ticks: %g, value: %u", nsec, ticks, currentValue);
+#ifndef CT_DETERMINISTIC
+    u64 now = current_tick();
+    u64 tick;
+    if (!d->counter[0].next_irq_tick(now, tick))
+        return;
+
+    u64 deadline = cycles_for_ticks(tick);
+    u64 delay = deadline > scheduler.now() ? deadline - scheduler.now() : 0;
+    d->irq_event = scheduler.schedule(delay, [this] {
+        d->irq_event = 0;
+        raise_irq();
+        update_irq_deadline();
+    });
 #endif
-    return current_value;
 }
 
-void CounterInfo::check(PIT& pit)
+void PIT::load_count(u8 index, u16 data)
 {
-    value();
-    if (rolled_over) {
-        if (mode == 0)
-            pit.raise_irq();
-        rolled_over = false;
+    auto& counter = d->counter[index];
+    counter.count = counter.decrement_mode == DecrementBCD ? from_bcd(data) : data;
+    counter.null_count = false;
+
+    u64 now = current_tick();
+    switch (counter.mode) {
+    case 0:
+    case 2:
+    case 3:
+    case 4:
+        counter.triggered = false;
+        if (counter.gate)
+            counter.start(now);
+        else {
+            counter.running = false;
+            counter.elapsed_base = 0;
+        }
+        break;
+    case 1:
+    case 5:
+        // These wait for a rising edge on the gate.
+        counter.running = false;
+        counter.triggered = false;
+        counter.elapsed_base = 0;
+        break;
     }
+
+#ifdef PIT_DEBUG
+    vlog(LogTimer, "Counter %u loaded with %u (mode %u)", index, counter.effective_count(), counter.mode);
+#endif
+
+    if (index == 0)
+        update_irq_deadline();
 }
 
-void PIT::reconfigure_timer(u8 index)
+void PIT::set_gate(u8 index, bool gate)
 {
+    ASSERT(index <= 2);
     auto& counter = d->counter[index];
-    counter.qtimer.start();
-}
+    if (counter.gate == gate)
+        return;
+    counter.gate = gate;
 
-void PIT::boot()
-{
-    d->threaded_timer = make<ThreadedTimer>(*this, 5);
+    if (counter.null_count)
+        return;
 
-    // FIXME: This should be done by the BIOS instead.
-    reconfigure_timer(0);
-    reconfigure_timer(1);
-    reconfigure_timer(2);
+    u64 now = current_tick();
+    switch (counter.mode) {
+    case 0:
+    case 4:
+        // Gate low suspends counting.
+        if (!gate) {
+            counter.elapsed_base = counter.elapsed(now);
+            counter.running = false;
+        } else {
+            counter.resume_tick = now;
+            counter.running = true;
+        }
+        break;
+    case 1:
+    case 5:
+        if (gate) {
+            counter.triggered = true;
+            counter.start(now);
+        }
+        break;
+    case 2:
+    case 3:
+        // Gate low forces the output high and stops the counter; a rising edge reloads it.
+        if (gate)
+            counter.start(now);
+        else
+            counter.running = false;
+        break;
+    }
+
+    if (index == 0)
+        update_irq_deadline();
 }
 
-void PIT::threaded_timer_fired(Badge<ThreadedTimer>)
+bool PIT::output(u8 index) const
 {
-#ifndef CT_DETERMINISTIC
-    d->counter[0].check(*this);
-    d->counter[1].check(*this);
-    d->counter[2].check(*this);
-#endif
+    ASSERT(index <= 2);
+    return d->counter[index].output(current_tick());
 }
 
 u8 PIT::read_counter(u8 index)
 {
     auto& counter = d->counter[index];
+
+    if (counter.status_latched) {
+        counter.status_latched = false;
+        return counter.latched_status;
+    }
+
+    u16 value = counter.count_latched ? counter.latched_count : counter.value(current_tick());
+    if (counter.decrement_mode == DecrementBCD)
+        value = to_bcd(value);
+
     u8 data = 0;
-    switch (counter.access_state) {
-    case ReadLatchedLSB:
-        data = least_significant<u8>(counter.latched_value);
-        counter.access_state = ReadLatchedMSB;
-        break;
-    case ReadLatchedMSB:
-        data = most_significant<u8>(counter.latched_value);
-        counter.access_state = ReadLatchedLSB;
-        break;
+    switch (counter.access_mode) {
+    case AccessLatch:
     case AccessLSBOnly:
-        data = least_significant<u8>(counter.latched_value);
+        data = least_significant<u8>(value);
+        counter.count_latched = false;
         break;
     case AccessMSBOnly:
-        data = most_significant<u8>(counter.latched_value);
+        data = most_significant<u8>(value);
+        counter.count_latched = false;
         break;
     case AccessLSBThenMSB:
-        data = least_significant<u8>(counter.value());
-        counter.access_state = AccessMSBThenLSB;
-        break;
-    case AccessMSBThenLSB:
-        data = most_significant<u8>(counter.value());
-        counter.access_state = AccessLSBThenMSB;
+        if (counter.read_msb_next) {
+            data = most_significant<u8>(value);
+            counter.count_latched = false;
+        } else {
+            data = least_significant<u8>(value);
+        }
+        counter.read_msb_next = !counter.read_msb_next;
         break;
     }
     return data;
@@ -187,26 +409,23 @@ u8 PIT::read_counter(u8 index)
 void PIT::write_counter(u8 index, u8 data)
 {
     auto& counter = d->counter[index];
-    switch (counter.access_state) {
-    case ReadLatchedLSB:
-    case ReadLatchedMSB:
+    switch (counter.access_mode) {
+    case AccessLatch:
         break;
     case AccessLSBOnly:
-        counter.reload = weld<u16>(most_significant<u8>(counter.reload), data);
-        reconfigure_timer(index);
+        load_count(index, data);
         break;
     case AccessMSBOnly:
-        counter.reload = weld<u16>(data, least_significant<u8>(counter.reload));
-        reconfigure_timer(index);
+        load_count(index, data << 8);
         break;
     case AccessLSBThenMSB:
-        counter.reload = weld<u16>(most_significant<u8>(counter.reload), data);
-        counter.access_state = AccessMSBThenLSB;
-        break;
-    case AccessMSBThenLSB:
-        counter.reload = weld<u16>(data, least_significant<u8>(counter.reload));
-        counter.access_state = AccessLSBThenMSB;
-        reconfigure_timer(index);
+        if (!counter.write_msb_next) {
+            counter.count_register = data;
+            counter.write_msb_next = true;
+        } else {
+            counter.write_msb_next = false;
+            load_count(index, weld<u16>(data, counter.count_register));
+        }
         break;
     }
 }
@@ -221,7 +440,8 @@ u8 PIT::in8(u16 port)
         data = read_counter(port - 0x40);
         break;
     case 0x43:
-        ASSERT_NOT_REACHED();
+        // The control word register is write-only.
+        data = IODevice::JunkValue;
         break;
     }
 
@@ -248,47 +468,78 @@ void PIT::out8(u16 port, u8 data)
     }
 }
 
+void PIT::latch_count(u8 index)
+{
+    auto& counter = d->counter[index];
+    if (counter.count_latched)
+        return;
+    counter.latched_count = counter.value(current_tick());
+    counter.count_latched = true;
+    counter.read_msb_next = false;
+}
+
+void PIT::latch_status(u8 index)
+{
+    auto& counter = d->counter[index];
+    if (counter.status_latched)
+        return;
+    counter.latched_status = (counter.output(current_tick()) << 7)
+        | (counter.null_count << 6)
+        | (counter.access_mode << 4)
+        | (counter.mode << 1)
+        | counter.decrement_mode;
+    counter.status_latched = true;
+}
+
 void PIT::mode_control(int timer_index, u8 data)
 {
     ASSERT(timer_index == 0 || timer_index == 1);
 
     u8 counter_index = (data >> 6);
 
-    if (counter_index > 2) {
-        vlog(LogTimer, "Invalid counter index %d specified.", counter_index);
+    if (counter_index == 3) {
+        // Read-back command: bit 5 clear latches counts, bit 4 clear latches status.
+        for (u8 i = 0; i < 3; ++i) {
+            if (!(data & (2 << i)))
+                continue;
+            if (!(data & 0x20))
+                latch_count(i);
+            if (!(data & 0x10))
+                latch_status(i);
+        }
         return;
     }
 
-    ASSERT(counter_index <= 2);
-    CounterInfo& counter = d->counter[counter_index];
+    auto access_mode = static_cast<AccessMode>((data >> 4) & 3);
+    if (access_mode == AccessLatch) {
+        latch_count(counter_index);
+        return;
+    }
 
+    CounterInfo& counter = d->counter[counter_index];
     counter.decrement_mode = static_cast<DecrementMode>(data & 1);
     counter.mode = (data >> 1) & 7;
-
-    counter.format = (data >> 4) & 3;
-    switch (counter.format) {
-    case 0:
-        counter.access_state = ReadLatchedLSB;
-        counter.latched_value = counter.value();
-        break;
-    case 1:
-        counter.access_state = AccessMSBOnly;
-        break;
-    case 2:
-        counter.access_state = AccessLSBOnly;
-        break;
-    case 3:
-        counter.access_state = AccessLSBThenMSB;
-        break;
-    }
+    // Modes 6 and 7 are aliases for 2 and 3.
+    if (counter.mode > 5)
+        counter.mode -= 4;
+    counter.access_mode = access_mode;
+    counter.null_count = true;
+    counter.running = false;
+    counter.triggered = false;
+    counter.elapsed_base = 0;
+    counter.read_msb_next = false;
+    counter.write_msb_next = false;
+    counter.count_latched = false;
+    counter.status_latched = false;
 
 #ifdef PIT_DEBUG
-    vlog(LogTimer, "Setting mode for counter %u { dec: %s, mode: %u, fmt: %02x }",
+    vlog(LogTimer, "Setting mode for counter %u { dec: %s, mode: %u, access: %u }",
         counter_index,
-        (counter.decrementMode == DecrementBCD) ? "BCD" : "binary",
+        (counter.decrement_mode == DecrementBCD) ? "BCD" : "binary",
         counter.mode,
-        counter.format);
+        counter.access_mode);
 #endif
 
-    reconfigure_timer(counter_index);
+    if (counter_index == 0)
+        update_irq_deadline();
 }
@@ -25,12 +25,9 @@
 #pragma once
 
 #include "OwnPtr.h"
-#include "ThreadedTimer.h"
 #include "iodevice.h"
 
-class PIT final
-    : public IODevice
-    , public ThreadedTimer::Listener {
+class PIT final : public IODevice {
 public:
     explicit PIT(Machine&);
     virtual ~PIT();
@@ -39,18 +36,23 @@ public:
     virtual u8 in8(u16 port) override;
     virtual void out8(u16 port, u8 data) override;
 
-    void boot();
-
-    virtual void threaded_timer_fired(Badge<ThreadedTimer>) override;
+    // Channel 2's gate and output are wired to port 0x61.
+    void set_gate(u8 index, bool);
+    bool output(u8 index) const;
 
 private:
     friend class CPU;
 
+    u64 current_tick() const;
+
     u8 read_counter(u8 index);
     void write_counter(u8 index, u8 data);
+    void load_count(u8 index, u16 data);
+    void latch_count(u8 index);
+    void latch_status(u8 index);
 
     void mode_control(int timerIndex, u8 data);
-    void reconfigure_timer(u8 index);
+    void update_irq_deadline();
 
     struct Private;
     OwnPtr<Private> d;
@@ -23,6 +23,7 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "vga.h"
+#include "BochsVBE.h"
 #include "CPU.h"
 #include "Common.h"
 #include "debug.h"
@@ -37,12 +38,40 @@ struct RGBColor {
     operator QColor() const { return QColor::fromRgb(red << 2, green << 2, blue << 2); }
 };
 
+// Expands the low four bits of a register into byte lanes, one lane per plane.
+static inline u32 expand_to_lanes(u8 bits)
+{
+    return ((((bits & 0xf) * 0x00204081) & 0x01010101) * 0xff);
+}
+
+static inline u32 broadcast_to_lanes(u8 value)
+{
+    return value * 0x01010101;
+}
+
 struct VGA::Private {
     QColor color[16];
     QBrush brush[16];
-    u8* memory { nullptr };
-    u8* plane[4];
-    u8 latch[4];
+
+    // Plane n lives in byte n of each u32, so the latches and every write operate on all planes at once.
+    u32 planes[65536];
+    u32 latch { 0 };
+
+    u32 memory_window_base { 0 };
+    u32 memory_window_size { 0 };
+
+    // Recomputed by update_write_pipeline() whenever one of the registers it depends on changes.
+    typedef void (*WriteFunction)(Private&, u32 offset, u8 value);
+    WriteFunction write_function { nullptr };
+    u32 set_reset { 0 };
+    u32 enable_set_reset { 0 };
+    u32 bit_mask { 0 };
+    u32 map_mask { 0 };
+    u8 rotate_count { 0 };
+
+    template<u8 write_mode, u8 logical_op>
+    static void write_planar(Private&, u32 offset, u8 value);
+    static void write_chain4(Private&, u32 offset, u8 value);
 
     struct {
         u8 reg_index;
@@ -173,9 +202,9 @@ static const RGBColor default_vga_color_registers[256] = {
     { 0x3f, 0x3f, 0x3f },
 };
 
-const u8* VGA::text_memory() const
+const u32* VGA::planes() const
 {
-    return d->memory;
+    return d->planes;
 }
 
 VGA::VGA(Machine& m)
@@ -185,23 +214,22 @@ VGA::VGA(Machine& m)
 {
     machine().cpu().register_memory_provider(*this);
 
-    listen(0x3B4, IODevice::ReadWrite);
-    listen(0x3B5, IODevice::ReadWrite);
-    listen(0x3BA, IODevice::ReadWrite);
+    listen<VGA>(0x3B4, IODevice::ReadWrite);
+    listen<VGA>(0x3B5, IODevice::ReadWrite);
+    listen<VGA>(0x3BA, IODevice::ReadWrite);
 
     for (u16 port = 0x3c0; port <= 0x3cf; ++port)
-        listen(port, IODevice::ReadWrite);
+        listen<VGA>(port, IODevice::ReadWrite);
 
-    listen(0x3D4, IODevice::ReadWrite);
-    listen(0x3D5, IODevice::ReadWrite);
-    listen(0x3DA, IODevice::ReadWrite);
+    listen<VGA>(0x3D4, IODevice::ReadWrite);
+    listen<VGA>(0x3D5, IODevice::ReadWrite);
+    listen<VGA>(0x3DA, IODevice::ReadWrite);
 
     reset();
 }
 
 VGA::~VGA()
 {
-    delete[] d->memory;
 }
 
 void VGA::reset()
@@ -259,21 +287,14 @@ void VGA::reset()
     d->screen_in_refresh = false;
     d->status_register = 0;
 
-    d->memory = new u8[0x40000];
-    d->plane[0] = d->memory;
-    d->plane[1] = d->plane[0] + 0x10000;
-    d->plane[2] = d->plane[1] + 0x10000;
-    d->plane[3] = d->plane[2] + 0x10000;
-
-    memset(d->memory, 0x00, 0x40000);
-
-    d->latch[0] = 0;
-    d->latch[1] = 0;
-    d->latch[2] = 0;
-    d->latch[3] = 0;
+    memset(d->planes, 0x00, sizeof(d->planes));
+    d->latch = 0;
 
     d->write_protect = false;
 
+    update_memory_window();
+    update_write_pipeline();
+
     synchronize_colors();
     set_palette_dirty(true);
 }
@@ -288,7 +309,7 @@ void VGA::out8(u16 port, u8 data)
         d->crtc.reg_index = data & 0x3f;
         if (d->crtc.reg_index > 0x18)
             vlog(LogVGA, "Invalid I/O register 0x%02X selected through port %03X", d->crtc.reg_index, port);
-        else if (options.vgadebug)
+        else if (machine().options().vgadebug)
             vlog(LogVGA, "I/O register 0x%02X selected through port %03X", d->crtc.reg_index, port);
         break;
 
@@ -299,7 +320,7 @@ void VGA::out8(u16 port, u8 data)
             //ASSERT_NOT_REACHED();
             break;
         }
-        if (options.vgadebug)
+        if (machine().options().vgadebug)
             vlog(LogVGA, "I/O register 0x%02X written (%02X) through port %03X", d->crtc.reg_index, data, port);
         if (d->write_protect && d->crtc.reg_index < 8) {
             if (d->crtc.reg_index == 7) {
@@ -391,6 +412,7 @@ void VGA::out8(u16 port, u8 data)
             break;
         }
         d->sequencer.reg[d->sequencer.reg_index] = data;
+        update_write_pipeline();
         break;
 
     case 0x3C6:
@@ -453,7 +475,9 @@ void VGA::out8(u16 port, u8 data)
             d->graphics_ctrl.alphanumeric_mode_disable = data & 1;
             //vlog(LogVGA, "Memory map select: %u", d->graphics_ctrl.memory_map_select);
             //vlog(LogVGA, "Alphanumeric mode disable: %u", d->graphics_ctrl.alphanumeric_mode_disable);
+            update_memory_window();
         }
+        update_write_pipeline();
         break;
 
     default:
@@ -506,7 +530,7 @@ u8 VGA::in8(u16 port)
             vlog(LogVGA, "Invalid I/O register 0x%02X read through port %03X", d->crtc.reg_index, port);
             return 0;
         }
-        if (options.vgadebug)
+        if (machine().options().vgadebug)
             vlog(LogVGA, "I/O register 0x%02X read through port %03X", d->crtc.reg_index, port);
         return d->crtc.reg[d->crtc.reg_index];
 
@@ -706,277 +730,150 @@ u8 VGA::read_map_select() const
     return d->graphics_ctrl.reg[4] & 3;
 }
 
-void VGA::write_memory8(u32 address, u8 value)
+u8 VGA::color_compare() const
+{
+    return d->graphics_ctrl.reg[2] & 0xf;
+}
+
+u8 VGA::color_dont_care() const
+{
+    return d->graphics_ctrl.reg[7] & 0xf;
+}
+
+void VGA::update_memory_window()
 {
-    u32 offset;
     switch (d->graphics_ctrl.memory_map_select) {
     case 0: // A0000h-BFFFFh (128K region)
-        if (address < 0xa0000 || address > 0xbffff)
-            return;
-        offset = address - 0xa0000;
+        d->memory_window_base = 0xa0000;
+        d->memory_window_size = 0x20000;
         break;
     case 1: // A0000h-AFFFFh (64K region)
-        if (address < 0xa0000 || address > 0xaffff)
-            return;
-        offset = address - 0xa0000;
+        d->memory_window_base = 0xa0000;
+        d->memory_window_size = 0x10000;
         break;
     case 2: // B0000h-B7FFFh (32K region)
-        if (address < 0xb0000 || address > 0xb7fff)
-            return;
-        offset = address - 0xb0000;
+        d->memory_window_base = 0xb0000;
+        d->memory_window_size = 0x8000;
         break;
     default: // B8000h-BFFFFh (32K region)
-        if (address < 0xb8000 || address > 0xbffff)
-            return;
-        offset = address - 0xb8000;
+        d->memory_window_base = 0xb8000;
+        d->memory_window_size = 0x8000;
         break;
     }
+}
 
-    machine().notify_screen();
-
-    if (in_chain4_mode()) {
-        d->memory[(offset & ~0x03) + (offset % 4) * 65536] = value;
-        return;
+template<u8 logical_op>
+static ALWAYS_INLINE u32 apply_logical_op(u32 data, u32 latch)
+{
+    switch (logical_op) {
+    case 0:
+        return data;
+    case 1:
+        return data & latch;
+    case 2:
+        return data | latch;
+    default:
+        return data ^ latch;
     }
+}
 
-    u8 new_val[4];
-
-    if (write_mode() == 2) {
-        new_val[0] = d->latch[0] & ~bit_mask();
-        new_val[1] = d->latch[1] & ~bit_mask();
-        new_val[2] = d->latch[2] & ~bit_mask();
-        new_val[3] = d->latch[3] & ~bit_mask();
-
-        switch (logical_op()) {
-        case 0:
-            new_val[0] |= (value & 1) ? bit_mask() : 0;
-            new_val[1] |= (value & 2) ? bit_mask() : 0;
-            new_val[2] |= (value & 4) ? bit_mask() : 0;
-            new_val[3] |= (value & 8) ? bit_mask() : 0;
-            break;
-        default:
-            vlog(LogVGA, "Gaah, unsupported draw_op %d in mode 2 :(\n", logical_op());
-            hard_exit(1);
-        }
-    } else if (write_mode() == 0) {
-        u8 set_reset = d->graphics_ctrl.reg[0];
-        u8 enable_set_reset = d->graphics_ctrl.reg[1];
-        u8 val = value;
-
-        if (rotate_count()) {
-            vlog(LogVGA, "rotate_count non-zero!");
-            val = (val >> rotate_count()) | (val << (8 - rotate_count()));
-        }
+static ALWAYS_INLINE u8 rotate_right(u8 value, u8 count)
+{
+    return (value >> count) | (value << ((8 - count) & 7));
+}
 
-        new_val[0] = d->latch[0] & ~bit_mask();
-        new_val[1] = d->latch[1] & ~bit_mask();
-        new_val[2] = d->latch[2] & ~bit_mask();
-        new_val[3] = d->latch[3] & ~bit_mask();
+template<u8 write_mode, u8 logical_op>
+void VGA::Private::write_planar(Private& d, u32 offset, u8 value)
+{
+    u32 data;
+    u32 bit_mask = d.bit_mask;
 
-        val &= bit_mask();
+    switch (write_mode) {
+    case 0:
+        data = broadcast_to_lanes(rotate_right(value, d.rotate_count));
+        data = (data & ~d.enable_set_reset) | (d.set_reset & d.enable_set_reset);
+        break;
+    case 1:
+        d.planes[offset] = (d.planes[offset] & ~d.map_mask) | (d.latch & d.map_mask);
+        return;
+    case 2:
+        data = expand_to_lanes(value);
+        break;
+    default:
+        data = d.set_reset;
+        bit_mask &= broadcast_to_lanes(rotate_right(value, d.rotate_count));
+        break;
+    }
 
-        switch (logical_op()) {
-        case 0:
-            new_val[0] |= ((enable_set_reset & 1)
-                    ? ((set_reset & 1) ? bit_mask() : 0)
-                    : (val & bit_mask()));
-            new_val[1] |= ((enable_set_reset & 2)
-                    ? ((set_reset & 2) ? bit_mask() : 0)
-                    : (val & bit_mask()));
-            new_val[2] |= ((enable_set_reset & 4)
-                    ? ((set_reset & 4) ? bit_mask() : 0)
-                    : (val & bit_mask()));
-            new_val[3] |= ((enable_set_reset & 8)
-                    ? ((set_reset & 8) ? bit_mask() : 0)
-                    : (val & bit_mask()));
-            break;
-        case 1:
-            new_val[0] |= ((enable_set_reset & 1)
-                    ? ((set_reset & 1)
-                            ? (~d->latch[0] & bit_mask())
-                            : (d->latch[0] & bit_mask()))
-                    : (val & d->latch[0]) & bit_mask());
-
-            new_val[1] |= ((enable_set_reset & 2)
-                    ? ((set_reset & 2)
-                            ? (~d->latch[1] & bit_mask())
-                            : (d->latch[1] & bit_mask()))
-                    : (val & d->latch[1]) & bit_mask());
-
-            new_val[2] |= ((enable_set_reset & 4)
-                    ? ((set_reset & 4)
-                            ? (~d->latch[2] & bit_mask())
-                            : (d->latch[2] & bit_mask()))
-                    : (val & d->latch[2]) & bit_mask());
-
-            new_val[3] |= ((enable_set_reset & 8)
-                    ? ((set_reset & 8)
-                            ? (~d->latch[3] & bit_mask())
-                            : (d->latch[3] & bit_mask()))
-                    : (val & d->latch[3]) & bit_mask());
-            break;
-        case 2:
-            new_val[0] |= ((enable_set_reset & 1)
-                    ? ((set_reset & 1)
-                            ? (~d->latch[0] & bit_mask())
-                            : (d->latch[0] & bit_mask()))
-                    : (val | d->latch[0]) & bit_mask());
-
-            new_val[1] |= ((enable_set_reset & 2)
-                    ? ((set_reset & 2)
-                            ? (~d->latch[1] & bit_mask())
-                            : (d->latch[1] & bit_mask()))
-                    : (val | d->latch[1]) & bit_mask());
-
-            new_val[2] |= ((enable_set_reset & 4)
-                    ? ((set_reset & 4)
-                            ? (~d->latch[2] & bit_mask())
-                            : (d->latch[2] & bit_mask()))
-                    : (val | d->latch[2]) & bit_mask());
-
-            new_val[3] |= ((enable_set_reset & 8)
-                    ? ((set_reset & 8)
-                            ? (~d->latch[3] & bit_mask())
-                            : (d->latch[3] & bit_mask()))
-                    : (val | d->latch[3]) & bit_mask());
-            break;
-        case 3:
-            new_val[0] |= ((enable_set_reset & 1)
-                    ? ((set_reset & 1)
-                            ? (~d->latch[0] & bit_mask())
-                            : (d->latch[0] & bit_mask()))
-                    : (val ^ d->latch[0]) & bit_mask());
-
-            new_val[1] |= ((enable_set_reset & 2)
-                    ? ((set_reset & 2)
-                            ? (~d->latch[1] & bit_mask())
-                            : (d->latch[1] & bit_mask()))
-                    : (val ^ d->latch[1]) & bit_mask());
-
-            new_val[2] |= ((enable_set_reset & 4)
-                    ? ((set_reset & 4)
-                            ? (~d->latch[2] & bit_mask())
-                            : (d->latch[2] & bit_mask()))
-                    : (val ^ d->latch[2]) & bit_mask());
-
-            new_val[3] |= ((enable_set_reset & 8)
-                    ? ((set_reset & 8)
-                            ? (~d->latch[3] & bit_mask())
-                            : (d->latch[3] & bit_mask()))
-                    : (val ^ d->latch[3]) & bit_mask());
-            break;
-        }
-    } else if (write_mode() == 3) {
-        u8 set_reset = d->graphics_ctrl.reg[0];
-        u8 val = value;
+    u32 result = (apply_logical_op<logical_op>(data, d.latch) & bit_mask) | (d.latch & ~bit_mask);
+    d.planes[offset] = (d.planes[offset] & ~d.map_mask) | (result & d.map_mask);
+}
 
-        if (rotate_count()) {
-            vlog(LogVGA, "rotate_count non-zero!");
-            val = (val >> rotate_count()) | (val << (8 - rotate_count()));
-        }
+void VGA::Private::write_chain4(Private& d, u32 offset, u8 value)
+{
+    reinterpret_cast<u8*>(d.planes)[((offset & ~3) << 2) | (offset & 3)] = value;
+}
 
-        new_val[0] = d->latch[0] & ~bit_mask();
-        new_val[1] = d->latch[1] & ~bit_mask();
-        new_val[2] = d->latch[2] & ~bit_mask();
-        new_val[3] = d->latch[3] & ~bit_mask();
+void VGA::update_write_pipeline()
+{
+#define WRITE_MODE(mode) \
+    { &Private::write_planar<mode, 0>, &Private::write_planar<mode, 1>, &Private::write_planar<mode, 2>, &Private::write_planar<mode, 3> }
+    static const Private::WriteFunction planar_write_functions[4][4] = {
+        WRITE_MODE(0),
+        WRITE_MODE(1),
+        WRITE_MODE(2),
+        WRITE_MODE(3),
+    };
+#undef WRITE_MODE
+
+    d->set_reset = expand_to_lanes(d->graphics_ctrl.reg[0]);
+    d->enable_set_reset = expand_to_lanes(d->graphics_ctrl.reg[1]);
+    d->rotate_count = rotate_count();
+    d->bit_mask = broadcast_to_lanes(bit_mask());
+    d->map_mask = expand_to_lanes(d->sequencer.reg[2]);
 
-        val &= bit_mask();
+    if (in_chain4_mode())
+        d->write_function = &Private::write_chain4;
+    else
+        d->write_function = planar_write_functions[write_mode()][logical_op()];
+}
 
-        switch (logical_op()) {
-        case 0:
-            new_val[0] |= (set_reset & 1) ? value : 0;
-            new_val[1] |= (set_reset & 2) ? value : 0;
-            new_val[2] |= (set_reset & 4) ? value : 0;
-            new_val[3] |= (set_reset & 8) ? value : 0;
-            break;
-        case 1:
-            new_val[0] |= ((set_reset & 1) ? value : 0) & d->latch[0];
-            new_val[1] |= ((set_reset & 2) ? value : 0) & d->latch[1];
-            new_val[2] |= ((set_reset & 4) ? value : 0) & d->latch[2];
-            new_val[3] |= ((set_reset & 8) ? value : 0) & d->latch[3];
-            break;
-        case 2:
-            new_val[0] |= ((set_reset & 1) ? value : 0) | d->latch[0];
-            new_val[1] |= ((set_reset & 2) ? value : 0) | d->latch[1];
-            new_val[2] |= ((set_reset & 4) ? value : 0) | d->latch[2];
-            new_val[3] |= ((set_reset & 8) ? value : 0) | d->latch[3];
-            break;
-        case 3:
-            new_val[0] |= ((set_reset & 1) ? value : 0) ^ d->latch[0];
-            new_val[1] |= ((set_reset & 2) ? value : 0) ^ d->latch[1];
-            new_val[2] |= ((set_reset & 4) ? value : 0) ^ d->latch[2];
-            new_val[3] |= ((set_reset & 8) ? value : 0) ^ d->latch[3];
-            break;
-        }
-    } else if (write_mode() == 1) {
-        new_val[0] = d->latch[0];
-        new_val[1] = d->latch[1];
-        new_val[2] = d->latch[2];
-        new_val[3] = d->latch[3];
-    } else {
-        vlog(LogVGA, "Unsupported VGA write mode %d", write_mode());
-        hard_exit(1);
-
-        // This is just here to make GCC stop worrying about accessing new_val[] uninitialized.
+void VGA::write_memory8(u32 address, u8 value)
+{
+    if (UNLIKELY(machine().vbe().is_enabled()) && address < 0xb0000) {
+        machine().vbe().write_banked(address - 0xa0000, value);
         return;
     }
 
-    u8 map_mask = d->sequencer.reg[2] & 0x0f;
+    u32 offset = address - d->memory_window_base;
+    if (offset >= d->memory_window_size)
+        return;
 
-    if (map_mask & 0x01)
-        d->plane[0][offset] = new_val[0];
-    if (map_mask & 0x02)
-        d->plane[1][offset] = new_val[1];
-    if (map_mask & 0x04)
-        d->plane[2][offset] = new_val[2];
-    if (map_mask & 0x08)
-        d->plane[3][offset] = new_val[3];
+    machine().notify_screen();
+    d->write_function(*d, offset & 0xffff, value);
 }
 
 u8 VGA::read_memory8(u32 address)
 {
-    u32 offset;
-    switch (d->graphics_ctrl.memory_map_select) {
-    case 0: // A0000h-BFFFFh (128K region)
-        offset = address & 0x1ffff;
-        break;
-    case 1: // A0000h-AFFFFh (64K region)
-        if (address > 0xaffff)
-            return 0xff;
-        offset = address & 0xffff;
-        break;
-    case 2: // B0000h-B7FFFh (32K region)
-        if (address < 0xb0000 || address > 0xb7fff)
-            return 0xff;
-        offset = address & 0x7fff;
-        break;
-    default: // B8000h-BFFFFh (32K region)
-        if (address < 0xb8000 || address > 0xbffff)
-            return 0xff;
-        offset = address & 0x7fff;
-        break;
-    }
+    if (UNLIKELY(machine().vbe().is_enabled()) && address < 0xb0000)
+        return machine().vbe().read_banked(address - 0xa0000);
+
+    u32 offset = address - d->memory_window_base;
+    if (offset >= d->memory_window_size)
+        return 0xff;
+    offset &= 0xffff;
 
     if (in_chain4_mode())
-        return d->memory[(offset & ~3) + (offset % 4) * 65536];
+        return reinterpret_cast<const u8*>(d->planes)[((offset & ~3) << 2) | (offset & 3)];
 
-    if (read_mode() != 0) {
-        vlog(LogVGA, "ZOMG! READ_MODE = %u", read_mode());
-        hard_exit(1);
-    }
+    d->latch = d->planes[offset];
 
-    d->latch[0] = d->plane[0][offset];
-    d->latch[1] = d->plane[1][offset];
-    d->latch[2] = d->plane[2][offset];
-    d->latch[3] = d->plane[3][offset];
+    if (read_mode() == 0)
+        return d->latch >> (read_map_select() * 8);
 
-    return d->latch[read_map_select()];
-}
-
-const u8* VGA::plane(int index) const
-{
-    ASSERT(index >= 0 && index <= 3);
-    return d->plane[index];
+    // Color compare: a bit is set where every plane selected by Color Don't Care matches Color Compare.
+    u32 matches = ~(d->latch ^ expand_to_lanes(color_compare())) | ~expand_to_lanes(color_dont_care());
+    return matches & (matches >> 8) & (matches >> 16) & (matches >> 24);
 }
 
 void VGA::synchronize_colors()
@@ -47,8 +47,8 @@ public:
     virtual void write_memory8(u32 address, u8 value) override;
     virtual u8 read_memory8(u32 address) override;
 
-    const u8* plane(int index) const;
-    const u8* text_memory() const;
+    // One u32 per offset, with plane n in byte n.
+    const u32* planes() const;
 
     void set_palette_dirty(bool);
     bool is_palette_dirty();
@@ -79,12 +79,16 @@ signals:
 
 private:
     void synchronize_colors();
+    void update_memory_window();
+    void update_write_pipeline();
     u8 read_mode() const;
     u8 write_mode() const;
     u8 rotate_count() const;
     u8 logical_op() const;
     u8 bit_mask() const;
     u8 read_map_select() const;
+    u8 color_compare() const;
+    u8 color_dont_care() const;
 
     struct Private;
     OwnPtr<Private> d;
@@ -37,20 +37,20 @@ VomCtl::VomCtl(Machine& machine)
     : IODevice("VomCtl", machine)
     , d(make<Private>())
 {
-    listen(0xD6, IODevice::ReadWrite);
-    listen(0xD7, IODevice::ReadWrite);
-    listen(0xE9, IODevice::WriteOnly);
+    listen<VomCtl>(0xD6, IODevice::ReadWrite);
+    listen<VomCtl>(0xD7, IODevice::ReadWrite);
+    listen<VomCtl>(0xE9, IODevice::WriteOnly);
 
     // FIXME: These should all be removed.
-    listen(0xE0, IODevice::WriteOnly);
-    listen(0xE2, IODevice::WriteOnly);
-    listen(0xE3, IODevice::WriteOnly);
-    listen(0xE4, IODevice::WriteOnly);
-    listen(0xE6, IODevice::WriteOnly);
-    listen(0xE7, IODevice::WriteOnly);
-    listen(0xE8, IODevice::WriteOnly);
+    listen<VomCtl>(0xE0, IODevice::WriteOnly);
+    listen<VomCtl>(0xE2, IODevice::WriteOnly);
+    listen<VomCtl>(0xE3, IODevice::WriteOnly);
+    listen<VomCtl>(0xE4, IODevice::WriteOnly);
+    listen<VomCtl>(0xE6, IODevice::WriteOnly);
+    listen<VomCtl>(0xE7, IODevice::WriteOnly);
+    listen<VomCtl>(0xE8, IODevice::WriteOnly);
 
-    listen(0x666, IODevice::WriteOnly);
+    listen<VomCtl>(0x666, IODevice::WriteOnly);
 
     reset();
 }
@@ -115,12 +115,14 @@ void VomCtl::out8(u16 port, u8 data)
     case 0xE9:
     case 0x666:
 #ifdef DEBUG_SERENITY
-        if (options.serenity) {
+        if (machine().options().serenity) {
             printf("%c", data);
             fflush(stdout);
         }
 #endif
-        {
+        if (machine().options().debug_port_to_stderr) {
+            fputc(data, stderr);
+        } else {
             static FILE* fp = fopen("out.txt", "w");
             fputc(data, fp);
             fflush(fp);
@@ -67,7 +67,12 @@ struct RuntimeOptions {
     bool crash_on_general_protection_fault { false };
     bool crash_on_exception { false };
     bool stacklog { false };
+    bool debug_port_to_stderr { false };
+    QString trace_path;
     QString autotest_path;
+    QString suite_path;
+    QString bench_path;
+    u64 bench_instruction_count { 100000000 };
     QString config_path;
 #ifdef DISASSEMBLE_EVERYTHING
     bool disassemble_everything { false };
@@ -79,7 +84,8 @@ struct RuntimeOptions {
     bool log_page_translations { false };
 };
 
-extern RuntimeOptions options;
+// Parsed from the command line. Each Machine starts out with its own copy.
+extern RuntimeOptions g_default_options;
 
 inline PhysicalAddress real_mode_address_to_physical_address(u16 segment, u32 offset)
 {
@@ -0,0 +1,71 @@
+// Computron x86 PC Emulator
+// Copyright (C) 2003-2018 Andreas Kling <awesomekling@gmail.com>
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY ANDREAS KLING ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL ANDREAS KLING OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+
+// Hands complete frames from one producer thread to one consumer thread without locks.
+// The producer draws into back() and publish()es it; the consumer acquire()s the most recently
+// published frame into front(). Neither side ever waits for the other, and neither ever sees
+// a frame the other is still working on.
+template<typename T>
+class TripleBuffer {
+public:
+    // Producer side.
+    T& back() { return m_slots[m_back]; }
+    void publish()
+    {
+        unsigned previous = m_middle.exchange(m_back | FreshBit, std::memory_order_acq_rel);
+        m_back = previous & IndexMask;
+    }
+
+    // Consumer side. Returns true if a newer frame replaced front().
+    bool acquire()
+    {
+        if (!(m_middle.load(std::memory_order_relaxed) & FreshBit))
+            return false;
+        unsigned previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+        m_front = previous & IndexMask;
+        return true;
+    }
+    const T& front() const { return m_slots[m_front]; }
+
+    // Only before either thread starts using the buffer.
+    template<typename Callback>
+    void for_each_slot(Callback callback)
+    {
+        for (auto& slot : m_slots)
+            callback(slot);
+    }
+
+private:
+    static constexpr unsigned IndexMask = 3;
+    static constexpr unsigned FreshBit = 4;
+
+    T m_slots[3];
+    unsigned m_back { 0 };
+    std::atomic<unsigned> m_middle { 1 };
+    unsigned m_front { 2 };
+};
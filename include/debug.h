@@ -25,22 +25,38 @@
 #pragma once
 
 #include "Common.h"
+#include <atomic>
 
+// Waits until everything queued so far has been written out.
+void vlog_flush();
+
+// Failed assertions flush the log first, since whatever led up to them is usually still queued.
 #ifndef NDEBUG
 #    include <QtCore/qdebug.h>
 #    include <assert.h>
-#    define ASSERT assert
+#    define ASSERT(x)         \
+        do {                  \
+            if (!(x)) {       \
+                vlog_flush(); \
+                assert(x);    \
+            }                 \
+        } while (0)
 #    define ASSERT_NOT_REACHED() ASSERT(false)
-#    define RELEASE_ASSERT assert
+#    define RELEASE_ASSERT ASSERT
 #else
 #    define ASSERT(x)
-#    define ASSERT_NOT_REACHED() CRASH()
+#    define ASSERT_NOT_REACHED() \
+        do {                     \
+            vlog_flush();        \
+            CRASH();             \
+        } while (0)
 #    define RELEASE_ASSERT(x) \
         do {                  \
             if (!(x)) {       \
+                vlog_flush(); \
                 CRASH();      \
             }                 \
-            while (0)
+        } while (0)
 #endif
 
 #define BEGIN_ASSERT_NO_EXCEPTIONS try {
@@ -73,6 +89,37 @@ enum VLogChannel {
 #ifdef DEBUG_SERENITY
     LogSerenity,
 #endif
+    VLogChannelCount
 };
 
-void vlog(VLogChannel channel, const char* format, ...);
+static_assert(VLogChannelCount <= 32, "VLogChannel must fit in a u32 mask");
+
+// Channels missing from this mask are compiled out entirely, arguments and all.
+// Build with e.g. DEFINES += CT_VLOG_COMPILED_CHANNELS=0 to drop every vlog() call.
+#ifndef CT_VLOG_COMPILED_CHANNELS
+#    define CT_VLOG_COMPILED_CHANNELS 0xffffffffu
+#endif
+
+extern std::atomic<u32> g_vlog_channel_mask;
+
+inline bool vlog_enabled(VLogChannel channel)
+{
+    u32 bit = 1u << channel;
+    return (CT_VLOG_COMPILED_CHANNELS & bit) && (g_vlog_channel_mask.load(std::memory_order_relaxed) & bit);
+}
+
+const char* vlog_channel_name(VLogChannel);
+bool vlog_channel_from_name(const QString&, VLogChannel&);
+void set_vlog_channel_enabled(VLogChannel, bool);
+void set_vlog_channel_mask(u32);
+
+// Formats the message and queues it for the logger thread. Never blocks; drops the message if the queue is full.
+// LogError, LogExit and LogAlert are the exception: they're written out before this returns.
+void vlog_impl(VLogChannel channel, const char* format, ...);
+
+// The channel mask is checked before any of the arguments are evaluated.
+#define vlog(channel, ...)                   \
+    do {                                     \
+        if (vlog_enabled(channel))           \
+            vlog_impl(channel, __VA_ARGS__); \
+    } while (0)
@@ -56,10 +56,15 @@ private:
     void handle_step();
     void handle_continue();
     void handle_breakpoint(const QStringList&);
+    void handle_watch(const QStringList&);
     void handle_dump_memory(const QStringList&);
     void handle_dump_flat_memory(const QStringList&);
     void handle_tracing(const QStringList&);
     void handle_irq(const QStringList&);
+    void handle_disks(const QStringList&);
+    void handle_profile(const QStringList&);
+    void handle_sample(const QStringList&);
+    void handle_log(const QStringList&);
     void handle_dump_unassembled(const QStringList&);
     void handle_selector(const QStringList&);
     void handle_stack(const QStringList&);
@@ -27,6 +27,7 @@
 #include "Common.h"
 #include "OwnPtr.h"
 #include "ROM.h"
+#include "iodevice.h"
 #include "types.h"
 #include <QHash>
 #include <QMutex>
@@ -36,6 +37,7 @@
 #include <functional>
 
 class IODevice;
+class BochsVBE;
 class BusMouse;
 class CMOS;
 class DMA;
@@ -43,9 +45,11 @@ class DiskDrive;
 class FDC;
 class IDE;
 class Keyboard;
+class MathCoprocessor;
 class PIC;
 class PIT;
 class PS2;
+class Scheduler;
 class Settings;
 class CPU;
 class VGA;
@@ -58,12 +62,17 @@ class Machine : public QObject {
 public:
     static OwnPtr<Machine> create_from_file(const QString& fileName);
     static OwnPtr<Machine> create_for_autotest(const QString& fileName);
+    static OwnPtr<Machine> create_for_benchmark(const QString& fileName);
 
     explicit Machine(OwnPtr<Settings>&&, QObject* parent = nullptr);
     virtual ~Machine();
 
+    // Every live Machine in the process, each running on its own worker thread.
+    static void for_each_machine(std::function<void(Machine&)>);
+
     CPU& cpu() { return *m_cpu; }
     VGA& vga() { return *m_vga; }
+    BochsVBE& vbe() { return *m_vbe; }
     PIT& pit() { return *m_pit; }
     BusMouse& busmouse() { return *m_busmouse; }
     Keyboard& keyboard() { return *m_keyboard; }
@@ -71,13 +80,19 @@ public:
     PIC& master_pic() { return *m_master_pic; }
     PIC& slave_pic() { return *m_slave_pic; }
     CMOS& cmos() { return *m_cmos; }
+    DMA& dma() { return *m_dma; }
+    Scheduler& scheduler() { return *m_scheduler; }
     Settings& settings() { return *m_settings; }
+    RuntimeOptions& options() { return m_options; }
 
     DiskDrive& floppy0();
     DiskDrive& floppy1();
     DiskDrive& fixed0();
     DiskDrive& fixed1();
 
+    void for_each_disk_drive(std::function<void(DiskDrive&)>);
+    void flush_disk_drives();
+
     bool is_for_autotest() PURE;
 
     MachineWidget* widget() { return m_widget; }
@@ -88,14 +103,16 @@ public:
 
     void for_each_io_device(std::function<void(IODevice&)>);
 
-    IODevice* input_device_for_port(u16 port);
-    IODevice* output_device_for_port(u16 port);
+    const IOPortHandler& io_port_handler(u16 port) const { return m_io_port_handlers.constData()[port]; }
 
-    void register_input_device(Badge<IODevice>, u16 port, IODevice&);
-    void register_output_device(Badge<IODevice>, u16 port, IODevice&);
+    void register_input_device(Badge<IODevice>, u16 port, IODevice&, const IOPortHandler&);
+    void register_output_device(Badge<IODevice>, u16 port, IODevice&, const IOPortHandler&);
     void register_device(Badge<IODevice>, IODevice&);
     void unregister_device(Badge<IODevice>, IODevice&);
 
+    // Accesses to an ignored port that no device claims are dropped without logging.
+    void ignore_port(u16 port);
+
     void make_cpu(Badge<Worker>);
     void make_devices(Badge<Worker>);
     void did_initialize_worker(Badge<Worker>);
@@ -117,11 +134,10 @@ private:
 
     Worker& worker() { return *m_worker; }
 
-    IODevice* input_device_for_port_slow_case(u16 port);
-    IODevice* output_device_for_port_slow_case(u16 port);
-
     OwnPtr<Settings> m_settings;
+    RuntimeOptions m_options;
     OwnPtr<CPU> m_cpu;
+    OwnPtr<Scheduler> m_scheduler;
 
     OwnPtr<Worker> m_worker;
     QMutex m_worker_mutex;
@@ -129,6 +145,7 @@ private:
 
     // IODevices
     OwnPtr<VGA> m_vga;
+    OwnPtr<BochsVBE> m_vbe;
     OwnPtr<PIT> m_pit;
     OwnPtr<BusMouse> m_busmouse;
     OwnPtr<CMOS> m_cmos;
@@ -138,6 +155,7 @@ private:
     OwnPtr<PIC> m_master_pic;
     OwnPtr<PIC> m_slave_pic;
     OwnPtr<PS2> m_ps2;
+    OwnPtr<MathCoprocessor> m_math_coprocessor;
     OwnPtr<DMA> m_dma;
     OwnPtr<VomCtl> m_vomctl;
 
@@ -150,25 +168,9 @@ private:
 
     QSet<IODevice*> m_allDevices;
 
-    IODevice* m_fast_input_devices[1024];
-    IODevice* m_fast_output_devices[1024];
-
-    QHash<u16, IODevice*> m_all_input_devices;
-    QHash<u16, IODevice*> m_all_output_devices;
+    // Indexed by port number, all 65536 of them. Unclaimed ports point at handlers that log and return junk.
+    QVector<IOPortHandler> m_io_port_handlers;
+    QSet<u16> m_ignored_ports;
 
     QVector<ROM*> m_roms;
 };
-
-inline IODevice* Machine::input_device_for_port(u16 port)
-{
-    if (port < 1024)
-        return m_fast_input_devices[port];
-    return input_device_for_port_slow_case(port);
-}
-
-inline IODevice* Machine::output_device_for_port(u16 port)
-{
-    if (port < 1024)
-        return m_fast_output_devices[port];
-    return output_device_for_port_slow_case(port);
-}
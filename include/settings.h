@@ -36,6 +36,7 @@ class Settings {
 public:
     static OwnPtr<Settings> create_from_file(const QString&);
     static OwnPtr<Settings> create_for_autotest(const QString& fileName);
+    static OwnPtr<Settings> create_for_benchmark(const QString& fileName);
 
     unsigned memory_size() const { return m_memory_size; }
     void set_memory_size(unsigned size) { m_memory_size = size; }
@@ -50,9 +51,14 @@ public:
     const QHash<u32, QString>& rom_images() const { return m_rom_images; }
     QString keymap() const { return m_keymap; }
 
+    unsigned disk_cache_size() const { return m_disk_cache_size; }
+
     bool is_for_autotest() const { return m_for_autotest; }
     void set_for_autotest(bool b) { m_for_autotest = b; }
 
+    // Benchmarks boot like autotests but without the per-instruction trace.
+    bool is_for_benchmark() const { return m_for_benchmark; }
+
     Settings() { }
     ~Settings() { }
 
@@ -71,6 +77,7 @@ private:
     bool handle_fixed_disk(const QStringList&);
     bool handle_floppy_disk(const QStringList&);
     bool handle_keymap(const QStringList&);
+    bool handle_disk_cache(const QStringList&);
 
     DiskDrive::Configuration m_floppy0;
     DiskDrive::Configuration m_floppy1;
@@ -81,10 +88,12 @@ private:
     QHash<u32, QString> m_rom_images;
     QString m_keymap;
     unsigned m_memory_size { 0 };
+    unsigned m_disk_cache_size { DiskDrive::default_cache_size_in_kilobytes };
     u16 m_entryCS { 0 };
     u16 m_entryIP { 0 };
     u16 m_entryDS { 0 };
     u16 m_entrySS { 0 };
     u16 m_entrySP { 0 };
     bool m_for_autotest { false };
+    bool m_for_benchmark { false };
 };
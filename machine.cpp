@@ -23,10 +23,13 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "machine.h"
+#include "BochsVBE.h"
 #include "CPU.h"
 #include "DMA.h"
 #include "DiskDrive.h"
+#include "MathCoprocessor.h"
 #include "PS2.h"
+#include "Scheduler.h"
 #include "busmouse.h"
 #include "cmos.h"
 #include "fdc.h"
@@ -43,6 +46,16 @@
 #include "worker.h"
 #include <QtCore/QFile>
 
+static QMutex s_machines_mutex;
+static QSet<Machine*> s_machines;
+
+void Machine::for_each_machine(std::function<void(Machine&)> callback)
+{
+    QMutexLocker locker(&s_machines_mutex);
+    for (auto* machine : s_machines)
+        callback(*machine);
+}
+
 OwnPtr<Machine> Machine::create_from_file(const QString& fileName)
 {
     auto settings = Settings::create_from_file(fileName);
@@ -59,9 +72,18 @@ OwnPtr<Machine> Machine::create_for_autotest(const QString& fileName)
     return make<Machine>(std::move(settings));
 }
 
+OwnPtr<Machine> Machine::create_for_benchmark(const QString& fileName)
+{
+    auto settings = Settings::create_for_benchmark(fileName);
+    if (!settings)
+        return nullptr;
+    return make<Machine>(std::move(settings));
+}
+
 Machine::Machine(OwnPtr<Settings>&& settings, QObject* parent)
     : QObject(parent)
     , m_settings(std::move(settings))
+    , m_options(g_default_options)
 {
     m_worker_mutex.lock();
     m_worker = make<Worker>(*this);
@@ -75,43 +97,50 @@ Machine::Machine(OwnPtr<Settings>&& settings, QObject* parent)
     if (!m_settings->is_for_autotest()) {
         // FIXME: Move this somewhere else.
         // Mitigate spam about uninteresting ports.
-        IODevice::ignore_port(0x220);
-        IODevice::ignore_port(0x221);
-        IODevice::ignore_port(0x222);
-        IODevice::ignore_port(0x223);
-        IODevice::ignore_port(0x201); // Gameport.
-        IODevice::ignore_port(0x330); // MIDI
-        IODevice::ignore_port(0x331); // MIDI
-        IODevice::ignore_port(0x334); // SCSI (BusLogic)
-
-        IODevice::ignore_port(0x237);
-        IODevice::ignore_port(0x337);
-
-        IODevice::ignore_port(0x322);
-
-        IODevice::ignore_port(0x0C8F);
-        IODevice::ignore_port(0x1C8F);
-        IODevice::ignore_port(0x2C8F);
-        IODevice::ignore_port(0x3C8F);
-        IODevice::ignore_port(0x4C8F);
-        IODevice::ignore_port(0x5C8F);
-        IODevice::ignore_port(0x6C8F);
-        IODevice::ignore_port(0x7C8F);
-        IODevice::ignore_port(0x8C8F);
-        IODevice::ignore_port(0x9C8F);
-        IODevice::ignore_port(0xAC8F);
-        IODevice::ignore_port(0xBC8F);
-        IODevice::ignore_port(0xCC8F);
-        IODevice::ignore_port(0xDC8F);
-        IODevice::ignore_port(0xEC8F);
-        IODevice::ignore_port(0xFC8F);
-
-        IODevice::ignore_port(0x3f6);
+        ignore_port(0x220);
+        ignore_port(0x221);
+        ignore_port(0x222);
+        ignore_port(0x223);
+        ignore_port(0x201); // Gameport.
+        ignore_port(0x330); // MIDI
+        ignore_port(0x331); // MIDI
+        ignore_port(0x334); // SCSI (BusLogic)
+
+        ignore_port(0x237);
+        ignore_port(0x337);
+
+        ignore_port(0x322);
+
+        ignore_port(0x0C8F);
+        ignore_port(0x1C8F);
+        ignore_port(0x2C8F);
+        ignore_port(0x3C8F);
+        ignore_port(0x4C8F);
+        ignore_port(0x5C8F);
+        ignore_port(0x6C8F);
+        ignore_port(0x7C8F);
+        ignore_port(0x8C8F);
+        ignore_port(0x9C8F);
+        ignore_port(0xAC8F);
+        ignore_port(0xBC8F);
+        ignore_port(0xCC8F);
+        ignore_port(0xDC8F);
+        ignore_port(0xEC8F);
+        ignore_port(0xFC8F);
+
+        ignore_port(0x3f6);
     }
+
+    QMutexLocker locker(&s_machines_mutex);
+    s_machines.insert(this);
 }
 
 Machine::~Machine()
 {
+    {
+        QMutexLocker locker(&s_machines_mutex);
+        s_machines.remove(this);
+    }
     qDeleteAll(m_roms);
 }
 
@@ -124,6 +153,7 @@ void Machine::make_cpu(Badge<Worker>)
 {
     RELEASE_ASSERT(QThread::currentThread() == m_worker.ptr());
     m_cpu = make<CPU>(*this);
+    m_scheduler = make<Scheduler>(*m_cpu);
 }
 
 void Machine::make_devices(Badge<Worker>)
@@ -136,8 +166,7 @@ void Machine::make_devices(Badge<Worker>)
 
     apply_settings();
 
-    memset(m_fast_input_devices, 0, sizeof(m_fast_input_devices));
-    memset(m_fast_output_devices, 0, sizeof(m_fast_output_devices));
+    m_io_port_handlers.fill(IODevice::unhandled_port_handler(), 65536);
 
     cpu().set_base_memory_size(640 * 1024);
 
@@ -150,11 +179,11 @@ void Machine::make_devices(Badge<Worker>)
     m_ide = make<IDE>(*this);
     m_keyboard = make<Keyboard>(*this);
     m_ps2 = make<PS2>(*this);
+    m_math_coprocessor = make<MathCoprocessor>(*this);
     m_vomctl = make<VomCtl>(*this);
     m_pit = make<PIT>(*this);
     m_vga = make<VGA>(*this);
-
-    pit().boot();
+    m_vbe = make<BochsVBE>(*this);
 }
 
 void Machine::apply_settings()
@@ -187,6 +216,10 @@ void Machine::apply_settings()
     m_floppy1->set_configuration(settings().floppy1());
     m_fixed0->set_configuration(settings().fixed0());
     m_fixed1->set_configuration(settings().fixed1());
+
+    for_each_disk_drive([this](DiskDrive& drive) {
+        drive.set_cache_size_in_kilobytes(settings().disk_cache_size());
+    });
 }
 
 bool Machine::load_file(u32 address, const QString& fileName)
@@ -265,33 +298,47 @@ void Machine::for_each_io_device(std::function<void(IODevice&)> function)
 
 void Machine::reset_all_io_devices()
 {
+    flush_disk_drives();
+    scheduler().clear();
     for_each_io_device([](IODevice& device) {
         device.reset();
     });
 }
 
-IODevice* Machine::input_device_for_port_slow_case(u16 port)
+void Machine::register_input_device(Badge<IODevice>, u16 port, IODevice& device, const IOPortHandler& handler)
 {
-    return m_all_input_devices.value(port, nullptr);
+    auto& entry = m_io_port_handlers[port];
+    entry.input_device = &device;
+    entry.in8 = handler.in8;
+    entry.in16 = handler.in16;
+    entry.in32 = handler.in32;
 }
 
-IODevice* Machine::output_device_for_port_slow_case(u16 port)
+void Machine::register_output_device(Badge<IODevice>, u16 port, IODevice& device, const IOPortHandler& handler)
 {
-    return m_all_output_devices.value(port, nullptr);
+    auto& entry = m_io_port_handlers[port];
+    entry.output_device = &device;
+    entry.out8 = handler.out8;
+    entry.out16 = handler.out16;
+    entry.out32 = handler.out32;
 }
 
-void Machine::register_input_device(Badge<IODevice>, u16 port, IODevice& device)
+void Machine::ignore_port(u16 port)
 {
-    if (port < 1024)
-        m_fast_input_devices[port] = &device;
-    m_all_input_devices.insert(port, &device);
-}
-
-void Machine::register_output_device(Badge<IODevice>, u16 port, IODevice& device)
-{
-    if (port < 1024)
-        m_fast_output_devices[port] = &device;
-    m_all_output_devices.insert(port, &device);
+    m_ignored_ports.insert(port);
+
+    auto ignored = IODevice::ignored_port_handler();
+    auto& entry = m_io_port_handlers[port];
+    if (!entry.input_device) {
+        entry.in8 = ignored.in8;
+        entry.in16 = ignored.in16;
+        entry.in32 = ignored.in32;
+    }
+    if (!entry.output_device) {
+        entry.out8 = ignored.out8;
+        entry.out16 = ignored.out16;
+        entry.out32 = ignored.out32;
+    }
 }
 
 void Machine::register_device(Badge<IODevice>, IODevice& device)
@@ -302,6 +349,40 @@ void Machine::register_device(Badge<IODevice>, IODevice& device)
 void Machine::unregister_device(Badge<IODevice>, IODevice& device)
 {
     m_allDevices.remove(&device);
+
+    auto unhandled = IODevice::unhandled_port_handler();
+    auto ignored = IODevice::ignored_port_handler();
+    for (u16 port : device.ports()) {
+        auto& entry = m_io_port_handlers[port];
+        auto& unclaimed = m_ignored_ports.contains(port) ? ignored : unhandled;
+        if (entry.input_device == &device) {
+            entry.input_device = nullptr;
+            entry.in8 = unclaimed.in8;
+            entry.in16 = unclaimed.in16;
+            entry.in32 = unclaimed.in32;
+        }
+        if (entry.output_device == &device) {
+            entry.output_device = nullptr;
+            entry.out8 = unclaimed.out8;
+            entry.out16 = unclaimed.out16;
+            entry.out32 = unclaimed.out32;
+        }
+    }
+}
+
+void Machine::for_each_disk_drive(std::function<void(DiskDrive&)> callback)
+{
+    callback(*m_floppy0);
+    callback(*m_floppy1);
+    callback(*m_fixed0);
+    callback(*m_fixed1);
+}
+
+void Machine::flush_disk_drives()
+{
+    for_each_disk_drive([](DiskDrive& drive) {
+        drive.flush();
+    });
 }
 
 DiskDrive& Machine::floppy0()
@@ -118,6 +118,23 @@ bool Settings::handle_memory_size(const QStringList& arguments)
     return true;
 }
 
+bool Settings::handle_disk_cache(const QStringList& arguments)
+{
+    // disk-cache <size in kilobytes>
+
+    if (arguments.count() != 1)
+        return false;
+
+    bool ok;
+    unsigned size = arguments.at(0).toUInt(&ok);
+    if (!ok)
+        return false;
+
+    vlog(LogConfig, "Disk cache: %u KiB per drive", size);
+    m_disk_cache_size = size;
+    return true;
+}
+
 bool Settings::handle_keymap(const QStringList& arguments)
 {
     // keymap <path/to/file>
@@ -213,6 +230,8 @@ OwnPtr<Settings> Settings::create_for_autotest(const QString& fileName)
     static const u16 autotestEntryDS = 0x1000;
     static const u16 autotestEntrySS = 0x9000;
     static const u16 autotestEntrySP = 0x1000;
+    // Same as the CPU's power-on default. Left at 0, apply_settings() would free guest RAM and the test image would never load.
+    static const unsigned autotestMemorySize = 8192 * 1024;
 
     auto settings = make<Settings>();
 
@@ -221,12 +240,20 @@ OwnPtr<Settings> Settings::create_for_autotest(const QString& fileName)
     settings->m_entryDS = autotestEntryDS;
     settings->m_entrySS = autotestEntrySS;
     settings->m_entrySP = autotestEntrySP;
+    settings->m_memory_size = autotestMemorySize;
     settings->m_files.insert(real_mode_address_to_physical_address(autotestEntryCS, autotestEntryIP).get(), fileName);
 
     settings->m_for_autotest = true;
     return settings;
 }
 
+OwnPtr<Settings> Settings::create_for_benchmark(const QString& fileName)
+{
+    auto settings = create_for_autotest(fileName);
+    settings->m_for_benchmark = true;
+    return settings;
+}
+
 OwnPtr<Settings> Settings::create_from_file(const QString& fileName)
 {
     QFile file(fileName);
@@ -274,6 +301,8 @@ OwnPtr<Settings> Settings::create_from_file(const QString& fileName)
             success = settings->handle_floppy_disk(arguments);
         else if (command == QLatin1String("keymap"))
             success = settings->handle_keymap(arguments);
+        else if (command == QLatin1String("disk-cache"))
+            success = settings->handle_disk_cache(arguments);
 
         if (!success) {
             vlog(LogConfig, "Failed parsing %s:%u %s", qPrintable(fileName), lineNumber, qPrintable(line));
@@ -0,0 +1,88 @@
+[bits 16]
+
+; Masked exceptions deliver their default result and only set the sticky status bits.
+; Unmasked ones leave the operands alone and, with CR0.NE clear, are reported on IRQ13
+; at the next waiting instruction. IRQ13 is raised once per error, until FNCLEX.
+
+cli
+mov al, 0x11
+out 0x20, al
+out 0xa0, al
+mov al, 0x08
+out 0x21, al
+mov al, 0x70
+out 0xa1, al
+mov al, 0x04
+out 0x21, al
+mov al, 0x02
+out 0xa1, al
+mov al, 0x01
+out 0x21, al
+out 0xa1, al
+mov al, 0xfb
+out 0x21, al
+mov al, 0xdf
+out 0xa1, al
+
+xor ax, ax
+mov es, ax
+mov word [es:0x75 * 4], irq13
+mov word [es:0x75 * 4 + 2], 0x1000
+
+fninit
+
+; Masked divide by zero: 1 / 0 = +inf with ZE set, TOP = 7.
+fld1
+fldz
+fdivp st1, st0
+fnstsw ax
+
+; Masked invalid operation: storing +inf as an integer gives the integer indefinite.
+fistp word [result]
+mov bx, [result]
+mov cx, ax
+fnstsw ax
+xchg cx, ax
+
+; Unmasked divide by zero: ST(1) keeps its 1, and the pending error sets ES and B.
+fninit
+fldcw word [cw_unmask_zero]
+fld1
+fldz
+fdivp st1, st0
+mov dx, ax
+fnstsw ax
+xchg dx, ax
+
+; The first waiting instruction raises IRQ13. The handler acknowledges it through port F0.
+sti
+fwait
+nop
+fwait
+nop
+
+; FNCLEX re-arms the report, and the next error raises IRQ13 again.
+fnclex
+fdivp st1, st0
+fwait
+nop
+fnstsw ax
+mov bx, ax
+fnclex
+fnstsw ax
+xchg bx, ax
+
+db 0xf1
+
+irq13:
+inc si
+out 0xf0, al
+mov al, 0x20
+out 0xa0, al
+out 0x20, al
+iret
+
+cw_unmask_zero:
+dw 0x037b
+result:
+dw 0
@@ -0,0 +1,68 @@
+[bits 16]
+
+; FXAM reports the class of ST(0) in C3/C2/C0 and its sign in C1.
+; FPREM truncates the quotient and FPREM1 rounds it to nearest; both report
+; its low three bits in C0/C3/C1.
+
+fninit
+
+; Empty: C3 C0.
+fxam
+fnstsw ax
+mov bx, ax
+
+; Zero: C3.
+fldz
+fxam
+fnstsw ax
+mov cx, ax
+
+; Negative normal: C2, with C1 for the sign.
+fld1
+fchs
+fxam
+fnstsw ax
+mov dx, ax
+
+; Infinity: C2 C0.
+fld1
+fldz
+fdivp st1, st0
+fxam
+fnstsw ax
+mov si, ax
+
+; NaN: C0. 0 / 0 gives the negative default NaN.
+fldz
+fldz
+fdivp st1, st0
+fxam
+fnstsw ax
+mov di, ax
+
+; 11 FPREM 3 = 2, quotient 3 (C3 C1).
+fninit
+fld dword [three]
+fld dword [eleven]
+fprem
+fnstsw ax
+mov bp, ax
+fistp word [result]
+mov bx, [result]
+
+; 11 FPREM1 3 = -1, quotient 4 (C0).
+fld dword [eleven]
+fprem1
+fnstsw ax
+mov cx, ax
+fistp word [result]
+mov dx, [result]
+
+db 0xf1
+
+three:
+dd 0x40400000
+eleven:
+dd 0x41300000
+result:
+dw 0
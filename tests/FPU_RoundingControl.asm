@@ -0,0 +1,55 @@
+[bits 16]
+
+; FIST rounds according to CR.RC. 2.5 and -2.5 sit exactly between two integers,
+; so each rounding mode gives a different pair of results.
+
+fninit
+
+fldcw word [cw_nearest]
+fld dword [plus_two_and_a_half]
+fistp word [result]
+mov ax, [result]
+fld dword [minus_two_and_a_half]
+fistp word [result]
+mov bx, [result]
+
+fldcw word [cw_down]
+fld dword [plus_two_and_a_half]
+fistp word [result]
+mov cx, [result]
+fld dword [minus_two_and_a_half]
+fistp word [result]
+mov dx, [result]
+
+fldcw word [cw_up]
+fld dword [plus_two_and_a_half]
+fistp word [result]
+mov si, [result]
+fld dword [minus_two_and_a_half]
+fistp word [result]
+mov di, [result]
+
+fldcw word [cw_zero]
+fld dword [minus_two_and_a_half]
+fistp word [result]
+mov bp, [result]
+
+; Inexact results set PE in the status word, and RC doesn't change the top of stack.
+fnstsw ax
+
+db 0xf1
+
+cw_nearest:
+dw 0x037f
+cw_down:
+dw 0x077f
+cw_up:
+dw 0x0b7f
+cw_zero:
+dw 0x0f7f
+plus_two_and_a_half:
+dd 0x40200000
+minus_two_and_a_half:
+dd 0xc0200000
+result:
+dw 0
@@ -0,0 +1,65 @@
+[bits 16]
+
+; Pushing onto a full stack or reading an empty register is an invalid-operation stack
+; fault: IE and SF, with C1 set for overflow and clear for underflow. Masked, the
+; destination gets the default NaN. Unmasked, the stack is left alone.
+
+cli
+fninit
+
+; Masked overflow: the ninth push replaces ST(0) with the default NaN, which FISTP stores as 8000h.
+fld1
+fld1
+fld1
+fld1
+fld1
+fld1
+fld1
+fld1
+fld1
+fnstsw ax
+mov bx, ax
+fistp word [result]
+mov cx, [result]
+
+; Masked underflow: ST(0) + ST(1) with both empty.
+fninit
+fadd st0, st1
+fnstsw ax
+mov dx, ax
+
+; Unmasked overflow: TOP and ST(0) stay as they were.
+fninit
+fldcw word [cw_unmask_invalid]
+fld1
+fld1
+fld1
+fld1
+fld1
+fld1
+fld1
+fldz
+fld1
+fnstsw ax
+mov si, ax
+fnclex
+fistp word [result]
+mov di, [result]
+
+; Unmasked underflow: ST(0) keeps its value.
+fninit
+fldcw word [cw_unmask_invalid]
+fld1
+fadd st0, st2
+fnstsw ax
+mov bp, ax
+fnclex
+fistp word [result]
+mov ax, [result]
+
+db 0xf1
+
+cw_unmask_invalid:
+dw 0x037e
+result:
+dw 0
@@ -0,0 +1,136 @@
+[bits 16]
+
+; With CR4.VME set, CLI/STI in VM86 mode at IOPL < 3 only touch VIF, and INT n
+; goes through the real mode IVT when its bit in the TSS redirection bitmap is clear.
+; The TSS lives on a supervisor-only page, so the bitmap must be read as CPL 0.
+
+BASE equ 0x10000
+
+cli
+lgdt [gdtr]
+mov eax, BASE + page_directory
+mov cr3, eax
+mov eax, cr4
+or eax, 1
+mov cr4, eax
+mov eax, 0x80000001
+mov cr0, eax
+jmp dword 0x08:BASE + pm_entry
+
+[bits 32]
+
+pm_entry:
+mov eax, 0x10
+mov ds, eax
+mov es, eax
+mov ss, eax
+mov esp, BASE + ring0_stack_top
+mov eax, 0x18
+ltr ax
+
+; POPFD leaves VIF alone, even at CPL 0.
+pushfd
+or dword [esp], 0x80000
+popfd
+pushfd
+pop eax
+
+; A CPL 0 IRETD loads it.
+pushfd
+or dword [esp], 0x80000
+push dword 0x08
+push dword BASE + after_iretd
+iretd
+after_iretd:
+pushfd
+pop ebp
+
+mov word [0x42 * 4], vm86_int42
+mov word [0x42 * 4 + 2], 0x1000
+
+; IRETD into VM86 mode at 1000:vm86_entry with IOPL 0, IF 0 and VIF 0.
+push dword 0
+push dword 0
+push dword 0x1000
+push dword 0x1000
+push dword 0x1000
+push dword vm86_stack_top
+push dword 0x00020002
+push dword 0x1000
+push dword vm86_entry
+iretd
+
+[bits 16]
+
+vm86_entry:
+pushf
+pop ax
+sti
+pushf
+pop bx
+cli
+pushf
+pop cx
+sti
+int 0x42
+pushf
+pop si
+
+db 0xf1
+
+vm86_int42:
+pushf
+pop di
+mov dx, 0x4242
+iret
+
+gdt:
+dq 0
+dq 0x00cf9a000000ffff
+dq 0x00cf92000000ffff
+dw tss_end - tss - 1
+dw (BASE + tss - $$) & 0xffff
+db (BASE + tss - $$) >> 16
+db 0x89
+db 0
+db 0
+gdt_end:
+
+gdtr:
+dw gdt_end - gdt - 1
+dd BASE + gdt
+
+times 0x1000 - ($ - $$) db 0
+
+page_directory:
+dd BASE + page_table + 7
+times 1023 dd 0
+
+page_table:
+dd 0x00000007
+times 0x0f dd 0
+dd BASE + 0x0000 + 7
+dd 0
+dd 0
+dd BASE + 0x3000 + 3
+dd BASE + 0x4000 + 7
+times 1024 - 0x15 dd 0
+
+tss:
+dd 0
+dd BASE + ring0_stack_top
+dd 0x10
+times 22 dd 0
+dw 0
+dw tss_io_map - tss
+tss_redirection_map:
+times 32 db 0
+tss_io_map:
+db 0xff
+tss_end:
+
+times 0x4000 - ($ - $$) db 0
+ring0_stack_top:
+
+times 0x5000 - ($ - $$) db 0
+vm86_stack_top:
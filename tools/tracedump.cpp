@@ -0,0 +1,305 @@
+// Computron x86 PC Emulator
+// Copyright (C) 2003-2020 Andreas Kling <kling@serenityos.org>
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY ANDREAS KLING ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL ANDREAS KLING OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "CPU.h"
+#include "Common.h"
+#include "Instruction.h"
+#include "TraceFormat.h"
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QFile>
+#include <QStringList>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ct-tracedump: decodes and filters binary traces written by "computron --trace-file".
+
+RuntimeOptions g_default_options;
+
+// No CPU runs in this tool; debug.cpp only reads this to decorate log lines.
+thread_local CPU* g_cpu = nullptr;
+
+void hard_exit(int exit_code)
+{
+    exit(exit_code);
+}
+
+struct Filter {
+    bool has_cs { false };
+    u16 cs { 0 };
+    u32 eip_start { 0 };
+    u32 eip_end { 0xffffffff };
+    u64 cycle_start { 0 };
+    u64 cycle_end { ~(u64)0 };
+    QString mnemonic;
+    u64 limit { 0 };
+};
+
+static const char* gpr_names[8] = { "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi" };
+static const char* segment_names[6] = { "es", "cs", "ss", "ds", "fs", "gs" };
+
+static void usage()
+{
+    fprintf(stderr, "usage: ct-tracedump [options] <trace file>\n");
+    fprintf(stderr, "    --cs <selector>         only show instructions in this code segment\n");
+    fprintf(stderr, "    --eip <start>[-<end>]   only show instructions in this EIP range\n");
+    fprintf(stderr, "    --cycles <start>[-<end>] only show instructions in this cycle range\n");
+    fprintf(stderr, "    --mnemonic <name>       only show instructions with this mnemonic\n");
+    fprintf(stderr, "    --limit <count>         stop after this many instructions\n");
+    exit(1);
+}
+
+static bool parse_range(const QString& string, u64& start, u64& end)
+{
+    auto parts = string.split(QLatin1Char('-'));
+    if (parts.size() > 2)
+        return false;
+    bool ok;
+    start = parts[0].toULongLong(&ok, 0);
+    if (!ok)
+        return false;
+    if (parts.size() == 1) {
+        end = start;
+        return true;
+    }
+    end = parts[1].toULongLong(&ok, 0);
+    return ok;
+}
+
+class TraceReader {
+public:
+    explicit TraceReader(QFile& file)
+        : m_file(file)
+    {
+    }
+
+    bool read_header();
+    const TraceRecord* next();
+
+private:
+    bool read_chunk();
+
+    QFile& m_file;
+    QByteArray m_chunk;
+    int m_offset { 0 };
+};
+
+bool TraceReader::read_header()
+{
+    TraceFileHeader header;
+    if (m_file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header))
+        return false;
+    if (memcmp(header.magic, trace_file_magic, sizeof(header.magic))) {
+        fprintf(stderr, "ct-tracedump: Not a trace file\n");
+        return false;
+    }
+    if (header.version != trace_file_version || header.record_size != sizeof(TraceRecord)) {
+        fprintf(stderr, "ct-tracedump: Unsupported trace version %u (record size %u)\n", header.version, header.record_size);
+        return false;
+    }
+    return true;
+}
+
+bool TraceReader::read_chunk()
+{
+    u32 size;
+    if (m_file.read(reinterpret_cast<char*>(&size), sizeof(size)) != sizeof(size))
+        return false;
+    QByteArray compressed(size, 0);
+    if (m_file.read(compressed.data(), size) != size) {
+        fprintf(stderr, "ct-tracedump: Truncated chunk\n");
+        return false;
+    }
+    m_chunk = qUncompress(compressed);
+    m_offset = 0;
+    if (m_chunk.size() % sizeof(TraceRecord)) {
+        fprintf(stderr, "ct-tracedump: Corrupt chunk\n");
+        return false;
+    }
+    return true;
+}
+
+const TraceRecord* TraceReader::next()
+{
+    while (m_offset >= m_chunk.size()) {
+        if (!read_chunk())
+            return nullptr;
+    }
+    auto* record = reinterpret_cast<const TraceRecord*>(m_chunk.constData() + m_offset);
+    m_offset += sizeof(TraceRecord);
+    return record;
+}
+
+static QString disassemble(const TraceRecord& record, QString* mnemonic)
+{
+    // Pad so a truncated capture can't make the decoder read past the buffer.
+    u8 bytes[TraceRecord::max_instruction_length + 16];
+    memset(bytes, 0, sizeof(bytes));
+    memcpy(bytes, record.instruction, record.instruction_length);
+    SimpleInstructionStream stream(bytes);
+    bool x32 = record.flags & TraceRecord::X32;
+    bool a32 = record.flags & TraceRecord::A32;
+    auto insn = Instruction::from_stream(stream, x32, a32);
+    if (mnemonic)
+        *mnemonic = insn.mnemonic();
+    return insn.to_string(record.eip, x32);
+}
+
+static void print_record(const TraceRecord& record, const TraceRecord* next)
+{
+    QString bytes;
+    for (unsigned i = 0; i < record.instruction_length; ++i)
+        bytes += QString("%1").arg(record.instruction[i], 2, 16, QLatin1Char('0'));
+
+    printf("%10llu  %04x:%08x  %-20s  %s\n",
+        (unsigned long long)record.cycle,
+        record.segment[1],
+        record.eip,
+        qPrintable(bytes),
+        qPrintable(disassemble(record, nullptr)));
+
+    if (next) {
+        QStringList changes;
+        for (unsigned i = 0; i < 8; ++i) {
+            if (record.gpr[i] != next->gpr[i])
+                changes << QString("%1=%2").arg(gpr_names[i]).arg(next->gpr[i], 8, 16, QLatin1Char('0'));
+        }
+        for (unsigned i = 0; i < 6; ++i) {
+            if (record.segment[i] != next->segment[i])
+                changes << QString("%1=%2").arg(segment_names[i]).arg(next->segment[i], 4, 16, QLatin1Char('0'));
+        }
+        if (record.eflags != next->eflags)
+            changes << QString("eflags=%1").arg(next->eflags, 8, 16, QLatin1Char('0'));
+        if (!changes.isEmpty())
+            printf("%44s%s\n", "", qPrintable(changes.join(" ")));
+    }
+
+    for (unsigned i = 0; i < record.memory_access_count; ++i) {
+        auto& access = record.memory_accesses[i];
+        printf("%44s%s%u [%08x] %s %0*x\n", "",
+            access.is_write ? "write" : "read",
+            access.size * 8u,
+            access.address,
+            access.is_write ? "<-" : "->",
+            access.size * 2, access.value);
+    }
+    if (record.flags & TraceRecord::MemoryAccessesTruncated)
+        printf("%44s(more memory accesses not recorded)\n", "");
+}
+
+static bool matches(const Filter& filter, const TraceRecord& record)
+{
+    if (filter.has_cs && record.segment[1] != filter.cs)
+        return false;
+    if (record.eip < filter.eip_start || record.eip > filter.eip_end)
+        return false;
+    if (record.cycle < filter.cycle_start || record.cycle > filter.cycle_end)
+        return false;
+    if (!filter.mnemonic.isEmpty()) {
+        QString mnemonic;
+        disassemble(record, &mnemonic);
+        if (mnemonic.toLower() != filter.mnemonic.toLower())
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+    g_default_options.novlog = true;
+
+    Filter filter;
+    QString path;
+
+    QStringList arguments = app.arguments();
+    for (int i = 1; i < arguments.size(); ++i) {
+        auto& argument = arguments[i];
+        bool is_last = i + 1 == arguments.size();
+        if (argument == "--cs" && !is_last) {
+            bool ok;
+            filter.cs = arguments[++i].toUInt(&ok, 0);
+            if (!ok)
+                usage();
+            filter.has_cs = true;
+        } else if (argument == "--eip" && !is_last) {
+            u64 start, end;
+            if (!parse_range(arguments[++i], start, end))
+                usage();
+            filter.eip_start = start;
+            filter.eip_end = end;
+        } else if (argument == "--cycles" && !is_last) {
+            if (!parse_range(arguments[++i], filter.cycle_start, filter.cycle_end))
+                usage();
+        } else if (argument == "--mnemonic" && !is_last) {
+            filter.mnemonic = arguments[++i];
+        } else if (argument == "--limit" && !is_last) {
+            bool ok;
+            filter.limit = arguments[++i].toULongLong(&ok, 0);
+            if (!ok)
+                usage();
+        } else if (argument.startsWith("-") || !path.isEmpty()) {
+            usage();
+        } else {
+            path = argument;
+        }
+    }
+
+    if (path.isEmpty())
+        usage();
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "ct-tracedump: Can't open %s\n", qPrintable(path));
+        return 1;
+    }
+
+    build_opcode_tables_if_needed();
+
+    TraceReader reader(file);
+    if (!reader.read_header())
+        return 1;
+
+    // Keep a copy of the current record, since the next one may come from a fresh chunk.
+    TraceRecord current;
+    const TraceRecord* record = reader.next();
+    if (!record)
+        return 0;
+    current = *record;
+
+    u64 shown = 0;
+    for (;;) {
+        const TraceRecord* next = reader.next();
+        if (matches(filter, current)) {
+            print_record(current, next);
+            if (filter.limit && ++shown >= filter.limit)
+                break;
+        }
+        if (!next)
+            break;
+        current = *next;
+    }
+    return 0;
+}
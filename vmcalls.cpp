@@ -26,6 +26,7 @@
 #include "Common.h"
 #include "DiskDrive.h"
 #include "debug.h"
+#include "keyboard.h"
 #include "machine.h"
 #include <stdio.h>
 #include <sys/time.h>
@@ -102,9 +103,6 @@ static DiskDrive* disk_drive_for_bios_index(Machine& machine, u8 index)
 
 void vm_handle_e6(CPU& cpu)
 {
-    extern u16 kbd_hit();
-    extern u16 kbd_getc();
-
     struct tm* t;
     time_t curtime;
     struct timeval timv;
@@ -113,8 +111,8 @@ void vm_handle_e6(CPU& cpu)
 
     switch (cpu.get_ax()) {
     case 0x1601:
-        if (kbd_hit()) {
-            cpu.set_ax(kbd_hit());
+        if (u16 key = cpu.machine().keyboard().peek_key()) {
+            cpu.set_ax(key);
             cpu.set_zf(0);
         } else {
             cpu.set_ax(0);
@@ -217,7 +215,7 @@ void vm_handle_e6(CPU& cpu)
         break;
 
     case 0x1600:
-        cpu.set_ax(kbd_getc());
+        cpu.set_ax(cpu.machine().keyboard().next_key());
         break;
 
     case 0x1700:
@@ -268,46 +266,50 @@ void vm_handle_e6(CPU& cpu)
     }
 }
 
-static void bios_disk_read(CPU& cpu, FILE* fp, DiskDrive& drive, u16 cylinder, u16 head, u16 sector, u16 count, u16 segment, u16 offset)
+static bool bios_disk_read(CPU& cpu, DiskDrive& drive, u16 cylinder, u16 head, u16 sector, u16 count, u16 segment, u16 offset)
 {
     auto lba = drive.to_lba(cylinder, head, sector);
 
-    if (options.disklog)
+    if (cpu.options().disklog)
         vlog(LogDisk, "%s reading %u sectors at %u/%u/%u (LBA %u) to %04x:%04x", qPrintable(drive.name()), count, cylinder, head, sector, lba, segment, offset);
 
     QByteArray data(drive.bytes_per_sector() * count, Qt::Uninitialized);
-    fread(data.data(), drive.bytes_per_sector(), count, fp);
+    if (!drive.read_sectors(lba, count, reinterpret_cast<u8*>(data.data())))
+        return false;
     LinearAddress dest((segment << 4) + offset);
     for (int i = 0; i < data.size(); ++i)
         cpu.write_memory<u8>(dest.offset(i), data[i]);
+    return true;
 }
 
-static void bios_disk_write(CPU& cpu, FILE* fp, DiskDrive& drive, u16 cylinder, u16 head, u16 sector, u16 count, u16 segment, u16 offset)
+static bool bios_disk_write(CPU& cpu, DiskDrive& drive, u16 cylinder, u16 head, u16 sector, u16 count, u16 segment, u16 offset)
 {
     auto lba = drive.to_lba(cylinder, head, sector);
 
-    if (options.disklog)
+    if (cpu.options().disklog)
         vlog(LogDisk, "%s writing %u sectors at %u/%u/%u (LBA %u) from %04x:%04x", qPrintable(drive.name()), count, cylinder, head, sector, lba, segment, offset);
 
-    const void* source = cpu.memory_pointer(LogicalAddress(segment, offset));
-    fwrite(source, drive.bytes_per_sector(), count, fp);
+    const u8* source = cpu.memory_pointer(LogicalAddress(segment, offset));
+    return drive.write_sectors(lba, count, source);
 }
 
-static void bios_disk_verify(CPU&, FILE* fp, DiskDrive& drive, u16 cylinder, u16 head, u16 sector, u16 count, u16 segment, u16 offset)
+static bool bios_disk_verify(CPU& cpu, DiskDrive& drive, u16 cylinder, u16 head, u16 sector, u16 count, u16 segment, u16 offset)
 {
     auto lba = drive.to_lba(cylinder, head, sector);
 
-    if (options.disklog)
+    if (cpu.options().disklog)
         vlog(LogDisk, "%s verifying %u sectors at %u/%u/%u (LBA %u)", qPrintable(drive.name()), count, cylinder, head, sector, lba);
 
-    u8 dummy[count * drive.bytes_per_sector()];
-    u16 veri = fread(dummy, drive.bytes_per_sector(), count, fp);
-    if (veri != count)
-        vlog(LogAlert, "veri != count, something went wrong");
+    QByteArray dummy(drive.bytes_per_sector() * count, Qt::Uninitialized);
+    if (!drive.read_sectors(lba, count, reinterpret_cast<u8*>(dummy.data()))) {
+        vlog(LogAlert, "Verify read failed, something went wrong");
+        return false;
+    }
 
     // FIXME: Actually compare something..
     Q_UNUSED(segment);
     Q_UNUSED(offset);
+    return true;
 }
 
 void bios_disk_call(CPU& cpu, DiskCallFunction function)
@@ -320,14 +322,14 @@ void bios_disk_call(CPU& cpu, DiskCallFunction function)
     u8 driveIndex = cpu.get_dl();
     u8 head = cpu.get_dh();
     u16 sector_count = cpu.get_al();
-    FILE* fp;
     u32 lba;
+    bool success = false;
 
     auto* drive = disk_drive_for_bios_index(cpu.machine(), driveIndex);
     u8 error = FD_NO_ERROR;
 
     if (!drive || !drive->present()) {
-        if (options.disklog)
+        if (cpu.options().disklog)
             vlog(LogDisk, "Drive %02X not ready", driveIndex);
         if (!(driveIndex & 0x80))
             error = FD_CHANGED_OR_REMOVED;
@@ -338,41 +340,32 @@ void bios_disk_call(CPU& cpu, DiskCallFunction function)
 
     lba = drive->to_lba(cylinder, head, sector);
     if (lba > drive->sectors()) {
-        if (options.disklog)
+        if (cpu.options().disklog)
             vlog(LogDisk, "%s bogus sector request (LBA %u from CHS %u/%u/%u)", qPrintable(drive->name()), lba, cylinder, head, sector);
         error = FD_TIMEOUT;
         goto epilogue;
     }
 
     if ((sector > drive->sectors_per_track()) || (head >= drive->heads())) {
-        if (options.disklog)
+        if (cpu.options().disklog)
             vlog(LogDisk, "%s request out of geometrical bounds (%u/%u/%u)", qPrintable(drive->name()), cylinder, head, sector);
         error = FD_TIMEOUT;
         goto epilogue;
     }
 
-    fp = fopen(qPrintable(drive->image_path()), function == WriteSectors ? "rb+" : "rb");
-    if (!fp) {
-        vlog(LogDisk, "PANIC: Could not access drive %d image (%s)!", driveIndex, qPrintable(drive->image_path()));
-        hard_exit(1);
-    }
-
-    fseek(fp, lba * drive->bytes_per_sector(), SEEK_SET);
-
     switch (function) {
     case ReadSectors:
-        bios_disk_read(cpu, fp, *drive, cylinder, head, sector, sector_count, cpu.get_es(), cpu.get_bx());
+        success = bios_disk_read(cpu, *drive, cylinder, head, sector, sector_count, cpu.get_es(), cpu.get_bx());
         break;
     case WriteSectors:
-        bios_disk_write(cpu, fp, *drive, cylinder, head, sector, sector_count, cpu.get_es(), cpu.get_bx());
+        success = bios_disk_write(cpu, *drive, cylinder, head, sector, sector_count, cpu.get_es(), cpu.get_bx());
         break;
     case VerifySectors:
-        bios_disk_verify(cpu, fp, *drive, cylinder, head, sector, sector_count, cpu.get_es(), cpu.get_bx());
+        success = bios_disk_verify(cpu, *drive, cylinder, head, sector, sector_count, cpu.get_es(), cpu.get_bx());
         break;
     }
 
-    error = FD_NO_ERROR;
-    fclose(fp);
+    error = success ? FD_NO_ERROR : FD_TIMEOUT;
 
 epilogue:
     if (error == FD_NO_ERROR) {
@@ -24,21 +24,28 @@
 
 #include "CPU.h"
 #include "Common.h"
+#include "OpcodeProfiler.h"
+#include "SamplingProfiler.h"
+#include "Scheduler.h"
 #include "Tasking.h"
+#include "TraceWriter.h"
+#include "busmouse.h"
 #include "debug.h"
 #include "debugger.h"
+#include "keyboard.h"
 #include "machine.h"
 #include "pic.h"
 #include "pit.h"
 #include "settings.h"
+#include <QElapsedTimer>
+#include <algorithm>
+#include <string.h>
 #include <unistd.h>
 
 //#define DEBUG_PAGING
 #define CRASH_ON_OPCODE_00_00
 //#define CRASH_ON_EXECUTE_00000000
 #define CRASH_ON_PE_JMP_00000000
-#define CRASH_ON_VME
-#define CRASH_ON_PVI
 #define A20_ENABLED
 #define DEBUG_PHYSICAL_OOB
 //#define DEBUG_ON_UD0
@@ -73,7 +80,7 @@ static bool should_log_memory_read(PhysicalAddress address)
 }
 #endif
 
-CPU* g_cpu = 0;
+thread_local CPU* g_cpu = nullptr;
 
 u32 CPU::read_register_for_address_size(int register_index)
 {
@@ -115,10 +122,10 @@ template void CPU::write_register<u8>(int, u8);
 template void CPU::write_register<u16>(int, u16);
 template void CPU::write_register<u32>(int, u32);
 
-FLATTEN void CPU::decodeNext()
+FLATTEN void CPU::decodeNext(InstructionStream& stream)
 {
 #ifdef CT_TRACE
-    if (UNLIKELY(m_is_for_autotest))
+    if (UNLIKELY(m_should_dump_trace_for_autotest))
         dump_trace();
 #endif
 
@@ -130,17 +137,7 @@ FLATTEN void CPU::decodeNext()
     }
 #endif
 
-#ifdef CRASH_ON_VME
-    if (UNLIKELY(get_vme()))
-        ASSERT_NOT_REACHED();
-#endif
-
-#ifdef CRASH_ON_PVI
-    if (UNLIKELY(get_pvi()))
-        ASSERT_NOT_REACHED();
-#endif
-
-    auto insn = Instruction::from_stream(*this, m_operand_size32, m_address_size32);
+    auto insn = Instruction::from_stream(stream, m_operand_size32, m_address_size32);
     if (!insn.is_valid())
         throw InvalidOpcode();
     execute(insn);
@@ -156,14 +153,51 @@ FLATTEN void CPU::execute(Instruction& insn)
 #endif
 
 #ifdef DISASSEMBLE_EVERYTHING
-    if (options.disassemble_everything)
+    if (options().disassemble_everything)
         vlog(LogCPU, "%s", qPrintable(insn.to_string(m_base_eip, x32())));
 #endif
-    insn.execute(*this);
+    if (UNLIKELY(m_opcode_profiling_enabled))
+        execute_with_profiling(insn);
+    else
+        insn.execute(*this);
 
     ++m_cycle;
 }
 
+NEVER_INLINE void CPU::execute_with_profiling(Instruction& insn)
+{
+    auto& entry = m_opcode_profiler->entry(insn.opcode_index());
+    ++entry.count;
+    if (!m_opcode_profiler->measures_host_cycles()) {
+        insn.execute(*this);
+        return;
+    }
+    // Instructions that fault don't get their host cycles counted.
+    u64 start = OpcodeProfiler::read_host_cycle_counter();
+    insn.execute(*this);
+    entry.host_cycles += OpcodeProfiler::read_host_cycle_counter() - start;
+}
+
+void CPU::set_opcode_profiling_enabled(bool enabled)
+{
+    if (enabled && !m_opcode_profiler)
+        m_opcode_profiler = make<OpcodeProfiler>();
+    m_opcode_profiling_enabled = enabled;
+}
+
+void CPU::flush_trace()
+{
+    if (m_trace_writer)
+        m_trace_writer->flush();
+}
+
+SamplingProfiler& CPU::sampling_profiler()
+{
+    if (!m_sampling_profiler)
+        m_sampling_profiler = make<SamplingProfiler>(*this);
+    return *m_sampling_profiler;
+}
+
 void CPU::_RDTSC(Instruction&)
 {
     if (get_tsd() && get_pe() && get_cpl() != 0) {
@@ -185,6 +219,8 @@ void CPU::_INVLPG(Instruction&)
     if (get_pe() && get_cpl() != 0) {
         throw GeneralProtectionFault(0, "INVLPG");
     }
+    // Any of the cached system tables may have moved to a different physical page.
+    invalidate_table_caches();
 }
 
 void CPU::_VKILL(Instruction&)
@@ -214,6 +250,7 @@ void CPU::set_memory_size_and_reallocate_if_needed(u32 size)
 
 CPU::CPU(Machine& m)
     : m_machine(m)
+    , m_options(m.options())
 {
 #ifdef SYMBOLIC_TRACING
     {
@@ -237,10 +274,16 @@ CPU::CPU(Machine& m)
     }
 #endif
     m_is_for_autotest = machine().is_for_autotest();
+    m_should_dump_trace_for_autotest = m_is_for_autotest && !machine().settings().is_for_benchmark();
+
+    if (!options().trace_path.isEmpty()) {
+        m_trace_writer = TraceWriter::create(options().trace_path);
+        if (!m_trace_writer)
+            vlog(LogCPU, "Failed to open trace file %s", qPrintable(options().trace_path));
+    }
 
     build_opcode_tables_if_needed();
 
-    ASSERT(!g_cpu);
     g_cpu = this;
 
     set_memory_size_and_reallocate_if_needed(8192 * 1024);
@@ -294,7 +337,7 @@ void CPU::reset()
     m_next_instruction_is_uninterruptible = false;
 
     memset(&m_gpr, 0, sizeof(m_gpr));
-    m_cr0 = 0;
+    m_cr0 = CR0::ET;
     m_cr2 = 0;
     m_cr3 = 0;
     m_cr4 = 0;
@@ -324,9 +367,12 @@ void CPU::reset()
     this->m_tr.limit = 0xffff;
     this->m_tr.base = LinearAddress();
     this->m_tr.is_32bit = false;
+    invalidate_table_caches();
 
     memset(m_descriptor, 0, sizeof(m_descriptor));
 
+    m_fpu.initialize();
+
     m_segment_prefix = SegmentRegisterIndex::None;
 
     set_cs(0);
@@ -365,6 +411,8 @@ void CPU::reset()
 
 CPU::~CPU()
 {
+    if (g_cpu == this)
+        g_cpu = nullptr;
     delete[] m_memory;
     m_memory = nullptr;
 }
@@ -382,7 +430,12 @@ private:
     CPU& m_cpu;
 };
 
-FLATTEN void CPU::execute_one_instruction()
+void CPU::execute_one_instruction()
+{
+    execute_one_instruction(*this);
+}
+
+FLATTEN void CPU::execute_one_instruction(InstructionStream& stream)
 {
     try {
         InstructionExecutionContext context(*this);
@@ -392,9 +445,9 @@ FLATTEN void CPU::execute_one_instruction()
             vlog(LogCPU, "\033[34;1m%s\033[0m", qPrintable(*it));
         }
 #endif
-        decodeNext();
-    } catch (Exception e) {
-        if (options.log_exceptions)
+        decodeNext(stream);
+    } catch (const Exception& e) {
+        if (options().log_exceptions)
             dump_disassembled(cached_descriptor(SegmentRegisterIndex::CS), m_base_eip, 3);
         raise_exception(e);
     } catch (HardwareInterruptDuringREP) {
@@ -404,19 +457,33 @@ FLATTEN void CPU::execute_one_instruction()
 
 void CPU::halted_loop()
 {
+    // While halted, let virtual time pass at host speed so the guest's clock doesn't run away.
+    QElapsedTimer idle_timer;
+    idle_timer.start();
+    u64 idle_start_cycle = m_cycle;
+
     while (state() == CPU::Halted) {
+        u64 idle_cycle = idle_start_cycle + Scheduler::microseconds_to_cycles(idle_timer.nsecsElapsed() / 1000);
+        if (idle_cycle >= m_next_event_cycle) {
+            m_cycle = std::max(m_cycle, m_next_event_cycle);
+            machine().scheduler().run_due_events();
+        } else {
+            m_cycle = std::max(m_cycle, idle_cycle);
 #ifdef HAVE_USLEEP
-        usleep(100);
+            usleep(100);
 #endif
+        }
         if (m_should_hard_reboot) {
             hard_reboot();
             return;
         }
+        if (m_should_drain_input_queues)
+            drain_input_queues();
         if (debugger().is_active()) {
             save_base_address();
             debugger().do_console();
         }
-        if (PIC::has_pending_irq() && get_if())
+        if (has_pending_irq() && get_if())
             PIC::service_irq(*this);
     }
 }
@@ -433,17 +500,33 @@ void CPU::queue_command(Command command)
     case HardReboot:
         m_should_hard_reboot = true;
         break;
+    case DrainInputQueues:
+        m_should_drain_input_queues = true;
+        break;
     }
-    recompute_main_loop_needs_slow_stuff();
+    // This runs on other threads, so only ever raise the flag. The CPU thread does the full recompute.
+    m_main_loop_needs_slow_stuff = true;
 }
 
 void CPU::hard_reboot()
 {
-    machine().reset_all_io_devices();
+    // Reset the CPU first so that devices restart from the beginning of the virtual timeline.
     reset();
+    machine().reset_all_io_devices();
+    if (m_sampling_profiler)
+        m_sampling_profiler->did_hard_reboot();
     m_should_hard_reboot = false;
 }
 
+void CPU::drain_input_queues()
+{
+    // Clear the request first, so input queued while draining asks again.
+    m_should_drain_input_queues = false;
+    recompute_main_loop_needs_slow_stuff();
+    machine().keyboard().drain_input();
+    machine().busmouse().drain_input();
+}
+
 void CPU::make_next_instruction_uninterruptible()
 {
     m_next_instruction_is_uninterruptible = true;
@@ -451,7 +534,13 @@ void CPU::make_next_instruction_uninterruptible()
 
 void CPU::recompute_main_loop_needs_slow_stuff()
 {
-    m_main_loop_needs_slow_stuff = m_debugger_request != NoDebuggerRequest || m_should_hard_reboot || options.trace || !m_breakpoints.empty() || debugger().is_active() || !m_watches.isEmpty();
+    bool needs_slow_stuff = m_debugger_request != NoDebuggerRequest || m_should_hard_reboot || m_should_drain_input_queues || options().trace || debugger().is_active();
+    m_main_loop_needs_slow_stuff = needs_slow_stuff;
+
+    // queue_command() sets its request before raising the flag, so a request that raced
+    // with the store above is visible here and must not be lost.
+    if (!needs_slow_stuff && (m_debugger_request != NoDebuggerRequest || m_should_hard_reboot || m_should_drain_input_queues))
+        m_main_loop_needs_slow_stuff = true;
 }
 
 NEVER_INLINE bool CPU::main_loop_slow_stuff()
@@ -461,14 +550,8 @@ NEVER_INLINE bool CPU::main_loop_slow_stuff()
         return true;
     }
 
-    if (!m_breakpoints.empty()) {
-        for (auto& breakpoint : m_breakpoints) {
-            if (get_cs() == breakpoint.selector() && get_eip() == breakpoint.offset()) {
-                debugger().enter();
-                break;
-            }
-        }
-    }
+    if (m_should_drain_input_queues)
+        drain_input_queues();
 
     if (m_debugger_request == PleaseEnterDebugger) {
         debugger().enter();
@@ -485,24 +568,198 @@ NEVER_INLINE bool CPU::main_loop_slow_stuff()
         debugger().do_console();
     }
 
-    if (options.trace)
-        dump_trace();
-
-    if (!m_watches.isEmpty())
-        dump_watches();
+    if (options().trace) {
+        if (m_trace_writer)
+            m_trace_writer->begin_instruction(*this);
+        else
+            dump_trace();
+    }
 
     return true;
 }
 
-FLATTEN void CPU::main_loop()
+void CPU::flag_page(QVector<u64>& bitmap, u32 address)
 {
-    forever
+    if (bitmap.isEmpty())
+        bitmap.fill(0, (0x100000000ULL >> 12) / 64);
+    u32 page = address >> 12;
+    bitmap[page / 64] |= 1ULL << (page % 64);
+}
+
+void CPU::add_breakpoint(LogicalAddress address)
+{
+    m_breakpoints.insert(address);
+    flag_page(m_breakpoint_page_bitmap, address.offset());
+}
+
+void CPU::remove_breakpoint(LogicalAddress address)
+{
+    m_breakpoints.erase(address);
+    m_breakpoint_page_bitmap.clear();
+    for (auto& breakpoint : m_breakpoints)
+        flag_page(m_breakpoint_page_bitmap, breakpoint.offset());
+}
+
+NEVER_INLINE void CPU::check_breakpoints()
+{
+    if (m_breakpoints.count(LogicalAddress(get_cs(), get_eip())))
+        debugger().enter();
+}
+
+void CPU::add_watch(const WatchedAddress& watch)
+{
+    m_watches.append(watch);
+    auto& added_watch = m_watches.last();
+    if (added_watch.size == ByteSize)
+        added_watch.last_seen_value = read_physical_memory<u8>(added_watch.address);
+    else if (added_watch.size == WordSize)
+        added_watch.last_seen_value = read_physical_memory<u16>(added_watch.address);
+    else
+        added_watch.last_seen_value = read_physical_memory<u32>(added_watch.address);
+    rebuild_watched_page_bitmap();
+}
+
+bool CPU::remove_watch(PhysicalAddress address)
+{
+    for (int i = 0; i < m_watches.size(); ++i) {
+        if (m_watches[i].address.get() == address.get()) {
+            m_watches.remove(i);
+            rebuild_watched_page_bitmap();
+            return true;
+        }
+    }
+    return false;
+}
+
+void CPU::rebuild_watched_page_bitmap()
+{
+    m_watched_page_bitmap.clear();
+    for (auto& watch : m_watches) {
+        flag_page(m_watched_page_bitmap, watch.address.get());
+        flag_page(m_watched_page_bitmap, watch.address.get() + watch.size / 8 - 1);
+    }
+}
+
+void CPU::watch_table_pages(LinearAddress base, u32 limit)
+{
+    u32 first_page = base.get() & 0xfffff000;
+    u32 last_page = (base.get() + limit) & 0xfffff000;
+    for (u32 page = first_page;; page += 0x1000) {
+        // Pages that aren't mapped can't have been cached from, and mapping them takes an INVLPG or CR3 write.
+        if (auto translated = translate_address_without_faulting(LinearAddress(page))) {
+            auto physical_address = *translated;
+#ifdef A20_ENABLED
+            physical_address.mask(a20_mask());
+#endif
+            if (m_table_page_bitmap.isEmpty() || !is_flagged_page(m_table_page_bitmap, physical_address.get())) {
+                flag_page(m_table_page_bitmap, physical_address.get());
+                m_table_pages.append(physical_address.get() & 0xfffff000);
+            }
+        }
+        if (page == last_page)
+            break;
+    }
+}
+
+void CPU::invalidate_table_caches()
+{
+    invalidate_io_permission_cache();
+    invalidate_idt_cache();
+    invalidate_gdt_cache();
+    invalidate_ldt_cache();
+    for (u32 address : m_table_pages) {
+        u32 page = address >> 12;
+        m_table_page_bitmap[page / 64] &= ~(1ULL << (page % 64));
+    }
+    m_table_pages.clear();
+}
+
+template<CPU::ExecutionMode mode>
+class CPU::ModeInstructionStream final : public InstructionStream {
+public:
+    explicit ModeInstructionStream(CPU& cpu)
+        : m_cpu(cpu)
     {
+    }
+
+    virtual u8 read_instruction8() override { return m_cpu.read_instruction_stream_in_mode<u8, mode>(); }
+    virtual u16 read_instruction16() override { return m_cpu.read_instruction_stream_in_mode<u16, mode>(); }
+    virtual u32 read_instruction32() override { return m_cpu.read_instruction_stream_in_mode<u32, mode>(); }
+
+private:
+    CPU& m_cpu;
+};
+
+static constexpr bool is_paged_mode(CPU::ExecutionMode mode)
+{
+    return mode == CPU::ExecutionMode::VM86Paged || mode == CPU::ExecutionMode::ProtectedPaged || mode == CPU::ExecutionMode::Flat32Paged;
+}
+
+static constexpr bool is_flat_mode(CPU::ExecutionMode mode)
+{
+    return mode == CPU::ExecutionMode::Flat32 || mode == CPU::ExecutionMode::Flat32Paged;
+}
+
+static constexpr bool checks_code_segment_limit(CPU::ExecutionMode mode)
+{
+    return mode == CPU::ExecutionMode::Protected || mode == CPU::ExecutionMode::ProtectedPaged;
+}
+
+static constexpr bool checks_data_segment_limits(CPU::ExecutionMode mode)
+{
+    return mode == CPU::ExecutionMode::Protected || mode == CPU::ExecutionMode::ProtectedPaged || is_flat_mode(mode);
+}
+
+template<typename T, CPU::ExecutionMode mode>
+ALWAYS_INLINE T CPU::read_instruction_stream_in_mode()
+{
+    u32 offset = current_instruction_pointer();
+    auto& cs_descriptor = cached_descriptor(SegmentRegisterIndex::CS);
+
+    if constexpr (checks_code_segment_limit(mode))
+        validate_address<T>(cs_descriptor, offset, MemoryAccessType::Execute);
+
+    LinearAddress linear_address = is_flat_mode(mode) ? LinearAddress(offset) : cs_descriptor.linear_address(offset);
+
+    PhysicalAddress physical_address;
+    if constexpr (is_paged_mode(mode)) {
+        // Fetches straddling a page boundary are rare enough to leave to the generic path.
+        if (UNLIKELY((linear_address.get() & 0xfff) > 0x1000 - sizeof(T))) {
+            T data = read_memory<T>(linear_address, MemoryAccessType::Execute);
+            adjust_instruction_pointer(sizeof(T));
+            return data;
+        }
+        physical_address = translate_address_slow_case(linear_address, MemoryAccessType::Execute, 0xff);
+    } else {
+        physical_address = PhysicalAddress(linear_address.get());
+    }
+#ifdef A20_ENABLED
+    physical_address.mask(a20_mask());
+#endif
+    T data = read_physical_memory<T>(physical_address);
+    adjust_instruction_pointer(sizeof(T));
+    return data;
+}
+
+template<CPU::ExecutionMode mode>
+FLATTEN void CPU::main_loop_in_mode()
+{
+    // Runs until something changes the execution mode, then main_loop() picks the next specialization.
+    ModeInstructionStream<mode> stream(*this);
+
+    while (LIKELY(m_execution_mode == mode)) {
+        // Only instructions on a page with a breakpoint pay for the lookup.
+        if (UNLIKELY(!m_breakpoint_page_bitmap.isEmpty()) && UNLIKELY(is_flagged_page(m_breakpoint_page_bitmap, get_eip())))
+            check_breakpoints();
+
         if (UNLIKELY(m_main_loop_needs_slow_stuff)) {
             main_loop_slow_stuff();
+            // A reboot or the debugger may have put us in a different mode.
+            if (m_execution_mode != mode)
+                return;
         }
 
-        execute_one_instruction();
+        execute_one_instruction(stream);
 
         // FIXME: An obvious optimization here would be to dispatch next insn directly from whoever put us in this state.
         // Easy to implement: just call executeOneInstruction() in e.g "POP SS"
@@ -521,7 +778,10 @@ FLATTEN void CPU::main_loop()
             interrupt(1, InterruptSource::Internal);
         }
 
-        if (PIC::has_pending_irq() && get_if())
+        if (UNLIKELY(m_cycle >= m_next_event_cycle))
+            machine().scheduler().run_due_events();
+
+        if (has_pending_irq() && get_if())
             PIC::service_irq(*this);
 
 #ifdef CT_DETERMINISTIC
@@ -532,6 +792,39 @@ FLATTEN void CPU::main_loop()
     }
 }
 
+FLATTEN void CPU::main_loop()
+{
+    // Logging picks up the CPU running on the current thread.
+    g_cpu = this;
+
+    forever
+    {
+        switch (m_execution_mode) {
+        case ExecutionMode::Real:
+            main_loop_in_mode<ExecutionMode::Real>();
+            break;
+        case ExecutionMode::VM86:
+            main_loop_in_mode<ExecutionMode::VM86>();
+            break;
+        case ExecutionMode::VM86Paged:
+            main_loop_in_mode<ExecutionMode::VM86Paged>();
+            break;
+        case ExecutionMode::Protected:
+            main_loop_in_mode<ExecutionMode::Protected>();
+            break;
+        case ExecutionMode::ProtectedPaged:
+            main_loop_in_mode<ExecutionMode::ProtectedPaged>();
+            break;
+        case ExecutionMode::Flat32:
+            main_loop_in_mode<ExecutionMode::Flat32>();
+            break;
+        case ExecutionMode::Flat32Paged:
+            main_loop_in_mode<ExecutionMode::Flat32Paged>();
+            break;
+        }
+    }
+}
+
 void CPU::jump_relative8(i8 displacement)
 {
     m_eip += displacement;
@@ -646,14 +939,14 @@ void CPU::protected_mode_far_jump(LogicalAddress address, JumpType type, Gate* g
     auto descriptor = get_descriptor(selector);
 
     if (descriptor.is_null()) {
-        throw GeneralProtectionFault(0, QString("%1 to null selector").arg(to_string(type)));
+        throw GeneralProtectionFault(0, "%s to null selector", to_string(type));
     }
 
     if (descriptor.is_outside_table_limits())
-        throw GeneralProtectionFault(selector & 0xfffc, QString("%1 to selector outside table limit").arg(to_string(type)));
+        throw GeneralProtectionFault(selector & 0xfffc, "%s to selector outside table limit", to_string(type));
 
     if (!descriptor.is_code() && !descriptor.is_call_gate() && !descriptor.is_task_gate() && !descriptor.is_tss())
-        throw GeneralProtectionFault(selector & 0xfffc, QString("%1 to invalid descriptor type").arg(to_string(type)));
+        throw GeneralProtectionFault(selector & 0xfffc, "%s to invalid descriptor type", to_string(type));
 
     if (descriptor.is_gate() && gate) {
         dump_descriptor(*gate);
@@ -677,13 +970,13 @@ void CPU::protected_mode_far_jump(LogicalAddress address, JumpType type, Gate* g
         }
 
         if (gate.dpl() < get_cpl())
-            throw GeneralProtectionFault(selector & 0xfffc, QString("%1 to gate with DPL(%2) < CPL(%3)").arg(to_string(type)).arg(gate.dpl()).arg(get_cpl()));
+            throw GeneralProtectionFault(selector & 0xfffc, "%s to gate with DPL(%u) < CPL(%u)", to_string(type), gate.dpl(), get_cpl());
 
         if (selectorRPL > gate.dpl())
-            throw GeneralProtectionFault(selector & 0xfffc, QString("%1 to gate with RPL(%2) > DPL(%3)").arg(to_string(type)).arg(selectorRPL).arg(gate.dpl()));
+            throw GeneralProtectionFault(selector & 0xfffc, "%s to gate with RPL(%u) > DPL(%u)", to_string(type), selectorRPL, gate.dpl());
 
         if (!gate.present()) {
-            throw NotPresent(selector & 0xfffc, QString("Gate not present"));
+            throw NotPresent(selector & 0xfffc, "Gate not present");
         }
 
         // NOTE: We recurse here, jumping to the gate entry point.
@@ -699,9 +992,9 @@ void CPU::protected_mode_far_jump(LogicalAddress address, JumpType type, Gate* g
         vlog(LogCPU, "%s to TSS descriptor (%s) -> %08x", to_string(type), tss_descriptor.type_name(), tss_descriptor.base());
 #endif
         if (tss_descriptor.dpl() < get_cpl())
-            throw GeneralProtectionFault(selector & 0xfffc, QString("%1 to TSS descriptor with DPL < CPL").arg(to_string(type)));
+            throw GeneralProtectionFault(selector & 0xfffc, "%s to TSS descriptor with DPL < CPL", to_string(type));
         if (tss_descriptor.dpl() < selectorRPL)
-            throw GeneralProtectionFault(selector & 0xfffc, QString("%1 to TSS descriptor with DPL < RPL").arg(to_string(type)));
+            throw GeneralProtectionFault(selector & 0xfffc, "%s to TSS descriptor with DPL < RPL", to_string(type));
         if (!tss_descriptor.present())
             throw NotPresent(selector & 0xfffc, "TSS not present");
         task_switch(selector, tss_descriptor, type);
@@ -714,14 +1007,14 @@ void CPU::protected_mode_far_jump(LogicalAddress address, JumpType type, Gate* g
     if ((type == JumpType::CALL || type == JumpType::JMP) && !gate) {
         if (code_segment.conforming()) {
             if (code_segment.dpl() > get_cpl()) {
-                throw GeneralProtectionFault(selector & 0xfffc, QString("%1 -> Code segment DPL(%2) > CPL(%3)").arg(to_string(type)).arg(code_segment.dpl()).arg(get_cpl()));
+                throw GeneralProtectionFault(selector & 0xfffc, "%s -> Code segment DPL(%u) > CPL(%u)", to_string(type), code_segment.dpl(), get_cpl());
             }
         } else {
             if (selectorRPL > code_segment.dpl()) {
-                throw GeneralProtectionFault(selector & 0xfffc, QString("%1 -> Code segment RPL(%2) > CPL(%3)").arg(to_string(type)).arg(selectorRPL).arg(code_segment.dpl()));
+                throw GeneralProtectionFault(selector & 0xfffc, "%s -> Code segment RPL(%u) > CPL(%u)", to_string(type), selectorRPL, code_segment.dpl());
             }
             if (code_segment.dpl() != get_cpl()) {
-                throw GeneralProtectionFault(selector & 0xfffc, QString("%1 -> Code segment DPL(%2) != CPL(%3)").arg(to_string(type)).arg(code_segment.dpl()).arg(get_cpl()));
+                throw GeneralProtectionFault(selector & 0xfffc, "%s -> Code segment DPL(%u) != CPL(%u)", to_string(type), code_segment.dpl(), get_cpl());
             }
         }
     }
@@ -737,7 +1030,7 @@ void CPU::protected_mode_far_jump(LogicalAddress address, JumpType type, Gate* g
     }
 
     if (!code_segment.present()) {
-        throw NotPresent(selector & 0xfffc, QString("Code segment not present"));
+        throw NotPresent(selector & 0xfffc, "Code segment not present");
     }
 
     if (offset > code_segment.effective_limit()) {
@@ -771,7 +1064,7 @@ void CPU::protected_mode_far_jump(LogicalAddress address, JumpType type, Gate* g
             }
 
             if (new_ss_descriptor.dpl() != descriptor.dpl()) {
-                throw InvalidTSS(new_ss & 0xfffc, QString("New ss DPL(%1) != code segment DPL(%2)").arg(new_ss_descriptor.dpl()).arg(descriptor.dpl()));
+                throw InvalidTSS(new_ss & 0xfffc, "New ss DPL(%u) != code segment DPL(%u)", new_ss_descriptor.dpl(), descriptor.dpl());
             }
 
             if (!new_ss_descriptor.is_data() || !new_ss_descriptor.as_data_segment_descriptor().writable()) {
@@ -864,7 +1157,7 @@ void CPU::protected_far_return(u16 stack_adjustment)
     }
 
     if (selector_rpl < get_cpl())
-        throw GeneralProtectionFault(selector & 0xfffc, QString("RETF with RPL(%1) < CPL(%2)").arg(selector_rpl).arg(get_cpl()));
+        throw GeneralProtectionFault(selector & 0xfffc, "RETF with RPL(%u) < CPL(%u)", selector_rpl, get_cpl());
 
     auto& codeSegment = descriptor.as_code_segment_descriptor();
 
@@ -951,7 +1244,7 @@ void CPU::_NOP(Instruction&)
 void CPU::_HLT(Instruction&)
 {
     if (get_cpl() != 0) {
-        throw GeneralProtectionFault(0, QString("HLT with CPL!=0(%1)").arg(get_cpl()));
+        throw GeneralProtectionFault(0, "HLT with CPL!=0(%u)", get_cpl());
     }
 
     set_state(CPU::Halted);
@@ -1172,7 +1465,7 @@ static const char* to_string(CPU::MemoryAccessType type)
 
 PhysicalAddress CPU::translate_address(LinearAddress linear_address, MemoryAccessType access_type, u8 effective_cpl)
 {
-    if (!get_pe() || !get_pg())
+    if (!is_paged_mode(m_execution_mode))
         return PhysicalAddress(linear_address.get());
     return translate_address_slow_case(linear_address, access_type, effective_cpl);
 }
@@ -1188,7 +1481,7 @@ static u16 makePFErrorCode(PageFaultFlags::Flags flags, CPU::MemoryAccessType ac
 Exception CPU::PageFault(LinearAddress linear_address, PageFaultFlags::Flags flags, CPU::MemoryAccessType access_type, bool user_mode, const char* fault_table, u32 pde, u32 pte)
 {
     u16 error = makePFErrorCode(flags, access_type, user_mode);
-    if (options.log_exceptions) {
+    if (options().log_exceptions) {
         vlog(LogCPU, "Exception: #PF(%04x) %s in %s for %s %s @%08x, PDBR=%08x, PDE=%08x, PTE=%08x",
             error,
             (flags & PageFaultFlags::ProtectionViolation) ? "PV" : "NP",
@@ -1201,7 +1494,7 @@ Exception CPU::PageFault(LinearAddress linear_address, PageFaultFlags::Flags fla
             pte);
     }
     m_cr2 = linear_address.get();
-    if (options.crash_on_page_fault) {
+    if (options().crash_on_page_fault) {
         dump_all();
         vlog(LogAlert, "CRASH ON #PF");
         ASSERT_NOT_REACHED();
@@ -1273,12 +1566,30 @@ PhysicalAddress CPU::translate_address_slow_case(LinearAddress linear_address, M
 
     PhysicalAddress physical_address((page_table_entry & 0xfffff000) | offset);
 #ifdef DEBUG_PAGING
-    if (options.log_page_translations)
+    if (options().log_page_translations)
         vlog(LogCPU, "PG=1 Translating %08x {dir=%03x, page=%03x, offset=%03x} => %08x [%08x + %08x] <PTE @ %08x>", linear_address.get(), dir, page, offset, physical_address.get(), page_directory_entry, page_table_entry, pte_address);
 #endif
     return physical_address;
 }
 
+std::optional<PhysicalAddress> CPU::translate_address_without_faulting(LinearAddress linear_address)
+{
+    if (!is_paged_mode(m_execution_mode))
+        return PhysicalAddress(linear_address.get());
+
+    u32 dir = (linear_address.get() >> 22) & 0x3FF;
+    u32 page = (linear_address.get() >> 12) & 0x3FF;
+    u32 offset = linear_address.get() & 0xFFF;
+
+    u32 page_directory_entry = read_physical_memory<u32>(PhysicalAddress(get_cr3() + dir * sizeof(u32)));
+    if (!(page_directory_entry & PageTableEntryFlags::Present))
+        return {};
+    u32 page_table_entry = read_physical_memory<u32>(PhysicalAddress((page_directory_entry & 0xfffff000) + page * sizeof(u32)));
+    if (!(page_table_entry & PageTableEntryFlags::Present))
+        return {};
+    return PhysicalAddress((page_table_entry & 0xfffff000) | offset);
+}
+
 void CPU::snoop(LinearAddress linear_address, MemoryAccessType access_type)
 {
     translate_address(linear_address, access_type);
@@ -1293,9 +1604,24 @@ void CPU::snoop(SegmentRegisterIndex segreg, u32 offset, MemoryAccessType access
     snoop(linear_address, access_type);
 }
 
+static ALWAYS_INLINE u8 access_right_for(CPU::MemoryAccessType access_type)
+{
+    static_assert(SegmentDescriptor::AllowsRead == 1 << (int)CPU::MemoryAccessType::Read);
+    static_assert(SegmentDescriptor::AllowsWrite == 1 << (int)CPU::MemoryAccessType::Write);
+    static_assert(SegmentDescriptor::AllowsExecute == 1 << (int)CPU::MemoryAccessType::Execute);
+    static_assert(SegmentDescriptor::AllowsInternalPointer == 1 << (int)CPU::MemoryAccessType::InternalPointer);
+    return 1 << (int)access_type;
+}
+
 template<typename T>
 ALWAYS_INLINE void CPU::validate_address(const SegmentDescriptor& descriptor, u32 offset, MemoryAccessType access_type)
 {
+    // Fast path: the rights and [low, high] range were worked out when the descriptor was loaded.
+    // Anything that doesn't pass falls through to the checks below, which pick the right exception.
+    u32 last_offset = offset + (sizeof(T) - 1);
+    if (LIKELY(descriptor.allows(access_right_for(access_type)) && offset >= descriptor.valid_offset_low() && last_offset <= descriptor.valid_offset_high()))
+        return;
+
     if (!get_vm()) {
         if (access_type != MemoryAccessType::Execute) {
             if (descriptor.is_null()) {
@@ -1342,11 +1668,11 @@ ALWAYS_INLINE void CPU::validate_address(const SegmentDescriptor& descriptor, u3
 #if 0
     // FIXME: Is this appropriate somehow? Need to figure it out. The code below as-is breaks IRET.
     if (get_cpl() > descriptor.dpl()) {
-        throw GeneralProtectionFault(0, QString("Insufficient privilege for access (CPL=%1, DPL=%2)").arg(get_cpl()).arg(descriptor.dpl()));
+        throw GeneralProtectionFault(0, "Insufficient privilege for access (CPL=%u, DPL=%u)", get_cpl(), descriptor.dpl());
     }
 #endif
 
-    if (UNLIKELY((offset + (sizeof(T) - 1)) > descriptor.effective_limit())) {
+    if (UNLIKELY(descriptor.has_empty_valid_range() || offset < descriptor.valid_offset_low() || last_offset > descriptor.valid_offset_high())) {
         vlog(LogAlert, "%zu-bit %s offset %08X outside limit (selector index: %04X, effective limit: %08X [%08X x %s])",
             sizeof(T) * 8,
             to_string(access_type),
@@ -1378,7 +1704,7 @@ ALWAYS_INLINE bool CPU::validate_physical_address(PhysicalAddress physical_addre
     UNUSED_PARAM(access_type);
     if (physical_address.get() < m_memory_size)
         return true;
-    return false;
+    return UNLIKELY(!m_high_memory_providers.isEmpty()) && high_memory_provider_for_address(physical_address);
 }
 
 template<typename T>
@@ -1419,6 +1745,14 @@ void CPU::write_physical_memory(PhysicalAddress physical_address, T data)
     } else {
         *reinterpret_cast<T*>(&m_memory[physical_address.get()]) = data;
     }
+    if (UNLIKELY(!m_table_pages.isEmpty())) {
+        if (is_flagged_page(m_table_page_bitmap, physical_address.get()) || is_flagged_page(m_table_page_bitmap, physical_address.get() + sizeof(T) - 1))
+            invalidate_table_caches();
+    }
+    if (UNLIKELY(!m_watched_page_bitmap.isEmpty())) {
+        if (is_flagged_page(m_watched_page_bitmap, physical_address.get()) || is_flagged_page(m_watched_page_bitmap, physical_address.get() + sizeof(T) - 1))
+            dump_watches();
+    }
 }
 
 template void CPU::write_physical_memory<u8>(PhysicalAddress, u8);
@@ -1430,7 +1764,7 @@ ALWAYS_INLINE T CPU::read_memory(LinearAddress linear_address, MemoryAccessType
 {
     // FIXME: This needs to be optimized.
     if constexpr (sizeof(T) == 4) {
-        if (get_pg() && (linear_address.get() & 0xfffff000) != (((linear_address.get() + (sizeof(T) - 1)) & 0xfffff000))) {
+        if (is_paged_mode(m_execution_mode) && (linear_address.get() & 0xfffff000) != (((linear_address.get() + (sizeof(T) - 1)) & 0xfffff000))) {
             u8 b1 = read_memory<u8>(linear_address.offset(0), access_type, effective_cpl);
             u8 b2 = read_memory<u8>(linear_address.offset(1), access_type, effective_cpl);
             u8 b3 = read_memory<u8>(linear_address.offset(2), access_type, effective_cpl);
@@ -1438,7 +1772,7 @@ ALWAYS_INLINE T CPU::read_memory(LinearAddress linear_address, MemoryAccessType
             return weld<u32>(weld<u16>(b4, b3), weld<u16>(b2, b1));
         }
     } else if constexpr (sizeof(T) == 2) {
-        if (get_pg() && (linear_address.get() & 0xfffff000) != (((linear_address.get() + (sizeof(T) - 1)) & 0xfffff000))) {
+        if (is_paged_mode(m_execution_mode) && (linear_address.get() & 0xfffff000) != (((linear_address.get() + (sizeof(T) - 1)) & 0xfffff000))) {
             u8 b1 = read_memory<u8>(linear_address.offset(0), access_type, effective_cpl);
             u8 b2 = read_memory<u8>(linear_address.offset(1), access_type, effective_cpl);
             return weld<u16>(b2, b1);
@@ -1450,9 +1784,13 @@ ALWAYS_INLINE T CPU::read_memory(LinearAddress linear_address, MemoryAccessType
     physical_address.mask(a20_mask());
 #endif
     T value = read_physical_memory<T>(physical_address);
+#ifdef CT_TRACE
+    if (UNLIKELY(m_trace_writer) && access_type != MemoryAccessType::Execute)
+        m_trace_writer->did_access_memory(linear_address.get(), value, sizeof(T), false);
+#endif
 #ifdef MEMORY_DEBUGGING
-    if (options.memdebug || should_log_memory_read(physical_address)) {
-        if (options.novlog)
+    if (options().memdebug || should_log_memory_read(physical_address)) {
+        if (options().novlog)
             printf("%04X:%08X: %zu-bit read [A20=%s] 0x%08X, value: %08X\n", get_base_cs(), current_base_instruction_pointer(), sizeof(T) * 8, is_a20_enabled() ? "on" : "off", physical_address.get(), value);
         else
             vlog(LogCPU, "%zu-bit read [A20=%s] 0x%08X, value: %08X", sizeof(T) * 8, is_a20_enabled() ? "on" : "off", physical_address.get(), value);
@@ -1464,8 +1802,11 @@ ALWAYS_INLINE T CPU::read_memory(LinearAddress linear_address, MemoryAccessType
 template<typename T>
 ALWAYS_INLINE T CPU::read_memory(const SegmentDescriptor& descriptor, u32 offset, MemoryAccessType access_type)
 {
+    // Flat segments can't fail any segment checks, and have no base to add.
+    if (LIKELY(descriptor.is_flat() && descriptor.allows(access_right_for(access_type))))
+        return read_memory<T>(LinearAddress(offset), access_type);
     auto linear_address = descriptor.linear_address(offset);
-    if (get_pe() && !get_vm())
+    if (checks_data_segment_limits(m_execution_mode))
         validate_address<T>(descriptor, offset, access_type);
     return read_memory<T>(linear_address, access_type);
 }
@@ -1498,6 +1839,7 @@ template void CPU::write_memory<u32>(SegmentRegisterIndex, u32, u32);
 
 template void CPU::write_memory<u8>(LinearAddress, u8, u8);
 
+template u8 CPU::read_memory_metal<u8>(LinearAddress);
 template u16 CPU::read_memory_metal<u16>(LinearAddress);
 template u32 CPU::read_memory_metal<u32>(LinearAddress);
 
@@ -1527,7 +1869,7 @@ void CPU::write_memory(LinearAddress linear_address, T value, u8 effectiveCPL)
 {
     // FIXME: This needs to be optimized.
     if constexpr (sizeof(T) == 4) {
-        if (get_pg() && (linear_address.get() & 0xfffff000) != (((linear_address.get() + (sizeof(T) - 1)) & 0xfffff000))) {
+        if (is_paged_mode(m_execution_mode) && (linear_address.get() & 0xfffff000) != (((linear_address.get() + (sizeof(T) - 1)) & 0xfffff000))) {
             write_memory<u8>(linear_address.offset(0), value & 0xff, effectiveCPL);
             write_memory<u8>(linear_address.offset(1), (value >> 8) & 0xff, effectiveCPL);
             write_memory<u8>(linear_address.offset(2), (value >> 16) & 0xff, effectiveCPL);
@@ -1535,7 +1877,7 @@ void CPU::write_memory(LinearAddress linear_address, T value, u8 effectiveCPL)
             return;
         }
     } else if constexpr (sizeof(T) == 2) {
-        if (get_pg() && (linear_address.get() & 0xfffff000) != (((linear_address.get() + (sizeof(T) - 1)) & 0xfffff000))) {
+        if (is_paged_mode(m_execution_mode) && (linear_address.get() & 0xfffff000) != (((linear_address.get() + (sizeof(T) - 1)) & 0xfffff000))) {
             write_memory<u8>(linear_address.offset(0), value & 0xff, effectiveCPL);
             write_memory<u8>(linear_address.offset(1), (value >> 8) & 0xff, effectiveCPL);
             return;
@@ -1547,12 +1889,16 @@ void CPU::write_memory(LinearAddress linear_address, T value, u8 effectiveCPL)
     physical_address.mask(a20_mask());
 #endif
 #ifdef MEMORY_DEBUGGING
-    if (options.memdebug || should_log_memory_write(physical_address)) {
-        if (options.novlog)
+    if (options().memdebug || should_log_memory_write(physical_address)) {
+        if (options().novlog)
             printf("%04X:%08X: %zu-bit write [A20=%s] 0x%08X, value: %08X\n", get_base_cs(), current_base_instruction_pointer(), sizeof(T) * 8, is_a20_enabled() ? "on" : "off", physical_address.get(), value);
         else
             vlog(LogCPU, "%zu-bit write [A20=%s] 0x%08X, value: %08X", sizeof(T) * 8, is_a20_enabled() ? "on" : "off", physical_address.get(), value);
     }
+#endif
+#ifdef CT_TRACE
+    if (UNLIKELY(m_trace_writer))
+        m_trace_writer->did_access_memory(linear_address.get(), value, sizeof(T), true);
 #endif
     write_physical_memory(physical_address, value);
 }
@@ -1560,8 +1906,10 @@ void CPU::write_memory(LinearAddress linear_address, T value, u8 effectiveCPL)
 template<typename T>
 void CPU::write_memory(const SegmentDescriptor& descriptor, u32 offset, T value)
 {
+    if (LIKELY(descriptor.is_flat() && descriptor.allows(SegmentDescriptor::AllowsWrite)))
+        return write_memory(LinearAddress(offset), value);
     auto linear_address = descriptor.linear_address(offset);
-    if (get_pe() && !get_vm())
+    if (checks_data_segment_limits(m_execution_mode))
         validate_address<T>(descriptor, offset, MemoryAccessType::Write);
     write_memory(linear_address, value);
 }
@@ -1622,6 +1970,23 @@ void CPU::update_code_segment_cache()
     // FIXME: We need some kind of fast pointer for fetching from CS:EIP.
 }
 
+void CPU::update_execution_mode()
+{
+    bool paged = get_pg();
+    if (!get_pe()) {
+        m_execution_mode = ExecutionMode::Real;
+    } else if (get_vm()) {
+        m_execution_mode = paged ? ExecutionMode::VM86Paged : ExecutionMode::VM86;
+    } else {
+        auto& cs_descriptor = cached_descriptor(SegmentRegisterIndex::CS);
+        bool flat = cs_descriptor.d() && !cs_descriptor.base().get() && cs_descriptor.effective_limit() == 0xffffffff;
+        if (flat)
+            m_execution_mode = paged ? ExecutionMode::Flat32Paged : ExecutionMode::Flat32;
+        else
+            m_execution_mode = paged ? ExecutionMode::ProtectedPaged : ExecutionMode::Protected;
+    }
+}
+
 void CPU::set_cs(u16 value)
 {
     write_segment_register(SegmentRegisterIndex::CS, value);
@@ -1688,6 +2053,95 @@ const u8* CPU::memory_pointer(LinearAddress linear_address)
     return pointer_to_physical_memory(physical_address);
 }
 
+const u8* CPU::memory_pointer_without_faulting(LinearAddress linear_address)
+{
+    auto physical_address = translate_address_without_faulting(linear_address);
+    if (!physical_address)
+        return nullptr;
+#ifdef A20_ENABLED
+    physical_address->mask(a20_mask());
+#endif
+    return pointer_to_physical_memory(*physical_address);
+}
+
+CPU::MetalBlock CPU::translate_metal_block(LinearAddress linear_address, u32 size, MemoryAccessType access_type)
+{
+    ASSERT(size && size <= 4096);
+    MetalBlock block;
+    block.linear_address = linear_address;
+    block.size = size;
+    for (u32 offset = 0; offset < size;) {
+        auto chunk_linear_address = linear_address.offset(offset);
+        u32 chunk_size = std::min(size - offset, 4096 - (chunk_linear_address.get() & 0xfff));
+        auto physical_address = translate_address(chunk_linear_address, access_type, 0);
+#ifdef A20_ENABLED
+        physical_address.mask(a20_mask());
+#endif
+        block.chunk_address[block.chunk_count] = physical_address;
+        block.chunk_size[block.chunk_count] = chunk_size;
+        ++block.chunk_count;
+        offset += chunk_size;
+    }
+    return block;
+}
+
+void CPU::read_metal_block(const MetalBlock& block, u8* buffer)
+{
+    for (unsigned i = 0; i < block.chunk_count; ++i) {
+        auto physical_address = block.chunk_address[i];
+        u32 chunk_size = block.chunk_size[i];
+        if (physical_address.get() + chunk_size <= m_memory_size && !memory_provider_for_address(physical_address)) {
+            memcpy(buffer, &m_memory[physical_address.get()], chunk_size);
+        } else {
+            for (u32 j = 0; j < chunk_size; ++j)
+                buffer[j] = read_physical_memory<u8>(PhysicalAddress(physical_address.get() + j));
+        }
+        buffer += chunk_size;
+    }
+#ifdef CT_TRACE
+    if (UNLIKELY(m_trace_writer)) {
+        for (u32 offset = 0; offset < block.size; offset += 4) {
+            u32 value = 0;
+            u8 size = std::min(block.size - offset, 4u);
+            memcpy(&value, buffer - block.size + offset, size);
+            m_trace_writer->did_access_memory(block.linear_address.get() + offset, value, size, false);
+        }
+    }
+#endif
+}
+
+void CPU::write_metal_block(const MetalBlock& block, const u8* buffer)
+{
+#ifdef CT_TRACE
+    if (UNLIKELY(m_trace_writer)) {
+        for (u32 offset = 0; offset < block.size; offset += 4) {
+            u32 value = 0;
+            u8 size = std::min(block.size - offset, 4u);
+            memcpy(&value, buffer + offset, size);
+            m_trace_writer->did_access_memory(block.linear_address.get() + offset, value, size, true);
+        }
+    }
+#endif
+
+    for (unsigned i = 0; i < block.chunk_count; ++i) {
+        auto physical_address = block.chunk_address[i];
+        u32 chunk_size = block.chunk_size[i];
+        if (physical_address.get() + chunk_size <= m_memory_size && !memory_provider_for_address(physical_address)) {
+            memcpy(&m_memory[physical_address.get()], buffer, chunk_size);
+            if (UNLIKELY(!m_table_pages.isEmpty()) && is_flagged_page(m_table_page_bitmap, physical_address.get()))
+                invalidate_table_caches();
+            if (UNLIKELY(!m_watched_page_bitmap.isEmpty())) {
+                if (is_flagged_page(m_watched_page_bitmap, physical_address.get()))
+                    dump_watches();
+            }
+        } else {
+            for (u32 j = 0; j < chunk_size; ++j)
+                write_physical_memory<u8>(PhysicalAddress(physical_address.get() + j), buffer[j]);
+        }
+        buffer += chunk_size;
+    }
+}
+
 template<typename T>
 ALWAYS_INLINE T CPU::read_instruction_stream()
 {
@@ -1728,7 +2182,7 @@ void CPU::_CPUID(Instruction&)
         u32 type = 0;
         set_eax(stepping | (model << 4) | (family << 8) | (type << 12));
         set_ebx(0);
-        set_edx((1 << 4) | (1 << 15)); // RDTSC + CMOV
+        set_edx((1 << 0) | (1 << 1) | (1 << 4) | (1 << 15)); // FPU + VME + RDTSC + CMOV
         set_ecx(0);
         return;
     }
@@ -1776,6 +2230,16 @@ void CPU::init_watches()
 
 void CPU::register_memory_provider(MemoryProvider& provider)
 {
+    if (provider.base_address().get() >= 1048576) {
+        if (provider.base_address().get() < m_memory_size) {
+            vlog(LogConfig, "Can't register mapper with length %u @ %08x inside RAM", provider.size(), provider.base_address().get());
+            ASSERT_NOT_REACHED();
+        }
+        vlog(LogConfig, "Register memory provider %p above RAM @ %08x", &provider, provider.base_address().get());
+        m_high_memory_providers.append(&provider);
+        return;
+    }
+
     if ((provider.base_address().get() + provider.size()) > 1048576) {
         vlog(LogConfig, "Can't register mapper with length %u @ %08x", provider.size(), provider.base_address().get());
         ASSERT_NOT_REACHED();
@@ -1789,11 +2253,23 @@ void CPU::register_memory_provider(MemoryProvider& provider)
 
 ALWAYS_INLINE MemoryProvider* CPU::memory_provider_for_address(PhysicalAddress address)
 {
-    if (address.get() >= 1048576)
-        return nullptr;
+    if (address.get() >= 1048576) {
+        if (LIKELY(address.get() < m_memory_size))
+            return nullptr;
+        return high_memory_provider_for_address(address);
+    }
     return m_memory_providers[address.get() / memory_provider_block_size];
 }
 
+MemoryProvider* CPU::high_memory_provider_for_address(PhysicalAddress address)
+{
+    for (auto* provider : m_high_memory_providers) {
+        if (address.get() - provider->base_address().get() < provider->size())
+            return provider;
+    }
+    return nullptr;
+}
+
 template<typename T>
 void CPU::doBOUND(Instruction& insn)
 {
@@ -1813,7 +2289,7 @@ void CPU::doBOUND(Instruction& insn)
         within_bounds ? "yes" : "no");
 #endif
     if (!within_bounds)
-        throw BoundRangeExceeded(QString("%1 not within [%2, %3]").arg(array_index).arg(lower_bound).arg(upper_bound));
+        throw BoundRangeExceeded("%d not within [%d, %d]", (int)array_index, (int)lower_bound, (int)upper_bound);
 }
 
 void CPU::_BOUND(Instruction& insn)
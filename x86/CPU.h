@@ -26,15 +26,21 @@
 
 #include "Common.h"
 #include "Descriptor.h"
+#include "FPU.h"
 #include "Instruction.h"
 #include "OwnPtr.h"
 #include "debug.h"
 #include <QtCore/QVector>
+#include <optional>
 #include <set>
 
 class Debugger;
+class OpcodeProfiler;
+class SamplingProfiler;
+class TraceWriter;
 class Machine;
 class MemoryProvider;
+class PIC;
 class CPU;
 class TSS;
 
@@ -91,7 +97,7 @@ struct HardwareInterruptDuringREP {
 
 class Exception {
 public:
-    Exception(u8 num, u16 code, u32 address, const QString& reason)
+    Exception(u8 num, u16 code, u32 address, const char* reason)
         : m_num(num)
         , m_code(code)
         , m_address(address)
@@ -100,7 +106,7 @@ public:
     {
     }
 
-    Exception(u8 num, u16 code, const QString& reason)
+    Exception(u8 num, u16 code, const char* reason)
         : m_num(num)
         , m_code(code)
         , m_has_code(true)
@@ -108,7 +114,7 @@ public:
     {
     }
 
-    Exception(u8 num, const QString& reason)
+    Exception(u8 num, const char* reason)
         : m_num(num)
         , m_has_code(false)
         , m_reason(reason)
@@ -121,14 +127,15 @@ public:
     u16 code() const { return m_code; }
     bool has_code() const { return m_has_code; }
     u32 address() const { return m_address; }
-    QString reason() const { return m_reason; }
+    const char* reason() const { return m_reason; }
 
 private:
     u8 m_num { 0 };
     u16 m_code { 0 };
     u32 m_address { 0 };
     bool m_has_code { false };
-    QString m_reason;
+    // Always a string literal; any details are only formatted into the exception log.
+    const char* m_reason { nullptr };
 };
 
 union PartAddressableRegister {
@@ -229,8 +236,11 @@ public:
     struct CR0 {
         enum Bits : u32 {
             PE = 1u << 0,
+            MP = 1u << 1,
             EM = 1u << 2,
             TS = 1u << 3,
+            ET = 1u << 4,
+            NE = 1u << 5,
             WP = 1u << 16,
             PG = 1u << 31,
         };
@@ -246,16 +256,26 @@ public:
 
     void register_memory_provider(MemoryProvider&);
     MemoryProvider* memory_provider_for_address(PhysicalAddress);
+    MemoryProvider* high_memory_provider_for_address(PhysicalAddress);
 
     void recompute_main_loop_needs_slow_stuff();
 
     u64 cycle() const { return m_cycle; }
 
+    bool has_pending_irq() const { return m_has_pending_irq; }
+    void set_has_pending_irq(Badge<PIC>, bool b) { m_has_pending_irq = b; }
+
+    static const u64 no_pending_event = 0xffffffffffffffffULL;
+    void set_next_event_cycle(u64 cycle) { m_next_event_cycle = cycle; }
+
     void reset();
 
     Machine& machine() const { return m_machine; }
+    RuntimeOptions& options() const { return m_options; }
 
-    std::set<LogicalAddress>& breakpoints() { return m_breakpoints; }
+    const std::set<LogicalAddress>& breakpoints() const { return m_breakpoints; }
+    void add_breakpoint(LogicalAddress);
+    void remove_breakpoint(LogicalAddress);
 
     enum class MemoryAccessType { Read,
         Write,
@@ -346,6 +366,9 @@ public:
     Descriptor get_descriptor(u16 selector);
     SegmentDescriptor get_segment_descriptor(u16 selector);
     Descriptor get_interrupt_descriptor(u8 number);
+    void invalidate_idt_cache();
+    void invalidate_gdt_cache();
+    void invalidate_ldt_cache();
     Descriptor get_descriptor(DescriptorTableRegister&, u16 index, bool index_is_selector);
 
     SegmentRegisterIndex current_segment() const { return m_segment_prefix == SegmentRegisterIndex::None ? SegmentRegisterIndex::DS : m_segment_prefix; }
@@ -371,6 +394,8 @@ public:
     u32 base_memory_size() const { return m_base_memory_size; }
     void set_base_memory_size(u32 size) { m_base_memory_size = size; }
 
+    // Size of guest RAM in bytes.
+    size_t memory_size() const { return m_memory_size; }
     void set_memory_size_and_reallocate_if_needed(u32);
 
     void kill();
@@ -386,23 +411,26 @@ public:
     };
 
     void real_mode_interrupt(u8 isr, InterruptSource);
-    void protected_mode_interrupt(u8 isr, InterruptSource, QVariant error_code);
-    void interrupt(u8 isr, InterruptSource, QVariant errorCode = QVariant());
-    void interrupt_to_task_gate(u8 isr, InterruptSource, QVariant errorCode, Gate&);
+    void protected_mode_interrupt(u8 isr, InterruptSource, std::optional<u16> error_code);
+    void interrupt(u8 isr, InterruptSource, std::optional<u16> error_code = {});
+    void interrupt_to_task_gate(u8 isr, InterruptSource, std::optional<u16> error_code, Gate&);
 
-    void interrupt_from_vm86_mode(Gate&, u32 offset, CodeSegmentDescriptor&, InterruptSource, QVariant errorCode);
+    void interrupt_from_vm86_mode(Gate&, u32 offset, CodeSegmentDescriptor&, InterruptSource, std::optional<u16> error_code);
     void iret_to_vm86_mode(TransactionalPopper&, LogicalAddress, u32 flags);
+    bool is_vm86_interrupt_redirected(u8 isr);
+    void redirect_vm86_interrupt(u8 isr);
     void iret_from_vm86_mode();
     void iret_from_real_mode();
 
-    Exception GeneralProtectionFault(u16 selector, const QString& reason);
-    Exception StackFault(u16 selector, const QString& reason);
-    Exception NotPresent(u16 selector, const QString& reason);
-    Exception InvalidTSS(u16 selector, const QString& reason);
+    // The reason is a printf-style format, only expanded when exceptions are being logged.
+    Exception GeneralProtectionFault(u16 selector, const char* reason, ...);
+    Exception StackFault(u16 selector, const char* reason, ...);
+    Exception NotPresent(u16 selector, const char* reason, ...);
+    Exception InvalidTSS(u16 selector, const char* reason, ...);
     Exception PageFault(LinearAddress, PageFaultFlags::Flags, MemoryAccessType, bool inUserMode, const char* faultTable, u32 pde, u32 pte = 0);
-    Exception DivideError(const QString& reason);
-    Exception InvalidOpcode(const QString& reason = QString());
-    Exception BoundRangeExceeded(const QString& reason);
+    Exception DivideError(const char* reason, ...);
+    Exception InvalidOpcode(const char* reason = "Invalid opcode", ...);
+    Exception BoundRangeExceeded(const char* reason, ...);
 
     void raise_exception(const Exception&);
 
@@ -428,9 +456,16 @@ public:
         this->m_zf = value;
     }
     void set_vif(bool value) { this->m_vif = value; }
+    void set_vip(bool value) { this->m_vip = value; }
     void set_nt(bool value) { this->m_nt = value; }
     void set_rf(bool value) { this->m_rf = value; }
-    void set_vm(bool value) { this->m_vm = value; }
+    void set_vm(bool value)
+    {
+        if (this->m_vm == value)
+            return;
+        this->m_vm = value;
+        update_execution_mode();
+    }
     void set_iopl(unsigned int value) { this->m_iopl = value; }
 
     bool get_if() const { return this->m_if; }
@@ -456,6 +491,9 @@ public:
     bool get_pg() const { return m_cr0 & CR0::PG; }
     bool get_vme() const { return m_cr4 & CR4::VME; }
     bool get_pvi() const { return m_cr4 & CR4::PVI; }
+
+    // Whether CLI/STI with IOPL < CPL operate on VIF instead of faulting.
+    bool has_virtual_interrupt_flag() const { return get_vm() ? get_vme() : (get_pvi() && get_cpl() == 3); }
     bool get_tsd() const { return m_cr4 & CR4::TSD; }
 
     u16 get_cs() const { return this->m_cs; }
@@ -549,6 +587,8 @@ public:
     u32 get_cr3() const { return m_cr3; }
     u32 get_cr4() const { return m_cr4; }
 
+    FPU& fpu() { return m_fpu; }
+
     u32 getDR0() const { return m_dr0; }
     u32 getDR1() const { return m_dr1; }
     u32 getDR2() const { return m_dr2; }
@@ -621,14 +661,17 @@ public:
     void jump_absolute16(u16 offset);
     void jump_absolute32(u32 offset);
 
-    void decodeNext();
+    void decodeNext(InstructionStream&);
     void execute(Instruction&);
+    void execute_with_profiling(Instruction&);
 
     void execute_one_instruction();
+    void execute_one_instruction(InstructionStream&);
 
     // CPU main loop - will fetch & decode until stopped
     void main_loop();
     bool main_loop_slow_stuff();
+    void drain_input_queues();
 
     // CPU main loop when halted (HLT) - will do nothing until an IRQ is raised
     void halted_loop();
@@ -663,6 +706,16 @@ public:
 
     Debugger& debugger() { return *m_debugger; }
 
+    // Per-opcode execution counts. The profiler is kept around (with its data) while disabled.
+    OpcodeProfiler* opcode_profiler() { return m_opcode_profiler.ptr(); }
+    bool is_opcode_profiling_enabled() const { return m_opcode_profiling_enabled; }
+    void set_opcode_profiling_enabled(bool);
+
+    SamplingProfiler& sampling_profiler();
+
+    // Waits for the binary trace (--trace-file) to reach the disk.
+    void flush_trace();
+
     template<typename T>
     T in(u16 port);
     template<typename T>
@@ -679,12 +732,14 @@ public:
     const u8* memory_pointer(LogicalAddress);
     const u8* memory_pointer(SegmentRegisterIndex, u32 offset);
     const u8* memory_pointer(const SegmentDescriptor&, u32 offset);
+    // Like memory_pointer(), but returns nullptr instead of faulting, and leaves the page tables alone.
+    const u8* memory_pointer_without_faulting(LinearAddress);
 
     u32 get_eflags() const;
     u16 get_flags() const;
     void set_eflags(u32 flags);
     void set_flags(u16 flags);
-    void set_eflags_respectfully(u32 flags, u8 effectiveCPL);
+    void set_eflags_respectfully(u32 flags, u8 effectiveCPL, bool is_iret);
 
     bool evaluate(u8) const;
 
@@ -745,12 +800,24 @@ public:
     void write_memory(SegmentRegisterIndex, u32 offset, T);
 
     PhysicalAddress translate_address(LinearAddress, MemoryAccessType, u8 effectiveCPL = 0xff);
+    // Walks the page tables without faulting or setting accessed/dirty bits. Empty if the page isn't present.
+    std::optional<PhysicalAddress> translate_address_without_faulting(LinearAddress);
     void snoop(LinearAddress, MemoryAccessType);
     void snoop(SegmentRegisterIndex, u32 offset, MemoryAccessType);
 
     template<typename T>
     void validate_io_access(u16 port);
 
+    // Ports the current TSS I/O bitmap is known to permit. The slow path fills this in as it reads the bitmap.
+    bool is_io_access_known_permitted(u16 port, unsigned size) const;
+    void remember_io_permissions(u16 first_port, u16 bitmap_bits, unsigned port_count);
+    void invalidate_io_permission_cache();
+
+    // Flags the physical pages backing [base, base + limit] so that any write to them drops the table caches.
+    void watch_table_pages(LinearAddress base, u32 limit);
+    // Drops the GDT, LDT, IDT and I/O permission caches and forgets the watched pages.
+    void invalidate_table_caches();
+
     u8 read_memory8(LinearAddress);
     u8 read_memory8(SegmentRegisterIndex, u32 offset);
     u16 read_memory16(LinearAddress);
@@ -768,6 +835,19 @@ public:
     void write_memory_metal16(LinearAddress, u16);
     void write_memory_metal32(LinearAddress, u32);
 
+    // A small run of guest memory translated at CPL 0, one page at a time, before any of it is touched.
+    // Used to move whole system structures (like the TSS) without a translation per field.
+    struct MetalBlock {
+        LinearAddress linear_address;
+        u32 size { 0 };
+        unsigned chunk_count { 0 };
+        PhysicalAddress chunk_address[2];
+        u32 chunk_size[2] { 0, 0 };
+    };
+    MetalBlock translate_metal_block(LinearAddress, u32 size, MemoryAccessType);
+    void read_metal_block(const MetalBlock&, u8* buffer);
+    void write_metal_block(const MetalBlock&, const u8* buffer);
+
     enum State {
         Dead,
         Alive,
@@ -776,6 +856,20 @@ public:
     State state() const { return m_state; }
     void set_state(State s) { m_state = s; }
 
+    // The main loop and instruction fetch are specialized for each of these.
+    // Data accesses aren't (the instruction handlers are mode-agnostic), but test this
+    // instead of CR0.PE/CR0.PG/EFLAGS.VM. Recomputed whenever CR0, EFLAGS.VM or CS changes.
+    enum class ExecutionMode : u8 {
+        Real,
+        VM86,
+        VM86Paged,
+        Protected,
+        ProtectedPaged,
+        Flat32,
+        Flat32Paged,
+    };
+    ExecutionMode execution_mode() const { return m_execution_mode; }
+
     SegmentDescriptor& cached_descriptor(SegmentRegisterIndex index) { return m_descriptor[(int)index]; }
     const SegmentDescriptor& cached_descriptor(SegmentRegisterIndex index) const { return m_descriptor[(int)index]; }
 
@@ -805,10 +899,9 @@ public:
     void dump_trace();
 #endif
 
-    QVector<WatchedAddress>& watches()
-    {
-        return m_watches;
-    }
+    const QVector<WatchedAddress>& watches() const { return m_watches; }
+    void add_watch(const WatchedAddress&);
+    bool remove_watch(PhysicalAddress);
 
     // Current execution mode (16 or 32 bit)
     bool x16() const { return !x32(); }
@@ -825,7 +918,8 @@ public:
     enum Command {
         ExitDebugger,
         EnterDebugger,
-        HardReboot
+        HardReboot,
+        DrainInputQueues,
     };
     void queue_command(Command);
 
@@ -1447,13 +1541,32 @@ private:
     u32 read_instruction32() override;
 
     void init_watches();
+    void rebuild_watched_page_bitmap();
+
+    // One bit per 4 KB page, sized on demand. Breakpoints are indexed by EIP page, watches by physical page.
+    static bool is_flagged_page(const QVector<u64>& bitmap, u32 address)
+    {
+        u32 page = address >> 12;
+        return bitmap[page / 64] & (1ULL << (page % 64));
+    }
+    static void flag_page(QVector<u64>& bitmap, u32 address);
+
+    void check_breakpoints();
     void hard_reboot();
 
     void update_default_sizes();
     void update_stack_size();
     void update_code_segment_cache();
+    void update_execution_mode();
     void make_next_instruction_uninterruptible();
 
+    template<ExecutionMode>
+    class ModeInstructionStream;
+    template<ExecutionMode>
+    void main_loop_in_mode();
+    template<typename T, ExecutionMode>
+    T read_instruction_stream_in_mode();
+
     PhysicalAddress translate_address_slow_case(LinearAddress, MemoryAccessType, u8 effectiveCPL);
 
     template<typename T>
@@ -1553,6 +1666,8 @@ private:
     u32 m_cr3 { 0 };
     u32 m_cr4 { 0 };
 
+    FPU m_fpu;
+
     u32 m_dr0, m_dr1, m_dr2, m_dr3, m_dr4, m_dr5, m_dr6, m_dr7;
 
     struct {
@@ -1562,7 +1677,37 @@ private:
         bool is_32bit { false };
     } m_tr;
 
+    // Decoded GDT/LDT descriptors, direct-mapped by selector index and tagged with the full index.
+    // Dropped on LGDT/LLDT, task switches, paging changes and writes to the table's physical pages.
+    static const unsigned descriptor_cache_size = 256;
+    struct CachedDescriptor {
+        u16 tag { 0 };
+        bool valid { false };
+        Descriptor descriptor;
+    };
+    struct DescriptorCache {
+        CachedDescriptor entries[descriptor_cache_size];
+        bool populated { false };
+    };
+    DescriptorCache m_gdt_cache;
+    DescriptorCache m_ldt_cache;
+    void invalidate_descriptor_cache(DescriptorCache&);
+
+    // Decoded IDT gates, filled in on first use. Dropped on LIDT, paging changes and writes to the IDT's physical pages.
+    Descriptor m_idt_cache[256];
+    u64 m_idt_cache_valid[256 / 64] { 0, 0, 0, 0 };
+    bool m_idt_cache_populated { false };
+
+    u64 m_io_permitted_ports[65536 / 64];
+    bool m_io_permission_cache_populated { false };
+
+    // Physical pages the table caches were filled from. Checked on every physical write, so aliased
+    // mappings, write_physical_memory() and DMA all invalidate. Flags may outlive the cache that set them.
+    QVector<u64> m_table_page_bitmap;
+    QVector<u32> m_table_pages;
+
     State m_state { Dead };
+    ExecutionMode m_execution_mode { ExecutionMode::Real };
 
     // Actual CS:EIP (when we started fetching the instruction)
     u16 m_base_cs { 0 };
@@ -1574,16 +1719,24 @@ private:
     u32 m_extended_memory_size { 0 };
 
     std::set<LogicalAddress> m_breakpoints;
+    QVector<u64> m_breakpoint_page_bitmap;
 
     bool m_a20_enabled { false };
     bool m_next_instruction_is_uninterruptible { false };
 
     OwnPtr<Debugger> m_debugger;
+    OwnPtr<OpcodeProfiler> m_opcode_profiler;
+    bool m_opcode_profiling_enabled { false };
+    OwnPtr<SamplingProfiler> m_sampling_profiler;
+    OwnPtr<TraceWriter> m_trace_writer;
 
     // One MemoryProvider* per 'memoryProviderBlockSize' bytes for the first MB of memory.
     static const size_t memory_provider_block_size = 16384;
     MemoryProvider* m_memory_providers[1048576 / memory_provider_block_size];
 
+    // Device memory mapped above the end of RAM, e.g. a linear framebuffer.
+    QVector<MemoryProvider*> m_high_memory_providers;
+
     u8* m_memory { nullptr };
     size_t m_memory_size { 0 };
 
@@ -1592,6 +1745,7 @@ private:
     u32* m_debug_register_map[8];
 
     Machine& m_machine;
+    RuntimeOptions& m_options;
 
     bool m_address_size32 { false };
     bool m_operand_size32 { false };
@@ -1608,8 +1762,13 @@ private:
     std::atomic<bool> m_main_loop_needs_slow_stuff { false };
     std::atomic<DebuggerRequest> m_debugger_request { NoDebuggerRequest };
     std::atomic<bool> m_should_hard_reboot { false };
+    std::atomic<bool> m_should_drain_input_queues { false };
+    std::atomic<bool> m_has_pending_irq { false };
 
+    // Only checked in write_physical_memory() and write_metal_block(). Devices storing into their own
+    // backing memory (e.g. BochsVBE clearing the framebuffer on a mode set) or reallocating RAM don't trip them.
     QVector<WatchedAddress> m_watches;
+    QVector<u64> m_watched_page_bitmap;
 
 #ifdef SYMBOLIC_TRACING
     QHash<u32, QString> m_symbols;
@@ -1621,15 +1780,18 @@ private:
 #endif
 
     bool m_is_for_autotest { false };
+    bool m_should_dump_trace_for_autotest { false };
 
     u64 m_cycle { 0 };
+    u64 m_next_event_cycle { no_pending_event };
 
     mutable u32 m_dirty_flags { 0 };
     u64 m_last_result { 0 };
     unsigned m_last_op_size { ByteSize };
 };
 
-extern CPU* g_cpu;
+// The CPU running on the current thread, if any. Each machine runs on its own thread.
+extern thread_local CPU* g_cpu;
 
 #include "debug.h"
 
@@ -1817,6 +1979,15 @@ inline void MemoryOrRegisterReference::write32(u32 data)
     return write(data);
 }
 
+inline void MemoryOrRegisterReference::write_special(u32 data, bool o32)
+{
+    if (o32 && is_register()) {
+        m_cpu->write_register<u32>(m_register_index, data);
+        return;
+    }
+    return write<u16>(data & 0xffff);
+}
+
 template<typename T>
 void CPU::math_flags(typename TypeDoubler<T>::type result, T dest, T src)
 {
@@ -25,6 +25,7 @@
 #include "Descriptor.h"
 #include "CPU.h"
 #include "debugger.h"
+#include <string.h>
 
 SegmentDescriptor CPU::get_real_mode_or_vm86_descriptor(u16 selector, SegmentRegisterIndex segment_register)
 {
@@ -46,6 +47,7 @@ SegmentDescriptor CPU::get_real_mode_or_vm86_descriptor(u16 selector, SegmentReg
         // Data + Writable
         descriptor.m_type |= 0x2;
     }
+    descriptor.precompute_segment_checks();
     return descriptor;
 }
 
@@ -55,15 +57,71 @@ Descriptor CPU::get_descriptor(u16 selector)
         return ErrorDescriptor(Descriptor::NullSelector);
 
     bool isGlobal = (selector & 0x04) == 0;
-    if (isGlobal)
-        return get_descriptor(m_gdtr, selector, true);
-    return get_descriptor(m_ldtr, selector, true);
+    auto& table = isGlobal ? m_gdtr : m_ldtr;
+    auto& cache = isGlobal ? m_gdt_cache : m_ldt_cache;
+    u16 tag = selector & 0xfff8;
+    auto& entry = cache.entries[(selector >> 3) % descriptor_cache_size];
+
+    if (entry.valid && entry.tag == tag) {
+        Descriptor descriptor = entry.descriptor;
+        descriptor.m_index = selector;
+        descriptor.m_rpl = selector & 3;
+        return descriptor;
+    }
+
+    auto descriptor = get_descriptor(table, selector, true);
+
+    if (!cache.populated) {
+        watch_table_pages(table.base(), table.limit());
+        cache.populated = true;
+    }
+    entry.tag = tag;
+    entry.valid = true;
+    entry.descriptor = descriptor;
+    return descriptor;
+}
+
+void CPU::invalidate_descriptor_cache(DescriptorCache& cache)
+{
+    if (!cache.populated)
+        return;
+    for (auto& entry : cache.entries)
+        entry.valid = false;
+    cache.populated = false;
+}
+
+void CPU::invalidate_gdt_cache()
+{
+    invalidate_descriptor_cache(m_gdt_cache);
+}
+
+void CPU::invalidate_ldt_cache()
+{
+    invalidate_descriptor_cache(m_ldt_cache);
 }
 
 Descriptor CPU::get_interrupt_descriptor(u8 number)
 {
     ASSERT(get_pe());
-    return get_descriptor(m_idtr, number, false);
+    u64 bit = 1ULL << (number % 64);
+    if (m_idt_cache_valid[number / 64] & bit)
+        return m_idt_cache[number];
+
+    auto descriptor = get_descriptor(m_idtr, number, false);
+
+    if (!m_idt_cache_populated) {
+        watch_table_pages(m_idtr.base(), m_idtr.limit());
+        m_idt_cache_populated = true;
+    }
+    m_idt_cache[number] = descriptor;
+    m_idt_cache_valid[number / 64] |= bit;
+    return descriptor;
+}
+
+void CPU::invalidate_idt_cache()
+{
+    memset(m_idt_cache_valid, 0, sizeof(m_idt_cache_valid));
+    m_idt_cache_populated = false;
 }
 
 SegmentDescriptor CPU::get_segment_descriptor(u16 selector)
@@ -121,6 +179,8 @@ Descriptor CPU::get_descriptor(DescriptorTableRegister& table_register, u16 inde
             descriptor.m_effective_limit = (descriptor.m_segment_limit << 12) | 0xfff;
         else
             descriptor.m_effective_limit = descriptor.m_segment_limit;
+        if (descriptor.is_segment_descriptor())
+            descriptor.precompute_segment_checks();
     }
 
     descriptor.m_high = hi;
@@ -129,6 +189,40 @@ Descriptor CPU::get_descriptor(DescriptorTableRegister& table_register, u16 inde
     return descriptor;
 }
 
+void Descriptor::precompute_segment_checks()
+{
+    ASSERT(is_segment_descriptor());
+    if (is_code()) {
+        auto& code_segment = as_code_segment_descriptor();
+        m_access_rights = SegmentDescriptor::AllowsExecute | SegmentDescriptor::AllowsInternalPointer;
+        if (code_segment.readable())
+            m_access_rights |= SegmentDescriptor::AllowsRead;
+    } else {
+        auto& data_segment = as_data_segment_descriptor();
+        m_access_rights = SegmentDescriptor::AllowsRead | SegmentDescriptor::AllowsInternalPointer;
+        if (data_segment.writable())
+            m_access_rights |= SegmentDescriptor::AllowsWrite;
+    }
+
+    if (is_data() && as_data_segment_descriptor().expand_down()) {
+        m_valid_offset_high = m_d ? 0xffffffff : 0xffff;
+        m_flat = false;
+        if (m_effective_limit >= m_valid_offset_high) {
+            // limit + 1 would wrap to 0 and accept everything. Keep the fast path from accepting anything instead.
+            m_valid_offset_low = 0xffffffff;
+            m_valid_offset_high = 0;
+            m_access_rights = 0;
+            return;
+        }
+        m_valid_offset_low = m_effective_limit + 1;
+        return;
+    }
+
+    m_valid_offset_low = 0;
+    m_valid_offset_high = m_effective_limit;
+    m_flat = !m_segment_base && m_effective_limit == 0xffffffff;
+}
+
 const char* SystemDescriptor::type_name() const
 {
     switch (m_type) {
@@ -118,6 +118,13 @@ protected:
 
     u32 m_effective_limit { 0 };
 
+    // Segment access checks, precomputed when the descriptor is decoded so loads into segment registers carry them.
+    void precompute_segment_checks();
+    u32 m_valid_offset_low { 0 };
+    u32 m_valid_offset_high { 0 };
+    u8 m_access_rights { 0 };
+    bool m_flat { false };
+
     // These are not part of the descriptor, but metadata about the lookup that found this descriptor.
     unsigned m_index { 0xFFFFFFFF };
     bool m_global { false };
@@ -236,9 +243,28 @@ inline const LDTDescriptor& Descriptor::as_ldt_descriptor() const
 
 class SegmentDescriptor : public Descriptor {
 public:
+    // Indexed by CPU::MemoryAccessType.
+    enum AccessRight : u8 {
+        AllowsRead = 1 << 0,
+        AllowsWrite = 1 << 1,
+        AllowsExecute = 1 << 2,
+        AllowsInternalPointer = 1 << 3,
+    };
+
     LinearAddress base() const { return LinearAddress(m_segment_base); }
     u32 limit() const { return m_segment_limit; }
 
+    // Offsets in [low, high] are inside the segment. Expand-down data segments have a raised low bound.
+    u32 valid_offset_low() const { return m_valid_offset_low; }
+    u32 valid_offset_high() const { return m_valid_offset_high; }
+    // An expand-down segment whose limit is already the top of its range has no valid offsets.
+    bool has_empty_valid_range() const { return m_valid_offset_low > m_valid_offset_high; }
+    u8 access_rights() const { return m_access_rights; }
+    bool allows(u8 access_right) const { return m_access_rights & access_right; }
+
+    // Base 0, expand-up, 4 GiB: no offset can fall outside, and linear address == offset.
+    bool is_flat() const { return m_flat; }
+
     bool is_code() const { return (m_type & 0x8) != 0; }
     bool is_data() const { return (m_type & 0x8) == 0; }
     bool accessed() const { return m_type & 0x1; }
@@ -0,0 +1,158 @@
+// Computron x86 PC Emulator
+// Copyright (C) 2003-2020 Andreas Kling <kling@serenityos.org>
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY ANDREAS KLING ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL ANDREAS KLING OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "types.h"
+
+// The x87 register stack and control state. Instructions are decoded in fpu.cpp.
+class FPU {
+public:
+    enum Tag : u8 {
+        Valid = 0,
+        Zero = 1,
+        Special = 2,
+        Empty = 3,
+    };
+
+    struct Status {
+        enum Bits : u16 {
+            IE = 1u << 0,
+            DE = 1u << 1,
+            ZE = 1u << 2,
+            OE = 1u << 3,
+            UE = 1u << 4,
+            PE = 1u << 5,
+            SF = 1u << 6,
+            ES = 1u << 7,
+            C0 = 1u << 8,
+            C1 = 1u << 9,
+            C2 = 1u << 10,
+            TopMask = 7u << 11,
+            C3 = 1u << 14,
+            B = 1u << 15,
+
+            ExceptionMask = IE | DE | ZE | OE | UE | PE,
+            ConditionMask = C0 | C1 | C2 | C3,
+        };
+    };
+
+    struct Control {
+        enum Bits : u16 {
+            IM = 1u << 0,
+            DM = 1u << 1,
+            ZM = 1u << 2,
+            OM = 1u << 3,
+            UM = 1u << 4,
+            PM = 1u << 5,
+
+            ExceptionMask = IM | DM | ZM | OM | UM | PM,
+        };
+    };
+
+    enum RoundingMode {
+        RoundToNearest = 0,
+        RoundDown = 1,
+        RoundUp = 2,
+        RoundTowardZero = 3,
+    };
+
+    enum PrecisionMode {
+        SinglePrecision = 0,
+        DoublePrecision = 2,
+        ExtendedPrecision = 3,
+    };
+
+    FPU() { initialize(); }
+
+    // FNINIT
+    void initialize();
+
+    u16 control_word() const { return m_control; }
+    void set_control_word(u16);
+    u16 status_word() const { return (m_status & ~Status::TopMask) | (m_top << 11); }
+    void set_status_word(u16);
+    u16 tag_word() const;
+    void set_tag_word(u16);
+
+    RoundingMode rounding_mode() const { return static_cast<RoundingMode>((m_control >> 10) & 3); }
+    PrecisionMode precision_mode() const { return static_cast<PrecisionMode>((m_control >> 8) & 3); }
+
+    unsigned top() const { return m_top; }
+    unsigned physical_index(unsigned i) const { return (m_top + i) & 7; }
+
+    bool is_empty(unsigned i) const { return m_tags[physical_index(i)] == Empty; }
+    long double st(unsigned i) const { return m_registers[physical_index(i)]; }
+    void set_st(unsigned i, long double);
+    void free(unsigned i) { m_tags[physical_index(i)] = Empty; }
+
+    // Physical register access for FSAVE/FRSTOR, which store the stack in ST(i) order.
+    long double physical_register(unsigned index) const { return m_registers[index]; }
+    void set_physical_register(unsigned index, long double value) { m_registers[index] = value; }
+
+    // Reports a stack overflow if ST(7) is in use.
+    void push(long double);
+    void pop();
+    void increment_top() { m_top = (m_top + 1) & 7; }
+    void decrement_top() { m_top = (m_top - 1) & 7; }
+
+    void set_condition_codes(bool c3, bool c2, bool c1, bool c0);
+    void set_c1(bool);
+    void set_c2(bool);
+
+    // Records exceptions in the sticky status bits. Returns false if any of them are unmasked and
+    // the operation must leave its destination alone.
+    bool raise(u16 exceptions);
+    bool raise_stack_fault(bool overflow);
+    bool has_pending_exception() const { return m_status & Status::ES; }
+    void clear_exceptions() { m_status &= ~(Status::ExceptionMask | Status::SF | Status::ES | Status::B); }
+
+    // Where the last non-control instruction came from, for FSTENV/FSAVE.
+    u32 m_instruction_pointer { 0 };
+    u16 m_instruction_selector { 0 };
+    u16 m_opcode { 0 };
+    u32 m_operand_pointer { 0 };
+    u16 m_operand_selector { 0 };
+
+    // Set once an unmasked exception has been signalled through IRQ13, so it isn't raised again every instruction.
+    bool m_error_signalled { false };
+
+    static Tag classify(long double);
+
+    // 80-bit extended precision in memory byte order.
+    static long double load_extended(const u8*);
+    static void store_extended(long double, u8*);
+
+    static constexpr long double indefinite() { return -__builtin_nanl(""); }
+
+private:
+    void update_error_summary();
+
+    long double m_registers[8];
+    Tag m_tags[8];
+    unsigned m_top { 0 };
+    u16 m_control { 0x037f };
+    u16 m_status { 0 };
+};
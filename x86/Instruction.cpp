@@ -24,6 +24,14 @@
 
 #include "Instruction.h"
 #include "CPU.h"
+#include <QMutex>
+
+#ifdef CT_DECODER_ONLY
+// ct-tracedump only decodes, so it doesn't link the instruction implementations.
+#define IMPL(name) nullptr
+#else
+#define IMPL(name) &CPU::name
+#endif
 
 enum IsLockPrefixAllowed { LockPrefixNotAllowed = 0,
     LockPrefixAllowed };
@@ -157,6 +165,9 @@ struct InstructionDescriptor {
     }
 
     IsLockPrefixAllowed lock_prefix_allowed { LockPrefixNotAllowed };
+
+    // Index into s_opcodes, assigned once the tables are complete.
+    unsigned opcode_index { 0 };
 };
 
 static InstructionDescriptor s_table16[256];
@@ -164,6 +175,8 @@ static InstructionDescriptor s_table32[256];
 static InstructionDescriptor s_0f_table16[256];
 static InstructionDescriptor s_0f_table32[256];
 
+static QVector<OpcodeInfo> s_opcodes;
+
 static bool opcode_has_register_index(u8 op)
 {
     if (op >= 0x40 && op <= 0x5F)
@@ -178,7 +191,7 @@ static bool opcode_has_register_index(u8 op)
 static void build(InstructionDescriptor* table, u8 op, const char* mnemonic, InstructionFormat format, InstructionImpl impl, IsLockPrefixAllowed lock_prefix_allowed)
 {
     InstructionDescriptor& d = table[op];
-    ASSERT(!d.impl);
+    ASSERT(!d.mnemonic);
 
     d.mnemonic = mnemonic;
     d.format = format;
@@ -379,452 +392,520 @@ static void build_0f_slash(u8 op, u8 slash, const char* mnemonic, InstructionFor
     build_slash(s_0f_table32, op, slash, mnemonic, format, impl, lock_prefix_allowed);
 }
 
+static void assign_opcode_index(InstructionDescriptor& descriptor, u8 op, bool has_sub_op, u8 sub_op, u8 slash, bool o32)
+{
+    if (!descriptor.mnemonic)
+        return;
+    descriptor.opcode_index = s_opcodes.size();
+    s_opcodes.append({ descriptor.mnemonic, op, has_sub_op, sub_op, slash, o32 });
+}
+
+static void assign_opcode_indices()
+{
+    struct {
+        InstructionDescriptor* table;
+        bool is_0f;
+        bool o32;
+    } tables[] = {
+        { s_table16, false, false },
+        { s_table32, false, true },
+        { s_0f_table16, true, false },
+        { s_0f_table32, true, true },
+    };
+
+    for (auto& it : tables) {
+        for (unsigned i = 0; i < 256; ++i) {
+            auto& descriptor = it.table[i];
+            u8 op = it.is_0f ? 0x0F : i;
+            u8 sub_op = it.is_0f ? i : 0;
+            if (descriptor.format != MultibyteWithSlash) {
+                assign_opcode_index(descriptor, op, it.is_0f, sub_op, OpcodeInfo::no_slash, it.o32);
+                continue;
+            }
+            for (u8 slash = 0; slash < 8; ++slash)
+                assign_opcode_index(descriptor.slashes[slash], op, it.is_0f, sub_op, slash, it.o32);
+        }
+    }
+}
+
+unsigned opcode_count()
+{
+    return s_opcodes.size();
+}
+
+const OpcodeInfo& opcode_info(unsigned index)
+{
+    return s_opcodes[index];
+}
+
+QString OpcodeInfo::to_string() const
+{
+    QString s = QString("%1").arg(op, 2, 16, QLatin1Char('0')).toUpper();
+    if (has_sub_op)
+        s += QString(" %1").arg(sub_op, 2, 16, QLatin1Char('0')).toUpper();
+    if (slash != no_slash)
+        s += QString(" /%1").arg(slash);
+    return s;
+}
+
+unsigned Instruction::opcode_index() const
+{
+    ASSERT(m_descriptor);
+    return m_descriptor->opcode_index;
+}
+
 void build_opcode_tables_if_needed()
 {
+    // The tables are shared by every CPU in the process, and machines may be created in parallel.
+    static QMutex mutex;
+    QMutexLocker locker(&mutex);
+
     static bool has_built_tables = false;
     if (has_built_tables)
         return;
 
-    build(0x00, "ADD", OP_RM8_reg8, &CPU::_ADD_RM8_reg8, LockPrefixAllowed);
-    build(0x01, "ADD", OP_RM16_reg16, &CPU::_ADD_RM16_reg16, OP_RM32_reg32, &CPU::_ADD_RM32_reg32, LockPrefixAllowed);
-    build(0x02, "ADD", OP_reg8_RM8, &CPU::_ADD_reg8_RM8, LockPrefixAllowed);
-    build(0x03, "ADD", OP_reg16_RM16, &CPU::_ADD_reg16_RM16, OP_reg32_RM32, &CPU::_ADD_reg32_RM32, LockPrefixAllowed);
-    build(0x04, "ADD", OP_AL_imm8, &CPU::_ADD_AL_imm8);
-    build(0x05, "ADD", OP_AX_imm16, &CPU::_ADD_AX_imm16, OP_EAX_imm32, &CPU::_ADD_EAX_imm32);
-    build(0x06, "PUSH", OP_ES, &CPU::_PUSH_ES);
-    build(0x07, "POP", OP_ES, &CPU::_POP_ES);
-    build(0x08, "OR", OP_RM8_reg8, &CPU::_OR_RM8_reg8, LockPrefixAllowed);
-    build(0x09, "OR", OP_RM16_reg16, &CPU::_OR_RM16_reg16, OP_RM32_reg32, &CPU::_OR_RM32_reg32, LockPrefixAllowed);
-    build(0x0A, "OR", OP_reg8_RM8, &CPU::_OR_reg8_RM8, LockPrefixAllowed);
-    build(0x0B, "OR", OP_reg16_RM16, &CPU::_OR_reg16_RM16, OP_reg32_RM32, &CPU::_OR_reg32_RM32, LockPrefixAllowed);
-    build(0x0C, "OR", OP_AL_imm8, &CPU::_OR_AL_imm8);
-    build(0x0D, "OR", OP_AX_imm16, &CPU::_OR_AX_imm16, OP_EAX_imm32, &CPU::_OR_EAX_imm32);
-    build(0x0E, "PUSH", OP_CS, &CPU::_PUSH_CS);
-
-    build(0x10, "ADC", OP_RM8_reg8, &CPU::_ADC_RM8_reg8, LockPrefixAllowed);
-    build(0x11, "ADC", OP_RM16_reg16, &CPU::_ADC_RM16_reg16, OP_RM32_reg32, &CPU::_ADC_RM32_reg32, LockPrefixAllowed);
-    build(0x12, "ADC", OP_reg8_RM8, &CPU::_ADC_reg8_RM8, LockPrefixAllowed);
-    build(0x13, "ADC", OP_reg16_RM16, &CPU::_ADC_reg16_RM16, OP_reg32_RM32, &CPU::_ADC_reg32_RM32, LockPrefixAllowed);
-    build(0x14, "ADC", OP_AL_imm8, &CPU::_ADC_AL_imm8);
-    build(0x15, "ADC", OP_AX_imm16, &CPU::_ADC_AX_imm16, OP_EAX_imm32, &CPU::_ADC_EAX_imm32);
-    build(0x16, "PUSH", OP_SS, &CPU::_PUSH_SS);
-    build(0x17, "POP", OP_SS, &CPU::_POP_SS);
-    build(0x18, "SBB", OP_RM8_reg8, &CPU::_SBB_RM8_reg8, LockPrefixAllowed);
-    build(0x19, "SBB", OP_RM16_reg16, &CPU::_SBB_RM16_reg16, OP_RM32_reg32, &CPU::_SBB_RM32_reg32, LockPrefixAllowed);
-    build(0x1A, "SBB", OP_reg8_RM8, &CPU::_SBB_reg8_RM8, LockPrefixAllowed);
-    build(0x1B, "SBB", OP_reg16_RM16, &CPU::_SBB_reg16_RM16, OP_reg32_RM32, &CPU::_SBB_reg32_RM32, LockPrefixAllowed);
-    build(0x1C, "SBB", OP_AL_imm8, &CPU::_SBB_AL_imm8);
-    build(0x1D, "SBB", OP_AX_imm16, &CPU::_SBB_AX_imm16, OP_EAX_imm32, &CPU::_SBB_EAX_imm32);
-    build(0x1E, "PUSH", OP_DS, &CPU::_PUSH_DS);
-    build(0x1F, "POP", OP_DS, &CPU::_POP_DS);
-
-    build(0x20, "AND", OP_RM8_reg8, &CPU::_AND_RM8_reg8, LockPrefixAllowed);
-    build(0x21, "AND", OP_RM16_reg16, &CPU::_AND_RM16_reg16, OP_RM32_reg32, &CPU::_AND_RM32_reg32, LockPrefixAllowed);
-    build(0x22, "AND", OP_reg8_RM8, &CPU::_AND_reg8_RM8, LockPrefixAllowed);
-    build(0x23, "AND", OP_reg16_RM16, &CPU::_AND_reg16_RM16, OP_reg32_RM32, &CPU::_AND_reg32_RM32, LockPrefixAllowed);
-    build(0x24, "AND", OP_AL_imm8, &CPU::_AND_AL_imm8);
-    build(0x25, "AND", OP_AX_imm16, &CPU::_AND_AX_imm16, OP_EAX_imm32, &CPU::_AND_EAX_imm32);
-    build(0x27, "DAA", OP, &CPU::_DAA);
-    build(0x28, "SUB", OP_RM8_reg8, &CPU::_SUB_RM8_reg8, LockPrefixAllowed);
-    build(0x29, "SUB", OP_RM16_reg16, &CPU::_SUB_RM16_reg16, OP_RM32_reg32, &CPU::_SUB_RM32_reg32, LockPrefixAllowed);
-    build(0x2A, "SUB", OP_reg8_RM8, &CPU::_SUB_reg8_RM8, LockPrefixAllowed);
-    build(0x2B, "SUB", OP_reg16_RM16, &CPU::_SUB_reg16_RM16, OP_reg32_RM32, &CPU::_SUB_reg32_RM32, LockPrefixAllowed);
-    build(0x2C, "SUB", OP_AL_imm8, &CPU::_SUB_AL_imm8);
-    build(0x2D, "SUB", OP_AX_imm16, &CPU::_SUB_AX_imm16, OP_EAX_imm32, &CPU::_SUB_EAX_imm32);
-    build(0x2F, "DAS", OP, &CPU::_DAS);
-
-    build(0x30, "XOR", OP_RM8_reg8, &CPU::_XOR_RM8_reg8, LockPrefixAllowed);
-    build(0x31, "XOR", OP_RM16_reg16, &CPU::_XOR_RM16_reg16, OP_RM32_reg32, &CPU::_XOR_RM32_reg32, LockPrefixAllowed);
-    build(0x32, "XOR", OP_reg8_RM8, &CPU::_XOR_reg8_RM8, LockPrefixAllowed);
-    build(0x33, "XOR", OP_reg16_RM16, &CPU::_XOR_reg16_RM16, OP_reg32_RM32, &CPU::_XOR_reg32_RM32, LockPrefixAllowed);
-    build(0x34, "XOR", OP_AL_imm8, &CPU::_XOR_AL_imm8);
-    build(0x35, "XOR", OP_AX_imm16, &CPU::_XOR_AX_imm16, OP_EAX_imm32, &CPU::_XOR_EAX_imm32);
-    build(0x37, "AAA", OP, &CPU::_AAA);
-    build(0x38, "CMP", OP_RM8_reg8, &CPU::_CMP_RM8_reg8, LockPrefixAllowed);
-    build(0x39, "CMP", OP_RM16_reg16, &CPU::_CMP_RM16_reg16, OP_RM32_reg32, &CPU::_CMP_RM32_reg32, LockPrefixAllowed);
-    build(0x3A, "CMP", OP_reg8_RM8, &CPU::_CMP_reg8_RM8, LockPrefixAllowed);
-    build(0x3B, "CMP", OP_reg16_RM16, &CPU::_CMP_reg16_RM16, OP_reg32_RM32, &CPU::_CMP_reg32_RM32, LockPrefixAllowed);
-    build(0x3C, "CMP", OP_AL_imm8, &CPU::_CMP_AL_imm8);
-    build(0x3D, "CMP", OP_AX_imm16, &CPU::_CMP_AX_imm16, OP_EAX_imm32, &CPU::_CMP_EAX_imm32);
-    build(0x3F, "AAS", OP, &CPU::_AAS);
+    build(0x00, "ADD", OP_RM8_reg8, IMPL(_ADD_RM8_reg8), LockPrefixAllowed);
+    build(0x01, "ADD", OP_RM16_reg16, IMPL(_ADD_RM16_reg16), OP_RM32_reg32, IMPL(_ADD_RM32_reg32), LockPrefixAllowed);
+    build(0x02, "ADD", OP_reg8_RM8, IMPL(_ADD_reg8_RM8), LockPrefixAllowed);
+    build(0x03, "ADD", OP_reg16_RM16, IMPL(_ADD_reg16_RM16), OP_reg32_RM32, IMPL(_ADD_reg32_RM32), LockPrefixAllowed);
+    build(0x04, "ADD", OP_AL_imm8, IMPL(_ADD_AL_imm8));
+    build(0x05, "ADD", OP_AX_imm16, IMPL(_ADD_AX_imm16), OP_EAX_imm32, IMPL(_ADD_EAX_imm32));
+    build(0x06, "PUSH", OP_ES, IMPL(_PUSH_ES));
+    build(0x07, "POP", OP_ES, IMPL(_POP_ES));
+    build(0x08, "OR", OP_RM8_reg8, IMPL(_OR_RM8_reg8), LockPrefixAllowed);
+    build(0x09, "OR", OP_RM16_reg16, IMPL(_OR_RM16_reg16), OP_RM32_reg32, IMPL(_OR_RM32_reg32), LockPrefixAllowed);
+    build(0x0A, "OR", OP_reg8_RM8, IMPL(_OR_reg8_RM8), LockPrefixAllowed);
+    build(0x0B, "OR", OP_reg16_RM16, IMPL(_OR_reg16_RM16), OP_reg32_RM32, IMPL(_OR_reg32_RM32), LockPrefixAllowed);
+    build(0x0C, "OR", OP_AL_imm8, IMPL(_OR_AL_imm8));
+    build(0x0D, "OR", OP_AX_imm16, IMPL(_OR_AX_imm16), OP_EAX_imm32, IMPL(_OR_EAX_imm32));
+    build(0x0E, "PUSH", OP_CS, IMPL(_PUSH_CS));
+
+    build(0x10, "ADC", OP_RM8_reg8, IMPL(_ADC_RM8_reg8), LockPrefixAllowed);
+    build(0x11, "ADC", OP_RM16_reg16, IMPL(_ADC_RM16_reg16), OP_RM32_reg32, IMPL(_ADC_RM32_reg32), LockPrefixAllowed);
+    build(0x12, "ADC", OP_reg8_RM8, IMPL(_ADC_reg8_RM8), LockPrefixAllowed);
+    build(0x13, "ADC", OP_reg16_RM16, IMPL(_ADC_reg16_RM16), OP_reg32_RM32, IMPL(_ADC_reg32_RM32), LockPrefixAllowed);
+    build(0x14, "ADC", OP_AL_imm8, IMPL(_ADC_AL_imm8));
+    build(0x15, "ADC", OP_AX_imm16, IMPL(_ADC_AX_imm16), OP_EAX_imm32, IMPL(_ADC_EAX_imm32));
+    build(0x16, "PUSH", OP_SS, IMPL(_PUSH_SS));
+    build(0x17, "POP", OP_SS, IMPL(_POP_SS));
+    build(0x18, "SBB", OP_RM8_reg8, IMPL(_SBB_RM8_reg8), LockPrefixAllowed);
+    build(0x19, "SBB", OP_RM16_reg16, IMPL(_SBB_RM16_reg16), OP_RM32_reg32, IMPL(_SBB_RM32_reg32), LockPrefixAllowed);
+    build(0x1A, "SBB", OP_reg8_RM8, IMPL(_SBB_reg8_RM8), LockPrefixAllowed);
+    build(0x1B, "SBB", OP_reg16_RM16, IMPL(_SBB_reg16_RM16), OP_reg32_RM32, IMPL(_SBB_reg32_RM32), LockPrefixAllowed);
+    build(0x1C, "SBB", OP_AL_imm8, IMPL(_SBB_AL_imm8));
+    build(0x1D, "SBB", OP_AX_imm16, IMPL(_SBB_AX_imm16), OP_EAX_imm32, IMPL(_SBB_EAX_imm32));
+    build(0x1E, "PUSH", OP_DS, IMPL(_PUSH_DS));
+    build(0x1F, "POP", OP_DS, IMPL(_POP_DS));
+
+    build(0x20, "AND", OP_RM8_reg8, IMPL(_AND_RM8_reg8), LockPrefixAllowed);
+    build(0x21, "AND", OP_RM16_reg16, IMPL(_AND_RM16_reg16), OP_RM32_reg32, IMPL(_AND_RM32_reg32), LockPrefixAllowed);
+    build(0x22, "AND", OP_reg8_RM8, IMPL(_AND_reg8_RM8), LockPrefixAllowed);
+    build(0x23, "AND", OP_reg16_RM16, IMPL(_AND_reg16_RM16), OP_reg32_RM32, IMPL(_AND_reg32_RM32), LockPrefixAllowed);
+    build(0x24, "AND", OP_AL_imm8, IMPL(_AND_AL_imm8));
+    build(0x25, "AND", OP_AX_imm16, IMPL(_AND_AX_imm16), OP_EAX_imm32, IMPL(_AND_EAX_imm32));
+    build(0x27, "DAA", OP, IMPL(_DAA));
+    build(0x28, "SUB", OP_RM8_reg8, IMPL(_SUB_RM8_reg8), LockPrefixAllowed);
+    build(0x29, "SUB", OP_RM16_reg16, IMPL(_SUB_RM16_reg16), OP_RM32_reg32, IMPL(_SUB_RM32_reg32), LockPrefixAllowed);
+    build(0x2A, "SUB", OP_reg8_RM8, IMPL(_SUB_reg8_RM8), LockPrefixAllowed);
+    build(0x2B, "SUB", OP_reg16_RM16, IMPL(_SUB_reg16_RM16), OP_reg32_RM32, IMPL(_SUB_reg32_RM32), LockPrefixAllowed);
+    build(0x2C, "SUB", OP_AL_imm8, IMPL(_SUB_AL_imm8));
+    build(0x2D, "SUB", OP_AX_imm16, IMPL(_SUB_AX_imm16), OP_EAX_imm32, IMPL(_SUB_EAX_imm32));
+    build(0x2F, "DAS", OP, IMPL(_DAS));
+
+    build(0x30, "XOR", OP_RM8_reg8, IMPL(_XOR_RM8_reg8), LockPrefixAllowed);
+    build(0x31, "XOR", OP_RM16_reg16, IMPL(_XOR_RM16_reg16), OP_RM32_reg32, IMPL(_XOR_RM32_reg32), LockPrefixAllowed);
+    build(0x32, "XOR", OP_reg8_RM8, IMPL(_XOR_reg8_RM8), LockPrefixAllowed);
+    build(0x33, "XOR", OP_reg16_RM16, IMPL(_XOR_reg16_RM16), OP_reg32_RM32, IMPL(_XOR_reg32_RM32), LockPrefixAllowed);
+    build(0x34, "XOR", OP_AL_imm8, IMPL(_XOR_AL_imm8));
+    build(0x35, "XOR", OP_AX_imm16, IMPL(_XOR_AX_imm16), OP_EAX_imm32, IMPL(_XOR_EAX_imm32));
+    build(0x37, "AAA", OP, IMPL(_AAA));
+    build(0x38, "CMP", OP_RM8_reg8, IMPL(_CMP_RM8_reg8), LockPrefixAllowed);
+    build(0x39, "CMP", OP_RM16_reg16, IMPL(_CMP_RM16_reg16), OP_RM32_reg32, IMPL(_CMP_RM32_reg32), LockPrefixAllowed);
+    build(0x3A, "CMP", OP_reg8_RM8, IMPL(_CMP_reg8_RM8), LockPrefixAllowed);
+    build(0x3B, "CMP", OP_reg16_RM16, IMPL(_CMP_reg16_RM16), OP_reg32_RM32, IMPL(_CMP_reg32_RM32), LockPrefixAllowed);
+    build(0x3C, "CMP", OP_AL_imm8, IMPL(_CMP_AL_imm8));
+    build(0x3D, "CMP", OP_AX_imm16, IMPL(_CMP_AX_imm16), OP_EAX_imm32, IMPL(_CMP_EAX_imm32));
+    build(0x3F, "AAS", OP, IMPL(_AAS));
 
     for (u8 i = 0; i <= 7; ++i)
-        build(0x40 + i, "INC", OP_reg16, &CPU::_INC_reg16, OP_reg32, &CPU::_INC_reg32);
+        build(0x40 + i, "INC", OP_reg16, IMPL(_INC_reg16), OP_reg32, IMPL(_INC_reg32));
 
     for (u8 i = 0; i <= 7; ++i)
-        build(0x48 + i, "DEC", OP_reg16, &CPU::_DEC_reg16, OP_reg32, &CPU::_DEC_reg32);
+        build(0x48 + i, "DEC", OP_reg16, IMPL(_DEC_reg16), OP_reg32, IMPL(_DEC_reg32));
 
     for (u8 i = 0; i <= 7; ++i)
-        build(0x50 + i, "PUSH", OP_reg16, &CPU::_PUSH_reg16, OP_reg32, &CPU::_PUSH_reg32);
+        build(0x50 + i, "PUSH", OP_reg16, IMPL(_PUSH_reg16), OP_reg32, IMPL(_PUSH_reg32));
 
     for (u8 i = 0; i <= 7; ++i)
-        build(0x58 + i, "POP", OP_reg16, &CPU::_POP_reg16, OP_reg32, &CPU::_POP_reg32);
-
-    build(0x60, "PUSHAW", OP, &CPU::_PUSHA, "PUSHAD", OP, &CPU::_PUSHAD);
-    build(0x61, "POPAW", OP, &CPU::_POPA, "POPAD", OP, &CPU::_POPAD);
-    build(0x62, "BOUND", OP_reg16_RM16, &CPU::_BOUND, "BOUND", OP_reg32_RM32, &CPU::_BOUND);
-    build(0x63, "ARPL", OP_RM16_reg16, &CPU::_ARPL);
-
-    build(0x68, "PUSH", OP_imm16, &CPU::_PUSH_imm16, OP_imm32, &CPU::_PUSH_imm32);
-    build(0x69, "IMUL", OP_reg16_RM16_imm16, &CPU::_IMUL_reg16_RM16_imm16, OP_reg32_RM32_imm32, &CPU::_IMUL_reg32_RM32_imm32);
-    build(0x6A, "PUSH", OP_imm8, &CPU::_PUSH_imm8);
-    build(0x6B, "IMUL", OP_reg16_RM16_imm8, &CPU::_IMUL_reg16_RM16_imm8, OP_reg32_RM32_imm8, &CPU::_IMUL_reg32_RM32_imm8);
-    build(0x6C, "INSB", OP, &CPU::_INSB);
-    build(0x6D, "INSW", OP, &CPU::_INSW, "INSD", OP, &CPU::_INSD);
-    build(0x6E, "OUTSB", OP, &CPU::_OUTSB);
-    build(0x6F, "OUTSW", OP, &CPU::_OUTSW, "OUTSD", OP, &CPU::_OUTSD);
-
-    build(0x70, "JO", OP_short_imm8, &CPU::_Jcc_imm8);
-    build(0x71, "JNO", OP_short_imm8, &CPU::_Jcc_imm8);
-    build(0x72, "JC", OP_short_imm8, &CPU::_Jcc_imm8);
-    build(0x73, "JNC", OP_short_imm8, &CPU::_Jcc_imm8);
-    build(0x74, "JZ", OP_short_imm8, &CPU::_Jcc_imm8);
-    build(0x75, "JNZ", OP_short_imm8, &CPU::_Jcc_imm8);
-    build(0x76, "JNA", OP_short_imm8, &CPU::_Jcc_imm8);
-    build(0x77, "JA", OP_short_imm8, &CPU::_Jcc_imm8);
-    build(0x78, "JS", OP_short_imm8, &CPU::_Jcc_imm8);
-    build(0x79, "JNS", OP_short_imm8, &CPU::_Jcc_imm8);
-    build(0x7A, "JP", OP_short_imm8, &CPU::_Jcc_imm8);
-    build(0x7B, "JNP", OP_short_imm8, &CPU::_Jcc_imm8);
-    build(0x7C, "JL", OP_short_imm8, &CPU::_Jcc_imm8);
-    build(0x7D, "JNL", OP_short_imm8, &CPU::_Jcc_imm8);
-    build(0x7E, "JNG", OP_short_imm8, &CPU::_Jcc_imm8);
-    build(0x7F, "JG", OP_short_imm8, &CPU::_Jcc_imm8);
-
-    build(0x84, "TEST", OP_RM8_reg8, &CPU::_TEST_RM8_reg8);
-    build(0x85, "TEST", OP_RM16_reg16, &CPU::_TEST_RM16_reg16, OP_RM32_reg32, &CPU::_TEST_RM32_reg32);
-    build(0x86, "XCHG", OP_reg8_RM8, &CPU::_XCHG_reg8_RM8, LockPrefixAllowed);
-    build(0x87, "XCHG", OP_reg16_RM16, &CPU::_XCHG_reg16_RM16, OP_reg32_RM32, &CPU::_XCHG_reg32_RM32, LockPrefixAllowed);
-    build(0x88, "MOV", OP_RM8_reg8, &CPU::_MOV_RM8_reg8);
-    build(0x89, "MOV", OP_RM16_reg16, &CPU::_MOV_RM16_reg16, OP_RM32_reg32, &CPU::_MOV_RM32_reg32);
-    build(0x8A, "MOV", OP_reg8_RM8, &CPU::_MOV_reg8_RM8);
-    build(0x8B, "MOV", OP_reg16_RM16, &CPU::_MOV_reg16_RM16, OP_reg32_RM32, &CPU::_MOV_reg32_RM32);
-    build(0x8C, "MOV", OP_RM16_seg, &CPU::_MOV_RM16_seg);
-    build(0x8D, "LEA", OP_reg16_mem16, &CPU::_LEA_reg16_mem16, OP_reg32_mem32, &CPU::_LEA_reg32_mem32);
-    build(0x8E, "MOV", OP_seg_RM16, &CPU::_MOV_seg_RM16, OP_seg_RM32, &CPU::_MOV_seg_RM32);
-
-    build(0x90, "NOP", OP, &CPU::_NOP);
+        build(0x58 + i, "POP", OP_reg16, IMPL(_POP_reg16), OP_reg32, IMPL(_POP_reg32));
+
+    build(0x60, "PUSHAW", OP, IMPL(_PUSHA), "PUSHAD", OP, IMPL(_PUSHAD));
+    build(0x61, "POPAW", OP, IMPL(_POPA), "POPAD", OP, IMPL(_POPAD));
+    build(0x62, "BOUND", OP_reg16_RM16, IMPL(_BOUND), "BOUND", OP_reg32_RM32, IMPL(_BOUND));
+    build(0x63, "ARPL", OP_RM16_reg16, IMPL(_ARPL));
+
+    build(0x68, "PUSH", OP_imm16, IMPL(_PUSH_imm16), OP_imm32, IMPL(_PUSH_imm32));
+    build(0x69, "IMUL", OP_reg16_RM16_imm16, IMPL(_IMUL_reg16_RM16_imm16), OP_reg32_RM32_imm32, IMPL(_IMUL_reg32_RM32_imm32));
+    build(0x6A, "PUSH", OP_imm8, IMPL(_PUSH_imm8));
+    build(0x6B, "IMUL", OP_reg16_RM16_imm8, IMPL(_IMUL_reg16_RM16_imm8), OP_reg32_RM32_imm8, IMPL(_IMUL_reg32_RM32_imm8));
+    build(0x6C, "INSB", OP, IMPL(_INSB));
+    build(0x6D, "INSW", OP, IMPL(_INSW), "INSD", OP, IMPL(_INSD));
+    build(0x6E, "OUTSB", OP, IMPL(_OUTSB));
+    build(0x6F, "OUTSW", OP, IMPL(_OUTSW), "OUTSD", OP, IMPL(_OUTSD));
+
+    build(0x70, "JO", OP_short_imm8, IMPL(_Jcc_imm8));
+    build(0x71, "JNO", OP_short_imm8, IMPL(_Jcc_imm8));
+    build(0x72, "JC", OP_short_imm8, IMPL(_Jcc_imm8));
+    build(0x73, "JNC", OP_short_imm8, IMPL(_Jcc_imm8));
+    build(0x74, "JZ", OP_short_imm8, IMPL(_Jcc_imm8));
+    build(0x75, "JNZ", OP_short_imm8, IMPL(_Jcc_imm8));
+    build(0x76, "JNA", OP_short_imm8, IMPL(_Jcc_imm8));
+    build(0x77, "JA", OP_short_imm8, IMPL(_Jcc_imm8));
+    build(0x78, "JS", OP_short_imm8, IMPL(_Jcc_imm8));
+    build(0x79, "JNS", OP_short_imm8, IMPL(_Jcc_imm8));
+    build(0x7A, "JP", OP_short_imm8, IMPL(_Jcc_imm8));
+    build(0x7B, "JNP", OP_short_imm8, IMPL(_Jcc_imm8));
+    build(0x7C, "JL", OP_short_imm8, IMPL(_Jcc_imm8));
+    build(0x7D, "JNL", OP_short_imm8, IMPL(_Jcc_imm8));
+    build(0x7E, "JNG", OP_short_imm8, IMPL(_Jcc_imm8));
+    build(0x7F, "JG", OP_short_imm8, IMPL(_Jcc_imm8));
+
+    build(0x84, "TEST", OP_RM8_reg8, IMPL(_TEST_RM8_reg8));
+    build(0x85, "TEST", OP_RM16_reg16, IMPL(_TEST_RM16_reg16), OP_RM32_reg32, IMPL(_TEST_RM32_reg32));
+    build(0x86, "XCHG", OP_reg8_RM8, IMPL(_XCHG_reg8_RM8), LockPrefixAllowed);
+    build(0x87, "XCHG", OP_reg16_RM16, IMPL(_XCHG_reg16_RM16), OP_reg32_RM32, IMPL(_XCHG_reg32_RM32), LockPrefixAllowed);
+    build(0x88, "MOV", OP_RM8_reg8, IMPL(_MOV_RM8_reg8));
+    build(0x89, "MOV", OP_RM16_reg16, IMPL(_MOV_RM16_reg16), OP_RM32_reg32, IMPL(_MOV_RM32_reg32));
+    build(0x8A, "MOV", OP_reg8_RM8, IMPL(_MOV_reg8_RM8));
+    build(0x8B, "MOV", OP_reg16_RM16, IMPL(_MOV_reg16_RM16), OP_reg32_RM32, IMPL(_MOV_reg32_RM32));
+    build(0x8C, "MOV", OP_RM16_seg, IMPL(_MOV_RM16_seg));
+    build(0x8D, "LEA", OP_reg16_mem16, IMPL(_LEA_reg16_mem16), OP_reg32_mem32, IMPL(_LEA_reg32_mem32));
+    build(0x8E, "MOV", OP_seg_RM16, IMPL(_MOV_seg_RM16), OP_seg_RM32, IMPL(_MOV_seg_RM32));
+
+    build(0x90, "NOP", OP, IMPL(_NOP));
 
     for (u8 i = 0; i <= 6; ++i)
-        build(0x91 + i, "XCHG", OP_AX_reg16, &CPU::_XCHG_AX_reg16, OP_EAX_reg32, &CPU::_XCHG_EAX_reg32);
-
-    build(0x98, "CBW", OP, &CPU::_CBW, "CWDE", OP, &CPU::_CWDE);
-    build(0x99, "CWD", OP, &CPU::_CWD, "CDQ", OP, &CPU::_CDQ);
-    build(0x9A, "CALL", OP_imm16_imm16, &CPU::_CALL_imm16_imm16, OP_imm16_imm32, &CPU::_CALL_imm16_imm32);
-    build(0x9B, "WAIT", OP, &CPU::_WAIT);
-    build(0x9C, "PUSHFW", OP, &CPU::_PUSHF, "PUSHFD", OP, &CPU::_PUSHFD);
-    build(0x9D, "POPFW", OP, &CPU::_POPF, "POPFD", OP, &CPU::_POPFD);
-    build(0x9E, "SAHF", OP, &CPU::_SAHF);
-    build(0x9F, "LAHF", OP, &CPU::_LAHF);
-
-    build(0xA0, "MOV", OP_AL_moff8, &CPU::_MOV_AL_moff8);
-    build(0xA1, "MOV", OP_AX_moff16, &CPU::_MOV_AX_moff16, OP_EAX_moff32, &CPU::_MOV_EAX_moff32);
-    build(0xA2, "MOV", OP_moff8_AL, &CPU::_MOV_moff8_AL);
-    build(0xA3, "MOV", OP_moff16_AX, &CPU::_MOV_moff16_AX, OP_moff32_EAX, &CPU::_MOV_moff32_EAX);
-    build(0xA4, "MOVSB", OP, &CPU::_MOVSB);
-    build(0xA5, "MOVSW", OP, &CPU::_MOVSW, "MOVSD", OP, &CPU::_MOVSD);
-    build(0xA6, "CMPSB", OP, &CPU::_CMPSB);
-    build(0xA7, "CMPSW", OP, &CPU::_CMPSW, "CMPSD", OP, &CPU::_CMPSD);
-    build(0xA8, "TEST", OP_AL_imm8, &CPU::_TEST_AL_imm8);
-    build(0xA9, "TEST", OP_AX_imm16, &CPU::_TEST_AX_imm16, OP_EAX_imm32, &CPU::_TEST_EAX_imm32);
-    build(0xAA, "STOSB", OP, &CPU::_STOSB);
-    build(0xAB, "STOSW", OP, &CPU::_STOSW, "STOSD", OP, &CPU::_STOSD);
-    build(0xAC, "LODSB", OP, &CPU::_LODSB);
-    build(0xAD, "LODSW", OP, &CPU::_LODSW, "LODSD", OP, &CPU::_LODSD);
-    build(0xAE, "SCASB", OP, &CPU::_SCASB);
-    build(0xAF, "SCASW", OP, &CPU::_SCASW, "SCASD", OP, &CPU::_SCASD);
+        build(0x91 + i, "XCHG", OP_AX_reg16, IMPL(_XCHG_AX_reg16), OP_EAX_reg32, IMPL(_XCHG_EAX_reg32));
+
+    build(0x98, "CBW", OP, IMPL(_CBW), "CWDE", OP, IMPL(_CWDE));
+    build(0x99, "CWD", OP, IMPL(_CWD), "CDQ", OP, IMPL(_CDQ));
+    build(0x9A, "CALL", OP_imm16_imm16, IMPL(_CALL_imm16_imm16), OP_imm16_imm32, IMPL(_CALL_imm16_imm32));
+    build(0x9B, "WAIT", OP, IMPL(_WAIT));
+    build(0x9C, "PUSHFW", OP, IMPL(_PUSHF), "PUSHFD", OP, IMPL(_PUSHFD));
+    build(0x9D, "POPFW", OP, IMPL(_POPF), "POPFD", OP, IMPL(_POPFD));
+    build(0x9E, "SAHF", OP, IMPL(_SAHF));
+    build(0x9F, "LAHF", OP, IMPL(_LAHF));
+
+    build(0xA0, "MOV", OP_AL_moff8, IMPL(_MOV_AL_moff8));
+    build(0xA1, "MOV", OP_AX_moff16, IMPL(_MOV_AX_moff16), OP_EAX_moff32, IMPL(_MOV_EAX_moff32));
+    build(0xA2, "MOV", OP_moff8_AL, IMPL(_MOV_moff8_AL));
+    build(0xA3, "MOV", OP_moff16_AX, IMPL(_MOV_moff16_AX), OP_moff32_EAX, IMPL(_MOV_moff32_EAX));
+    build(0xA4, "MOVSB", OP, IMPL(_MOVSB));
+    build(0xA5, "MOVSW", OP, IMPL(_MOVSW), "MOVSD", OP, IMPL(_MOVSD));
+    build(0xA6, "CMPSB", OP, IMPL(_CMPSB));
+    build(0xA7, "CMPSW", OP, IMPL(_CMPSW), "CMPSD", OP, IMPL(_CMPSD));
+    build(0xA8, "TEST", OP_AL_imm8, IMPL(_TEST_AL_imm8));
+    build(0xA9, "TEST", OP_AX_imm16, IMPL(_TEST_AX_imm16), OP_EAX_imm32, IMPL(_TEST_EAX_imm32));
+    build(0xAA, "STOSB", OP, IMPL(_STOSB));
+    build(0xAB, "STOSW", OP, IMPL(_STOSW), "STOSD", OP, IMPL(_STOSD));
+    build(0xAC, "LODSB", OP, IMPL(_LODSB));
+    build(0xAD, "LODSW", OP, IMPL(_LODSW), "LODSD", OP, IMPL(_LODSD));
+    build(0xAE, "SCASB", OP, IMPL(_SCASB));
+    build(0xAF, "SCASW", OP, IMPL(_SCASW), "SCASD", OP, IMPL(_SCASD));
 
     for (u8 i = 0xb0; i <= 0xb7; ++i)
-        build(i, "MOV", OP_reg8_imm8, &CPU::_MOV_reg8_imm8);
+        build(i, "MOV", OP_reg8_imm8, IMPL(_MOV_reg8_imm8));
 
     for (u8 i = 0xb8; i <= 0xbf; ++i)
-        build(i, "MOV", OP_reg16_imm16, &CPU::_MOV_reg16_imm16, OP_reg32_imm32, &CPU::_MOV_reg32_imm32);
-
-    build(0xC2, "RET", OP_imm16, &CPU::_RET_imm16);
-    build(0xC3, "RET", OP, &CPU::_RET);
-    build(0xC4, "LES", OP_reg16_mem16, &CPU::_LES_reg16_mem16, OP_reg32_mem32, &CPU::_LES_reg32_mem32);
-    build(0xC5, "LDS", OP_reg16_mem16, &CPU::_LDS_reg16_mem16, OP_reg32_mem32, &CPU::_LDS_reg32_mem32);
-    build(0xC6, "MOV", OP_RM8_imm8, &CPU::_MOV_RM8_imm8);
-    build(0xC7, "MOV", OP_RM16_imm16, &CPU::_MOV_RM16_imm16, OP_RM32_imm32, &CPU::_MOV_RM32_imm32);
-    build(0xC8, "ENTER", OP_imm8_imm16, &CPU::_ENTER16, OP_imm8_imm16, &CPU::_ENTER32);
-    build(0xC9, "LEAVE", OP, &CPU::_LEAVE16, OP, &CPU::_LEAVE32);
-    build(0xCA, "RETF", OP_imm16, &CPU::_RETF_imm16);
-    build(0xCB, "RETF", OP, &CPU::_RETF);
-    build(0xCC, "INT3", OP_3, &CPU::_INT3);
-    build(0xCD, "INT", OP_imm8, &CPU::_INT_imm8);
-    build(0xCE, "INTO", OP, &CPU::_INTO);
-    build(0xCF, "IRET", OP, &CPU::_IRET);
-
-    build(0xD4, "AAM", OP_imm8, &CPU::_AAM);
-    build(0xD5, "AAD", OP_imm8, &CPU::_AAD);
-    build(0xD6, "SALC", OP, &CPU::_SALC);
-    build(0xD7, "XLAT", OP, &CPU::_XLAT);
+        build(i, "MOV", OP_reg16_imm16, IMPL(_MOV_reg16_imm16), OP_reg32_imm32, IMPL(_MOV_reg32_imm32));
+
+    build(0xC2, "RET", OP_imm16, IMPL(_RET_imm16));
+    build(0xC3, "RET", OP, IMPL(_RET));
+    build(0xC4, "LES", OP_reg16_mem16, IMPL(_LES_reg16_mem16), OP_reg32_mem32, IMPL(_LES_reg32_mem32));
+    build(0xC5, "LDS", OP_reg16_mem16, IMPL(_LDS_reg16_mem16), OP_reg32_mem32, IMPL(_LDS_reg32_mem32));
+    build(0xC6, "MOV", OP_RM8_imm8, IMPL(_MOV_RM8_imm8));
+    build(0xC7, "MOV", OP_RM16_imm16, IMPL(_MOV_RM16_imm16), OP_RM32_imm32, IMPL(_MOV_RM32_imm32));
+    build(0xC8, "ENTER", OP_imm8_imm16, IMPL(_ENTER16), OP_imm8_imm16, IMPL(_ENTER32));
+    build(0xC9, "LEAVE", OP, IMPL(_LEAVE16), OP, IMPL(_LEAVE32));
+    build(0xCA, "RETF", OP_imm16, IMPL(_RETF_imm16));
+    build(0xCB, "RETF", OP, IMPL(_RETF));
+    build(0xCC, "INT3", OP_3, IMPL(_INT3));
+    build(0xCD, "INT", OP_imm8, IMPL(_INT_imm8));
+    build(0xCE, "INTO", OP, IMPL(_INTO));
+    build(0xCF, "IRET", OP, IMPL(_IRET));
+
+    build(0xD4, "AAM", OP_imm8, IMPL(_AAM));
+    build(0xD5, "AAD", OP_imm8, IMPL(_AAD));
+    build(0xD6, "SALC", OP, IMPL(_SALC));
+    build(0xD7, "XLAT", OP, IMPL(_XLAT));
 
     // FIXME: D8-DF == FPU
     for (u8 i = 0; i <= 7; ++i)
-        build(0xD8 + i, "FPU?", OP_RM8, &CPU::_ESCAPE);
-
-    build(0xE0, "LOOPNZ", OP_imm8, &CPU::_LOOPNZ_imm8);
-    build(0xE1, "LOOPZ", OP_imm8, &CPU::_LOOPZ_imm8);
-    build(0xE2, "LOOP", OP_imm8, &CPU::_LOOP_imm8);
-    build(0xE3, "JCXZ", OP_imm8, &CPU::_JCXZ_imm8);
-    build(0xE4, "IN", OP_AL_imm8, &CPU::_IN_AL_imm8);
-    build(0xE5, "IN", OP_AX_imm8, &CPU::_IN_AX_imm8, OP_EAX_imm8, &CPU::_IN_EAX_imm8);
-    build(0xE6, "OUT", OP_imm8_AL, &CPU::_OUT_imm8_AL);
-    build(0xE7, "OUT", OP_imm8_AX, &CPU::_OUT_imm8_AX, OP_imm8_EAX, &CPU::_OUT_imm8_EAX);
-    build(0xE8, "CALL", OP_relimm16, &CPU::_CALL_imm16, OP_relimm32, &CPU::_CALL_imm32);
-    build(0xE9, "JMP", OP_relimm16, &CPU::_JMP_imm16, OP_relimm32, &CPU::_JMP_imm32);
-    build(0xEA, "JMP", OP_imm16_imm16, &CPU::_JMP_imm16_imm16, OP_imm16_imm32, &CPU::_JMP_imm16_imm32);
-    build(0xEB, "JMP", OP_short_imm8, &CPU::_JMP_short_imm8);
-    build(0xEC, "IN", OP_AL_DX, &CPU::_IN_AL_DX);
-    build(0xED, "IN", OP_AX_DX, &CPU::_IN_AX_DX, OP_EAX_DX, &CPU::_IN_EAX_DX);
-    build(0xEE, "OUT", OP_DX_AL, &CPU::_OUT_DX_AL);
-    build(0xEF, "OUT", OP_DX_AX, &CPU::_OUT_DX_AX, OP_DX_EAX, &CPU::_OUT_DX_EAX);
-
-    build(0xF1, "VKILL", OP, &CPU::_VKILL);
-
-    build(0xF4, "HLT", OP, &CPU::_HLT);
-    build(0xF5, "CMC", OP, &CPU::_CMC);
-
-    build(0xF8, "CLC", OP, &CPU::_CLC);
-    build(0xF9, "STC", OP, &CPU::_STC);
-    build(0xFA, "CLI", OP, &CPU::_CLI);
-    build(0xFB, "STI", OP, &CPU::_STI);
-    build(0xFC, "CLD", OP, &CPU::_CLD);
-    build(0xFD, "STD", OP, &CPU::_STD);
-
-    build_slash(0x80, 0, "ADD", OP_RM8_imm8, &CPU::_ADD_RM8_imm8, LockPrefixAllowed);
-    build_slash(0x80, 1, "OR", OP_RM8_imm8, &CPU::_OR_RM8_imm8, LockPrefixAllowed);
-    build_slash(0x80, 2, "ADC", OP_RM8_imm8, &CPU::_ADC_RM8_imm8, LockPrefixAllowed);
-    build_slash(0x80, 3, "SBB", OP_RM8_imm8, &CPU::_SBB_RM8_imm8, LockPrefixAllowed);
-    build_slash(0x80, 4, "AND", OP_RM8_imm8, &CPU::_AND_RM8_imm8, LockPrefixAllowed);
-    build_slash(0x80, 5, "SUB", OP_RM8_imm8, &CPU::_SUB_RM8_imm8, LockPrefixAllowed);
-    build_slash(0x80, 6, "XOR", OP_RM8_imm8, &CPU::_XOR_RM8_imm8, LockPrefixAllowed);
-    build_slash(0x80, 7, "CMP", OP_RM8_imm8, &CPU::_CMP_RM8_imm8);
-
-    build_slash(0x81, 0, "ADD", OP_RM16_imm16, &CPU::_ADD_RM16_imm16, OP_RM32_imm32, &CPU::_ADD_RM32_imm32, LockPrefixAllowed);
-    build_slash(0x81, 1, "OR", OP_RM16_imm16, &CPU::_OR_RM16_imm16, OP_RM32_imm32, &CPU::_OR_RM32_imm32, LockPrefixAllowed);
-    build_slash(0x81, 2, "ADC", OP_RM16_imm16, &CPU::_ADC_RM16_imm16, OP_RM32_imm32, &CPU::_ADC_RM32_imm32, LockPrefixAllowed);
-    build_slash(0x81, 3, "SBB", OP_RM16_imm16, &CPU::_SBB_RM16_imm16, OP_RM32_imm32, &CPU::_SBB_RM32_imm32, LockPrefixAllowed);
-    build_slash(0x81, 4, "AND", OP_RM16_imm16, &CPU::_AND_RM16_imm16, OP_RM32_imm32, &CPU::_AND_RM32_imm32, LockPrefixAllowed);
-    build_slash(0x81, 5, "SUB", OP_RM16_imm16, &CPU::_SUB_RM16_imm16, OP_RM32_imm32, &CPU::_SUB_RM32_imm32, LockPrefixAllowed);
-    build_slash(0x81, 6, "XOR", OP_RM16_imm16, &CPU::_XOR_RM16_imm16, OP_RM32_imm32, &CPU::_XOR_RM32_imm32, LockPrefixAllowed);
-    build_slash(0x81, 7, "CMP", OP_RM16_imm16, &CPU::_CMP_RM16_imm16, OP_RM32_imm32, &CPU::_CMP_RM32_imm32);
-
-    build_slash(0x83, 0, "ADD", OP_RM16_imm8, &CPU::_ADD_RM16_imm8, OP_RM32_imm8, &CPU::_ADD_RM32_imm8, LockPrefixAllowed);
-    build_slash(0x83, 1, "OR", OP_RM16_imm8, &CPU::_OR_RM16_imm8, OP_RM32_imm8, &CPU::_OR_RM32_imm8, LockPrefixAllowed);
-    build_slash(0x83, 2, "ADC", OP_RM16_imm8, &CPU::_ADC_RM16_imm8, OP_RM32_imm8, &CPU::_ADC_RM32_imm8, LockPrefixAllowed);
-    build_slash(0x83, 3, "SBB", OP_RM16_imm8, &CPU::_SBB_RM16_imm8, OP_RM32_imm8, &CPU::_SBB_RM32_imm8, LockPrefixAllowed);
-    build_slash(0x83, 4, "AND", OP_RM16_imm8, &CPU::_AND_RM16_imm8, OP_RM32_imm8, &CPU::_AND_RM32_imm8, LockPrefixAllowed);
-    build_slash(0x83, 5, "SUB", OP_RM16_imm8, &CPU::_SUB_RM16_imm8, OP_RM32_imm8, &CPU::_SUB_RM32_imm8, LockPrefixAllowed);
-    build_slash(0x83, 6, "XOR", OP_RM16_imm8, &CPU::_XOR_RM16_imm8, OP_RM32_imm8, &CPU::_XOR_RM32_imm8, LockPrefixAllowed);
-    build_slash(0x83, 7, "CMP", OP_RM16_imm8, &CPU::_CMP_RM16_imm8, OP_RM32_imm8, &CPU::_CMP_RM32_imm8);
-
-    build_slash(0x8F, 0, "POP", OP_RM16, &CPU::_POP_RM16, OP_RM32, &CPU::_POP_RM32);
-
-    build_slash(0xC0, 0, "ROL", OP_RM8_imm8, &CPU::_ROL_RM8_imm8);
-    build_slash(0xC0, 1, "ROR", OP_RM8_imm8, &CPU::_ROR_RM8_imm8);
-    build_slash(0xC0, 2, "RCL", OP_RM8_imm8, &CPU::_RCL_RM8_imm8);
-    build_slash(0xC0, 3, "RCR", OP_RM8_imm8, &CPU::_RCR_RM8_imm8);
-    build_slash(0xC0, 4, "SHL", OP_RM8_imm8, &CPU::_SHL_RM8_imm8);
-    build_slash(0xC0, 5, "SHR", OP_RM8_imm8, &CPU::_SHR_RM8_imm8);
-    build_slash(0xC0, 6, "SHL", OP_RM8_imm8, &CPU::_SHL_RM8_imm8); // Undocumented
-    build_slash(0xC0, 7, "SAR", OP_RM8_imm8, &CPU::_SAR_RM8_imm8);
-
-    build_slash(0xC1, 0, "ROL", OP_RM16_imm8, &CPU::_ROL_RM16_imm8, OP_RM32_imm8, &CPU::_ROL_RM32_imm8);
-    build_slash(0xC1, 1, "ROR", OP_RM16_imm8, &CPU::_ROR_RM16_imm8, OP_RM32_imm8, &CPU::_ROR_RM32_imm8);
-    build_slash(0xC1, 2, "RCL", OP_RM16_imm8, &CPU::_RCL_RM16_imm8, OP_RM32_imm8, &CPU::_RCL_RM32_imm8);
-    build_slash(0xC1, 3, "RCR", OP_RM16_imm8, &CPU::_RCR_RM16_imm8, OP_RM32_imm8, &CPU::_RCR_RM32_imm8);
-    build_slash(0xC1, 4, "SHL", OP_RM16_imm8, &CPU::_SHL_RM16_imm8, OP_RM32_imm8, &CPU::_SHL_RM32_imm8);
-    build_slash(0xC1, 5, "SHR", OP_RM16_imm8, &CPU::_SHR_RM16_imm8, OP_RM32_imm8, &CPU::_SHR_RM32_imm8);
-    build_slash(0xC1, 6, "SHL", OP_RM16_imm8, &CPU::_SHL_RM16_imm8, OP_RM32_imm8, &CPU::_SHL_RM32_imm8); // Undocumented
-    build_slash(0xC1, 7, "SAR", OP_RM16_imm8, &CPU::_SAR_RM16_imm8, OP_RM32_imm8, &CPU::_SAR_RM32_imm8);
-
-    build_slash(0xD0, 0, "ROL", OP_RM8_1, &CPU::_ROL_RM8_1);
-    build_slash(0xD0, 1, "ROR", OP_RM8_1, &CPU::_ROR_RM8_1);
-    build_slash(0xD0, 2, "RCL", OP_RM8_1, &CPU::_RCL_RM8_1);
-    build_slash(0xD0, 3, "RCR", OP_RM8_1, &CPU::_RCR_RM8_1);
-    build_slash(0xD0, 4, "SHL", OP_RM8_1, &CPU::_SHL_RM8_1);
-    build_slash(0xD0, 5, "SHR", OP_RM8_1, &CPU::_SHR_RM8_1);
-    build_slash(0xD0, 6, "SHL", OP_RM8_1, &CPU::_SHL_RM8_1); // Undocumented
-    build_slash(0xD0, 7, "SAR", OP_RM8_1, &CPU::_SAR_RM8_1);
-
-    build_slash(0xD1, 0, "ROL", OP_RM16_1, &CPU::_ROL_RM16_1, OP_RM32_1, &CPU::_ROL_RM32_1);
-    build_slash(0xD1, 1, "ROR", OP_RM16_1, &CPU::_ROR_RM16_1, OP_RM32_1, &CPU::_ROR_RM32_1);
-    build_slash(0xD1, 2, "RCL", OP_RM16_1, &CPU::_RCL_RM16_1, OP_RM32_1, &CPU::_RCL_RM32_1);
-    build_slash(0xD1, 3, "RCR", OP_RM16_1, &CPU::_RCR_RM16_1, OP_RM32_1, &CPU::_RCR_RM32_1);
-    build_slash(0xD1, 4, "SHL", OP_RM16_1, &CPU::_SHL_RM16_1, OP_RM32_1, &CPU::_SHL_RM32_1);
-    build_slash(0xD1, 5, "SHR", OP_RM16_1, &CPU::_SHR_RM16_1, OP_RM32_1, &CPU::_SHR_RM32_1);
-    build_slash(0xD1, 6, "SHL", OP_RM16_1, &CPU::_SHL_RM16_1, OP_RM32_1, &CPU::_SHL_RM32_1); // Undocumented
-    build_slash(0xD1, 7, "SAR", OP_RM16_1, &CPU::_SAR_RM16_1, OP_RM32_1, &CPU::_SAR_RM32_1);
-
-    build_slash(0xD2, 0, "ROL", OP_RM8_CL, &CPU::_ROL_RM8_CL);
-    build_slash(0xD2, 1, "ROR", OP_RM8_CL, &CPU::_ROR_RM8_CL);
-    build_slash(0xD2, 2, "RCL", OP_RM8_CL, &CPU::_RCL_RM8_CL);
-    build_slash(0xD2, 3, "RCR", OP_RM8_CL, &CPU::_RCR_RM8_CL);
-    build_slash(0xD2, 4, "SHL", OP_RM8_CL, &CPU::_SHL_RM8_CL);
-    build_slash(0xD2, 5, "SHR", OP_RM8_CL, &CPU::_SHR_RM8_CL);
-    build_slash(0xD2, 6, "SHL", OP_RM8_CL, &CPU::_SHL_RM8_CL); // Undocumented
-    build_slash(0xD2, 7, "SAR", OP_RM8_CL, &CPU::_SAR_RM8_CL);
-
-    build_slash(0xD3, 0, "ROL", OP_RM16_CL, &CPU::_ROL_RM16_CL, OP_RM32_CL, &CPU::_ROL_RM32_CL);
-    build_slash(0xD3, 1, "ROR", OP_RM16_CL, &CPU::_ROR_RM16_CL, OP_RM32_CL, &CPU::_ROR_RM32_CL);
-    build_slash(0xD3, 2, "RCL", OP_RM16_CL, &CPU::_RCL_RM16_CL, OP_RM32_CL, &CPU::_RCL_RM32_CL);
-    build_slash(0xD3, 3, "RCR", OP_RM16_CL, &CPU::_RCR_RM16_CL, OP_RM32_CL, &CPU::_RCR_RM32_CL);
-    build_slash(0xD3, 4, "SHL", OP_RM16_CL, &CPU::_SHL_RM16_CL, OP_RM32_CL, &CPU::_SHL_RM32_CL);
-    build_slash(0xD3, 5, "SHR", OP_RM16_CL, &CPU::_SHR_RM16_CL, OP_RM32_CL, &CPU::_SHR_RM32_CL);
-    build_slash(0xD3, 6, "SHL", OP_RM16_CL, &CPU::_SHL_RM16_CL, OP_RM32_CL, &CPU::_SHL_RM32_CL); // Undocumented
-    build_slash(0xD3, 7, "SAR", OP_RM16_CL, &CPU::_SAR_RM16_CL, OP_RM32_CL, &CPU::_SAR_RM32_CL);
-
-    build_slash(0xF6, 0, "TEST", OP_RM8_imm8, &CPU::_TEST_RM8_imm8);
-    build_slash(0xF6, 1, "TEST", OP_RM8_imm8, &CPU::_TEST_RM8_imm8); // Undocumented
-    build_slash(0xF6, 2, "NOT", OP_RM8, &CPU::_NOT_RM8, LockPrefixAllowed);
-    build_slash(0xF6, 3, "NEG", OP_RM8, &CPU::_NEG_RM8, LockPrefixAllowed);
-    build_slash(0xF6, 4, "MUL", OP_RM8, &CPU::_MUL_RM8);
-    build_slash(0xF6, 5, "IMUL", OP_RM8, &CPU::_IMUL_RM8);
-    build_slash(0xF6, 6, "DIV", OP_RM8, &CPU::_DIV_RM8);
-    build_slash(0xF6, 7, "IDIV", OP_RM8, &CPU::_IDIV_RM8);
-
-    build_slash(0xF7, 0, "TEST", OP_RM16_imm16, &CPU::_TEST_RM16_imm16, OP_RM32_imm32, &CPU::_TEST_RM32_imm32);
-    build_slash(0xF7, 1, "TEST", OP_RM16_imm16, &CPU::_TEST_RM16_imm16, OP_RM32_imm32, &CPU::_TEST_RM32_imm32); // Undocumented
-    build_slash(0xF7, 2, "NOT", OP_RM16, &CPU::_NOT_RM16, OP_RM32, &CPU::_NOT_RM32, LockPrefixAllowed);
-    build_slash(0xF7, 3, "NEG", OP_RM16, &CPU::_NEG_RM16, OP_RM32, &CPU::_NEG_RM32, LockPrefixAllowed);
-    build_slash(0xF7, 4, "MUL", OP_RM16, &CPU::_MUL_RM16, OP_RM32, &CPU::_MUL_RM32);
-    build_slash(0xF7, 5, "IMUL", OP_RM16, &CPU::_IMUL_RM16, OP_RM32, &CPU::_IMUL_RM32);
-    build_slash(0xF7, 6, "DIV", OP_RM16, &CPU::_DIV_RM16, OP_RM32, &CPU::_DIV_RM32);
-    build_slash(0xF7, 7, "IDIV", OP_RM16, &CPU::_IDIV_RM16, OP_RM32, &CPU::_IDIV_RM32);
-
-    build_slash(0xFE, 0, "INC", OP_RM8, &CPU::_INC_RM8, LockPrefixAllowed);
-    build_slash(0xFE, 1, "DEC", OP_RM8, &CPU::_DEC_RM8, LockPrefixAllowed);
-
-    build_slash(0xFF, 0, "INC", OP_RM16, &CPU::_INC_RM16, OP_RM32, &CPU::_INC_RM32, LockPrefixAllowed);
-    build_slash(0xFF, 1, "DEC", OP_RM16, &CPU::_DEC_RM16, OP_RM32, &CPU::_DEC_RM32, LockPrefixAllowed);
-    build_slash(0xFF, 2, "CALL", OP_RM16, &CPU::_CALL_RM16, OP_RM32, &CPU::_CALL_RM32);
-    build_slash(0xFF, 3, "CALL", OP_FAR_mem16, &CPU::_CALL_FAR_mem16, OP_FAR_mem32, &CPU::_CALL_FAR_mem32);
-    build_slash(0xFF, 4, "JMP", OP_RM16, &CPU::_JMP_RM16, OP_RM32, &CPU::_JMP_RM32);
-    build_slash(0xFF, 5, "JMP", OP_FAR_mem16, &CPU::_JMP_FAR_mem16, OP_FAR_mem32, &CPU::_JMP_FAR_mem32);
-    build_slash(0xFF, 6, "PUSH", OP_RM16, &CPU::_PUSH_RM16, OP_RM32, &CPU::_PUSH_RM32);
+        build(0xD8 + i, "FPU?", OP_RM8, IMPL(_ESCAPE));
+
+    build(0xE0, "LOOPNZ", OP_imm8, IMPL(_LOOPNZ_imm8));
+    build(0xE1, "LOOPZ", OP_imm8, IMPL(_LOOPZ_imm8));
+    build(0xE2, "LOOP", OP_imm8, IMPL(_LOOP_imm8));
+    build(0xE3, "JCXZ", OP_imm8, IMPL(_JCXZ_imm8));
+    build(0xE4, "IN", OP_AL_imm8, IMPL(_IN_AL_imm8));
+    build(0xE5, "IN", OP_AX_imm8, IMPL(_IN_AX_imm8), OP_EAX_imm8, IMPL(_IN_EAX_imm8));
+    build(0xE6, "OUT", OP_imm8_AL, IMPL(_OUT_imm8_AL));
+    build(0xE7, "OUT", OP_imm8_AX, IMPL(_OUT_imm8_AX), OP_imm8_EAX, IMPL(_OUT_imm8_EAX));
+    build(0xE8, "CALL", OP_relimm16, IMPL(_CALL_imm16), OP_relimm32, IMPL(_CALL_imm32));
+    build(0xE9, "JMP", OP_relimm16, IMPL(_JMP_imm16), OP_relimm32, IMPL(_JMP_imm32));
+    build(0xEA, "JMP", OP_imm16_imm16, IMPL(_JMP_imm16_imm16), OP_imm16_imm32, IMPL(_JMP_imm16_imm32));
+    build(0xEB, "JMP", OP_short_imm8, IMPL(_JMP_short_imm8));
+    build(0xEC, "IN", OP_AL_DX, IMPL(_IN_AL_DX));
+    build(0xED, "IN", OP_AX_DX, IMPL(_IN_AX_DX), OP_EAX_DX, IMPL(_IN_EAX_DX));
+    build(0xEE, "OUT", OP_DX_AL, IMPL(_OUT_DX_AL));
+    build(0xEF, "OUT", OP_DX_AX, IMPL(_OUT_DX_AX), OP_DX_EAX, IMPL(_OUT_DX_EAX));
+
+    build(0xF1, "VKILL", OP, IMPL(_VKILL));
+
+    build(0xF4, "HLT", OP, IMPL(_HLT));
+    build(0xF5, "CMC", OP, IMPL(_CMC));
+
+    build(0xF8, "CLC", OP, IMPL(_CLC));
+    build(0xF9, "STC", OP, IMPL(_STC));
+    build(0xFA, "CLI", OP, IMPL(_CLI));
+    build(0xFB, "STI", OP, IMPL(_STI));
+    build(0xFC, "CLD", OP, IMPL(_CLD));
+    build(0xFD, "STD", OP, IMPL(_STD));
+
+    build_slash(0x80, 0, "ADD", OP_RM8_imm8, IMPL(_ADD_RM8_imm8), LockPrefixAllowed);
+    build_slash(0x80, 1, "OR", OP_RM8_imm8, IMPL(_OR_RM8_imm8), LockPrefixAllowed);
+    build_slash(0x80, 2, "ADC", OP_RM8_imm8, IMPL(_ADC_RM8_imm8), LockPrefixAllowed);
+    build_slash(0x80, 3, "SBB", OP_RM8_imm8, IMPL(_SBB_RM8_imm8), LockPrefixAllowed);
+    build_slash(0x80, 4, "AND", OP_RM8_imm8, IMPL(_AND_RM8_imm8), LockPrefixAllowed);
+    build_slash(0x80, 5, "SUB", OP_RM8_imm8, IMPL(_SUB_RM8_imm8), LockPrefixAllowed);
+    build_slash(0x80, 6, "XOR", OP_RM8_imm8, IMPL(_XOR_RM8_imm8), LockPrefixAllowed);
+    build_slash(0x80, 7, "CMP", OP_RM8_imm8, IMPL(_CMP_RM8_imm8));
+
+    build_slash(0x81, 0, "ADD", OP_RM16_imm16, IMPL(_ADD_RM16_imm16), OP_RM32_imm32, IMPL(_ADD_RM32_imm32), LockPrefixAllowed);
+    build_slash(0x81, 1, "OR", OP_RM16_imm16, IMPL(_OR_RM16_imm16), OP_RM32_imm32, IMPL(_OR_RM32_imm32), LockPrefixAllowed);
+    build_slash(0x81, 2, "ADC", OP_RM16_imm16, IMPL(_ADC_RM16_imm16), OP_RM32_imm32, IMPL(_ADC_RM32_imm32), LockPrefixAllowed);
+    build_slash(0x81, 3, "SBB", OP_RM16_imm16, IMPL(_SBB_RM16_imm16), OP_RM32_imm32, IMPL(_SBB_RM32_imm32), LockPrefixAllowed);
+    build_slash(0x81, 4, "AND", OP_RM16_imm16, IMPL(_AND_RM16_imm16), OP_RM32_imm32, IMPL(_AND_RM32_imm32), LockPrefixAllowed);
+    build_slash(0x81, 5, "SUB", OP_RM16_imm16, IMPL(_SUB_RM16_imm16), OP_RM32_imm32, IMPL(_SUB_RM32_imm32), LockPrefixAllowed);
+    build_slash(0x81, 6, "XOR", OP_RM16_imm16, IMPL(_XOR_RM16_imm16), OP_RM32_imm32, IMPL(_XOR_RM32_imm32), LockPrefixAllowed);
+    build_slash(0x81, 7, "CMP", OP_RM16_imm16, IMPL(_CMP_RM16_imm16), OP_RM32_imm32, IMPL(_CMP_RM32_imm32));
+
+    build_slash(0x83, 0, "ADD", OP_RM16_imm8, IMPL(_ADD_RM16_imm8), OP_RM32_imm8, IMPL(_ADD_RM32_imm8), LockPrefixAllowed);
+    build_slash(0x83, 1, "OR", OP_RM16_imm8, IMPL(_OR_RM16_imm8), OP_RM32_imm8, IMPL(_OR_RM32_imm8), LockPrefixAllowed);
+    build_slash(0x83, 2, "ADC", OP_RM16_imm8, IMPL(_ADC_RM16_imm8), OP_RM32_imm8, IMPL(_ADC_RM32_imm8), LockPrefixAllowed);
+    build_slash(0x83, 3, "SBB", OP_RM16_imm8, IMPL(_SBB_RM16_imm8), OP_RM32_imm8, IMPL(_SBB_RM32_imm8), LockPrefixAllowed);
+    build_slash(0x83, 4, "AND", OP_RM16_imm8, IMPL(_AND_RM16_imm8), OP_RM32_imm8, IMPL(_AND_RM32_imm8), LockPrefixAllowed);
+    build_slash(0x83, 5, "SUB", OP_RM16_imm8, IMPL(_SUB_RM16_imm8), OP_RM32_imm8, IMPL(_SUB_RM32_imm8), LockPrefixAllowed);
+    build_slash(0x83, 6, "XOR", OP_RM16_imm8, IMPL(_XOR_RM16_imm8), OP_RM32_imm8, IMPL(_XOR_RM32_imm8), LockPrefixAllowed);
+    build_slash(0x83, 7, "CMP", OP_RM16_imm8, IMPL(_CMP_RM16_imm8), OP_RM32_imm8, IMPL(_CMP_RM32_imm8));
+
+    build_slash(0x8F, 0, "POP", OP_RM16, IMPL(_POP_RM16), OP_RM32, IMPL(_POP_RM32));
+
+    build_slash(0xC0, 0, "ROL", OP_RM8_imm8, IMPL(_ROL_RM8_imm8));
+    build_slash(0xC0, 1, "ROR", OP_RM8_imm8, IMPL(_ROR_RM8_imm8));
+    build_slash(0xC0, 2, "RCL", OP_RM8_imm8, IMPL(_RCL_RM8_imm8));
+    build_slash(0xC0, 3, "RCR", OP_RM8_imm8, IMPL(_RCR_RM8_imm8));
+    build_slash(0xC0, 4, "SHL", OP_RM8_imm8, IMPL(_SHL_RM8_imm8));
+    build_slash(0xC0, 5, "SHR", OP_RM8_imm8, IMPL(_SHR_RM8_imm8));
+    build_slash(0xC0, 6, "SHL", OP_RM8_imm8, IMPL(_SHL_RM8_imm8)); // Undocumented
+    build_slash(0xC0, 7, "SAR", OP_RM8_imm8, IMPL(_SAR_RM8_imm8));
+
+    build_slash(0xC1, 0, "ROL", OP_RM16_imm8, IMPL(_ROL_RM16_imm8), OP_RM32_imm8, IMPL(_ROL_RM32_imm8));
+    build_slash(0xC1, 1, "ROR", OP_RM16_imm8, IMPL(_ROR_RM16_imm8), OP_RM32_imm8, IMPL(_ROR_RM32_imm8));
+    build_slash(0xC1, 2, "RCL", OP_RM16_imm8, IMPL(_RCL_RM16_imm8), OP_RM32_imm8, IMPL(_RCL_RM32_imm8));
+    build_slash(0xC1, 3, "RCR", OP_RM16_imm8, IMPL(_RCR_RM16_imm8), OP_RM32_imm8, IMPL(_RCR_RM32_imm8));
+    build_slash(0xC1, 4, "SHL", OP_RM16_imm8, IMPL(_SHL_RM16_imm8), OP_RM32_imm8, IMPL(_SHL_RM32_imm8));
+    build_slash(0xC1, 5, "SHR", OP_RM16_imm8, IMPL(_SHR_RM16_imm8), OP_RM32_imm8, IMPL(_SHR_RM32_imm8));
+    build_slash(0xC1, 6, "SHL", OP_RM16_imm8, IMPL(_SHL_RM16_imm8), OP_RM32_imm8, IMPL(_SHL_RM32_imm8)); // Undocumented
+    build_slash(0xC1, 7, "SAR", OP_RM16_imm8, IMPL(_SAR_RM16_imm8), OP_RM32_imm8, IMPL(_SAR_RM32_imm8));
+
+    build_slash(0xD0, 0, "ROL", OP_RM8_1, IMPL(_ROL_RM8_1));
+    build_slash(0xD0, 1, "ROR", OP_RM8_1, IMPL(_ROR_RM8_1));
+    build_slash(0xD0, 2, "RCL", OP_RM8_1, IMPL(_RCL_RM8_1));
+    build_slash(0xD0, 3, "RCR", OP_RM8_1, IMPL(_RCR_RM8_1));
+    build_slash(0xD0, 4, "SHL", OP_RM8_1, IMPL(_SHL_RM8_1));
+    build_slash(0xD0, 5, "SHR", OP_RM8_1, IMPL(_SHR_RM8_1));
+    build_slash(0xD0, 6, "SHL", OP_RM8_1, IMPL(_SHL_RM8_1)); // Undocumented
+    build_slash(0xD0, 7, "SAR", OP_RM8_1, IMPL(_SAR_RM8_1));
+
+    build_slash(0xD1, 0, "ROL", OP_RM16_1, IMPL(_ROL_RM16_1), OP_RM32_1, IMPL(_ROL_RM32_1));
+    build_slash(0xD1, 1, "ROR", OP_RM16_1, IMPL(_ROR_RM16_1), OP_RM32_1, IMPL(_ROR_RM32_1));
+    build_slash(0xD1, 2, "RCL", OP_RM16_1, IMPL(_RCL_RM16_1), OP_RM32_1, IMPL(_RCL_RM32_1));
+    build_slash(0xD1, 3, "RCR", OP_RM16_1, IMPL(_RCR_RM16_1), OP_RM32_1, IMPL(_RCR_RM32_1));
+    build_slash(0xD1, 4, "SHL", OP_RM16_1, IMPL(_SHL_RM16_1), OP_RM32_1, IMPL(_SHL_RM32_1));
+    build_slash(0xD1, 5, "SHR", OP_RM16_1, IMPL(_SHR_RM16_1), OP_RM32_1, IMPL(_SHR_RM32_1));
+    build_slash(0xD1, 6, "SHL", OP_RM16_1, IMPL(_SHL_RM16_1), OP_RM32_1, IMPL(_SHL_RM32_1)); // Undocumented
+    build_slash(0xD1, 7, "SAR", OP_RM16_1, IMPL(_SAR_RM16_1), OP_RM32_1, IMPL(_SAR_RM32_1));
+
+    build_slash(0xD2, 0, "ROL", OP_RM8_CL, IMPL(_ROL_RM8_CL));
+    build_slash(0xD2, 1, "ROR", OP_RM8_CL, IMPL(_ROR_RM8_CL));
+    build_slash(0xD2, 2, "RCL", OP_RM8_CL, IMPL(_RCL_RM8_CL));
+    build_slash(0xD2, 3, "RCR", OP_RM8_CL, IMPL(_RCR_RM8_CL));
+    build_slash(0xD2, 4, "SHL", OP_RM8_CL, IMPL(_SHL_RM8_CL));
+    build_slash(0xD2, 5, "SHR", OP_RM8_CL, IMPL(_SHR_RM8_CL));
+    build_slash(0xD2, 6, "SHL", OP_RM8_CL, IMPL(_SHL_RM8_CL)); // Undocumented
+    build_slash(0xD2, 7, "SAR", OP_RM8_CL, IMPL(_SAR_RM8_CL));
+
+    build_slash(0xD3, 0, "ROL", OP_RM16_CL, IMPL(_ROL_RM16_CL), OP_RM32_CL, IMPL(_ROL_RM32_CL));
+    build_slash(0xD3, 1, "ROR", OP_RM16_CL, IMPL(_ROR_RM16_CL), OP_RM32_CL, IMPL(_ROR_RM32_CL));
+    build_slash(0xD3, 2, "RCL", OP_RM16_CL, IMPL(_RCL_RM16_CL), OP_RM32_CL, IMPL(_RCL_RM32_CL));
+    build_slash(0xD3, 3, "RCR", OP_RM16_CL, IMPL(_RCR_RM16_CL), OP_RM32_CL, IMPL(_RCR_RM32_CL));
+    build_slash(0xD3, 4, "SHL", OP_RM16_CL, IMPL(_SHL_RM16_CL), OP_RM32_CL, IMPL(_SHL_RM32_CL));
+    build_slash(0xD3, 5, "SHR", OP_RM16_CL, IMPL(_SHR_RM16_CL), OP_RM32_CL, IMPL(_SHR_RM32_CL));
+    build_slash(0xD3, 6, "SHL", OP_RM16_CL, IMPL(_SHL_RM16_CL), OP_RM32_CL, IMPL(_SHL_RM32_CL)); // Undocumented
+    build_slash(0xD3, 7, "SAR", OP_RM16_CL, IMPL(_SAR_RM16_CL), OP_RM32_CL, IMPL(_SAR_RM32_CL));
+
+    build_slash(0xF6, 0, "TEST", OP_RM8_imm8, IMPL(_TEST_RM8_imm8));
+    build_slash(0xF6, 1, "TEST", OP_RM8_imm8, IMPL(_TEST_RM8_imm8)); // Undocumented
+    build_slash(0xF6, 2, "NOT", OP_RM8, IMPL(_NOT_RM8), LockPrefixAllowed);
+    build_slash(0xF6, 3, "NEG", OP_RM8, IMPL(_NEG_RM8), LockPrefixAllowed);
+    build_slash(0xF6, 4, "MUL", OP_RM8, IMPL(_MUL_RM8));
+    build_slash(0xF6, 5, "IMUL", OP_RM8, IMPL(_IMUL_RM8));
+    build_slash(0xF6, 6, "DIV", OP_RM8, IMPL(_DIV_RM8));
+    build_slash(0xF6, 7, "IDIV", OP_RM8, IMPL(_IDIV_RM8));
+
+    build_slash(0xF7, 0, "TEST", OP_RM16_imm16, IMPL(_TEST_RM16_imm16), OP_RM32_imm32, IMPL(_TEST_RM32_imm32));
+    build_slash(0xF7, 1, "TEST", OP_RM16_imm16, IMPL(_TEST_RM16_imm16), OP_RM32_imm32, IMPL(_TEST_RM32_imm32)); // Undocumented
+    build_slash(0xF7, 2, "NOT", OP_RM16, IMPL(_NOT_RM16), OP_RM32, IMPL(_NOT_RM32), LockPrefixAllowed);
+    build_slash(0xF7, 3, "NEG", OP_RM16, IMPL(_NEG_RM16), OP_RM32, IMPL(_NEG_RM32), LockPrefixAllowed);
+    build_slash(0xF7, 4, "MUL", OP_RM16, IMPL(_MUL_RM16), OP_RM32, IMPL(_MUL_RM32));
+    build_slash(0xF7, 5, "IMUL", OP_RM16, IMPL(_IMUL_RM16), OP_RM32, IMPL(_IMUL_RM32));
+    build_slash(0xF7, 6, "DIV", OP_RM16, IMPL(_DIV_RM16), OP_RM32, IMPL(_DIV_RM32));
+    build_slash(0xF7, 7, "IDIV", OP_RM16, IMPL(_IDIV_RM16), OP_RM32, IMPL(_IDIV_RM32));
+
+    build_slash(0xFE, 0, "INC", OP_RM8, IMPL(_INC_RM8), LockPrefixAllowed);
+    build_slash(0xFE, 1, "DEC", OP_RM8, IMPL(_DEC_RM8), LockPrefixAllowed);
+
+    build_slash(0xFF, 0, "INC", OP_RM16, IMPL(_INC_RM16), OP_RM32, IMPL(_INC_RM32), LockPrefixAllowed);
+    build_slash(0xFF, 1, "DEC", OP_RM16, IMPL(_DEC_RM16), OP_RM32, IMPL(_DEC_RM32), LockPrefixAllowed);
+    build_slash(0xFF, 2, "CALL", OP_RM16, IMPL(_CALL_RM16), OP_RM32, IMPL(_CALL_RM32));
+    build_slash(0xFF, 3, "CALL", OP_FAR_mem16, IMPL(_CALL_FAR_mem16), OP_FAR_mem32, IMPL(_CALL_FAR_mem32));
+    build_slash(0xFF, 4, "JMP", OP_RM16, IMPL(_JMP_RM16), OP_RM32, IMPL(_JMP_RM32));
+    build_slash(0xFF, 5, "JMP", OP_FAR_mem16, IMPL(_JMP_FAR_mem16), OP_FAR_mem32, IMPL(_JMP_FAR_mem32));
+    build_slash(0xFF, 6, "PUSH", OP_RM16, IMPL(_PUSH_RM16), OP_RM32, IMPL(_PUSH_RM32));
 
     // Instructions starting with 0x0F are multi-byte opcodes.
-    build_0f_slash(0x00, 0, "SLDT", OP_RM16, &CPU::_SLDT_RM16);
-    build_0f_slash(0x00, 1, "STR", OP_RM16, &CPU::_STR_RM16);
-    build_0f_slash(0x00, 2, "LLDT", OP_RM16, &CPU::_LLDT_RM16);
-    build_0f_slash(0x00, 3, "LTR", OP_RM16, &CPU::_LTR_RM16);
-    build_0f_slash(0x00, 4, "VERR", OP_RM16, &CPU::_VERR_RM16);
-    build_0f_slash(0x00, 5, "VERW", OP_RM16, &CPU::_VERW_RM16);
-
-    build_0f_slash(0x01, 0, "SGDT", OP_RM16, &CPU::_SGDT);
-    build_0f_slash(0x01, 1, "SIDT", OP_RM16, &CPU::_SIDT);
-    build_0f_slash(0x01, 2, "LGDT", OP_RM16, &CPU::_LGDT);
-    build_0f_slash(0x01, 3, "LIDT", OP_RM16, &CPU::_LIDT);
-    build_0f_slash(0x01, 4, "SMSW", OP_RM16, &CPU::_SMSW_RM16);
-    build_0f_slash(0x01, 6, "LMSW", OP_RM16, &CPU::_LMSW_RM16);
-    build_0f_slash(0x01, 7, "INVLPG", OP_RM32, &CPU::_INVLPG);
-
-    build_0f_slash(0xBA, 4, "BT", OP_RM16_imm8, &CPU::_BT_RM16_imm8, OP_RM32_imm8, &CPU::_BT_RM32_imm8, LockPrefixAllowed);
-    build_0f_slash(0xBA, 5, "BTS", OP_RM16_imm8, &CPU::_BTS_RM16_imm8, OP_RM32_imm8, &CPU::_BTS_RM32_imm8, LockPrefixAllowed);
-    build_0f_slash(0xBA, 6, "BTR", OP_RM16_imm8, &CPU::_BTR_RM16_imm8, OP_RM32_imm8, &CPU::_BTR_RM32_imm8, LockPrefixAllowed);
-    build_0f_slash(0xBA, 7, "BTC", OP_RM16_imm8, &CPU::_BTC_RM16_imm8, OP_RM32_imm8, &CPU::_BTC_RM32_imm8, LockPrefixAllowed);
-
-    build_0f(0x02, "LAR", OP_reg16_RM16, &CPU::_LAR_reg16_RM16, OP_reg32_RM32, &CPU::_LAR_reg32_RM32);
-    build_0f(0x03, "LSL", OP_reg16_RM16, &CPU::_LSL_reg16_RM16, OP_reg32_RM32, &CPU::_LSL_reg32_RM32);
-    build_0f(0x06, "CLTS", OP, &CPU::_CLTS);
-    build_0f(0x09, "WBINVD", OP, &CPU::_WBINVD);
-    build_0f(0x0B, "UD2", OP, &CPU::_UD2);
-
-    build_0f(0x1E, "NOP", OP_RM16, &CPU::_NOP);
-
-    build_0f(0x20, "MOV", OP_reg32_CR, &CPU::_MOV_reg32_CR);
-    build_0f(0x21, "MOV", OP_reg32_DR, &CPU::_MOV_reg32_DR);
-    build_0f(0x22, "MOV", OP_CR_reg32, &CPU::_MOV_CR_reg32);
-    build_0f(0x23, "MOV", OP_DR_reg32, &CPU::_MOV_DR_reg32);
-
-    build_0f(0x31, "RDTSC", OP, &CPU::_RDTSC);
-
-    build_0f(0x40, "CMOVO", OP_reg16_RM16, &CPU::_CMOVcc_reg16_RM16, OP_reg32_RM32, &CPU::_CMOVcc_reg32_RM32);
-    build_0f(0x41, "CMOVNO", OP_reg16_RM16, &CPU::_CMOVcc_reg16_RM16, OP_reg32_RM32, &CPU::_CMOVcc_reg32_RM32);
-    build_0f(0x42, "CMOVC", OP_reg16_RM16, &CPU::_CMOVcc_reg16_RM16, OP_reg32_RM32, &CPU::_CMOVcc_reg32_RM32);
-    build_0f(0x43, "CMOVNC", OP_reg16_RM16, &CPU::_CMOVcc_reg16_RM16, OP_reg32_RM32, &CPU::_CMOVcc_reg32_RM32);
-    build_0f(0x44, "CMOVZ", OP_reg16_RM16, &CPU::_CMOVcc_reg16_RM16, OP_reg32_RM32, &CPU::_CMOVcc_reg32_RM32);
-    build_0f(0x45, "CMOVNZ", OP_reg16_RM16, &CPU::_CMOVcc_reg16_RM16, OP_reg32_RM32, &CPU::_CMOVcc_reg32_RM32);
-    build_0f(0x46, "CMOVNA", OP_reg16_RM16, &CPU::_CMOVcc_reg16_RM16, OP_reg32_RM32, &CPU::_CMOVcc_reg32_RM32);
-    build_0f(0x47, "CMOVA", OP_reg16_RM16, &CPU::_CMOVcc_reg16_RM16, OP_reg32_RM32, &CPU::_CMOVcc_reg32_RM32);
-    build_0f(0x48, "CMOVS", OP_reg16_RM16, &CPU::_CMOVcc_reg16_RM16, OP_reg32_RM32, &CPU::_CMOVcc_reg32_RM32);
-    build_0f(0x49, "CMOVNS", OP_reg16_RM16, &CPU::_CMOVcc_reg16_RM16, OP_reg32_RM32, &CPU::_CMOVcc_reg32_RM32);
-    build_0f(0x4A, "CMOVP", OP_reg16_RM16, &CPU::_CMOVcc_reg16_RM16, OP_reg32_RM32, &CPU::_CMOVcc_reg32_RM32);
-    build_0f(0x4B, "CMOVNP", OP_reg16_RM16, &CPU::_CMOVcc_reg16_RM16, OP_reg32_RM32, &CPU::_CMOVcc_reg32_RM32);
-    build_0f(0x4C, "CMOVL", OP_reg16_RM16, &CPU::_CMOVcc_reg16_RM16, OP_reg32_RM32, &CPU::_CMOVcc_reg32_RM32);
-    build_0f(0x4D, "CMOVNL", OP_reg16_RM16, &CPU::_CMOVcc_reg16_RM16, OP_reg32_RM32, &CPU::_CMOVcc_reg32_RM32);
-    build_0f(0x4E, "CMOVNG", OP_reg16_RM16, &CPU::_CMOVcc_reg16_RM16, OP_reg32_RM32, &CPU::_CMOVcc_reg32_RM32);
-    build_0f(0x4F, "CMOVG", OP_reg16_RM16, &CPU::_CMOVcc_reg16_RM16, OP_reg32_RM32, &CPU::_CMOVcc_reg32_RM32);
-
-    build_0f(0x80, "JO", OP_NEAR_imm, &CPU::_Jcc_NEAR_imm);
-    build_0f(0x81, "JNO", OP_NEAR_imm, &CPU::_Jcc_NEAR_imm);
-    build_0f(0x82, "JC", OP_NEAR_imm, &CPU::_Jcc_NEAR_imm);
-    build_0f(0x83, "JNC", OP_NEAR_imm, &CPU::_Jcc_NEAR_imm);
-    build_0f(0x84, "JZ", OP_NEAR_imm, &CPU::_Jcc_NEAR_imm);
-    build_0f(0x85, "JNZ", OP_NEAR_imm, &CPU::_Jcc_NEAR_imm);
-    build_0f(0x86, "JNA", OP_NEAR_imm, &CPU::_Jcc_NEAR_imm);
-    build_0f(0x87, "JA", OP_NEAR_imm, &CPU::_Jcc_NEAR_imm);
-    build_0f(0x88, "JS", OP_NEAR_imm, &CPU::_Jcc_NEAR_imm);
-    build_0f(0x89, "JNS", OP_NEAR_imm, &CPU::_Jcc_NEAR_imm);
-    build_0f(0x8A, "JP", OP_NEAR_imm, &CPU::_Jcc_NEAR_imm);
-    build_0f(0x8B, "JNP", OP_NEAR_imm, &CPU::_Jcc_NEAR_imm);
-    build_0f(0x8C, "JL", OP_NEAR_imm, &CPU::_Jcc_NEAR_imm);
-    build_0f(0x8D, "JNL", OP_NEAR_imm, &CPU::_Jcc_NEAR_imm);
-    build_0f(0x8E, "JNG", OP_NEAR_imm, &CPU::_Jcc_NEAR_imm);
-    build_0f(0x8F, "JG", OP_NEAR_imm, &CPU::_Jcc_NEAR_imm);
-
-    build_0f(0x90, "SETO", OP_RM8, &CPU::_SETcc_RM8);
-    build_0f(0x91, "SETNO", OP_RM8, &CPU::_SETcc_RM8);
-    build_0f(0x92, "SETC", OP_RM8, &CPU::_SETcc_RM8);
-    build_0f(0x93, "SETNC", OP_RM8, &CPU::_SETcc_RM8);
-    build_0f(0x94, "SETZ", OP_RM8, &CPU::_SETcc_RM8);
-    build_0f(0x95, "SETNZ", OP_RM8, &CPU::_SETcc_RM8);
-    build_0f(0x96, "SETNA", OP_RM8, &CPU::_SETcc_RM8);
-    build_0f(0x97, "SETA", OP_RM8, &CPU::_SETcc_RM8);
-    build_0f(0x98, "SETS", OP_RM8, &CPU::_SETcc_RM8);
-    build_0f(0x99, "SETNS", OP_RM8, &CPU::_SETcc_RM8);
-    build_0f(0x9A, "SETP", OP_RM8, &CPU::_SETcc_RM8);
-    build_0f(0x9B, "SETNP", OP_RM8, &CPU::_SETcc_RM8);
-    build_0f(0x9C, "SETL", OP_RM8, &CPU::_SETcc_RM8);
-    build_0f(0x9D, "SETNL", OP_RM8, &CPU::_SETcc_RM8);
-    build_0f(0x9E, "SETNG", OP_RM8, &CPU::_SETcc_RM8);
-    build_0f(0x9F, "SETG", OP_RM8, &CPU::_SETcc_RM8);
-
-    build_0f(0xA0, "PUSH", OP_FS, &CPU::_PUSH_FS);
-    build_0f(0xA1, "POP", OP_FS, &CPU::_POP_FS);
-    build_0f(0xA2, "CPUID", OP, &CPU::_CPUID);
-    build_0f(0xA3, "BT", OP_RM16_reg16, &CPU::_BT_RM16_reg16, OP_RM32_reg32, &CPU::_BT_RM32_reg32);
-    build_0f(0xA4, "SHLD", OP_RM16_reg16_imm8, &CPU::_SHLD_RM16_reg16_imm8, OP_RM32_reg32_imm8, &CPU::_SHLD_RM32_reg32_imm8);
-    build_0f(0xA5, "SHLD", OP_RM16_reg16_CL, &CPU::_SHLD_RM16_reg16_CL, OP_RM32_reg32_CL, &CPU::_SHLD_RM32_reg32_CL);
-    build_0f(0xA8, "PUSH", OP_GS, &CPU::_PUSH_GS);
-    build_0f(0xA9, "POP", OP_GS, &CPU::_POP_GS);
-    build_0f(0xAB, "BTS", OP_RM16_reg16, &CPU::_BTS_RM16_reg16, OP_RM32_reg32, &CPU::_BTS_RM32_reg32);
-    build_0f(0xAC, "SHRD", OP_RM16_reg16_imm8, &CPU::_SHRD_RM16_reg16_imm8, OP_RM32_reg32_imm8, &CPU::_SHRD_RM32_reg32_imm8);
-    build_0f(0xAD, "SHRD", OP_RM16_reg16_CL, &CPU::_SHRD_RM16_reg16_CL, OP_RM32_reg32_CL, &CPU::_SHRD_RM32_reg32_CL);
-    build_0f(0xAF, "IMUL", OP_reg16_RM16, &CPU::_IMUL_reg16_RM16, OP_reg32_RM32, &CPU::_IMUL_reg32_RM32);
-    build_0f(0xB1, "CMPXCHG", OP_RM16_reg16, &CPU::_CMPXCHG_RM16_reg16, OP_RM32_reg32, &CPU::_CMPXCHG_RM32_reg32);
-    build_0f(0xB2, "LSS", OP_reg16_mem16, &CPU::_LSS_reg16_mem16, OP_reg32_mem32, &CPU::_LSS_reg32_mem32);
-    build_0f(0xB3, "BTR", OP_RM16_reg16, &CPU::_BTR_RM16_reg16, OP_RM32_reg32, &CPU::_BTR_RM32_reg32);
-    build_0f(0xB4, "LFS", OP_reg16_mem16, &CPU::_LFS_reg16_mem16, OP_reg32_mem32, &CPU::_LFS_reg32_mem32);
-    build_0f(0xB5, "LGS", OP_reg16_mem16, &CPU::_LGS_reg16_mem16, OP_reg32_mem32, &CPU::_LGS_reg32_mem32);
-    build_0f(0xB6, "MOVZX", OP_reg16_RM8, &CPU::_MOVZX_reg16_RM8, OP_reg32_RM8, &CPU::_MOVZX_reg32_RM8);
-    build_0f(0xB7, "0xB7", OP, nullptr, "MOVZX", OP_reg32_RM16, &CPU::_MOVZX_reg32_RM16);
-    build_0f(0xB9, "UD1", OP, &CPU::_UD1);
-    build_0f(0xBB, "BTC", OP_RM16_reg16, &CPU::_BTC_RM16_reg16, OP_RM32_reg32, &CPU::_BTC_RM32_reg32);
-    build_0f(0xBC, "BSF", OP_reg16_RM16, &CPU::_BSF_reg16_RM16, OP_reg32_RM32, &CPU::_BSF_reg32_RM32);
-    build_0f(0xBD, "BSR", OP_reg16_RM16, &CPU::_BSR_reg16_RM16, OP_reg32_RM32, &CPU::_BSR_reg32_RM32);
-    build_0f(0xBE, "MOVSX", OP_reg16_RM8, &CPU::_MOVSX_reg16_RM8, OP_reg32_RM8, &CPU::_MOVSX_reg32_RM8);
-    build_0f(0xBF, "0xBF", OP, nullptr, "MOVSX", OP_reg32_RM16, &CPU::_MOVSX_reg32_RM16);
-
-    build_0f(0xC0, "XADD", OP_RM8_reg8, &CPU::_XADD_RM8_reg8, LockPrefixAllowed);
-    build_0f(0xC1, "XADD", OP_RM16_reg16, &CPU::_XADD_RM16_reg16, OP_RM32_reg32, &CPU::_XADD_RM32_reg32, LockPrefixAllowed);
+    build_0f_slash(0x00, 0, "SLDT", OP_RM16, IMPL(_SLDT_RM16));
+    build_0f_slash(0x00, 1, "STR", OP_RM16, IMPL(_STR_RM16));
+    build_0f_slash(0x00, 2, "LLDT", OP_RM16, IMPL(_LLDT_RM16));
+    build_0f_slash(0x00, 3, "LTR", OP_RM16, IMPL(_LTR_RM16));
+    build_0f_slash(0x00, 4, "VERR", OP_RM16, IMPL(_VERR_RM16));
+    build_0f_slash(0x00, 5, "VERW", OP_RM16, IMPL(_VERW_RM16));
+
+    build_0f_slash(0x01, 0, "SGDT", OP_RM16, IMPL(_SGDT));
+    build_0f_slash(0x01, 1, "SIDT", OP_RM16, IMPL(_SIDT));
+    build_0f_slash(0x01, 2, "LGDT", OP_RM16, IMPL(_LGDT));
+    build_0f_slash(0x01, 3, "LIDT", OP_RM16, IMPL(_LIDT));
+    build_0f_slash(0x01, 4, "SMSW", OP_RM16, IMPL(_SMSW_RM16));
+    build_0f_slash(0x01, 6, "LMSW", OP_RM16, IMPL(_LMSW_RM16));
+    build_0f_slash(0x01, 7, "INVLPG", OP_RM32, IMPL(_INVLPG));
+
+    build_0f_slash(0xBA, 4, "BT", OP_RM16_imm8, IMPL(_BT_RM16_imm8), OP_RM32_imm8, IMPL(_BT_RM32_imm8), LockPrefixAllowed);
+    build_0f_slash(0xBA, 5, "BTS", OP_RM16_imm8, IMPL(_BTS_RM16_imm8), OP_RM32_imm8, IMPL(_BTS_RM32_imm8), LockPrefixAllowed);
+    build_0f_slash(0xBA, 6, "BTR", OP_RM16_imm8, IMPL(_BTR_RM16_imm8), OP_RM32_imm8, IMPL(_BTR_RM32_imm8), LockPrefixAllowed);
+    build_0f_slash(0xBA, 7, "BTC", OP_RM16_imm8, IMPL(_BTC_RM16_imm8), OP_RM32_imm8, IMPL(_BTC_RM32_imm8), LockPrefixAllowed);
+
+    build_0f(0x02, "LAR", OP_reg16_RM16, IMPL(_LAR_reg16_RM16), OP_reg32_RM32, IMPL(_LAR_reg32_RM32));
+    build_0f(0x03, "LSL", OP_reg16_RM16, IMPL(_LSL_reg16_RM16), OP_reg32_RM32, IMPL(_LSL_reg32_RM32));
+    build_0f(0x06, "CLTS", OP, IMPL(_CLTS));
+    build_0f(0x09, "WBINVD", OP, IMPL(_WBINVD));
+    build_0f(0x0B, "UD2", OP, IMPL(_UD2));
+
+    build_0f(0x1E, "NOP", OP_RM16, IMPL(_NOP));
+
+    build_0f(0x20, "MOV", OP_reg32_CR, IMPL(_MOV_reg32_CR));
+    build_0f(0x21, "MOV", OP_reg32_DR, IMPL(_MOV_reg32_DR));
+    build_0f(0x22, "MOV", OP_CR_reg32, IMPL(_MOV_CR_reg32));
+    build_0f(0x23, "MOV", OP_DR_reg32, IMPL(_MOV_DR_reg32));
+
+    build_0f(0x31, "RDTSC", OP, IMPL(_RDTSC));
+
+    build_0f(0x40, "CMOVO", OP_reg16_RM16, IMPL(_CMOVcc_reg16_RM16), OP_reg32_RM32, IMPL(_CMOVcc_reg32_RM32));
+    build_0f(0x41, "CMOVNO", OP_reg16_RM16, IMPL(_CMOVcc_reg16_RM16), OP_reg32_RM32, IMPL(_CMOVcc_reg32_RM32));
+    build_0f(0x42, "CMOVC", OP_reg16_RM16, IMPL(_CMOVcc_reg16_RM16), OP_reg32_RM32, IMPL(_CMOVcc_reg32_RM32));
+    build_0f(0x43, "CMOVNC", OP_reg16_RM16, IMPL(_CMOVcc_reg16_RM16), OP_reg32_RM32, IMPL(_CMOVcc_reg32_RM32));
+    build_0f(0x44, "CMOVZ", OP_reg16_RM16, IMPL(_CMOVcc_reg16_RM16), OP_reg32_RM32, IMPL(_CMOVcc_reg32_RM32));
+    build_0f(0x45, "CMOVNZ", OP_reg16_RM16, IMPL(_CMOVcc_reg16_RM16), OP_reg32_RM32, IMPL(_CMOVcc_reg32_RM32));
+    build_0f(0x46, "CMOVNA", OP_reg16_RM16, IMPL(_CMOVcc_reg16_RM16), OP_reg32_RM32, IMPL(_CMOVcc_reg32_RM32));
+    build_0f(0x47, "CMOVA", OP_reg16_RM16, IMPL(_CMOVcc_reg16_RM16), OP_reg32_RM32, IMPL(_CMOVcc_reg32_RM32));
+    build_0f(0x48, "CMOVS", OP_reg16_RM16, IMPL(_CMOVcc_reg16_RM16), OP_reg32_RM32, IMPL(_CMOVcc_reg32_RM32));
+    build_0f(0x49, "CMOVNS", OP_reg16_RM16, IMPL(_CMOVcc_reg16_RM16), OP_reg32_RM32, IMPL(_CMOVcc_reg32_RM32));
+    build_0f(0x4A, "CMOVP", OP_reg16_RM16, IMPL(_CMOVcc_reg16_RM16), OP_reg32_RM32, IMPL(_CMOVcc_reg32_RM32));
+    build_0f(0x4B, "CMOVNP", OP_reg16_RM16, IMPL(_CMOVcc_reg16_RM16), OP_reg32_RM32, IMPL(_CMOVcc_reg32_RM32));
+    build_0f(0x4C, "CMOVL", OP_reg16_RM16, IMPL(_CMOVcc_reg16_RM16), OP_reg32_RM32, IMPL(_CMOVcc_reg32_RM32));
+    build_0f(0x4D, "CMOVNL", OP_reg16_RM16, IMPL(_CMOVcc_reg16_RM16), OP_reg32_RM32, IMPL(_CMOVcc_reg32_RM32));
+    build_0f(0x4E, "CMOVNG", OP_reg16_RM16, IMPL(_CMOVcc_reg16_RM16), OP_reg32_RM32, IMPL(_CMOVcc_reg32_RM32));
+    build_0f(0x4F, "CMOVG", OP_reg16_RM16, IMPL(_CMOVcc_reg16_RM16), OP_reg32_RM32, IMPL(_CMOVcc_reg32_RM32));
+
+    build_0f(0x80, "JO", OP_NEAR_imm, IMPL(_Jcc_NEAR_imm));
+    build_0f(0x81, "JNO", OP_NEAR_imm, IMPL(_Jcc_NEAR_imm));
+    build_0f(0x82, "JC", OP_NEAR_imm, IMPL(_Jcc_NEAR_imm));
+    build_0f(0x83, "JNC", OP_NEAR_imm, IMPL(_Jcc_NEAR_imm));
+    build_0f(0x84, "JZ", OP_NEAR_imm, IMPL(_Jcc_NEAR_imm));
+    build_0f(0x85, "JNZ", OP_NEAR_imm, IMPL(_Jcc_NEAR_imm));
+    build_0f(0x86, "JNA", OP_NEAR_imm, IMPL(_Jcc_NEAR_imm));
+    build_0f(0x87, "JA", OP_NEAR_imm, IMPL(_Jcc_NEAR_imm));
+    build_0f(0x88, "JS", OP_NEAR_imm, IMPL(_Jcc_NEAR_imm));
+    build_0f(0x89, "JNS", OP_NEAR_imm, IMPL(_Jcc_NEAR_imm));
+    build_0f(0x8A, "JP", OP_NEAR_imm, IMPL(_Jcc_NEAR_imm));
+    build_0f(0x8B, "JNP", OP_NEAR_imm, IMPL(_Jcc_NEAR_imm));
+    build_0f(0x8C, "JL", OP_NEAR_imm, IMPL(_Jcc_NEAR_imm));
+    build_0f(0x8D, "JNL", OP_NEAR_imm, IMPL(_Jcc_NEAR_imm));
+    build_0f(0x8E, "JNG", OP_NEAR_imm, IMPL(_Jcc_NEAR_imm));
+    build_0f(0x8F, "JG", OP_NEAR_imm, IMPL(_Jcc_NEAR_imm));
+
+    build_0f(0x90, "SETO", OP_RM8, IMPL(_SETcc_RM8));
+    build_0f(0x91, "SETNO", OP_RM8, IMPL(_SETcc_RM8));
+    build_0f(0x92, "SETC", OP_RM8, IMPL(_SETcc_RM8));
+    build_0f(0x93, "SETNC", OP_RM8, IMPL(_SETcc_RM8));
+    build_0f(0x94, "SETZ", OP_RM8, IMPL(_SETcc_RM8));
+    build_0f(0x95, "SETNZ", OP_RM8, IMPL(_SETcc_RM8));
+    build_0f(0x96, "SETNA", OP_RM8, IMPL(_SETcc_RM8));
+    build_0f(0x97, "SETA", OP_RM8, IMPL(_SETcc_RM8));
+    build_0f(0x98, "SETS", OP_RM8, IMPL(_SETcc_RM8));
+    build_0f(0x99, "SETNS", OP_RM8, IMPL(_SETcc_RM8));
+    build_0f(0x9A, "SETP", OP_RM8, IMPL(_SETcc_RM8));
+    build_0f(0x9B, "SETNP", OP_RM8, IMPL(_SETcc_RM8));
+    build_0f(0x9C, "SETL", OP_RM8, IMPL(_SETcc_RM8));
+    build_0f(0x9D, "SETNL", OP_RM8, IMPL(_SETcc_RM8));
+    build_0f(0x9E, "SETNG", OP_RM8, IMPL(_SETcc_RM8));
+    build_0f(0x9F, "SETG", OP_RM8, IMPL(_SETcc_RM8));
+
+    build_0f(0xA0, "PUSH", OP_FS, IMPL(_PUSH_FS));
+    build_0f(0xA1, "POP", OP_FS, IMPL(_POP_FS));
+    build_0f(0xA2, "CPUID", OP, IMPL(_CPUID));
+    build_0f(0xA3, "BT", OP_RM16_reg16, IMPL(_BT_RM16_reg16), OP_RM32_reg32, IMPL(_BT_RM32_reg32));
+    build_0f(0xA4, "SHLD", OP_RM16_reg16_imm8, IMPL(_SHLD_RM16_reg16_imm8), OP_RM32_reg32_imm8, IMPL(_SHLD_RM32_reg32_imm8));
+    build_0f(0xA5, "SHLD", OP_RM16_reg16_CL, IMPL(_SHLD_RM16_reg16_CL), OP_RM32_reg32_CL, IMPL(_SHLD_RM32_reg32_CL));
+    build_0f(0xA8, "PUSH", OP_GS, IMPL(_PUSH_GS));
+    build_0f(0xA9, "POP", OP_GS, IMPL(_POP_GS));
+    build_0f(0xAB, "BTS", OP_RM16_reg16, IMPL(_BTS_RM16_reg16), OP_RM32_reg32, IMPL(_BTS_RM32_reg32));
+    build_0f(0xAC, "SHRD", OP_RM16_reg16_imm8, IMPL(_SHRD_RM16_reg16_imm8), OP_RM32_reg32_imm8, IMPL(_SHRD_RM32_reg32_imm8));
+    build_0f(0xAD, "SHRD", OP_RM16_reg16_CL, IMPL(_SHRD_RM16_reg16_CL), OP_RM32_reg32_CL, IMPL(_SHRD_RM32_reg32_CL));
+    build_0f(0xAF, "IMUL", OP_reg16_RM16, IMPL(_IMUL_reg16_RM16), OP_reg32_RM32, IMPL(_IMUL_reg32_RM32));
+    build_0f(0xB1, "CMPXCHG", OP_RM16_reg16, IMPL(_CMPXCHG_RM16_reg16), OP_RM32_reg32, IMPL(_CMPXCHG_RM32_reg32));
+    build_0f(0xB2, "LSS", OP_reg16_mem16, IMPL(_LSS_reg16_mem16), OP_reg32_mem32, IMPL(_LSS_reg32_mem32));
+    build_0f(0xB3, "BTR", OP_RM16_reg16, IMPL(_BTR_RM16_reg16), OP_RM32_reg32, IMPL(_BTR_RM32_reg32));
+    build_0f(0xB4, "LFS", OP_reg16_mem16, IMPL(_LFS_reg16_mem16), OP_reg32_mem32, IMPL(_LFS_reg32_mem32));
+    build_0f(0xB5, "LGS", OP_reg16_mem16, IMPL(_LGS_reg16_mem16), OP_reg32_mem32, IMPL(_LGS_reg32_mem32));
+    build_0f(0xB6, "MOVZX", OP_reg16_RM8, IMPL(_MOVZX_reg16_RM8), OP_reg32_RM8, IMPL(_MOVZX_reg32_RM8));
+    build_0f(0xB7, nullptr, OP, nullptr, "MOVZX", OP_reg32_RM16, IMPL(_MOVZX_reg32_RM16));
+    build_0f(0xB9, "UD1", OP, IMPL(_UD1));
+    build_0f(0xBB, "BTC", OP_RM16_reg16, IMPL(_BTC_RM16_reg16), OP_RM32_reg32, IMPL(_BTC_RM32_reg32));
+    build_0f(0xBC, "BSF", OP_reg16_RM16, IMPL(_BSF_reg16_RM16), OP_reg32_RM32, IMPL(_BSF_reg32_RM32));
+    build_0f(0xBD, "BSR", OP_reg16_RM16, IMPL(_BSR_reg16_RM16), OP_reg32_RM32, IMPL(_BSR_reg32_RM32));
+    build_0f(0xBE, "MOVSX", OP_reg16_RM8, IMPL(_MOVSX_reg16_RM8), OP_reg32_RM8, IMPL(_MOVSX_reg32_RM8));
+    build_0f(0xBF, nullptr, OP, nullptr, "MOVSX", OP_reg32_RM16, IMPL(_MOVSX_reg32_RM16));
+
+    build_0f(0xC0, "XADD", OP_RM8_reg8, IMPL(_XADD_RM8_reg8), LockPrefixAllowed);
+    build_0f(0xC1, "XADD", OP_RM16_reg16, IMPL(_XADD_RM16_reg16), OP_RM32_reg32, IMPL(_XADD_RM32_reg32), LockPrefixAllowed);
 
     for (u8 i = 0xc8; i <= 0xcf; ++i)
-        build_0f(i, "BSWAP", OP_reg32, &CPU::_BSWAP_reg32);
+        build_0f(i, "BSWAP", OP_reg32, IMPL(_BSWAP_reg32));
+
+    build_0f(0xFF, "UD0", OP, IMPL(_UD0));
 
-    build_0f(0xFF, "UD0", OP, &CPU::_UD0);
+    assign_opcode_indices();
 
     has_built_tables = true;
 }
@@ -932,7 +1013,7 @@ ALWAYS_INLINE Instruction::Instruction(InstructionStream& stream, bool o32, bool
         m_descriptor = &m_descriptor->slashes[slash()];
     }
 
-    if (UNLIKELY(!m_descriptor->impl)) {
+    if (UNLIKELY(!m_descriptor->mnemonic)) {
         if (m_has_sub_op) {
             if (has_slash)
                 vlog(LogCPU, "Instruction %02X %02X /%u not understood", m_op, m_sub_op, slash());
@@ -1492,3 +1573,96 @@ u32 SimpleInstructionStream::read_instruction32()
     u16 msw = read_instruction16();
     return weld<u32>(msw, lsw);
 }
+
+const char* CPU::register_name(SegmentRegisterIndex index)
+{
+    switch (index) {
+    case SegmentRegisterIndex::CS:
+        return "cs";
+    case SegmentRegisterIndex::DS:
+        return "ds";
+    case SegmentRegisterIndex::ES:
+        return "es";
+    case SegmentRegisterIndex::SS:
+        return "ss";
+    case SegmentRegisterIndex::FS:
+        return "fs";
+    case SegmentRegisterIndex::GS:
+        return "gs";
+    default:
+        ASSERT_NOT_REACHED();
+        return nullptr;
+    }
+}
+
+const char* CPU::register_name(CPU::RegisterIndex8 register_index)
+{
+    switch (register_index) {
+    case CPU::RegisterAL:
+        return "al";
+    case CPU::RegisterBL:
+        return "bl";
+    case CPU::RegisterCL:
+        return "cl";
+    case CPU::RegisterDL:
+        return "dl";
+    case CPU::RegisterAH:
+        return "ah";
+    case CPU::RegisterBH:
+        return "bh";
+    case CPU::RegisterCH:
+        return "ch";
+    case CPU::RegisterDH:
+        return "dh";
+    }
+    ASSERT_NOT_REACHED();
+    return nullptr;
+}
+
+const char* CPU::register_name(CPU::RegisterIndex16 register_index)
+{
+    switch (register_index) {
+    case CPU::RegisterAX:
+        return "ax";
+    case CPU::RegisterBX:
+        return "bx";
+    case CPU::RegisterCX:
+        return "cx";
+    case CPU::RegisterDX:
+        return "dx";
+    case CPU::RegisterBP:
+        return "bp";
+    case CPU::RegisterSP:
+        return "sp";
+    case CPU::RegisterSI:
+        return "si";
+    case CPU::RegisterDI:
+        return "di";
+    }
+    ASSERT_NOT_REACHED();
+    return nullptr;
+}
+
+const char* CPU::register_name(CPU::RegisterIndex32 register_index)
+{
+    switch (register_index) {
+    case CPU::RegisterEAX:
+        return "eax";
+    case CPU::RegisterEBX:
+        return "ebx";
+    case CPU::RegisterECX:
+        return "ecx";
+    case CPU::RegisterEDX:
+        return "edx";
+    case CPU::RegisterEBP:
+        return "ebp";
+    case CPU::RegisterESP:
+        return "esp";
+    case CPU::RegisterESI:
+        return "esi";
+    case CPU::RegisterEDI:
+        return "edi";
+    }
+    ASSERT_NOT_REACHED();
+    return nullptr;
+}
@@ -253,6 +253,9 @@ public:
 
     QString to_string(u32 origin, bool x32) const;
 
+    // Dense index of this instruction's entry in the opcode tables, see opcode_info().
+    unsigned opcode_index() const;
+
 private:
     Instruction(InstructionStream&, bool o32, bool a32);
 
@@ -310,3 +313,20 @@ inline MemoryOrRegisterReference::Accessor<u16> MemoryOrRegisterReference::acces
 inline MemoryOrRegisterReference::Accessor<u32> MemoryOrRegisterReference::accessor32() { return Accessor<u32>(*this); }
 
 void build_opcode_tables_if_needed();
+
+// One entry per implemented opcode, sub-opcode and slash, for each operand size.
+struct OpcodeInfo {
+    static const u8 no_slash = 0xff;
+
+    const char* mnemonic { nullptr };
+    u8 op { 0 };
+    bool has_sub_op { false };
+    u8 sub_op { 0 };
+    u8 slash { no_slash };
+    bool o32 { false };
+
+    QString to_string() const;
+};
+
+unsigned opcode_count();
+const OpcodeInfo& opcode_info(unsigned index);
@@ -0,0 +1,118 @@
+// Computron x86 PC Emulator
+// Copyright (C) 2003-2020 Andreas Kling <kling@serenityos.org>
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY ANDREAS KLING ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL ANDREAS KLING OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "OpcodeProfiler.h"
+#include "Instruction.h"
+#include <QFile>
+#include <algorithm>
+#include <stdio.h>
+
+OpcodeProfiler::OpcodeProfiler()
+    : m_entries(opcode_count())
+{
+}
+
+OpcodeProfiler::~OpcodeProfiler()
+{
+}
+
+void OpcodeProfiler::reset()
+{
+    m_entries.fill(Entry());
+}
+
+QVector<unsigned> OpcodeProfiler::sorted_by_count() const
+{
+    QVector<unsigned> indices;
+    for (unsigned i = 0; i < (unsigned)m_entries.size(); ++i) {
+        if (m_entries[i].count)
+            indices.append(i);
+    }
+    std::sort(indices.begin(), indices.end(), [this](unsigned a, unsigned b) {
+        return m_entries[a].count > m_entries[b].count;
+    });
+    return indices;
+}
+
+void OpcodeProfiler::dump_top(int count) const
+{
+    u64 total_count = 0;
+    u64 total_host_cycles = 0;
+    for (auto& entry : m_entries) {
+        total_count += entry.count;
+        total_host_cycles += entry.host_cycles;
+    }
+
+    if (!total_count) {
+        printf("No instructions profiled\n");
+        return;
+    }
+
+    auto indices = sorted_by_count();
+    printf("%-10s %-8s %3s %14s %7s", "Opcode", "Mnemonic", "OS", "Count", "%");
+    if (m_measures_host_cycles)
+        printf(" %16s %7s %10s", "Host cycles", "%", "Per insn");
+    printf("\n");
+
+    for (int i = 0; i < indices.size() && i < count; ++i) {
+        auto& info = opcode_info(indices[i]);
+        auto& entry = m_entries[indices[i]];
+        printf("%-10s %-8s %3u %14llu %6.2f%%",
+            qPrintable(info.to_string()),
+            info.mnemonic,
+            info.o32 ? 32 : 16,
+            (unsigned long long)entry.count,
+            entry.count * 100.0 / total_count);
+        if (m_measures_host_cycles) {
+            printf(" %16llu %6.2f%% %10.1f",
+                (unsigned long long)entry.host_cycles,
+                total_host_cycles ? entry.host_cycles * 100.0 / total_host_cycles : 0.0,
+                (double)entry.host_cycles / entry.count);
+        }
+        printf("\n");
+    }
+
+    printf("%llu instructions, %d distinct opcodes\n", (unsigned long long)total_count, indices.size());
+}
+
+bool OpcodeProfiler::write_csv(const QString& path) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    file.write("opcode,mnemonic,operand_size,count,host_cycles\n");
+    for (unsigned index : sorted_by_count()) {
+        auto& info = opcode_info(index);
+        auto& entry = m_entries[index];
+        file.write(QString("%1,%2,%3,%4,%5\n")
+                       .arg(info.to_string())
+                       .arg(QString::fromLatin1(info.mnemonic))
+                       .arg(info.o32 ? 32 : 16)
+                       .arg(entry.count)
+                       .arg(entry.host_cycles)
+                       .toLatin1());
+    }
+    return true;
+}
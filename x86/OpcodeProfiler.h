@@ -0,0 +1,73 @@
+// Computron x86 PC Emulator
+// Copyright (C) 2003-2020 Andreas Kling <kling@serenityos.org>
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY ANDREAS KLING ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL ANDREAS KLING OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "Common.h"
+#include "types.h"
+#include <QString>
+#include <QVector>
+
+#if defined(__i386__) || defined(__x86_64__)
+#    include <x86intrin.h>
+#else
+#    include <chrono>
+#endif
+
+// Counts executions (and optionally host cycles spent) per entry in the opcode tables.
+class OpcodeProfiler {
+public:
+    struct Entry {
+        u64 count { 0 };
+        u64 host_cycles { 0 };
+    };
+
+    OpcodeProfiler();
+    ~OpcodeProfiler();
+
+    bool measures_host_cycles() const { return m_measures_host_cycles; }
+    void set_measures_host_cycles(bool b) { m_measures_host_cycles = b; }
+
+    Entry& entry(unsigned opcode_index) { return m_entries[opcode_index]; }
+
+    void reset();
+
+    void dump_top(int count) const;
+    bool write_csv(const QString& path) const;
+
+    static ALWAYS_INLINE u64 read_host_cycle_counter()
+    {
+#if defined(__i386__) || defined(__x86_64__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+private:
+    QVector<unsigned> sorted_by_count() const;
+
+    QVector<Entry> m_entries;
+    bool m_measures_host_cycles { false };
+};
@@ -0,0 +1,228 @@
+// Computron x86 PC Emulator
+// Copyright (C) 2003-2020 Andreas Kling <kling@serenityos.org>
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY ANDREAS KLING ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL ANDREAS KLING OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "SamplingProfiler.h"
+#include "CPU.h"
+#include "machine.h"
+#include <QFile>
+#include <QHash>
+#include <QPair>
+#include <QRegExp>
+#include <QStringList>
+#include <algorithm>
+#include <stdio.h>
+
+SamplingProfiler::SamplingProfiler(CPU& cpu)
+    : m_cpu(cpu)
+{
+}
+
+SamplingProfiler::~SamplingProfiler()
+{
+}
+
+void SamplingProfiler::start(u64 interval_in_instructions, unsigned capacity)
+{
+    stop();
+    if (capacity != m_capacity)
+        clear();
+    m_interval = qMax<u64>(1, interval_in_instructions);
+    m_capacity = qMax(1u, capacity);
+    m_running = true;
+    schedule_next_sample();
+}
+
+void SamplingProfiler::stop()
+{
+    if (m_event)
+        m_cpu.machine().scheduler().cancel(m_event);
+    m_event = 0;
+    m_running = false;
+}
+
+void SamplingProfiler::clear()
+{
+    m_samples.clear();
+    m_next_sample_index = 0;
+    m_samples_taken = 0;
+}
+
+void SamplingProfiler::did_hard_reboot()
+{
+    m_event = 0;
+    if (m_running)
+        schedule_next_sample();
+}
+
+void SamplingProfiler::schedule_next_sample()
+{
+    m_event = m_cpu.machine().scheduler().schedule(m_interval, [this] {
+        m_event = 0;
+        take_sample();
+        schedule_next_sample();
+    });
+}
+
+bool SamplingProfiler::peek32(u32 linear_address, u32& value) const
+{
+    // Walk the page tables by hand, so that sampling never faults and never touches accessed/dirty bits.
+    if ((linear_address & 0xfff) > 0xffc)
+        return false;
+    u32 physical_address = linear_address;
+    if (m_cpu.get_pg()) {
+        u32 pde_address = (m_cpu.get_cr3() & 0xfffff000) + ((linear_address >> 22) & 0x3ff) * sizeof(u32);
+        if (pde_address + sizeof(u32) > m_cpu.memory_size())
+            return false;
+        u32 pde = m_cpu.read_physical_memory<u32>(PhysicalAddress(pde_address));
+        if (!(pde & 1))
+            return false;
+        u32 pte_address = (pde & 0xfffff000) + ((linear_address >> 12) & 0x3ff) * sizeof(u32);
+        if (pte_address + sizeof(u32) > m_cpu.memory_size())
+            return false;
+        u32 pte = m_cpu.read_physical_memory<u32>(PhysicalAddress(pte_address));
+        if (!(pte & 1))
+            return false;
+        physical_address = (pte & 0xfffff000) | (linear_address & 0xfff);
+    }
+    physical_address &= m_cpu.a20_mask();
+    if (physical_address + sizeof(u32) > m_cpu.memory_size())
+        return false;
+    value = m_cpu.read_physical_memory<u32>(PhysicalAddress(physical_address));
+    return true;
+}
+
+void SamplingProfiler::take_sample()
+{
+    Sample sample;
+    sample.cs = m_cpu.get_cs();
+    sample.eip = m_cpu.get_eip();
+    sample.linear_eip = m_cpu.cached_descriptor(SegmentRegisterIndex::CS).base().get() + sample.eip;
+    sample.cr3 = m_cpu.get_cr3();
+    sample.cpl = m_cpu.get_cpl();
+
+    // Only 32-bit code gets its frames walked, each frame being { saved EBP, return address }.
+    if (m_cpu.x32() && m_cpu.s32()) {
+        u32 stack_base = m_cpu.cached_descriptor(SegmentRegisterIndex::SS).base().get();
+        u32 code_base = m_cpu.cached_descriptor(SegmentRegisterIndex::CS).base().get();
+        u32 frame_pointer = m_cpu.get_ebp();
+        while (frame_pointer && sample.frame_count < max_frames) {
+            u32 next_frame_pointer;
+            u32 return_address;
+            if (!peek32(stack_base + frame_pointer, next_frame_pointer) || !peek32(stack_base + frame_pointer + 4, return_address))
+                break;
+            if (!return_address)
+                break;
+            sample.frames[sample.frame_count++] = code_base + return_address;
+            // Stacks grow down, so anything else is garbage (or the end of the chain.)
+            if (next_frame_pointer <= frame_pointer)
+                break;
+            frame_pointer = next_frame_pointer;
+        }
+    }
+
+    if ((unsigned)m_samples.size() < m_capacity)
+        m_samples.append(sample);
+    else
+        m_samples[m_next_sample_index] = sample;
+    m_next_sample_index = (m_next_sample_index + 1) % m_capacity;
+    ++m_samples_taken;
+}
+
+bool SamplingProfiler::load_symbols(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    static QRegExp whitespace("\\s+");
+    QMap<u32, QString> symbols;
+    while (!file.atEnd()) {
+        auto parts = QString::fromLocal8Bit(file.readLine()).split(whitespace, QString::SkipEmptyParts);
+        if (parts.size() < 2)
+            continue;
+        bool ok;
+        u32 address = parts[0].toUInt(&ok, 16);
+        if (!ok)
+            continue;
+        // nm and System.map have a type column. Only code symbols are interesting here.
+        if (parts.size() >= 3 && parts[1].size() == 1 && !QString("TtWw").contains(parts[1]))
+            continue;
+        symbols.insert(address, parts.last());
+    }
+
+    if (symbols.isEmpty())
+        return false;
+    m_symbols = symbols;
+    return true;
+}
+
+QString SamplingProfiler::symbolicate(u32 linear_address, u8 cpl) const
+{
+    auto it = m_symbols.upperBound(linear_address);
+    if (it != m_symbols.constBegin())
+        return (--it).value();
+    return cpl == 3 ? "[user]" : "[unknown]";
+}
+
+void SamplingProfiler::dump_top(int count) const
+{
+    if (m_samples.isEmpty()) {
+        printf("No samples\n");
+        return;
+    }
+
+    QHash<QString, unsigned> self_counts;
+    for (auto& sample : m_samples)
+        ++self_counts[symbolicate(sample.linear_eip, sample.cpl)];
+
+    QVector<QPair<unsigned, QString>> sorted;
+    for (auto it = self_counts.constBegin(); it != self_counts.constEnd(); ++it)
+        sorted.append({ it.value(), it.key() });
+    std::sort(sorted.begin(), sorted.end(), [](auto& a, auto& b) { return a.first > b.first; });
+
+    printf("%10s %7s  %s\n", "Samples", "%", "Symbol");
+    for (int i = 0; i < sorted.size() && i < count; ++i)
+        printf("%10u %6.2f%%  %s\n", sorted[i].first, sorted[i].first * 100.0 / m_samples.size(), qPrintable(sorted[i].second));
+    printf("%d samples in buffer, %llu taken every %llu instructions\n", m_samples.size(), (unsigned long long)m_samples_taken, (unsigned long long)m_interval);
+}
+
+bool SamplingProfiler::write_folded_stacks(const QString& path) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QHash<QString, unsigned> stacks;
+    for (auto& sample : m_samples) {
+        QStringList names;
+        for (int i = sample.frame_count - 1; i >= 0; --i)
+            names.append(symbolicate(sample.frames[i], sample.cpl));
+        names.append(symbolicate(sample.linear_eip, sample.cpl));
+        ++stacks[names.join(";")];
+    }
+
+    for (auto it = stacks.constBegin(); it != stacks.constEnd(); ++it)
+        file.write(QString("%1 %2\n").arg(it.key()).arg(it.value()).toLocal8Bit());
+    return true;
+}
@@ -0,0 +1,97 @@
+// Computron x86 PC Emulator
+// Copyright (C) 2003-2020 Andreas Kling <kling@serenityos.org>
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY ANDREAS KLING ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL ANDREAS KLING OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "Common.h"
+#include "Scheduler.h"
+#include "types.h"
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+class CPU;
+
+// Periodically samples where the guest is executing, along with the chain of return
+// addresses found by walking EBP frames. Samples live in a ring buffer, so the most
+// recent ones win when it fills up.
+class SamplingProfiler {
+public:
+    static const unsigned max_frames = 16;
+    static const u64 default_interval = 10000;
+    static const unsigned default_capacity = 65536;
+
+    struct Sample {
+        u32 eip { 0 };
+        u32 linear_eip { 0 };
+        u32 cr3 { 0 };
+        u16 cs { 0 };
+        u8 cpl { 0 };
+        u8 frame_count { 0 };
+        u32 frames[max_frames];
+    };
+
+    explicit SamplingProfiler(CPU&);
+    ~SamplingProfiler();
+
+    bool is_running() const { return m_running; }
+    void start(u64 interval_in_instructions, unsigned capacity);
+    void stop();
+    void clear();
+
+    // The scheduler drops every event on reboot.
+    void did_hard_reboot();
+
+    u64 interval() const { return m_interval; }
+    u64 samples_taken() const { return m_samples_taken; }
+    unsigned sample_count() const { return m_samples.size(); }
+    unsigned capacity() const { return m_capacity; }
+
+    // Reads a System.map or nm-style file ("address type name" per line.)
+    bool load_symbols(const QString& path);
+    int symbol_count() const { return m_symbols.size(); }
+
+    void dump_top(int count) const;
+
+    // Writes one "outermost;...;innermost count" line per distinct stack, the input
+    // format of flamegraph.pl.
+    bool write_folded_stacks(const QString& path) const;
+
+private:
+    void schedule_next_sample();
+    void take_sample();
+    bool peek32(u32 linear_address, u32& value) const;
+    QString symbolicate(u32 linear_address, u8 cpl) const;
+
+    CPU& m_cpu;
+    QVector<Sample> m_samples;
+    unsigned m_next_sample_index { 0 };
+    unsigned m_capacity { default_capacity };
+    u64 m_samples_taken { 0 };
+    u64 m_interval { default_interval };
+    Scheduler::EventID m_event { 0 };
+    bool m_running { false };
+
+    QMap<u32, QString> m_symbols;
+};
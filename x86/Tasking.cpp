@@ -65,6 +65,7 @@ void CPU::_LTR_RM16(Instruction& insn)
     m_tr.base = tss_descriptor.base();
     m_tr.limit = tss_descriptor.limit();
     m_tr.is_32bit = tss_descriptor.is_32bit();
+    invalidate_io_permission_cache();
 #ifdef DEBUG_TASK_SWITCH
     vlog(LogAlert, "LTR { segment: %04x => base:%08x, limit:%08x }", TR.selector, TR.base.get(), TR.limit);
 #endif
@@ -114,39 +115,38 @@ void CPU::task_switch(u16 task_selector, TSSDescriptor& incoming_tss_descriptor,
 
     TSS outgoingTSS(*this, m_tr.base, outgoing_tss_descriptor.is_32bit());
 
-    outgoingTSS.set_eax(get_eax());
-    outgoingTSS.set_ebx(get_ebx());
-    outgoingTSS.set_ecx(get_ecx());
-    outgoingTSS.set_edx(get_edx());
-    outgoingTSS.set_ebp(get_ebp());
-    outgoingTSS.set_esp(get_esp());
-    outgoingTSS.set_esi(get_esi());
-    outgoingTSS.set_edi(get_edi());
-
-    if (source == JumpType::JMP || source == JumpType::IRET) {
-        outgoing_tss_descriptor.set_available();
-        write_to_gdt(outgoing_tss_descriptor);
-    }
-
     u32 outgoingEFlags = get_eflags();
 
     if (source == JumpType::IRET) {
         outgoingEFlags &= ~Flag::NT;
     }
 
-    outgoingTSS.set_eflags(outgoingEFlags);
+    TaskState outgoing_state;
+    outgoing_state.eax = get_eax();
+    outgoing_state.ebx = get_ebx();
+    outgoing_state.ecx = get_ecx();
+    outgoing_state.edx = get_edx();
+    outgoing_state.ebp = get_ebp();
+    outgoing_state.esp = get_esp();
+    outgoing_state.esi = get_esi();
+    outgoing_state.edi = get_edi();
+    outgoing_state.eflags = outgoingEFlags;
+    outgoing_state.cs = get_cs();
+    outgoing_state.ds = get_ds();
+    outgoing_state.es = get_es();
+    outgoing_state.fs = get_fs();
+    outgoing_state.gs = get_gs();
+    outgoing_state.ss = get_ss();
+    outgoing_state.ldt = m_ldtr.selector();
+    outgoing_state.eip = get_eip();
+    outgoing_state.cr3 = get_cr3();
+    outgoing_state.backlink = 0;
+    outgoingTSS.store_task_state(outgoing_state);
 
-    outgoingTSS.set_cs(get_cs());
-    outgoingTSS.set_ds(get_ds());
-    outgoingTSS.set_es(get_es());
-    outgoingTSS.set_fs(get_fs());
-    outgoingTSS.set_gs(get_gs());
-    outgoingTSS.set_ss(get_ss());
-    outgoingTSS.set_ldt(m_ldtr.selector());
-    outgoingTSS.set_eip(get_eip());
-
-    if (get_pg())
-        outgoingTSS.set_cr3(get_cr3());
+    if (source == JumpType::JMP || source == JumpType::IRET) {
+        outgoing_tss_descriptor.set_available();
+        write_to_gdt(outgoing_tss_descriptor);
+    }
 
     TSS incoming_tss(*this, incoming_tss_descriptor.base(), incoming_tss_descriptor.is_32bit());
 
@@ -157,21 +157,26 @@ void CPU::task_switch(u16 task_selector, TSSDescriptor& incoming_tss_descriptor,
     dumpTSS(incomingTSS);
 #endif
 
+    // Read the whole incoming TSS up front, while the outgoing address space is still in effect.
+    TaskState incoming_state = incoming_tss.load_task_state();
+
     // First, load all registers from TSS without validating contents.
-    m_cr3 = incoming_tss.get_cr3();
+    m_cr3 = incoming_state.cr3;
+    invalidate_table_caches();
 
-    m_ldtr.set_selector(incoming_tss.get_ldt());
+    m_ldtr.set_selector(incoming_state.ldt);
     m_ldtr.set_base(LinearAddress());
     m_ldtr.set_limit(0);
+    invalidate_ldt_cache();
 
-    m_cs = incoming_tss.get_cs();
-    m_ds = incoming_tss.get_ds();
-    m_es = incoming_tss.get_es();
-    m_fs = incoming_tss.get_fs();
-    m_gs = incoming_tss.get_gs();
-    m_ss = incoming_tss.get_ss();
+    m_cs = incoming_state.cs;
+    m_ds = incoming_state.ds;
+    m_es = incoming_state.es;
+    m_fs = incoming_state.fs;
+    m_gs = incoming_state.gs;
+    m_ss = incoming_state.ss;
 
-    u32 incomingEFlags = incoming_tss.get_eflags();
+    u32 incomingEFlags = incoming_state.eflags;
 
     if (incomingEFlags & Flag::VM) {
         vlog(LogCPU, "Incoming task is in VM86 mode, this needs work!");
@@ -187,14 +192,14 @@ void CPU::task_switch(u16 task_selector, TSSDescriptor& incoming_tss_descriptor,
     else
         set_flags(incomingEFlags);
 
-    set_eax(incoming_tss.get_eax());
-    set_ebx(incoming_tss.get_ebx());
-    set_ecx(incoming_tss.get_ecx());
-    set_edx(incoming_tss.get_edx());
-    set_ebp(incoming_tss.get_ebp());
-    set_esp(incoming_tss.get_esp());
-    set_esi(incoming_tss.get_esi());
-    set_edi(incoming_tss.get_edi());
+    set_eax(incoming_state.eax);
+    set_ebx(incoming_state.ebx);
+    set_ecx(incoming_state.ecx);
+    set_edx(incoming_state.edx);
+    set_ebp(incoming_state.ebp);
+    set_esp(incoming_state.esp);
+    set_esi(incoming_state.esi);
+    set_edi(incoming_state.edi);
 
     if (source == JumpType::CALL || source == JumpType::INT) {
         incoming_tss.set_backlink(m_tr.selector);
@@ -204,6 +209,7 @@ void CPU::task_switch(u16 task_selector, TSSDescriptor& incoming_tss_descriptor,
     m_tr.base = incoming_tss_descriptor.base();
     m_tr.limit = incoming_tss_descriptor.limit();
     m_tr.is_32bit = incoming_tss_descriptor.is_32bit();
+    invalidate_io_permission_cache();
 
     if (source != JumpType::IRET) {
         incoming_tss_descriptor.set_busy();
@@ -227,7 +233,7 @@ void CPU::task_switch(u16 task_selector, TSSDescriptor& incoming_tss_descriptor,
     if (cs_descriptor.is_code()) {
         if (cs_descriptor.is_nonconforming_code()) {
             if (cs_descriptor.dpl() != (get_cs() & 3))
-                throw InvalidTSS(get_cs() & 0xfffc, QString("CS is non-conforming with DPL(%1) != RPL(%2)").arg(cs_descriptor.dpl()).arg(get_cs() & 3));
+                throw InvalidTSS(get_cs() & 0xfffc, "CS is non-conforming with DPL(%u) != RPL(%u)", cs_descriptor.dpl(), get_cs() & 3);
         } else if (cs_descriptor.is_conforming_code()) {
             if (cs_descriptor.dpl() > (get_cs() & 3))
                 throw InvalidTSS(get_cs() & 0xfffc, "CS is conforming with DPL > RPL");
@@ -244,7 +250,7 @@ void CPU::task_switch(u16 task_selector, TSSDescriptor& incoming_tss_descriptor,
         if (!ss_descriptor.present())
             throw StackFault(get_ss() & 0xfffc, "SS is not present");
         if (ss_descriptor.dpl() != incoming_cpl)
-            throw InvalidTSS(get_ss() & 0xfffc, QString("SS DPL(%1) != CPL(%2)").arg(ss_descriptor.dpl()).arg(incoming_cpl));
+            throw InvalidTSS(get_ss() & 0xfffc, "SS DPL(%u) != CPL(%u)", ss_descriptor.dpl(), incoming_cpl);
     }
 
     if (!ldt_descriptor.is_null()) {
@@ -282,14 +288,14 @@ void CPU::task_switch(u16 task_selector, TSSDescriptor& incoming_tss_descriptor,
 
     EXCEPTION_ON(GeneralProtectionFault, 0, get_eip() > cached_descriptor(SegmentRegisterIndex::CS).effective_limit(), "Task switch to EIP outside CS limit");
 
-    set_ldt(incoming_tss.get_ldt());
-    set_cs(incoming_tss.get_cs());
-    set_es(incoming_tss.get_es());
-    set_ds(incoming_tss.get_ds());
-    set_fs(incoming_tss.get_fs());
-    set_gs(incoming_tss.get_gs());
-    set_ss(incoming_tss.get_ss());
-    set_eip(incoming_tss.get_eip());
+    set_ldt(incoming_state.ldt);
+    set_cs(incoming_state.cs);
+    set_es(incoming_state.es);
+    set_ds(incoming_state.ds);
+    set_fs(incoming_state.fs);
+    set_gs(incoming_state.gs);
+    set_ss(incoming_state.ss);
+    set_eip(incoming_state.eip);
 
     if (get_tf()) {
         vlog(LogCPU, "Leaving task switch with TF=1");
@@ -444,6 +450,120 @@ TSS_FIELD_16(ss0)
 TSS_FIELD_16(ss1)
 TSS_FIELD_16(ss2)
 
+TaskState TSS::load_task_state() const
+{
+    TaskState state;
+    if (m_is_32bit) {
+        TSS32 tss;
+        auto block = m_cpu.translate_metal_block(m_base, sizeof(tss), CPU::MemoryAccessType::Read);
+        m_cpu.read_metal_block(block, reinterpret_cast<u8*>(&tss));
+        state.eax = tss.eax;
+        state.ebx = tss.ebx;
+        state.ecx = tss.ecx;
+        state.edx = tss.edx;
+        state.esi = tss.esi;
+        state.edi = tss.edi;
+        state.esp = tss.esp;
+        state.ebp = tss.ebp;
+        state.eip = tss.eip;
+        state.eflags = tss.eflags;
+        state.cr3 = tss.cr3;
+        state.cs = tss.cs;
+        state.ds = tss.ds;
+        state.es = tss.es;
+        state.ss = tss.ss;
+        state.fs = tss.fs;
+        state.gs = tss.gs;
+        state.ldt = tss.ldt;
+        state.backlink = tss.backlink;
+        return state;
+    }
+
+    TSS16 tss;
+    auto block = m_cpu.translate_metal_block(m_base, sizeof(tss), CPU::MemoryAccessType::Read);
+    m_cpu.read_metal_block(block, reinterpret_cast<u8*>(&tss));
+    state.eax = tss.ax;
+    state.ebx = tss.bx;
+    state.ecx = tss.cx;
+    state.edx = tss.dx;
+    state.esi = tss.si;
+    state.edi = tss.di;
+    state.esp = tss.sp;
+    state.ebp = tss.bp;
+    state.eip = tss.ip;
+    state.eflags = tss.flags;
+    // A 16-bit TSS has no CR3 field, so the address space carries over.
+    state.cr3 = m_cpu.get_cr3();
+    state.cs = tss.cs;
+    state.ds = tss.ds;
+    state.es = tss.es;
+    state.ss = tss.ss;
+    state.fs = tss.fs;
+    state.gs = tss.gs;
+    state.ldt = tss.ldt;
+    state.backlink = tss.backlink;
+    return state;
+}
+
+void TSS::store_task_state(const TaskState& state)
+{
+    // The dynamic fields are contiguous, so they go out as a single block.
+    if (m_is_32bit) {
+        // Read the range first so the reserved upper halves of the selector slots are left intact.
+        constexpr u32 first = offsetof(TSS32, cr3);
+        constexpr u32 end = offsetof(TSS32, ldt) + sizeof(u16);
+        TSS32 tss;
+        u8* image = reinterpret_cast<u8*>(&tss) + first;
+        auto block = m_cpu.translate_metal_block(m_base.offset(first), end - first, CPU::MemoryAccessType::Write);
+        m_cpu.read_metal_block(block, image);
+        if (m_cpu.get_pg())
+            tss.cr3 = state.cr3;
+        tss.eip = state.eip;
+        tss.eflags = state.eflags;
+        tss.eax = state.eax;
+        tss.ecx = state.ecx;
+        tss.edx = state.edx;
+        tss.ebx = state.ebx;
+        tss.esp = state.esp;
+        tss.ebp = state.ebp;
+        tss.esi = state.esi;
+        tss.edi = state.edi;
+        tss.es = state.es;
+        tss.cs = state.cs;
+        tss.ss = state.ss;
+        tss.ds = state.ds;
+        tss.fs = state.fs;
+        tss.gs = state.gs;
+        tss.ldt = state.ldt;
+        m_cpu.write_metal_block(block, image);
+        return;
+    }
+
+    constexpr u32 first = offsetof(TSS16, ip);
+    constexpr u32 end = offsetof(TSS16, ldt) + sizeof(u16);
+    TSS16 tss;
+    u8* image = reinterpret_cast<u8*>(&tss) + first;
+    auto block = m_cpu.translate_metal_block(m_base.offset(first), end - first, CPU::MemoryAccessType::Write);
+    tss.ip = state.eip;
+    tss.flags = state.eflags;
+    tss.ax = state.eax;
+    tss.cx = state.ecx;
+    tss.dx = state.edx;
+    tss.bx = state.ebx;
+    tss.sp = state.esp;
+    tss.bp = state.ebp;
+    tss.si = state.esi;
+    tss.di = state.edi;
+    tss.es = state.es;
+    tss.cs = state.cs;
+    tss.ss = state.ss;
+    tss.ds = state.ds;
+    tss.fs = state.fs;
+    tss.gs = state.gs;
+    tss.ldt = state.ldt;
+    m_cpu.write_metal_block(block, image);
+}
+
 u32 TSS::get_ring_esp(u8 ring) const
 {
     if (ring == 0)
@@ -29,6 +29,13 @@
 
 class CPU;
 
+// The register state a task switch saves to and restores from a TSS.
+struct TaskState {
+    u32 eax, ebx, ecx, edx, esi, edi, esp, ebp;
+    u32 eip, eflags, cr3;
+    u16 cs, ds, es, ss, fs, gs, ldt, backlink;
+};
+
 class TSS {
 public:
     TSS(CPU&, LinearAddress, bool is_32bit);
@@ -97,6 +104,11 @@ public:
     void set_eflags(u32);
     void set_backlink(u16);
 
+    // Whole-state access for task switching, as a single block per TSS.
+    // All pages are translated before anything moves, so a fault leaves memory and registers untouched.
+    TaskState load_task_state() const;
+    void store_task_state(const TaskState&);
+
 private:
     CPU& m_cpu;
     LinearAddress m_base;
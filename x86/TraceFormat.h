@@ -0,0 +1,83 @@
+// Computron x86 PC Emulator
+// Copyright (C) 2003-2020 Andreas Kling <kling@serenityos.org>
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY ANDREAS KLING ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL ANDREAS KLING OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "types.h"
+
+// On-disk format written by TraceWriter and read by ct-tracedump.
+//
+// The file starts with a TraceFileHeader. After it come chunks, each one being a u32 byte
+// count followed by that many bytes of qCompress()ed TraceRecords.
+//
+// Each record captures the state right before an instruction executes, along with the memory
+// accesses made while it executed. The registers it changed are the difference from the next record.
+
+static const char trace_file_magic[8] = { 'C', 'T', 'T', 'R', 'A', 'C', 'E', '1' };
+
+struct TraceFileHeader {
+    char magic[8];
+    u32 version;
+    u32 record_size;
+};
+
+struct TraceMemoryAccess {
+    u32 address;
+    u32 value;
+    u8 size;
+    u8 is_write;
+    u16 padding;
+};
+
+struct TraceRecord {
+    enum Flags : u8 {
+        X32 = 0x01,
+        A32 = 0x02,
+        PE = 0x04,
+        VM = 0x08,
+        PG = 0x10,
+        MemoryAccessesTruncated = 0x80,
+    };
+
+    static const unsigned max_instruction_length = 15;
+    static const unsigned max_memory_accesses = 4;
+
+    u64 cycle;
+    u32 eip;
+    u32 gpr[8];
+    u32 eflags;
+    u16 segment[6];
+    u8 flags;
+    u8 cpl;
+    u8 instruction_length;
+    u8 memory_access_count;
+    u8 instruction[max_instruction_length];
+    u8 padding;
+    TraceMemoryAccess memory_accesses[max_memory_accesses];
+};
+
+static const u32 trace_file_version = 1;
+
+static_assert(sizeof(TraceFileHeader) == 16, "TraceFileHeader size");
+static_assert(sizeof(TraceRecord) == 128, "TraceRecord size");
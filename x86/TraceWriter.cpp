@@ -0,0 +1,199 @@
+// Computron x86 PC Emulator
+// Copyright (C) 2003-2020 Andreas Kling <kling@serenityos.org>
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY ANDREAS KLING ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL ANDREAS KLING OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "TraceWriter.h"
+#include "CPU.h"
+#include "debug.h"
+#include <QByteArray>
+#include <QThread>
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+
+// Must be a power of two, so that the free-running indices wrap cleanly.
+static const u32 ring_capacity = 65536;
+static const u32 records_per_chunk = 4096;
+
+class TraceWriterThread final : public QThread {
+public:
+    explicit TraceWriterThread(TraceWriter::Private& writer)
+        : m_writer(writer)
+    {
+    }
+
+private:
+    virtual void run() override;
+    TraceWriter::Private& m_writer;
+};
+
+struct TraceWriter::Private {
+    FILE* file { nullptr };
+    TraceRecord* ring { nullptr };
+
+    // Free-running; the CPU thread only writes head and the writer thread only writes tail.
+    std::atomic<u32> head { 0 };
+    std::atomic<u32> tail { 0 };
+    std::atomic<bool> should_stop { false };
+
+    OwnPtr<TraceWriterThread> thread;
+
+    void drain();
+};
+
+void TraceWriterThread::run()
+{
+    m_writer.drain();
+}
+
+void TraceWriter::Private::drain()
+{
+    for (;;) {
+        u32 current_tail = tail.load(std::memory_order_relaxed);
+        u32 available = head.load(std::memory_order_acquire) - current_tail;
+        if (!available) {
+            if (should_stop)
+                break;
+            QThread::usleep(500);
+            continue;
+        }
+
+        u32 index = current_tail & (ring_capacity - 1);
+        u32 count = std::min({ available, records_per_chunk, ring_capacity - index });
+        QByteArray compressed = qCompress(reinterpret_cast<const uchar*>(&ring[index]), count * sizeof(TraceRecord), 1);
+        u32 size = compressed.size();
+        if (fwrite(&size, sizeof(size), 1, file) != 1 || fwrite(compressed.constData(), size, 1, file) != 1)
+            vlog(LogCPU, "Failed to write trace chunk");
+
+        tail.store(current_tail + count, std::memory_order_release);
+    }
+    fflush(file);
+}
+
+OwnPtr<TraceWriter> TraceWriter::create(const QString& path)
+{
+    FILE* file = fopen(qPrintable(path), "wb");
+    if (!file)
+        return nullptr;
+
+    TraceFileHeader header;
+    memcpy(header.magic, trace_file_magic, sizeof(header.magic));
+    header.version = trace_file_version;
+    header.record_size = sizeof(TraceRecord);
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        fclose(file);
+        return nullptr;
+    }
+
+    auto writer = OwnPtr<TraceWriter>(new TraceWriter);
+    writer->d->file = file;
+    writer->d->thread = make<TraceWriterThread>(*writer->d);
+    writer->d->thread->start();
+    return writer;
+}
+
+TraceWriter::TraceWriter()
+    : d(make<Private>())
+{
+    d->ring = new TraceRecord[ring_capacity];
+}
+
+TraceWriter::~TraceWriter()
+{
+    if (m_has_pending_record)
+        commit();
+    d->should_stop = true;
+    d->thread->wait();
+    fclose(d->file);
+    delete[] d->ring;
+}
+
+void TraceWriter::commit()
+{
+    u32 head = d->head.load(std::memory_order_relaxed);
+    // Tracing must not lose records, so wait for the writer thread if it's fallen behind.
+    while (head - d->tail.load(std::memory_order_acquire) == ring_capacity)
+        QThread::yieldCurrentThread();
+    d->ring[head & (ring_capacity - 1)] = m_pending_record;
+    d->head.store(head + 1, std::memory_order_release);
+    m_has_pending_record = false;
+}
+
+void TraceWriter::begin_instruction(CPU& cpu)
+{
+    if (m_has_pending_record)
+        commit();
+
+    auto& record = m_pending_record;
+    memset(&record, 0, sizeof(record));
+    record.cycle = cpu.cycle();
+    record.eip = cpu.get_eip();
+    record.gpr[0] = cpu.get_eax();
+    record.gpr[1] = cpu.get_ecx();
+    record.gpr[2] = cpu.get_edx();
+    record.gpr[3] = cpu.get_ebx();
+    record.gpr[4] = cpu.get_esp();
+    record.gpr[5] = cpu.get_ebp();
+    record.gpr[6] = cpu.get_esi();
+    record.gpr[7] = cpu.get_edi();
+    record.eflags = cpu.get_eflags();
+    record.segment[0] = cpu.get_es();
+    record.segment[1] = cpu.get_cs();
+    record.segment[2] = cpu.get_ss();
+    record.segment[3] = cpu.get_ds();
+    record.segment[4] = cpu.get_fs();
+    record.segment[5] = cpu.get_gs();
+    record.cpl = cpu.get_cpl();
+    if (cpu.x32())
+        record.flags |= TraceRecord::X32;
+    if (cpu.a32())
+        record.flags |= TraceRecord::A32;
+    if (cpu.get_pe())
+        record.flags |= TraceRecord::PE;
+    if (cpu.get_vm())
+        record.flags |= TraceRecord::VM;
+    if (cpu.get_pg())
+        record.flags |= TraceRecord::PG;
+
+    // Tracing must not change guest state, so this mustn't fault (a #PF sets CR2) or mark pages accessed.
+    auto linear_eip = cpu.cached_descriptor(SegmentRegisterIndex::CS).linear_address(record.eip);
+    if (const u8* data = cpu.memory_pointer_without_faulting(linear_eip)) {
+        // Don't read past the end of the page; the next one may not be where the guest thinks it is.
+        u32 length = std::min<u32>(TraceRecord::max_instruction_length, 0x1000 - (linear_eip.get() & 0xfff));
+        memcpy(record.instruction, data, length);
+        record.instruction_length = length;
+    }
+
+    m_has_pending_record = true;
+}
+
+void TraceWriter::flush()
+{
+    // The pending record is usually the instruction that brought us here, so don't leave it behind.
+    if (m_has_pending_record)
+        commit();
+    while (d->tail.load(std::memory_order_acquire) != d->head.load(std::memory_order_acquire))
+        QThread::yieldCurrentThread();
+    fflush(d->file);
+}
@@ -0,0 +1,72 @@
+// Computron x86 PC Emulator
+// Copyright (C) 2003-2020 Andreas Kling <kling@serenityos.org>
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY ANDREAS KLING ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL ANDREAS KLING OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "Common.h"
+#include "OwnPtr.h"
+#include "TraceFormat.h"
+#include <QString>
+
+class CPU;
+
+// Binary replacement for the text --trace output. The CPU thread fills a lock-free
+// single-producer ring of fixed-size records, and a background thread drains it into
+// a compressed file. See TraceFormat.h.
+class TraceWriter {
+public:
+    static OwnPtr<TraceWriter> create(const QString& path);
+    ~TraceWriter();
+
+    // Commits the previous instruction's record and starts a new one for the instruction at CS:EIP.
+    void begin_instruction(CPU&);
+
+    ALWAYS_INLINE void did_access_memory(u32 linear_address, u32 value, u8 size, bool is_write)
+    {
+        if (!m_has_pending_record)
+            return;
+        if (m_pending_record.memory_access_count == TraceRecord::max_memory_accesses) {
+            m_pending_record.flags |= TraceRecord::MemoryAccessesTruncated;
+            return;
+        }
+        auto& access = m_pending_record.memory_accesses[m_pending_record.memory_access_count++];
+        access.address = linear_address;
+        access.value = value;
+        access.size = size;
+        access.is_write = is_write;
+    }
+
+    // Commits the in-flight record and waits until everything is on disk.
+    void flush();
+
+    struct Private;
+
+private:
+    TraceWriter();
+    void commit();
+
+    OwnPtr<Private> d;
+    TraceRecord m_pending_record;
+    bool m_has_pending_record { false };
+};
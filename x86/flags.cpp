@@ -91,8 +91,8 @@ void CPU::_STI(Instruction&)
         return;
     }
 
-    if (!get_vme() && !get_pvi())
-        throw GeneralProtectionFault(0, "STI with VME=0 && PVI=0");
+    if (!has_virtual_interrupt_flag())
+        throw GeneralProtectionFault(0, "STI with IOPL < CPL and no virtual interrupt flag");
 
     if (get_vip())
         throw GeneralProtectionFault(0, "STI with VIP=1");
@@ -107,8 +107,8 @@ void CPU::_CLI(Instruction&)
         return;
     }
 
-    if (!get_vme() && !get_pvi())
-        throw GeneralProtectionFault(0, "CLI with VME=0 && PVI=0");
+    if (!has_virtual_interrupt_flag())
+        throw GeneralProtectionFault(0, "CLI with IOPL < CPL and no virtual interrupt flag");
 
     set_vif(0);
 }
@@ -178,9 +178,9 @@ void CPU::set_eflags(u32 eflags)
     set_flags(eflags & 0xffff);
     set_rf(eflags & Flag::RF);
     set_vm(eflags & Flag::VM);
+    set_vif(eflags & Flag::VIF);
+    set_vip(eflags & Flag::VIP);
     //    this->AC = (eflags & 0x40000) != 0;
-    //    this->VIF = (eflags & 0x80000) != 0;
-    //    this->VIP = (eflags & 0x100000) != 0;
     //    this->ID = (eflags & 0x200000) != 0;
 }
 
@@ -189,9 +189,9 @@ u32 CPU::get_eflags() const
     u32 eflags = get_flags()
         | (this->m_rf * Flag::RF)
         | (this->m_vm * Flag::VM)
+        | (this->m_vif * Flag::VIF)
+        | (this->m_vip * Flag::VIP)
         //         | (this->AC << 18)
-        //         | (this->VIF << 19)
-        //         | (this->VIP << 20)
         //         | (this->ID << 21);
         ;
     return eflags;
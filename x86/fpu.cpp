@@ -24,18 +24,1493 @@
 
 #include "CPU.h"
 #include "Common.h"
+#include "FPU.h"
 #include "debug.h"
+#include "pic.h"
+#include <fenv.h>
+#include <float.h>
+#include <limits>
+#include <math.h>
+#include <string.h>
+
+//#define FPU_DEBUG
+
+static const long double ln2 = 0.693147180559945309417232121458176568L;
+
+void FPU::initialize()
+{
+    m_control = 0x037f;
+    m_status = 0;
+    m_top = 0;
+    for (unsigned i = 0; i < 8; ++i) {
+        m_registers[i] = 0;
+        m_tags[i] = Empty;
+    }
+    m_instruction_pointer = 0;
+    m_instruction_selector = 0;
+    m_opcode = 0;
+    m_operand_pointer = 0;
+    m_operand_selector = 0;
+    m_error_signalled = false;
+}
+
+void FPU::update_error_summary()
+{
+    if (m_status & ~m_control & Status::ExceptionMask)
+        m_status |= Status::ES | Status::B;
+    else
+        m_status &= ~(Status::ES | Status::B);
+}
+
+void FPU::set_control_word(u16 value)
+{
+    m_control = value | 0x40;
+    update_error_summary();
+}
+
+void FPU::set_status_word(u16 value)
+{
+    m_top = (value >> 11) & 7;
+    m_status = value & ~Status::TopMask;
+    update_error_summary();
+}
+
+u16 FPU::tag_word() const
+{
+    u16 word = 0;
+    for (unsigned i = 0; i < 8; ++i)
+        word |= m_tags[i] << (i * 2);
+    return word;
+}
+
+void FPU::set_tag_word(u16 word)
+{
+    // Only "empty" is taken from the guest, the other tags are derived from the register contents.
+    for (unsigned i = 0; i < 8; ++i) {
+        if (((word >> (i * 2)) & 3) == Empty)
+            m_tags[i] = Empty;
+        else
+            m_tags[i] = classify(m_registers[i]);
+    }
+}
+
+void FPU::set_st(unsigned i, long double value)
+{
+    unsigned index = physical_index(i);
+    m_registers[index] = value;
+    m_tags[index] = classify(value);
+}
+
+void FPU::push(long double value)
+{
+    decrement_top();
+    if (m_tags[m_top] != Empty) {
+        if (!raise_stack_fault(true)) {
+            increment_top();
+            return;
+        }
+        value = indefinite();
+    }
+    set_st(0, value);
+}
+
+void FPU::pop()
+{
+    m_tags[m_top] = Empty;
+    increment_top();
+}
+
+void FPU::set_condition_codes(bool c3, bool c2, bool c1, bool c0)
+{
+    m_status &= ~Status::ConditionMask;
+    if (c3)
+        m_status |= Status::C3;
+    if (c2)
+        m_status |= Status::C2;
+    if (c1)
+        m_status |= Status::C1;
+    if (c0)
+        m_status |= Status::C0;
+}
+
+void FPU::set_c1(bool value)
+{
+    if (value)
+        m_status |= Status::C1;
+    else
+        m_status &= ~Status::C1;
+}
+
+void FPU::set_c2(bool value)
+{
+    if (value)
+        m_status |= Status::C2;
+    else
+        m_status &= ~Status::C2;
+}
+
+bool FPU::raise(u16 exceptions)
+{
+    exceptions &= Status::ExceptionMask;
+    if (!exceptions)
+        return true;
+    m_status |= exceptions;
+    u16 unmasked = exceptions & ~m_control;
+    if (!unmasked)
+        return true;
+    m_status |= Status::ES | Status::B;
+    // Overflow, underflow and precision faults still deliver a result.
+    return !(unmasked & (Status::IE | Status::DE | Status::ZE));
+}
+
+bool FPU::raise_stack_fault(bool overflow)
+{
+    m_status |= Status::SF;
+    set_c1(overflow);
+    return raise(Status::IE);
+}
+
+FPU::Tag FPU::classify(long double value)
+{
+    switch (fpclassify(value)) {
+    case FP_ZERO:
+        return Zero;
+    case FP_NORMAL:
+        return Valid;
+    default:
+        return Special;
+    }
+}
+
+long double FPU::load_extended(const u8* data)
+{
+#if LDBL_MANT_DIG == 64
+    long double value = 0;
+    memcpy(&value, data, 10);
+    return value;
+#else
+    u64 mantissa;
+    u16 sign_and_exponent;
+    memcpy(&mantissa, data, 8);
+    memcpy(&sign_and_exponent, data + 8, 2);
+    int exponent = sign_and_exponent & 0x7fff;
+    long double value;
+    if (exponent == 0x7fff)
+        value = (mantissa << 1) ? __builtin_nanl("") : __builtin_infl();
+    else if (exponent == 0)
+        value = ldexpl((long double)mantissa, -16382 - 63);
+    else
+        value = ldexpl((long double)mantissa, exponent - 16383 - 63);
+    return (sign_and_exponent & 0x8000) ? -value : value;
+#endif
+}
+
+void FPU::store_extended(long double value, u8* data)
+{
+#if LDBL_MANT_DIG == 64
+    memcpy(data, &value, 10);
+#else
+    u64 mantissa = 0;
+    u16 sign_and_exponent = signbit(value) ? 0x8000 : 0;
+    if (isnan(value)) {
+        sign_and_exponent |= 0x7fff;
+        mantissa = 0xc000000000000000ULL;
+    } else if (isinf(value)) {
+        sign_and_exponent |= 0x7fff;
+        mantissa = 0x8000000000000000ULL;
+    } else if (value != 0) {
+        int exponent;
+        long double fraction = frexpl(fabsl(value), &exponent);
+        int biased = exponent - 1 + 16383;
+        if (biased <= 0) {
+            mantissa = (u64)ldexpl(fabsl(value), 16382 + 63);
+        } else {
+            mantissa = (u64)ldexpl(fraction, 64);
+            sign_and_exponent |= biased;
+        }
+    }
+    memcpy(data, &mantissa, 8);
+    memcpy(data + 8, &sign_and_exponent, 2);
+#endif
+}
+
+// Switches the host to the guest's rounding mode (when it isn't the default) for the lifetime
+// of the scope and collects the IEEE exceptions raised by the host arithmetic.
+class HostFloatingPointScope {
+public:
+    explicit HostFloatingPointScope(FPU::RoundingMode mode)
+        : m_changes_rounding(mode != FPU::RoundToNearest)
+    {
+        if (m_changes_rounding) {
+            m_saved_rounding = fegetround();
+            fesetround(host_rounding(mode));
+        }
+        feclearexcept(FE_ALL_EXCEPT);
+    }
+
+    ~HostFloatingPointScope()
+    {
+        if (m_changes_rounding)
+            fesetround(m_saved_rounding);
+    }
+
+    u16 exceptions() const
+    {
+        int raised = fetestexcept(FE_ALL_EXCEPT);
+        u16 exceptions = 0;
+        if (raised & FE_INVALID)
+            exceptions |= FPU::Status::IE;
+        if (raised & FE_DIVBYZERO)
+            exceptions |= FPU::Status::ZE;
+        if (raised & FE_OVERFLOW)
+            exceptions |= FPU::Status::OE;
+        if (raised & FE_UNDERFLOW)
+            exceptions |= FPU::Status::UE;
+        if (raised & FE_INEXACT)
+            exceptions |= FPU::Status::PE;
+        return exceptions;
+    }
+
+private:
+    static int host_rounding(FPU::RoundingMode mode)
+    {
+        switch (mode) {
+        case FPU::RoundDown:
+            return FE_DOWNWARD;
+        case FPU::RoundUp:
+            return FE_UPWARD;
+        case FPU::RoundTowardZero:
+            return FE_TOWARDZERO;
+        default:
+            return FE_TONEAREST;
+        }
+    }
+
+    bool m_changes_rounding;
+    int m_saved_rounding { FE_TONEAREST };
+};
+
+static bool is_denormal(long double value)
+{
+    return fpclassify(value) == FP_SUBNORMAL;
+}
+
+template<typename T>
+static bool fits(long double value)
+{
+    return static_cast<long double>(static_cast<T>(value)) == value;
+}
+
+// Rounds to a narrower significand in the current host rounding mode, keeping the full exponent range.
+static long double round_significand(long double value, int bits)
+{
+    int exponent;
+    long double fraction = frexpl(value, &exponent);
+    return ldexpl(rintl(ldexpl(fraction, bits)), exponent - bits);
+}
+
+// Runs a precision-controlled operation (add, subtract, multiply, divide, square root).
+// With single or double precision selected, the host float/double operation is already
+// correctly rounded, so it's used whenever the operands fit and the result stays in range.
+// Otherwise the result is computed in long double and rounded a second time.
+template<typename Operation>
+static long double compute(FPU& fpu, u16& exceptions, long double a, long double b, Operation operation)
+{
+    auto precision = fpu.precision_mode();
+    u16 denormal = (is_denormal(a) || is_denormal(b)) ? FPU::Status::DE : 0;
+
+    if (precision == FPU::SinglePrecision && fits<float>(a) && fits<float>(b)) {
+        HostFloatingPointScope scope(fpu.rounding_mode());
+        volatile float x = a;
+        volatile float y = b;
+        volatile float result = operation(x, y);
+        if (isnormal(result) || (result == 0 && (a == 0 || b == 0))) {
+            exceptions = scope.exceptions() | denormal;
+            return result;
+        }
+    } else if (precision == FPU::DoublePrecision && fits<double>(a) && fits<double>(b)) {
+        HostFloatingPointScope scope(fpu.rounding_mode());
+        volatile double x = a;
+        volatile double y = b;
+        volatile double result = operation(x, y);
+        if (isnormal(result) || (result == 0 && (a == 0 || b == 0))) {
+            exceptions = scope.exceptions() | denormal;
+            return result;
+        }
+    }
+
+    HostFloatingPointScope scope(fpu.rounding_mode());
+    volatile long double x = a;
+    volatile long double y = b;
+    volatile long double result = operation(x, y);
+    if (precision != FPU::ExtendedPrecision && isfinite(result))
+        result = round_significand(result, precision == FPU::SinglePrecision ? 24 : 53);
+    exceptions = scope.exceptions() | denormal;
+    return result;
+}
+
+// Transcendental instructions always compute at full precision.
+template<typename Operation>
+static long double compute_extended(FPU& fpu, u16& exceptions, long double a, long double b, Operation operation)
+{
+    HostFloatingPointScope scope(fpu.rounding_mode());
+    volatile long double x = a;
+    volatile long double y = b;
+    volatile long double result = operation(x, y);
+    exceptions = scope.exceptions() | ((is_denormal(a) || is_denormal(b)) ? FPU::Status::DE : 0);
+    return result;
+}
+
+template<typename T>
+static bool round_to(FPU& fpu, long double value, T& out)
+{
+    HostFloatingPointScope scope(fpu.rounding_mode());
+    volatile long double input = value;
+    volatile T result = static_cast<T>(input);
+    out = result;
+    return fpu.raise(scope.exceptions());
+}
+
+template<typename T>
+static bool round_to_integer(FPU& fpu, long double value, bool truncate, T& out)
+{
+    HostFloatingPointScope scope(truncate ? FPU::RoundTowardZero : fpu.rounding_mode());
+    volatile long double input = value;
+    volatile long double rounded = rintl(input);
+    u16 exceptions = scope.exceptions() & FPU::Status::PE;
+    long double limit = -static_cast<long double>(std::numeric_limits<T>::min());
+    if (isnan(value) || rounded < -limit || rounded >= limit) {
+        // The integer indefinite.
+        out = std::numeric_limits<T>::min();
+        return fpu.raise(FPU::Status::IE);
+    }
+    fpu.set_c1(fabsl(rounded) > fabsl(value));
+    out = static_cast<T>(rounded);
+    return fpu.raise(exceptions);
+}
+
+template<typename T>
+static long double load_real(FPU& fpu, T value)
+{
+    HostFloatingPointScope scope(FPU::RoundToNearest);
+    volatile T input = value;
+    volatile long double result = input;
+    fpu.raise(scope.exceptions() | (is_denormal(value) ? FPU::Status::DE : 0));
+    return result;
+}
+
+struct MemoryOperand {
+    SegmentRegisterIndex segment;
+    u32 offset;
+};
+
+static u64 read_memory64(CPU& cpu, const MemoryOperand& m, u32 displacement = 0)
+{
+    u64 low = cpu.read_memory32(m.segment, m.offset + displacement);
+    u64 high = cpu.read_memory32(m.segment, m.offset + displacement + 4);
+    return low | (high << 32);
+}
+
+static void write_memory64(CPU& cpu, const MemoryOperand& m, u64 value, u32 displacement = 0)
+{
+    cpu.write_memory32(m.segment, m.offset + displacement, value);
+    cpu.write_memory32(m.segment, m.offset + displacement + 4, value >> 32);
+}
+
+static void read_memory80(CPU& cpu, const MemoryOperand& m, u8* data, u32 displacement = 0)
+{
+    u64 mantissa = read_memory64(cpu, m, displacement);
+    u16 sign_and_exponent = cpu.read_memory16(m.segment, m.offset + displacement + 8);
+    memcpy(data, &mantissa, 8);
+    memcpy(data + 8, &sign_and_exponent, 2);
+}
+
+static void write_memory80(CPU& cpu, const MemoryOperand& m, const u8* data, u32 displacement = 0)
+{
+    u64 mantissa;
+    u16 sign_and_exponent;
+    memcpy(&mantissa, data, 8);
+    memcpy(&sign_and_exponent, data + 8, 2);
+    write_memory64(cpu, m, mantissa, displacement);
+    cpu.write_memory16(m.segment, m.offset + displacement + 8, sign_and_exponent);
+}
+
+// Multi-part stores must fault before any part of them is written.
+static void snoop_write(CPU& cpu, const MemoryOperand& m, u32 size)
+{
+    cpu.snoop(m.segment, m.offset, CPU::MemoryAccessType::Write);
+    cpu.snoop(m.segment, m.offset + size - 1, CPU::MemoryAccessType::Write);
+}
+
+static float read_m32real(CPU& cpu, const MemoryOperand& m)
+{
+    u32 bits = cpu.read_memory32(m.segment, m.offset);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static double read_m64real(CPU& cpu, const MemoryOperand& m)
+{
+    u64 bits = read_memory64(cpu, m);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Reports a stack underflow if `empty` is set. With the exception masked, the destination
+// register (if any) receives the QNaN indefinite.
+static bool underflow(FPU& fpu, bool empty, int destination = -1)
+{
+    if (!empty)
+        return false;
+    if (fpu.raise_stack_fault(false) && destination >= 0)
+        fpu.set_st(destination, FPU::indefinite());
+    return true;
+}
+
+// Unmasked faults leave the condition codes alone and return false, and then the popping forms don't pop.
+static bool compare(FPU& fpu, long double a, long double b, bool quiet)
+{
+    if (isnan(a) || isnan(b)) {
+        // Signalling NaNs aren't told apart from quiet ones, so FUCOM never faults.
+        if (!quiet && !fpu.raise(FPU::Status::IE))
+            return false;
+        fpu.set_condition_codes(true, true, false, true);
+        return true;
+    }
+    if (!fpu.raise((is_denormal(a) || is_denormal(b)) ? FPU::Status::DE : 0))
+        return false;
+    fpu.set_condition_codes(a == b, false, false, a < b);
+    return true;
+}
+
+static bool compare_st0(FPU& fpu, long double operand, bool operand_empty, bool quiet)
+{
+    if (fpu.is_empty(0) || operand_empty) {
+        if (!fpu.raise_stack_fault(false))
+            return false;
+        fpu.set_condition_codes(true, true, false, true);
+        return true;
+    }
+    return compare(fpu, fpu.st(0), operand, quiet);
+}
+
+static void compare_to_eflags(CPU& cpu, unsigned index, bool quiet, bool pop)
+{
+    auto& fpu = cpu.fpu();
+    bool unordered;
+    bool equal = false;
+    bool less = false;
+    if (fpu.is_empty(0) || fpu.is_empty(index)) {
+        if (!fpu.raise_stack_fault(false))
+            return;
+        unordered = true;
+    } else {
+        long double a = fpu.st(0);
+        long double b = fpu.st(index);
+        unordered = isnan(a) || isnan(b);
+        if (unordered && !quiet && !fpu.raise(FPU::Status::IE))
+            return;
+        equal = a == b;
+        less = a < b;
+    }
+    cpu.set_zf(unordered || equal);
+    cpu.set_pf(unordered);
+    cpu.set_cf(unordered || less);
+    cpu.set_of(false);
+    cpu.set_sf(false);
+    cpu.set_af(false);
+    fpu.set_c1(false);
+    if (pop)
+        fpu.pop();
+}
+
+static long double arithmetic(FPU& fpu, unsigned operation, long double a, long double b, u16& exceptions)
+{
+    switch (operation) {
+    case 0:
+        return compute(fpu, exceptions, a, b, [](auto x, auto y) { return x + y; });
+    case 1:
+        return compute(fpu, exceptions, a, b, [](auto x, auto y) { return x * y; });
+    case 4:
+        return compute(fpu, exceptions, a, b, [](auto x, auto y) { return x - y; });
+    case 5:
+        return compute(fpu, exceptions, a, b, [](auto x, auto y) { return y - x; });
+    case 6:
+        return compute(fpu, exceptions, a, b, [](auto x, auto y) { return x / y; });
+    case 7:
+        return compute(fpu, exceptions, a, b, [](auto x, auto y) { return y / x; });
+    }
+    ASSERT_NOT_REACHED();
+    return 0;
+}
+
+// The D8/DA/DC/DE groups: FADD, FMUL, FCOM, FCOMP, FSUB, FSUBR, FDIV, FDIVR.
+// Returns false if an unmasked fault left the stack alone, so the popping forms must not pop.
+static bool arithmetic_group(FPU& fpu, unsigned operation, unsigned destination, long double operand, bool operand_empty = false)
+{
+    if (operation == 2 || operation == 3) {
+        if (!compare_st0(fpu, operand, operand_empty, false))
+            return false;
+        if (operation == 3)
+            fpu.pop();
+        return true;
+    }
+    if (fpu.is_empty(destination) || operand_empty) {
+        if (!fpu.raise_stack_fault(false))
+            return false;
+        fpu.set_st(destination, FPU::indefinite());
+        return true;
+    }
+    u16 exceptions = 0;
+    long double result = arithmetic(fpu, operation, fpu.st(destination), operand, exceptions);
+    fpu.set_c1(false);
+    if (!fpu.raise(exceptions))
+        return false;
+    fpu.set_st(destination, result);
+    return true;
+}
+
+static bool store_st0_to_register(FPU& fpu, unsigned index)
+{
+    if (fpu.is_empty(0)) {
+        if (!fpu.raise_stack_fault(false))
+            return false;
+        fpu.set_st(index, FPU::indefinite());
+        return true;
+    }
+    fpu.set_st(index, fpu.st(0));
+    return true;
+}
+
+template<typename T>
+static bool store_st0_real(CPU& cpu, const MemoryOperand& m)
+{
+    auto& fpu = cpu.fpu();
+    T value;
+    if (fpu.is_empty(0)) {
+        if (!fpu.raise_stack_fault(false))
+            return false;
+        value = static_cast<T>(FPU::indefinite());
+    } else if (!round_to(fpu, fpu.st(0), value)) {
+        return false;
+    }
+    if constexpr (sizeof(T) == 4) {
+        u32 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        cpu.write_memory32(m.segment, m.offset, bits);
+    } else {
+        u64 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        snoop_write(cpu, m, 8);
+        write_memory64(cpu, m, bits);
+    }
+    return true;
+}
+
+static bool store_st0_extended(CPU& cpu, const MemoryOperand& m)
+{
+    auto& fpu = cpu.fpu();
+    long double value = fpu.st(0);
+    if (fpu.is_empty(0)) {
+        if (!fpu.raise_stack_fault(false))
+            return false;
+        value = FPU::indefinite();
+    }
+    u8 data[10];
+    FPU::store_extended(value, data);
+    snoop_write(cpu, m, 10);
+    write_memory80(cpu, m, data);
+    return true;
+}
+
+template<typename T>
+static bool store_st0_integer(CPU& cpu, const MemoryOperand& m, bool truncate)
+{
+    auto& fpu = cpu.fpu();
+    T value;
+    if (fpu.is_empty(0)) {
+        if (!fpu.raise_stack_fault(false))
+            return false;
+        value = std::numeric_limits<T>::min();
+    } else if (!round_to_integer(fpu, fpu.st(0), truncate, value)) {
+        return false;
+    }
+    if constexpr (sizeof(T) == 2) {
+        cpu.write_memory16(m.segment, m.offset, value);
+    } else if constexpr (sizeof(T) == 4) {
+        cpu.write_memory32(m.segment, m.offset, value);
+    } else {
+        snoop_write(cpu, m, 8);
+        write_memory64(cpu, m, value);
+    }
+    return true;
+}
+
+static long double load_bcd(CPU& cpu, const MemoryOperand& m)
+{
+    u8 data[10];
+    read_memory80(cpu, m, data);
+    u64 value = 0;
+    for (int i = 8; i >= 0; --i)
+        value = value * 100 + (data[i] >> 4) * 10 + (data[i] & 0xf);
+    long double result = value;
+    return (data[9] & 0x80) ? -result : result;
+}
+
+static bool store_bcd(CPU& cpu, const MemoryOperand& m)
+{
+    auto& fpu = cpu.fpu();
+    u8 data[10];
+    memset(data, 0, sizeof(data));
+
+    bool valid = !fpu.is_empty(0);
+    if (!valid && !fpu.raise_stack_fault(false))
+        return false;
+
+    if (valid) {
+        HostFloatingPointScope scope(fpu.rounding_mode());
+        volatile long double input = fpu.st(0);
+        volatile long double rounded = rintl(input);
+        u16 exceptions = scope.exceptions() & FPU::Status::PE;
+        if (isnan(rounded) || fabsl(rounded) > 999999999999999999.0L) {
+            if (!fpu.raise(FPU::Status::IE))
+                return false;
+            valid = false;
+        } else {
+            if (!fpu.raise(exceptions))
+                return false;
+            u64 value = fabsl(rounded);
+            for (unsigned i = 0; i < 9; ++i) {
+                data[i] = (value % 10) | ((value / 10 % 10) << 4);
+                value /= 100;
+            }
+            data[9] = signbit(rounded) ? 0x80 : 0;
+        }
+    }
+
+    if (!valid) {
+        // The packed BCD indefinite.
+        data[7] = 0xc0;
+        data[8] = 0xff;
+        data[9] = 0xff;
+    }
+
+    snoop_write(cpu, m, 10);
+    write_memory80(cpu, m, data);
+    return true;
+}
+
+struct Environment {
+    u16 control { 0 };
+    u16 status { 0 };
+    u16 tags { 0 };
+    u16 opcode { 0 };
+    u32 instruction_pointer { 0 };
+    u16 instruction_selector { 0 };
+    u32 operand_pointer { 0 };
+    u16 operand_selector { 0 };
+};
+
+static u32 environment_size(CPU& cpu)
+{
+    return cpu.o32() ? 28 : 14;
+}
+
+// The real mode layouts hold 20-bit linear pointers split across two fields.
+static Environment read_environment(CPU& cpu, const MemoryOperand& m)
+{
+    bool protected_mode = cpu.get_pe() && !cpu.get_vm();
+    Environment environment;
+    if (cpu.o32()) {
+        environment.control = cpu.read_memory32(m.segment, m.offset);
+        environment.status = cpu.read_memory32(m.segment, m.offset + 4);
+        environment.tags = cpu.read_memory32(m.segment, m.offset + 8);
+        u32 instruction_pointer = cpu.read_memory32(m.segment, m.offset + 12);
+        u32 selector_and_opcode = cpu.read_memory32(m.segment, m.offset + 16);
+        u32 operand_pointer = cpu.read_memory32(m.segment, m.offset + 20);
+        u32 operand_selector = cpu.read_memory32(m.segment, m.offset + 24);
+        if (protected_mode) {
+            environment.instruction_pointer = instruction_pointer;
+            environment.instruction_selector = selector_and_opcode;
+            environment.opcode = (selector_and_opcode >> 16) & 0x7ff;
+            environment.operand_pointer = operand_pointer;
+            environment.operand_selector = operand_selector;
+        } else {
+            environment.instruction_pointer = (instruction_pointer & 0xffff) | ((selector_and_opcode >> 12) << 16);
+            environment.opcode = selector_and_opcode & 0x7ff;
+            environment.operand_pointer = (operand_pointer & 0xffff) | ((operand_selector >> 12) << 16);
+        }
+    } else {
+        environment.control = cpu.read_memory16(m.segment, m.offset);
+        environment.status = cpu.read_memory16(m.segment, m.offset + 2);
+        environment.tags = cpu.read_memory16(m.segment, m.offset + 4);
+        u16 instruction_pointer = cpu.read_memory16(m.segment, m.offset + 6);
+        u16 selector_and_opcode = cpu.read_memory16(m.segment, m.offset + 8);
+        u16 operand_pointer = cpu.read_memory16(m.segment, m.offset + 10);
+        u16 operand_selector = cpu.read_memory16(m.segment, m.offset + 12);
+        if (protected_mode) {
+            environment.instruction_pointer = instruction_pointer;
+            environment.instruction_selector = selector_and_opcode;
+            environment.operand_pointer = operand_pointer;
+            environment.operand_selector = operand_selector;
+        } else {
+            environment.instruction_pointer = instruction_pointer | ((selector_and_opcode >> 12) << 16);
+            environment.opcode = selector_and_opcode & 0x7ff;
+            environment.operand_pointer = operand_pointer | ((operand_selector >> 12) << 16);
+        }
+    }
+    return environment;
+}
+
+// IRQ13 stays raised while the error that raised it is pending. Anything that can clear
+// the error summary (FNCLEX, FNINIT, FLDCW, loading an environment) releases it.
+static void release_error_signal(CPU& cpu)
+{
+    auto& fpu = cpu.fpu();
+    if (!fpu.m_error_signalled || fpu.has_pending_exception())
+        return;
+    fpu.m_error_signalled = false;
+    PIC::lower_irq(cpu.machine(), 13);
+}
+
+static void reinitialize(CPU& cpu)
+{
+    auto& fpu = cpu.fpu();
+    fpu.clear_exceptions();
+    release_error_signal(cpu);
+    fpu.initialize();
+}
+
+static void apply_environment(FPU& fpu, const Environment& environment)
+{
+    fpu.set_control_word(environment.control);
+    fpu.set_status_word(environment.status);
+    fpu.m_opcode = environment.opcode;
+    fpu.m_instruction_pointer = environment.instruction_pointer;
+    fpu.m_instruction_selector = environment.instruction_selector;
+    fpu.m_operand_pointer = environment.operand_pointer;
+    fpu.m_operand_selector = environment.operand_selector;
+}
+
+static void write_environment(CPU& cpu, const MemoryOperand& m)
+{
+    auto& fpu = cpu.fpu();
+    bool protected_mode = cpu.get_pe() && !cpu.get_vm();
+    u32 ip = fpu.m_instruction_pointer;
+    u32 dp = fpu.m_operand_pointer;
+    if (cpu.o32()) {
+        cpu.write_memory32(m.segment, m.offset, 0xffff0000 | fpu.control_word());
+        cpu.write_memory32(m.segment, m.offset + 4, 0xffff0000 | fpu.status_word());
+        cpu.write_memory32(m.segment, m.offset + 8, 0xffff0000 | fpu.tag_word());
+        if (protected_mode) {
+            cpu.write_memory32(m.segment, m.offset + 12, ip);
+            cpu.write_memory32(m.segment, m.offset + 16, ((u32)fpu.m_opcode << 16) | fpu.m_instruction_selector);
+            cpu.write_memory32(m.segment, m.offset + 20, dp);
+            cpu.write_memory32(m.segment, m.offset + 24, 0xffff0000 | fpu.m_operand_selector);
+        } else {
+            cpu.write_memory32(m.segment, m.offset + 12, 0xffff0000 | (ip & 0xffff));
+            cpu.write_memory32(m.segment, m.offset + 16, ((ip >> 16) << 12) | fpu.m_opcode);
+            cpu.write_memory32(m.segment, m.offset + 20, 0xffff0000 | (dp & 0xffff));
+            cpu.write_memory32(m.segment, m.offset + 24, (dp >> 16) << 12);
+        }
+    } else {
+        cpu.write_memory16(m.segment, m.offset, fpu.control_word());
+        cpu.write_memory16(m.segment, m.offset + 2, fpu.status_word());
+        cpu.write_memory16(m.segment, m.offset + 4, fpu.tag_word());
+        if (protected_mode) {
+            cpu.write_memory16(m.segment, m.offset + 6, ip);
+            cpu.write_memory16(m.segment, m.offset + 8, fpu.m_instruction_selector);
+            cpu.write_memory16(m.segment, m.offset + 10, dp);
+            cpu.write_memory16(m.segment, m.offset + 12, fpu.m_operand_selector);
+        } else {
+            cpu.write_memory16(m.segment, m.offset + 6, ip);
+            cpu.write_memory16(m.segment, m.offset + 8, (((ip >> 16) & 0xf) << 12) | fpu.m_opcode);
+            cpu.write_memory16(m.segment, m.offset + 10, dp);
+            cpu.write_memory16(m.segment, m.offset + 12, ((dp >> 16) & 0xf) << 12);
+        }
+    }
+}
+
+static void fldenv(CPU& cpu, const MemoryOperand& m)
+{
+    auto& fpu = cpu.fpu();
+    auto environment = read_environment(cpu, m);
+    apply_environment(fpu, environment);
+    fpu.set_tag_word(environment.tags);
+    release_error_signal(cpu);
+}
+
+static void fnstenv(CPU& cpu, const MemoryOperand& m)
+{
+    snoop_write(cpu, m, environment_size(cpu));
+    write_environment(cpu, m);
+    // FNSTENV masks all exceptions afterwards, like hardware.
+    auto& fpu = cpu.fpu();
+    fpu.set_control_word(fpu.control_word() | FPU::Control::ExceptionMask);
+    release_error_signal(cpu);
+}
+
+static void frstor(CPU& cpu, const MemoryOperand& m)
+{
+    auto& fpu = cpu.fpu();
+    auto environment = read_environment(cpu, m);
+    u32 base = environment_size(cpu);
+    long double registers[8];
+    for (unsigned i = 0; i < 8; ++i) {
+        u8 data[10];
+        read_memory80(cpu, m, data, base + i * 10);
+        registers[i] = FPU::load_extended(data);
+    }
+    apply_environment(fpu, environment);
+    for (unsigned i = 0; i < 8; ++i)
+        fpu.set_physical_register(fpu.physical_index(i), registers[i]);
+    fpu.set_tag_word(environment.tags);
+    release_error_signal(cpu);
+}
+
+static void fnsave(CPU& cpu, const MemoryOperand& m)
+{
+    auto& fpu = cpu.fpu();
+    u32 base = environment_size(cpu);
+    snoop_write(cpu, m, base + 80);
+    write_environment(cpu, m);
+    for (unsigned i = 0; i < 8; ++i) {
+        u8 data[10];
+        FPU::store_extended(fpu.physical_register(fpu.physical_index(i)), data);
+        write_memory80(cpu, m, data, base + i * 10);
+    }
+    reinitialize(cpu);
+}
+
+static void fxam(FPU& fpu)
+{
+    long double value = fpu.st(0);
+    bool sign = signbit(value);
+    if (fpu.is_empty(0)) {
+        fpu.set_condition_codes(true, false, sign, true);
+        return;
+    }
+    switch (fpclassify(value)) {
+    case FP_NAN:
+        fpu.set_condition_codes(false, false, sign, true);
+        break;
+    case FP_INFINITE:
+        fpu.set_condition_codes(false, true, sign, true);
+        break;
+    case FP_ZERO:
+        fpu.set_condition_codes(true, false, sign, false);
+        break;
+    case FP_SUBNORMAL:
+        fpu.set_condition_codes(true, true, sign, false);
+        break;
+    default:
+        fpu.set_condition_codes(false, true, sign, false);
+        break;
+    }
+}
+
+// FSIN, FCOS, FPTAN and FSINCOS leave operands outside +-2^63 alone and set C2.
+static bool out_of_trigonometric_range(FPU& fpu)
+{
+    bool out_of_range = fabsl(fpu.st(0)) >= 0x1p63L;
+    fpu.set_c2(out_of_range);
+    return out_of_range;
+}
+
+// ST(destination) = operation(ST(0), ST(1)), optionally popping afterwards.
+template<typename Operation>
+static void transcendental(FPU& fpu, unsigned destination, bool uses_st1, bool pop, Operation operation)
+{
+    if (fpu.is_empty(0) || (uses_st1 && fpu.is_empty(1))) {
+        if (!fpu.raise_stack_fault(false))
+            return;
+        fpu.set_st(destination, FPU::indefinite());
+    } else {
+        u16 exceptions = 0;
+        long double result = compute_extended(fpu, exceptions, fpu.st(0), fpu.st(1), operation);
+        fpu.set_c1(false);
+        if (!fpu.raise(exceptions))
+            return;
+        fpu.set_st(destination, result);
+    }
+    if (pop)
+        fpu.pop();
+}
+
+static void partial_remainder(FPU& fpu, bool ieee)
+{
+    if (underflow(fpu, fpu.is_empty(0) || fpu.is_empty(1), 0))
+        return;
+    long double a = fpu.st(0);
+    long double b = fpu.st(1);
+    if (isnan(a) || isnan(b)) {
+        fpu.set_st(0, a + b);
+        return;
+    }
+    if (isinf(a) || b == 0) {
+        if (fpu.raise(FPU::Status::IE))
+            fpu.set_st(0, FPU::indefinite());
+        return;
+    }
+    if (a == 0 || isinf(b)) {
+        fpu.set_condition_codes(false, false, false, false);
+        return;
+    }
+
+    int exponent_difference = ilogbl(a) - ilogbl(b);
+    if (exponent_difference >= 64) {
+        // Reduce by a power-of-two multiple of ST(1) and have the guest loop.
+        fpu.set_st(0, fmodl(a, ldexpl(b, exponent_difference - 32)));
+        fpu.set_c2(true);
+        return;
+    }
+
+    int quotient;
+    long double remainder = remquol(a, b, &quotient);
+    unsigned quotient_bits = quotient < 0 ? -quotient : quotient;
+    if (!ieee && remainder != 0 && signbit(remainder) != signbit(a)) {
+        // FPREM truncates the quotient where remquo rounds it to nearest.
+        remainder = fmodl(a, b);
+        --quotient_bits;
+    }
+    fpu.set_st(0, remainder);
+    fpu.set_condition_codes(quotient_bits & 2, false, quotient_bits & 1, quotient_bits & 4);
+}
+
+static void escape_d9_register(CPU& cpu, u8 modrm)
+{
+    auto& fpu = cpu.fpu();
+    unsigned index = modrm & 7;
+    switch (modrm) {
+    case 0xc0 ... 0xc7: { // FLD ST(i)
+        if (underflow(fpu, fpu.is_empty(index))) {
+            if (fpu.control_word() & FPU::Control::IM)
+                fpu.push(FPU::indefinite());
+            return;
+        }
+        fpu.push(fpu.st(index));
+        return;
+    }
+    case 0xc8 ... 0xcf: { // FXCH ST(i)
+        if (fpu.is_empty(0) || fpu.is_empty(index)) {
+            if (!fpu.raise_stack_fault(false))
+                return;
+            if (fpu.is_empty(0))
+                fpu.set_st(0, FPU::indefinite());
+            if (fpu.is_empty(index))
+                fpu.set_st(index, FPU::indefinite());
+        }
+        long double value = fpu.st(0);
+        fpu.set_st(0, fpu.st(index));
+        fpu.set_st(index, value);
+        fpu.set_c1(false);
+        return;
+    }
+    case 0xd0: // FNOP
+        return;
+    case 0xd8 ... 0xdf: // FSTP1 (undocumented alias of FSTP ST(i))
+        if (store_st0_to_register(fpu, index))
+            fpu.pop();
+        return;
+    case 0xe0: // FCHS
+        if (!underflow(fpu, fpu.is_empty(0), 0))
+            fpu.set_st(0, -fpu.st(0));
+        fpu.set_c1(false);
+        return;
+    case 0xe1: // FABS
+        if (!underflow(fpu, fpu.is_empty(0), 0))
+            fpu.set_st(0, fabsl(fpu.st(0)));
+        fpu.set_c1(false);
+        return;
+    case 0xe4: // FTST
+        if (underflow(fpu, fpu.is_empty(0)))
+            fpu.set_condition_codes(true, true, false, true);
+        else
+            compare(fpu, fpu.st(0), 0, false);
+        return;
+    case 0xe5: // FXAM
+        fxam(fpu);
+        return;
+    case 0xe8: // FLD1
+        fpu.push(1);
+        return;
+    case 0xe9: // FLDL2T
+        fpu.push(3.321928094887362347870319429489390175864831393L);
+        return;
+    case 0xea: // FLDL2E
+        fpu.push(1.442695040888963407359924681001892137426645954L);
+        return;
+    case 0xeb: // FLDPI
+        fpu.push(3.141592653589793238462643383279502884197169399L);
+        return;
+    case 0xec: // FLDLG2
+        fpu.push(0.301029995663981195213738894724493026768189881L);
+        return;
+    case 0xed: // FLDLN2
+        fpu.push(ln2);
+        return;
+    case 0xee: // FLDZ
+        fpu.push(0);
+        return;
+    case 0xf0: // F2XM1
+        transcendental(fpu, 0, false, false, [](long double x, long double) { return expm1l(x * ln2); });
+        return;
+    case 0xf1: // FYL2X
+        transcendental(fpu, 1, true, true, [](long double x, long double y) { return y * log2l(x); });
+        return;
+    case 0xf2: // FPTAN
+        if (underflow(fpu, fpu.is_empty(0), 0) || out_of_trigonometric_range(fpu))
+            return;
+        transcendental(fpu, 0, false, false, [](long double x, long double) { return tanl(x); });
+        fpu.push(1);
+        return;
+    case 0xf3: // FPATAN
+        transcendental(fpu, 1, true, true, [](long double x, long double y) { return atan2l(y, x); });
+        return;
+    case 0xf4: { // FXTRACT
+        if (underflow(fpu, fpu.is_empty(0), 0))
+            return;
+        long double value = fpu.st(0);
+        if (value == 0) {
+            if (!fpu.raise(FPU::Status::ZE))
+                return;
+            fpu.set_st(0, -__builtin_infl());
+            fpu.push(value);
+            return;
+        }
+        if (isnan(value) || isinf(value)) {
+            fpu.set_st(0, isnan(value) ? value : __builtin_infl());
+            fpu.push(value);
+            return;
+        }
+        int exponent = ilogbl(value);
+        fpu.set_st(0, exponent);
+        fpu.push(scalbnl(value, -exponent));
+        return;
+    }
+    case 0xf5: // FPREM1
+        partial_remainder(fpu, true);
+        return;
+    case 0xf6: // FDECSTP
+        fpu.decrement_top();
+        fpu.set_c1(false);
+        return;
+    case 0xf7: // FINCSTP
+        fpu.increment_top();
+        fpu.set_c1(false);
+        return;
+    case 0xf8: // FPREM
+        partial_remainder(fpu, false);
+        return;
+    case 0xf9: // FYL2XP1
+        transcendental(fpu, 1, true, true, [](long double x, long double y) { return y * (log1pl(x) / ln2); });
+        return;
+    case 0xfa: { // FSQRT
+        if (underflow(fpu, fpu.is_empty(0), 0))
+            return;
+        u16 exceptions = 0;
+        long double result = compute(fpu, exceptions, fpu.st(0), 0, [](auto x, auto) { return sqrt(x); });
+        if (fpu.raise(exceptions))
+            fpu.set_st(0, result);
+        return;
+    }
+    case 0xfb: { // FSINCOS
+        if (underflow(fpu, fpu.is_empty(0), 0) || out_of_trigonometric_range(fpu))
+            return;
+        u16 exceptions = 0;
+        long double value = fpu.st(0);
+        long double sine = compute_extended(fpu, exceptions, value, 0, [](long double x, long double) { return sinl(x); });
+        long double cosine = compute_extended(fpu, exceptions, value, 0, [](long double x, long double) { return cosl(x); });
+        if (!fpu.raise(exceptions))
+            return;
+        fpu.set_st(0, sine);
+        fpu.push(cosine);
+        return;
+    }
+    case 0xfc: // FRNDINT
+        transcendental(fpu, 0, false, false, [](long double x, long double) { return rintl(x); });
+        return;
+    case 0xfd: // FSCALE
+        transcendental(fpu, 0, true, false, [](long double x, long double y) {
+            long double scale = truncl(y);
+            if (isnan(scale))
+                return x + y;
+            if (scale > 65536)
+                scale = 65536;
+            if (scale < -65536)
+                scale = -65536;
+            return scalbnl(x, (int)scale);
+        });
+        return;
+    case 0xfe: // FSIN
+        if (underflow(fpu, fpu.is_empty(0), 0) || out_of_trigonometric_range(fpu))
+            return;
+        transcendental(fpu, 0, false, false, [](long double x, long double) { return sinl(x); });
+        return;
+    case 0xff: // FCOS
+        if (underflow(fpu, fpu.is_empty(0), 0) || out_of_trigonometric_range(fpu))
+            return;
+        transcendental(fpu, 0, false, false, [](long double x, long double) { return cosl(x); });
+        return;
+    }
+    throw cpu.InvalidOpcode("Undefined FPU instruction D9 %02x", modrm);
+}
+
+static bool fcmov_condition(CPU& cpu, u8 op, unsigned slash)
+{
+    bool condition;
+    switch (slash) {
+    case 0:
+        condition = cpu.get_cf();
+        break;
+    case 1:
+        condition = cpu.get_zf();
+        break;
+    case 2:
+        condition = cpu.get_cf() || cpu.get_zf();
+        break;
+    default:
+        condition = cpu.get_pf();
+        break;
+    }
+    // DB negates the DA conditions.
+    return op == 3 ? !condition : condition;
+}
+
+// Control instructions don't update the last instruction and operand pointers.
+static bool is_control_instruction(u8 op, u8 modrm)
+{
+    bool is_memory = modrm < 0xc0;
+    unsigned slash = (modrm >> 3) & 7;
+    switch (op) {
+    case 1:
+        return is_memory && slash >= 4;
+    case 3:
+        return modrm >= 0xe0 && modrm <= 0xe4;
+    case 5:
+        return is_memory && slash >= 4;
+    case 7:
+        return modrm == 0xe0;
+    }
+    return false;
+}
+
+// The FN- forms skip the check for a pending unmasked exception.
+static bool is_non_waiting_instruction(u8 op, u8 modrm)
+{
+    bool is_memory = modrm < 0xc0;
+    unsigned slash = (modrm >> 3) & 7;
+    switch (op) {
+    case 1:
+        return is_memory && (slash == 6 || slash == 7);
+    case 3:
+        return modrm >= 0xe0 && modrm <= 0xe4;
+    case 5:
+        return is_memory && (slash == 6 || slash == 7);
+    case 7:
+        return modrm == 0xe0;
+    }
+    return false;
+}
+
+static void signal_pending_exception(CPU& cpu)
+{
+    auto& fpu = cpu.fpu();
+    if (!fpu.has_pending_exception())
+        return;
+    if (cpu.get_cr0() & CPU::CR0::NE)
+        throw Exception(16, "FPU error");
+    // MS-DOS style reporting: IRQ13 via the PIC, once per error.
+    if (!fpu.m_error_signalled) {
+        fpu.m_error_signalled = true;
+        PIC::raise_irq(cpu.machine(), 13);
+    }
+}
 
 void CPU::_WAIT(Instruction&)
 {
-    vlog(LogFPU, "FPU wait");
+    if ((get_cr0() & (CR0::MP | CR0::TS)) == (CR0::MP | CR0::TS))
+        throw Exception(7, "WAIT with MP and TS set");
+    signal_pending_exception(*this);
 }
 
 void CPU::_ESCAPE(Instruction& insn)
 {
+#ifdef FPU_DEBUG
     vlog(LogFPU, "FPU escape via %02X %02X (or %02X /%u)",
         insn.op(), insn.rm(), insn.op(), insn.slash());
+#endif
 
     if (get_cr0() & CR0::EM || get_cr0() & CR0::TS)
         throw Exception(7, "No FPU");
+
+    u8 op = insn.op() & 7;
+    u8 modrm = insn.rm();
+    unsigned slash = insn.slash();
+    unsigned index = modrm & 7;
+
+    if (!is_non_waiting_instruction(op, modrm))
+        signal_pending_exception(*this);
+
+    MemoryOperand m {};
+    bool is_memory = !insn.modrm().is_register();
+    if (is_memory) {
+        m.segment = insn.modrm().segment();
+        m.offset = insn.modrm().offset();
+    }
+
+    if (!is_control_instruction(op, modrm)) {
+        bool protected_mode = get_pe() && !get_vm();
+        m_fpu.m_opcode = (op << 8) | modrm;
+        m_fpu.m_instruction_pointer = protected_mode ? get_base_eip() : ((u32)get_base_cs() << 4) + get_base_ip();
+        m_fpu.m_instruction_selector = protected_mode ? get_base_cs() : 0;
+        if (is_memory) {
+            u16 selector = read_segment_register(m.segment);
+            m_fpu.m_operand_pointer = protected_mode ? m.offset : ((u32)selector << 4) + (m.offset & 0xffff);
+            m_fpu.m_operand_selector = protected_mode ? selector : 0;
+        }
+    }
+
+    auto& fpu = m_fpu;
+
+    if (!is_memory) {
+        switch (op) {
+        case 0: // D8: arithmetic with ST(0) as destination
+            arithmetic_group(fpu, slash, 0, fpu.st(index), fpu.is_empty(index));
+            return;
+        case 1:
+            escape_d9_register(*this, modrm);
+            return;
+        case 2:
+            if (slash < 4) { // FCMOVcc
+                if (!underflow(fpu, fpu.is_empty(0) || fpu.is_empty(index), 0) && fcmov_condition(*this, op, slash))
+                    fpu.set_st(0, fpu.st(index));
+                return;
+            }
+            if (modrm == 0xe9) { // FUCOMPP
+                if (compare_st0(fpu, fpu.st(1), fpu.is_empty(1), true)) {
+                    fpu.pop();
+                    fpu.pop();
+                }
+                return;
+            }
+            break;
+        case 3:
+            if (slash < 4) { // FCMOVNcc
+                if (!underflow(fpu, fpu.is_empty(0) || fpu.is_empty(index), 0) && fcmov_condition(*this, op, slash))
+                    fpu.set_st(0, fpu.st(index));
+                return;
+            }
+            switch (modrm) {
+            case 0xe0: // FNENI
+            case 0xe1: // FNDISI
+            case 0xe4: // FNSETPM
+                return;
+            case 0xe2: // FNCLEX
+                fpu.clear_exceptions();
+                release_error_signal(*this);
+                return;
+            case 0xe3: // FNINIT
+                reinitialize(*this);
+                return;
+            }
+            if (slash == 5) { // FUCOMI
+                compare_to_eflags(*this, index, true, false);
+                return;
+            }
+            if (slash == 6) { // FCOMI
+                compare_to_eflags(*this, index, false, false);
+                return;
+            }
+            break;
+        case 4: // DC: arithmetic with ST(i) as destination; the reversed forms swap encodings
+            if (slash == 2 || slash == 3) { // FCOM2, FCOMP3 (undocumented)
+                arithmetic_group(fpu, slash, 0, fpu.st(index), fpu.is_empty(index));
+                return;
+            }
+            arithmetic_group(fpu, slash >= 4 ? slash ^ 1 : slash, index, fpu.st(0), fpu.is_empty(0));
+            return;
+        case 5:
+            switch (slash) {
+            case 0: // FFREE
+                fpu.free(index);
+                return;
+            case 1: // FXCH4 (undocumented)
+                escape_d9_register(*this, 0xc8 | index);
+                return;
+            case 2: // FST ST(i)
+                store_st0_to_register(fpu, index);
+                return;
+            case 3: // FSTP ST(i)
+                if (store_st0_to_register(fpu, index))
+                    fpu.pop();
+                return;
+            case 4: // FUCOM
+            case 5: // FUCOMP
+                if (compare_st0(fpu, fpu.st(index), fpu.is_empty(index), true) && slash == 5)
+                    fpu.pop();
+                return;
+            }
+            break;
+        case 6:
+            if (slash == 2 || modrm == 0xd9) { // FCOMP5 (undocumented), FCOMPP
+                unsigned source = slash == 2 ? index : 1;
+                if (arithmetic_group(fpu, 3, 0, fpu.st(source), fpu.is_empty(source)) && modrm == 0xd9)
+                    fpu.pop();
+                return;
+            }
+            if (slash == 3)
+                break;
+            if (arithmetic_group(fpu, slash >= 4 ? slash ^ 1 : slash, index, fpu.st(0), fpu.is_empty(0)))
+                fpu.pop();
+            return;
+        case 7:
+            switch (slash) {
+            case 0: // FFREEP
+                fpu.free(index);
+                fpu.pop();
+                return;
+            case 4:
+                if (modrm == 0xe0) { // FNSTSW AX
+                    set_ax(fpu.status_word());
+                    return;
+                }
+                break;
+            case 5: // FUCOMIP
+                compare_to_eflags(*this, index, true, true);
+                return;
+            case 6: // FCOMIP
+                compare_to_eflags(*this, index, false, true);
+                return;
+            }
+            break;
+        }
+        throw InvalidOpcode("Undefined FPU instruction %02x %02x", insn.op(), modrm);
+    }
+
+    switch (op) {
+    case 0: // D8: m32real arithmetic
+        arithmetic_group(fpu, slash, 0, load_real(fpu, read_m32real(*this, m)));
+        return;
+    case 1:
+        switch (slash) {
+        case 0: // FLD m32real
+            fpu.push(load_real(fpu, read_m32real(*this, m)));
+            return;
+        case 2: // FST m32real
+            store_st0_real<float>(*this, m);
+            return;
+        case 3: // FSTP m32real
+            if (store_st0_real<float>(*this, m))
+                fpu.pop();
+            return;
+        case 4: // FLDENV
+            fldenv(*this, m);
+            return;
+        case 5: // FLDCW
+            fpu.set_control_word(read_memory16(m.segment, m.offset));
+            release_error_signal(*this);
+            return;
+        case 6: // FNSTENV
+            fnstenv(*this, m);
+            return;
+        case 7: // FNSTCW
+            write_memory16(m.segment, m.offset, fpu.control_word());
+            return;
+        }
+        break;
+    case 2: // DA: m32int arithmetic
+        arithmetic_group(fpu, slash, 0, (i32)read_memory32(m.segment, m.offset));
+        return;
+    case 3:
+        switch (slash) {
+        case 0: // FILD m32int
+            fpu.push((i32)read_memory32(m.segment, m.offset));
+            return;
+        case 1: // FISTTP m32int
+        case 3: // FISTP m32int
+            if (store_st0_integer<i32>(*this, m, slash == 1))
+                fpu.pop();
+            return;
+        case 2: // FIST m32int
+            store_st0_integer<i32>(*this, m, false);
+            return;
+        case 5: { // FLD m80real
+            u8 data[10];
+            read_memory80(*this, m, data);
+            fpu.push(FPU::load_extended(data));
+            return;
+        }
+        case 7: // FSTP m80real
+            if (store_st0_extended(*this, m))
+                fpu.pop();
+            return;
+        }
+        break;
+    case 4: // DC: m64real arithmetic
+        arithmetic_group(fpu, slash, 0, load_real(fpu, read_m64real(*this, m)));
+        return;
+    case 5:
+        switch (slash) {
+        case 0: // FLD m64real
+            fpu.push(load_real(fpu, read_m64real(*this, m)));
+            return;
+        case 1: // FISTTP m64int
+            if (store_st0_integer<i64>(*this, m, true))
+                fpu.pop();
+            return;
+        case 2: // FST m64real
+            store_st0_real<double>(*this, m);
+            return;
+        case 3: // FSTP m64real
+            if (store_st0_real<double>(*this, m))
+                fpu.pop();
+            return;
+        case 4: // FRSTOR
+            frstor(*this, m);
+            return;
+        case 6: // FNSAVE
+            fnsave(*this, m);
+            return;
+        case 7: // FNSTSW m16
+            write_memory16(m.segment, m.offset, fpu.status_word());
+            return;
+        }
+        break;
+    case 6: // DE: m16int arithmetic
+        arithmetic_group(fpu, slash, 0, (i16)read_memory16(m.segment, m.offset));
+        return;
+    case 7:
+        switch (slash) {
+        case 0: // FILD m16int
+            fpu.push((i16)read_memory16(m.segment, m.offset));
+            return;
+        case 1: // FISTTP m16int
+        case 3: // FISTP m16int
+            if (store_st0_integer<i16>(*this, m, slash == 1))
+                fpu.pop();
+            return;
+        case 2: // FIST m16int
+            store_st0_integer<i16>(*this, m, false);
+            return;
+        case 4: // FBLD
+            fpu.push(load_bcd(*this, m));
+            return;
+        case 5: // FILD m64int
+            fpu.push((i64)read_memory64(*this, m));
+            return;
+        case 6: // FBSTP
+            if (store_bcd(*this, m))
+                fpu.pop();
+            return;
+        case 7: // FISTP m64int
+            if (store_st0_integer<i64>(*this, m, false))
+                fpu.pop();
+            return;
+        }
+        break;
+    }
+    throw InvalidOpcode("Undefined FPU instruction %02x /%u", insn.op(), slash);
 }
@@ -40,6 +40,10 @@ void CPU::_INT_imm8(Instruction& insn)
         }
     }
 #endif
+    if (get_vm() && get_vme() && is_vm86_interrupt_redirected(insn.imm8())) {
+        redirect_vm86_interrupt(insn.imm8());
+        return;
+    }
     interrupt(insn.imm8(), InterruptSource::Internal);
 }
 
@@ -59,8 +63,27 @@ void CPU::_INTO(Instruction&)
 
 void CPU::iret_from_vm86_mode()
 {
-    if (get_iopl() != 3)
-        throw GeneralProtectionFault(0, "IRET in VM86 mode with IOPL != 3");
+    if (get_iopl() != 3) {
+        if (!get_vme() || o32())
+            throw GeneralProtectionFault(0, "IRET in VM86 mode with IOPL != 3");
+
+        TransactionalPopper popper(*this);
+        u16 offset = popper.pop16();
+        u16 selector = popper.pop16();
+        u16 flags = popper.pop16();
+
+        if (flags & Flag::TF)
+            throw GeneralProtectionFault(0, "IRET in VME mode with TF=1");
+        if ((flags & Flag::IF) && get_vip())
+            throw GeneralProtectionFault(0, "IRET in VME mode setting IF with VIP=1");
+
+        set_cs(selector);
+        set_eip(offset);
+        set_eflags_respectfully(flags, get_cpl(), true);
+        set_vif(flags & Flag::IF);
+        popper.commit();
+        return;
+    }
 
     u8 original_cpl = get_cpl();
 
@@ -74,7 +97,7 @@ void CPU::iret_from_vm86_mode()
 
     set_cs(selector);
     set_eip(offset);
-    set_eflags_respectfully(flags, original_cpl);
+    set_eflags_respectfully(flags, original_cpl, true);
     popper.commit();
 }
 
@@ -91,7 +114,7 @@ void CPU::iret_from_real_mode()
     set_cs(selector);
     set_eip(offset);
 
-    set_eflags_respectfully(flags, 0);
+    set_eflags_respectfully(flags, 0, true);
 }
 
 void CPU::_IRET(Instruction&)
@@ -136,7 +159,7 @@ void CPU::_IRET(Instruction&)
     }
     protected_iret(popper, LogicalAddress(selector, offset));
 
-    set_eflags_respectfully(flags, original_cpl);
+    set_eflags_respectfully(flags, original_cpl, true);
 }
 
 static u16 makeErrorCode(u16 num, bool idt, CPU::InterruptSource source)
@@ -146,10 +169,10 @@ static u16 makeErrorCode(u16 num, bool idt, CPU::InterruptSource source)
     return (num & 0xfc) | (u16)source;
 }
 
-void CPU::interrupt_to_task_gate(u8, InterruptSource source, QVariant errorCode, Gate& gate)
+void CPU::interrupt_to_task_gate(u8, InterruptSource source, std::optional<u16> error_code, Gate& gate)
 {
     auto descriptor = get_descriptor(gate.selector());
-    if (options.trapint) {
+    if (options().trapint) {
         dump_descriptor(descriptor);
     }
     if (!descriptor.is_global()) {
@@ -166,11 +189,11 @@ void CPU::interrupt_to_task_gate(u8, InterruptSource source, QVariant errorCode,
         throw GeneralProtectionFault(makeErrorCode(gate.selector(), 0, source), "Interrupt to task gate referencing non-present TSS descriptor");
     }
     task_switch(gate.selector(), tssDescriptor, JumpType::INT);
-    if (errorCode.isValid()) {
+    if (error_code) {
         if (tssDescriptor.is_32bit())
-            push32(errorCode.value<u16>());
+            push32(*error_code);
         else
-            push16(errorCode.value<u16>());
+            push16(*error_code);
     }
 }
 
@@ -181,6 +204,50 @@ LogicalAddress CPU::get_real_mode_interrupt_vector(u8 index)
     return { selector, offset };
 }
 
+bool CPU::is_vm86_interrupt_redirected(u8 isr)
+{
+    ASSERT(get_vm() && get_vme());
+    auto tss = current_tss();
+    if (!tss.is_32bit() || m_tr.limit < 103)
+        throw GeneralProtectionFault(0, "VME interrupt redirection without a 32-bit TSS");
+
+    // The redirection bitmap is the 32 bytes right below the I/O map. A set bit means the
+    // interrupt goes to the protected mode handler as usual.
+    u16 iomapBase = tss.get_io_map_base();
+    if (iomapBase < 32 || m_tr.limit < iomapBase - 1)
+        throw GeneralProtectionFault(0, "TSS interrupt redirection map outside limit");
+
+    u8 bits = read_memory_metal<u8>(m_tr.base.offset(iomapBase - 32 + isr / 8));
+    return !(bits & (1 << (isr % 8)));
+}
+
+void CPU::redirect_vm86_interrupt(u8 isr)
+{
+    ASSERT(get_vm());
+    u16 offset = read_memory16(LinearAddress(isr * 4));
+    u16 selector = read_memory16(LinearAddress(isr * 4 + 2));
+
+    if (options().trapint)
+        vlog(LogCPU, "VME redirected interrupt %02x,%04x -> %04x:%04x", isr, get_ax(), selector, offset);
+
+    u16 flags = get_flags();
+    if (get_iopl() < 3)
+        flags = (flags & ~Flag::IF) | Flag::IOPL | (get_vif() * Flag::IF);
+
+    push16(flags);
+    push16(get_cs());
+    push16(get_ip());
+
+    if (get_iopl() < 3)
+        set_vif(0);
+    else
+        set_if(0);
+    set_tf(0);
+
+    set_cs(selector);
+    set_eip(offset);
+}
+
 void CPU::real_mode_interrupt(u8 isr, InterruptSource source)
 {
     ASSERT(!get_pe());
@@ -189,7 +256,7 @@ void CPU::real_mode_interrupt(u8 isr, InterruptSource source)
     u16 flags = get_flags();
     auto vector = get_real_mode_interrupt_vector(isr);
 
-    if (options.trapint)
+    if (options().trapint)
         vlog(LogCPU, "PE=0 interrupt %02x,%04x%s -> %04x:%04x", isr, get_ax(), source == InterruptSource::External ? " (external)" : "", vector.selector(), vector.offset());
 
 #ifdef LOG_FAR_JUMPS
@@ -219,12 +286,12 @@ static void logSerenitySyscall(CPU& cpu)
 
 static const int ignoredInterrupt = -1;
 
-void CPU::protected_mode_interrupt(u8 isr, InterruptSource source, QVariant errorCode)
+void CPU::protected_mode_interrupt(u8 isr, InterruptSource source, std::optional<u16> error_code)
 {
     ASSERT(get_pe());
 
 #ifdef DEBUG_SERENITY
-    bool logAsSyscall = options.trapint && options.serenity && isr == 0x80;
+    bool logAsSyscall = options().trapint && options().serenity && isr == 0x80;
 
     if (logAsSyscall)
         logSerenitySyscall(*this);
@@ -244,7 +311,7 @@ void CPU::protected_mode_interrupt(u8 isr, InterruptSource source, QVariant erro
 
     if (source == InterruptSource::Internal) {
         if (gate.dpl() < get_cpl()) {
-            throw GeneralProtectionFault(makeErrorCode(isr, 1, source), QString("Software interrupt trying to escalate privilege (CPL=%1, DPL=%2, VM=%3)").arg(get_cpl()).arg(gate.dpl()).arg(get_vm()));
+            throw GeneralProtectionFault(makeErrorCode(isr, 1, source), "Software interrupt trying to escalate privilege (CPL=%u, DPL=%u, VM=%u)", get_cpl(), gate.dpl(), get_vm());
         }
     }
 
@@ -258,19 +325,19 @@ void CPU::protected_mode_interrupt(u8 isr, InterruptSource source, QVariant erro
 
     auto entry = gate.entry();
 
-    if (options.trapint && !logAsSyscall && isr != ignoredInterrupt) {
+    if (options().trapint && !logAsSyscall && isr != ignoredInterrupt) {
         vlog(LogCPU, "PE=1 interrupt %02x,%04x%s, type: %s (%1x), %04x:%08x", isr, get_ax(), source == InterruptSource::External ? " (external)" : "", gate.type_name(), gate.type(), entry.selector(), entry.offset());
         dump_descriptor(gate);
     }
 
     if (gate.is_task_gate()) {
-        interrupt_to_task_gate(isr, source, errorCode, gate);
+        interrupt_to_task_gate(isr, source, error_code, gate);
         return;
     }
 
     auto descriptor = get_descriptor(gate.selector());
 
-    if (options.trapint && !logAsSyscall && isr != ignoredInterrupt) {
+    if (options().trapint && !logAsSyscall && isr != ignoredInterrupt) {
         dump_descriptor(descriptor);
     }
 
@@ -289,7 +356,7 @@ void CPU::protected_mode_interrupt(u8 isr, InterruptSource source, QVariant erro
 
     auto& codeDescriptor = descriptor.as_code_segment_descriptor();
     if (codeDescriptor.dpl() > get_cpl()) {
-        throw GeneralProtectionFault(makeErrorCode(gate.selector(), 0, source), QString("Interrupt gate to segment with DPL(%1)>CPL(%2)").arg(codeDescriptor.dpl()).arg(get_cpl()));
+        throw GeneralProtectionFault(makeErrorCode(gate.selector(), 0, source), "Interrupt gate to segment with DPL(%u)>CPL(%u)", codeDescriptor.dpl(), get_cpl());
     }
 
     if (!codeDescriptor.present()) {
@@ -318,7 +385,7 @@ void CPU::protected_mode_interrupt(u8 isr, InterruptSource source, QVariant erro
     }
 
     if (get_vm()) {
-        interrupt_from_vm86_mode(gate, offset, codeDescriptor, source, errorCode);
+        interrupt_from_vm86_mode(gate, offset, codeDescriptor, source, error_code);
         return;
     }
 
@@ -341,7 +408,7 @@ void CPU::protected_mode_interrupt(u8 isr, InterruptSource source, QVariant erro
         }
 
         if (newSSDescriptor.dpl() != descriptor.dpl()) {
-            throw InvalidTSS(makeErrorCode(newSS, 0, source), QString("New ss DPL(%1) != code segment DPL(%2)").arg(newSSDescriptor.dpl()).arg(descriptor.dpl()));
+            throw InvalidTSS(makeErrorCode(newSS, 0, source), "New ss DPL(%u) != code segment DPL(%u)", newSSDescriptor.dpl(), descriptor.dpl());
         }
 
         if (!newSSDescriptor.is_data() || !newSSDescriptor.as_data_segment_descriptor().writable()) {
@@ -387,8 +454,8 @@ void CPU::protected_mode_interrupt(u8 isr, InterruptSource source, QVariant erro
     push_value_with_size(flags, gate.size());
     push_value_with_size(originalCS, gate.size());
     push_value_with_size(originalEIP, gate.size());
-    if (errorCode.isValid()) {
-        push_value_with_size(errorCode.value<u16>(), gate.size());
+    if (error_code) {
+        push_value_with_size(*error_code, gate.size());
     }
 
     if (gate.is_interrupt_gate())
@@ -402,7 +469,7 @@ void CPU::protected_mode_interrupt(u8 isr, InterruptSource source, QVariant erro
     END_ASSERT_NO_EXCEPTIONS
 }
 
-void CPU::interrupt_from_vm86_mode(Gate& gate, u32 offset, CodeSegmentDescriptor& codeDescriptor, InterruptSource source, QVariant errorCode)
+void CPU::interrupt_from_vm86_mode(Gate& gate, u32 offset, CodeSegmentDescriptor& codeDescriptor, InterruptSource source, std::optional<u16> error_code)
 {
 #ifdef DEBUG_VM86
     vlog(LogCPU, "Interrupt from VM86 mode -> %04x:%08x", gate.selector(), offset);
@@ -431,11 +498,11 @@ void CPU::interrupt_from_vm86_mode(Gate& gate, u32 offset, CodeSegmentDescriptor
     }
 
     if ((newSS & 3) != 0) {
-        throw InvalidTSS(makeErrorCode(newSS, 0, source), QString("New ss RPL(%1) != 0").arg(newSS & 3));
+        throw InvalidTSS(makeErrorCode(newSS, 0, source), "New ss RPL(%u) != 0", newSS & 3);
     }
 
     if (newSSDescriptor.dpl() != 0) {
-        throw InvalidTSS(makeErrorCode(newSS, 0, source), QString("New ss DPL(%1) != 0").arg(newSSDescriptor.dpl()));
+        throw InvalidTSS(makeErrorCode(newSS, 0, source), "New ss DPL(%u) != 0", newSSDescriptor.dpl());
     }
 
     if (!newSSDescriptor.is_data() || !newSSDescriptor.as_data_segment_descriptor().writable()) {
@@ -478,8 +545,8 @@ void CPU::interrupt_from_vm86_mode(Gate& gate, u32 offset, CodeSegmentDescriptor
     push_value_with_size(originalFlags, gate.size());
     push_value_with_size(get_cs(), gate.size());
     push_value_with_size(get_eip(), gate.size());
-    if (errorCode.isValid()) {
-        push_value_with_size(errorCode.value<u16>(), gate.size());
+    if (error_code) {
+        push_value_with_size(*error_code, gate.size());
     }
     set_gs(0);
     set_fs(0);
@@ -491,10 +558,10 @@ void CPU::interrupt_from_vm86_mode(Gate& gate, u32 offset, CodeSegmentDescriptor
     END_ASSERT_NO_EXCEPTIONS
 }
 
-void CPU::interrupt(u8 isr, InterruptSource source, QVariant errorCode)
+void CPU::interrupt(u8 isr, InterruptSource source, std::optional<u16> error_code)
 {
     if (get_pe())
-        protected_mode_interrupt(isr, source, errorCode);
+        protected_mode_interrupt(isr, source, error_code);
     else
         real_mode_interrupt(isr, source);
 }
@@ -532,7 +599,7 @@ void CPU::protected_iret(TransactionalPopper& popper, LogicalAddress address)
     }
 
     if (selectorRPL < get_cpl())
-        throw GeneralProtectionFault(selector & 0xfffc, QString("IRET with RPL(%1) < CPL(%2)").arg(selectorRPL).arg(get_cpl()));
+        throw GeneralProtectionFault(selector & 0xfffc, "IRET with RPL(%u) < CPL(%u)", selectorRPL, get_cpl());
 
     auto& codeSegment = descriptor.as_code_segment_descriptor();
 
@@ -599,16 +666,22 @@ void CPU::iret_to_vm86_mode(TransactionalPopper& popper, LogicalAddress entry, u
     if (entry.offset() & 0xffff0000)
         throw GeneralProtectionFault(0, "IRET to VM86 with offset > 0xffff");
 
+    // Pop the rest of the frame before entering VM86 mode, while the stack is still accessed at CPL 0.
+    u32 newESP = popper.pop32();
+    u16 newSS = popper.pop32();
+    u16 newES = popper.pop32();
+    u16 newDS = popper.pop32();
+    u16 newFS = popper.pop32();
+    u16 newGS = popper.pop32();
+
     set_eflags(flags);
     set_cs(entry.selector());
     set_eip(entry.offset());
 
-    u32 newESP = popper.pop32();
-    u16 newSS = popper.pop32();
-    set_es(popper.pop32());
-    set_ds(popper.pop32());
-    set_fs(popper.pop32());
-    set_gs(popper.pop32());
+    set_es(newES);
+    set_ds(newDS);
+    set_fs(newFS);
+    set_gs(newGS);
     set_cpl(3);
     set_esp(newESP);
     set_ss(newSS);
@@ -28,6 +28,7 @@
 #include "debug.h"
 #include "iodevice.h"
 #include "machine.h"
+#include <string.h>
 
 void CPU::_OUT_imm8_AL(Instruction& insn)
 {
@@ -96,6 +97,8 @@ void CPU::validate_io_access(u16 port)
         return;
     if (!get_vm() && !(get_cpl() > get_iopl()))
         return;
+    if (is_io_access_known_permitted(port, sizeof(T)))
+        return;
     auto tss = current_tss();
     if (!tss.is_32bit()) {
         vlog(LogCPU, "validateIOAccess for 16-bit TSS, what do?");
@@ -113,9 +116,47 @@ void CPU::validate_io_access(u16 port)
 
     u16 mask = (1 << (sizeof(T) - 1)) << (port & 7);
     LinearAddress address = m_tr.base.offset(iomapBase + (port / 8));
-    u16 perm = mask & 0xff00 ? read_memory16(address) : read_memory8(address);
+    u16 perm = mask & 0xff00 ? read_memory_metal16(address) : read_memory_metal<u8>(address);
     if (perm & mask)
         throw GeneralProtectionFault(0, "I/O map disallowed access");
+
+    remember_io_permissions(port & ~7, perm, mask & 0xff00 ? 16 : 8);
+}
+
+bool CPU::is_io_access_known_permitted(u16 port, unsigned size) const
+{
+    if (!m_io_permission_cache_populated)
+        return false;
+    if (port + size - 1 > 0xffff)
+        return false;
+    for (unsigned i = 0; i < size; ++i) {
+        unsigned p = port + i;
+        if (!(m_io_permitted_ports[p / 64] & (1ULL << (p % 64))))
+            return false;
+    }
+    return true;
+}
+
+void CPU::remember_io_permissions(u16 first_port, u16 bitmap_bits, unsigned port_count)
+{
+    if (!m_io_permission_cache_populated) {
+        memset(m_io_permitted_ports, 0, sizeof(m_io_permitted_ports));
+        m_io_permission_cache_populated = true;
+        watch_table_pages(m_tr.base, m_tr.limit);
+    }
+
+    for (unsigned i = 0; i < port_count; ++i) {
+        unsigned p = first_port + i;
+        if (p > 0xffff)
+            break;
+        if (!(bitmap_bits & (1 << i)))
+            m_io_permitted_ports[p / 64] |= 1ULL << (p % 64);
+    }
+}
+
+void CPU::invalidate_io_permission_cache()
+{
+    m_io_permission_cache_populated = false;
 }
 
 // Important note from IA32 manual, regarding string I/O instructions:
@@ -128,19 +169,13 @@ void CPU::out(u16 port, T data)
 {
     validate_io_access<T>(port);
 
-    if (options.iopeek) {
+    if (options().iopeek) {
         if (port != 0x00E6 && port != 0x0020 && port != 0x3D4 && port != 0x03d5 && port != 0xe2 && port != 0xe0 && port != 0x92) {
             vlog(LogIO, "CPU::out<%zu>: %x --> %03x", sizeof(T) * 8, data, port);
         }
     }
 
-    if (auto* device = machine().output_device_for_port(port)) {
-        device->out<T>(port, data);
-        return;
-    }
-
-    if (!IODevice::should_ignore_port(port))
-        vlog(LogAlert, "Unhandled I/O write to port %03x, data %x", port, data);
+    machine().io_port_handler(port).out<T>(port, data);
 }
 
 template<typename T>
@@ -148,16 +183,9 @@ T CPU::in(u16 port)
 {
     validate_io_access<T>(port);
 
-    T data;
-    if (auto* device = machine().input_device_for_port(port)) {
-        data = device->in<T>(port);
-    } else {
-        if (!IODevice::should_ignore_port(port))
-            vlog(LogAlert, "Unhandled I/O read from port %03x", port);
-        data = IODevice::JunkValue;
-    }
+    T data = machine().io_port_handler(port).in<T>(port);
 
-    if (options.iopeek) {
+    if (options().iopeek) {
         if (port != 0xe6 && port != 0x20 && port != 0x3d4 && port != 0x03d5 && port != 0x3da && port != 0x92) {
             vlog(LogIO, "CPU::in<%zu>: %03x = %x", sizeof(T) * 8, port, data);
         }
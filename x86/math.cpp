@@ -183,7 +183,7 @@ void CPU::doDIV(T dividendHigh, T dividendLow, T divisor, T& quotient, T& remain
     DT dividend = weld<DT>(dividendHigh, dividendLow);
     DT result = dividend / divisor;
     if (result > std::numeric_limits<T>::max() || result < std::numeric_limits<T>::min()) {
-        throw DivideError(QString("Divide overflow (%1 / %2 = %3 { range = %4 - %5 })").arg(dividend).arg(divisor).arg(result).arg(std::numeric_limits<T>::min()).arg(std::numeric_limits<T>::max()));
+        throw DivideError("Divide overflow (%lld / %lld = %lld { range = %lld - %lld })", (long long)dividend, (long long)divisor, (long long)result, (long long)std::numeric_limits<T>::min(), (long long)std::numeric_limits<T>::max());
     }
 
     quotient = result;
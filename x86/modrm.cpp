@@ -32,15 +32,6 @@
         m_segment = SegmentRegisterIndex::SS; \
     }
 
-void MemoryOrRegisterReference::write_special(u32 data, bool o32)
-{
-    if (o32 && is_register()) {
-        m_cpu->write_register<u32>(m_register_index, data);
-        return;
-    }
-    return write<u16>(data & 0xffff);
-}
-
 FLATTEN void MemoryOrRegisterReference::resolve(CPU& cpu)
 {
     m_cpu = &cpu;
@@ -125,7 +125,7 @@ void CPU::_MOV_reg32_CR(Instruction& insn)
         // table (PDPT) and the loading of a control register causes the
         // PDPT to be loaded into the processor.
         if (get_cpl() != 0) {
-            throw GeneralProtectionFault(0, QString("MOV reg32, CRx with CPL!=0(%1)").arg(get_cpl()));
+            throw GeneralProtectionFault(0, "MOV reg32, CRx with CPL!=0(%u)", get_cpl());
         }
     } else {
         // FIXME: GP(0) conditions:
@@ -160,7 +160,7 @@ void CPU::_MOV_CR_reg32(Instruction& insn)
         // table (PDPT) and the loading of a control register causes the
         // PDPT to be loaded into the processor.
         if (get_cpl() != 0) {
-            throw GeneralProtectionFault(0, QString("MOV CRx, reg32 with CPL!=0(%1)").arg(get_cpl()));
+            throw GeneralProtectionFault(0, "MOV CRx, reg32 with CPL!=0(%u)", get_cpl());
         }
     } else {
         // FIXME: GP(0) conditions:
@@ -172,13 +172,20 @@ void CPU::_MOV_CR_reg32(Instruction& insn)
 
     auto value = read_register<u32>(static_cast<CPU::RegisterIndex32>(insn.rm() & 7));
 
-    if (crIndex == 4) {
-        vlog(LogCPU, "CR4 written (%08x) but not supported!", value);
+    if (crIndex == 4 && (value & ~(CR4::VME | CR4::PVI | CR4::TSD))) {
+        vlog(LogCPU, "CR4 written (%08x) with unsupported bits!", value);
+    }
+    if (crIndex == 0) {
+        // The 387 is always present.
+        value |= CR0::ET;
     }
     set_control_register(crIndex, value);
 
-    if (crIndex == 0 || crIndex == 3)
+    if (crIndex == 0 || crIndex == 3) {
         update_code_segment_cache();
+        update_execution_mode();
+        invalidate_table_caches();
+    }
 
 #ifdef VERBOSE_DEBUG
     vlog(LogCPU, "MOV CR%u <- %08X", crIndex, getControlRegister(crIndex));
@@ -196,7 +203,7 @@ void CPU::_MOV_reg32_DR(Instruction& insn)
 
     if (get_pe()) {
         if (get_cpl() != 0) {
-            throw GeneralProtectionFault(0, QString("MOV reg32, DRx with CPL!=0(%1)").arg(get_cpl()));
+            throw GeneralProtectionFault(0, "MOV reg32, DRx with CPL!=0(%u)", get_cpl());
         }
     }
 
@@ -215,7 +222,7 @@ void CPU::_MOV_DR_reg32(Instruction& insn)
 
     if (get_pe()) {
         if (get_cpl() != 0) {
-            throw GeneralProtectionFault(0, QString("MOV DRx, reg32 with CPL!=0(%1)").arg(get_cpl()));
+            throw GeneralProtectionFault(0, "MOV DRx, reg32 with CPL!=0(%u)", get_cpl());
         }
     }
 
@@ -24,13 +24,15 @@
 
 #include "CPU.h"
 #include "debugger.h"
+#include <stdarg.h>
+#include <stdio.h>
 
 //#define DEBUG_DESCRIPTOR_TABLES
 
 void CPU::doSGDTorSIDT(Instruction& insn, DescriptorTableRegister& table)
 {
     if (insn.modrm().is_register())
-        throw InvalidOpcode(QString("%1 with register destination").arg(insn.mnemonic()));
+        throw InvalidOpcode("%s with register destination", table.name());
 
     snoop(insn.modrm().segment(), insn.modrm().offset(), MemoryAccessType::Write);
     snoop(insn.modrm().segment(), insn.modrm().offset() + 6, MemoryAccessType::Write);
@@ -78,6 +80,7 @@ void CPU::set_ldt(u16 selector)
     m_ldtr.set_selector(selector);
     m_ldtr.set_base(base);
     m_ldtr.set_limit(limit);
+    invalidate_ldt_cache();
 
 #ifdef DEBUG_DESCRIPTOR_TABLES
     vlog(LogAlert, "setLDT { segment: %04X => base:%08X, limit:%08X }", m_LDTR.selector(), m_LDTR.base(), m_LDTR.limit());
@@ -109,10 +112,10 @@ void CPU::dump_ldt()
 void CPU::doLGDTorLIDT(Instruction& insn, DescriptorTableRegister& table)
 {
     if (insn.modrm().is_register())
-        throw InvalidOpcode(QString("%1 with register source").arg(insn.mnemonic()));
+        throw InvalidOpcode("%s with register source", table.name());
 
     if (get_cpl() != 0)
-        throw GeneralProtectionFault(0, QString("%1 with CPL != 0").arg(insn.mnemonic()));
+        throw GeneralProtectionFault(0, "%s with CPL != 0", table.name());
 
     u32 base = read_memory32(insn.modrm().segment(), insn.modrm().offset() + 2);
     u16 limit = read_memory16(insn.modrm().segment(), insn.modrm().offset());
@@ -124,6 +127,7 @@ void CPU::doLGDTorLIDT(Instruction& insn, DescriptorTableRegister& table)
 void CPU::_LGDT(Instruction& insn)
 {
     doLGDTorLIDT(insn, m_gdtr);
+    invalidate_gdt_cache();
 #ifdef DEBUG_DESCRIPTOR_TABLES
     vlog(LogAlert, "LGDT { base:%08X, limit:%08X }", m_GDTR.base().get(), m_GDTR.limit());
     dumpGDT();
@@ -133,6 +137,7 @@ void CPU::_LGDT(Instruction& insn)
 void CPU::_LIDT(Instruction& insn)
 {
     doLGDTorLIDT(insn, m_idtr);
+    invalidate_idt_cache();
 #if DEBUG_DESCRIPTOR_TABLES
     dumpIDT();
 #endif
@@ -160,7 +165,7 @@ void CPU::_CLTS(Instruction&)
 {
     if (get_pe()) {
         if (get_cpl() != 0) {
-            throw GeneralProtectionFault(0, QString("CLTS with CPL!=0(%1)").arg(get_cpl()));
+            throw GeneralProtectionFault(0, "CLTS with CPL!=0(%u)", get_cpl());
         }
     }
     m_cr0 &= ~(1 << 3);
@@ -170,7 +175,7 @@ void CPU::_LMSW_RM16(Instruction& insn)
 {
     if (get_pe()) {
         if (get_cpl() != 0) {
-            throw GeneralProtectionFault(0, QString("LMSW with CPL!=0(%1)").arg(get_cpl()));
+            throw GeneralProtectionFault(0, "LMSW with CPL!=0(%u)", get_cpl());
         }
     }
 
@@ -182,6 +187,7 @@ void CPU::_LMSW_RM16(Instruction& insn)
     }
 
     m_cr0 = (m_cr0 & 0xFFFFFFF0) | (msw & 0x0F);
+    update_execution_mode();
 #ifdef PMODE_DEBUG
     vlog(LogCPU, "LMSW set CR0=%08X, PE=%u", getCR0(), get_pe());
 #endif
@@ -320,7 +326,7 @@ const char* toString(SegmentRegisterIndex segment)
 
 void CPU::raise_exception(const Exception& e)
 {
-    if (options.crash_on_exception) {
+    if (options().crash_on_exception) {
         dump_all();
         vlog(LogAlert, "CRASH ON EXCEPTION");
         ASSERT_NOT_REACHED();
@@ -333,21 +339,34 @@ void CPU::raise_exception(const Exception& e)
         } else {
             interrupt(e.num(), InterruptSource::External);
         }
-    } catch (Exception e) {
+    } catch (const Exception& e) {
         ASSERT_NOT_REACHED();
     }
 }
 
-Exception CPU::GeneralProtectionFault(u16 code, const QString& reason)
+static void log_exception(const char* what, const char* reason, va_list ap)
 {
-    u16 selector = code & 0xfff8;
-    bool TI = code & 4;
-    bool I = code & 2;
-    bool EX = code & 1;
+    char formatted_reason[256];
+    vsnprintf(formatted_reason, sizeof(formatted_reason), reason, ap);
+    vlog(LogCPU, "Exception: %s :: %s", what, formatted_reason);
+}
+
+#define LOG_EXCEPTION(what)                     \
+    do {                                        \
+        va_list ap;                             \
+        va_start(ap, reason);                   \
+        log_exception(what, reason, ap);        \
+        va_end(ap);                             \
+    } while (0)
 
-    if (options.log_exceptions)
-        vlog(LogCPU, "Exception: #GP(%04x) selector=%04X, TI=%u, I=%u, EX=%u :: %s", code, selector, TI, I, EX, qPrintable(reason));
-    if (options.crash_on_general_protection_fault) {
+Exception CPU::GeneralProtectionFault(u16 code, const char* reason, ...)
+{
+    if (options().log_exceptions) {
+        char what[64];
+        snprintf(what, sizeof(what), "#GP(%04x) selector=%04X, TI=%u, I=%u, EX=%u", code, code & 0xfff8, !!(code & 4), !!(code & 2), code & 1);
+        LOG_EXCEPTION(what);
+    }
+    if (options().crash_on_general_protection_fault) {
         dump_all();
         vlog(LogAlert, "CRASH ON GPF");
         ASSERT_NOT_REACHED();
@@ -355,45 +374,54 @@ Exception CPU::GeneralProtectionFault(u16 code, const QString& reason)
     return Exception(0xd, code, reason);
 }
 
-Exception CPU::StackFault(u16 selector, const QString& reason)
+Exception CPU::StackFault(u16 selector, const char* reason, ...)
 {
-    if (options.log_exceptions)
-        vlog(LogCPU, "Exception: #SS(%04x) :: %s", selector, qPrintable(reason));
+    if (options().log_exceptions) {
+        char what[16];
+        snprintf(what, sizeof(what), "#SS(%04x)", selector);
+        LOG_EXCEPTION(what);
+    }
     return Exception(0xc, selector, reason);
 }
 
-Exception CPU::NotPresent(u16 selector, const QString& reason)
+Exception CPU::NotPresent(u16 selector, const char* reason, ...)
 {
-    if (options.log_exceptions)
-        vlog(LogCPU, "Exception: #NP(%04x) :: %s", selector, qPrintable(reason));
+    if (options().log_exceptions) {
+        char what[16];
+        snprintf(what, sizeof(what), "#NP(%04x)", selector);
+        LOG_EXCEPTION(what);
+    }
     return Exception(0xb, selector, reason);
 }
 
-Exception CPU::InvalidOpcode(const QString& reason)
+Exception CPU::InvalidOpcode(const char* reason, ...)
 {
-    if (options.log_exceptions)
-        vlog(LogCPU, "Exception: #UD :: %s", qPrintable(reason));
+    if (options().log_exceptions)
+        LOG_EXCEPTION("#UD");
     return Exception(0x6, reason);
 }
 
-Exception CPU::BoundRangeExceeded(const QString& reason)
+Exception CPU::BoundRangeExceeded(const char* reason, ...)
 {
-    if (options.log_exceptions)
-        vlog(LogCPU, "Exception: #BR :: %s", qPrintable(reason));
+    if (options().log_exceptions)
+        LOG_EXCEPTION("#BR");
     return Exception(0x5, reason);
 }
 
-Exception CPU::InvalidTSS(u16 selector, const QString& reason)
+Exception CPU::InvalidTSS(u16 selector, const char* reason, ...)
 {
-    if (options.log_exceptions)
-        vlog(LogCPU, "Exception: #TS(%04x) :: %s", selector, qPrintable(reason));
+    if (options().log_exceptions) {
+        char what[16];
+        snprintf(what, sizeof(what), "#TS(%04x)", selector);
+        LOG_EXCEPTION(what);
+    }
     return Exception(0xa, selector, reason);
 }
 
-Exception CPU::DivideError(const QString& reason)
+Exception CPU::DivideError(const char* reason, ...)
 {
-    if (options.log_exceptions)
-        vlog(LogCPU, "Exception: #DE :: %s", qPrintable(reason));
+    if (options().log_exceptions)
+        LOG_EXCEPTION("#DE");
     return Exception(0x0, reason);
 }
 
@@ -413,13 +441,13 @@ void CPU::validate_segment_load(SegmentRegisterIndex reg, u16 selector, const De
             throw GeneralProtectionFault(0, "ss loaded with null descriptor");
         }
         if (selectorRPL != get_cpl()) {
-            throw GeneralProtectionFault(selector & 0xfffc, QString("ss selector RPL(%1) != CPL(%2)").arg(selectorRPL).arg(get_cpl()));
+            throw GeneralProtectionFault(selector & 0xfffc, "ss selector RPL(%u) != CPL(%u)", selectorRPL, get_cpl());
         }
         if (!descriptor.is_data() || !descriptor.as_data_segment_descriptor().writable()) {
             throw GeneralProtectionFault(selector & 0xfffc, "ss loaded with something other than a writable data segment");
         }
         if (descriptor.dpl() != get_cpl()) {
-            throw GeneralProtectionFault(selector & 0xfffc, QString("ss selector leads to descriptor with DPL(%1) != CPL(%2)").arg(descriptor.dpl()).arg(get_cpl()));
+            throw GeneralProtectionFault(selector & 0xfffc, "ss selector leads to descriptor with DPL(%u) != CPL(%u)", descriptor.dpl(), get_cpl());
         }
         if (!descriptor.present()) {
             throw StackFault(selector & 0xfffc, "ss loaded with non-present segment");
@@ -435,24 +463,24 @@ void CPU::validate_segment_load(SegmentRegisterIndex reg, u16 selector, const De
         || reg == SegmentRegisterIndex::FS
         || reg == SegmentRegisterIndex::GS) {
         if (!descriptor.is_data() && (descriptor.is_code() && !descriptor.as_code_segment_descriptor().readable())) {
-            throw GeneralProtectionFault(selector & 0xfffc, QString("%1 loaded with non-data or non-readable code segment").arg(register_name(reg)));
+            throw GeneralProtectionFault(selector & 0xfffc, "%s loaded with non-data or non-readable code segment", register_name(reg));
         }
         if (descriptor.is_data() || descriptor.is_nonconforming_code()) {
             if (selectorRPL > descriptor.dpl()) {
-                throw GeneralProtectionFault(selector & 0xfffc, QString("%1 loaded with data or non-conforming code segment and RPL > DPL").arg(register_name(reg)));
+                throw GeneralProtectionFault(selector & 0xfffc, "%s loaded with data or non-conforming code segment and RPL > DPL", register_name(reg));
             }
             if (get_cpl() > descriptor.dpl()) {
-                throw GeneralProtectionFault(selector & 0xfffc, QString("%1 loaded with data or non-conforming code segment and CPL > DPL").arg(register_name(reg)));
+                throw GeneralProtectionFault(selector & 0xfffc, "%s loaded with data or non-conforming code segment and CPL > DPL", register_name(reg));
             }
         }
         if (!descriptor.present()) {
-            throw NotPresent(selector & 0xfffc, QString("%1 loaded with non-present segment").arg(register_name(reg)));
+            throw NotPresent(selector & 0xfffc, "%s loaded with non-present segment", register_name(reg));
         }
     }
 
     if (!descriptor.is_null() && !descriptor.is_segment_descriptor()) {
         dump_descriptor(descriptor);
-        throw GeneralProtectionFault(selector & 0xfffc, QString("%1 loaded with system segment").arg(register_name(reg)));
+        throw GeneralProtectionFault(selector & 0xfffc, "%s loaded with system segment", register_name(reg));
     }
 }
 
@@ -479,7 +507,7 @@ void CPU::write_segment_register(SegmentRegisterIndex segreg, u16 selector)
 
     ASSERT(descriptor.is_segment_descriptor());
     cached_descriptor(segreg) = descriptor.as_segment_descriptor();
-    if (options.pedebug) {
+    if (options().pedebug) {
         if (get_pe()) {
             vlog(LogCPU, "%s loaded with %04x { type:%02X, base:%08X, limit:%08X }",
                 toString(segreg),
@@ -500,6 +528,7 @@ void CPU::write_segment_register(SegmentRegisterIndex segreg, u16 selector)
         }
         update_default_sizes();
         update_code_segment_cache();
+        update_execution_mode();
         break;
     case SegmentRegisterIndex::SS:
         cached_descriptor(SegmentRegisterIndex::SS).m_loaded_in_ss = true;
@@ -36,7 +36,7 @@ void CPU::push_segment_register_value(u16 value)
         new_esp &= 0xffff;
     write_memory16(SegmentRegisterIndex::SS, new_esp, value);
     adjust_stack_pointer(-4);
-    if (UNLIKELY(options.stacklog))
+    if (UNLIKELY(options().stacklog))
         vlog(LogCPU, "push32: %04x (at esp=%08x, special 16-bit write for segment registers)", value, get_esp());
 }
 
@@ -47,7 +47,7 @@ void CPU::push32(u32 value)
         new_esp &= 0xffff;
     write_memory32(SegmentRegisterIndex::SS, new_esp, value);
     adjust_stack_pointer(-4);
-    if (UNLIKELY(options.stacklog))
+    if (UNLIKELY(options().stacklog))
         vlog(LogCPU, "push32: %08x (at esp=%08x)", value, current_stack_pointer());
 }
 
@@ -58,14 +58,14 @@ void CPU::push16(u16 value)
         new_esp &= 0xffff;
     write_memory16(SegmentRegisterIndex::SS, new_esp, value);
     adjust_stack_pointer(-2);
-    if (UNLIKELY(options.stacklog))
+    if (UNLIKELY(options().stacklog))
         vlog(LogCPU, "push16: %04x (at esp=%08x)", value, current_stack_pointer());
 }
 
 u32 CPU::pop32()
 {
     u32 data = read_memory32(SegmentRegisterIndex::SS, current_stack_pointer());
-    if (UNLIKELY(options.stacklog))
+    if (UNLIKELY(options().stacklog))
         vlog(LogCPU, "pop32: %08x (from esp=%08x)", data, current_stack_pointer());
     adjust_stack_pointer(4);
     return data;
@@ -74,7 +74,7 @@ u32 CPU::pop32()
 u16 CPU::pop16()
 {
     u16 data = read_memory16(SegmentRegisterIndex::SS, current_stack_pointer());
-    if (UNLIKELY(options.stacklog))
+    if (UNLIKELY(options().stacklog))
         vlog(LogCPU, "pop16: %04x (from esp=%08x)", data, current_stack_pointer());
     adjust_stack_pointer(2);
     return data;
@@ -200,33 +200,54 @@ void CPU::_PUSH_imm32(Instruction& insn)
 
 void CPU::_PUSHF(Instruction&)
 {
-    if (get_pe() && get_vm() && get_iopl() < 3)
-        throw GeneralProtectionFault(0, "PUSHF in VM86 mode with IOPL < 3");
+    if (get_pe() && get_vm() && get_iopl() < 3) {
+        if (!get_vme())
+            throw GeneralProtectionFault(0, "PUSHF in VM86 mode with IOPL < 3");
+        // VME: the guest sees VIF as IF, and IOPL as 3.
+        u16 flags = get_flags() & ~Flag::IF;
+        push16(flags | Flag::IOPL | (get_vif() * Flag::IF));
+        return;
+    }
     push16(get_flags());
 }
 
 void CPU::_POPF(Instruction&)
 {
-    if (get_pe() && get_vm() && get_iopl() < 3)
-        throw GeneralProtectionFault(0, "POPF in VM86 mode with IOPL < 3");
-    set_eflags_respectfully(pop16(), get_cpl());
+    if (get_pe() && get_vm() && get_iopl() < 3) {
+        if (!get_vme())
+            throw GeneralProtectionFault(0, "POPF in VM86 mode with IOPL < 3");
+        TransactionalPopper popper(*this);
+        u16 flags = popper.pop16();
+        if (flags & Flag::TF)
+            throw GeneralProtectionFault(0, "POPF in VME mode with TF=1");
+        if ((flags & Flag::IF) && get_vip())
+            throw GeneralProtectionFault(0, "POPF in VME mode setting IF with VIP=1");
+        popper.commit();
+        set_eflags_respectfully(flags, get_cpl(), false);
+        set_vif(flags & Flag::IF);
+        return;
+    }
+    set_eflags_respectfully(pop16(), get_cpl(), false);
 }
 
 void CPU::_POPFD(Instruction&)
 {
     if (get_pe() && get_vm() && get_iopl() < 3)
         throw GeneralProtectionFault(0, "POPFD in VM86 mode with IOPL < 3");
-    set_eflags_respectfully(pop32(), get_cpl());
+    set_eflags_respectfully(pop32(), get_cpl(), false);
 }
 
-void CPU::set_eflags_respectfully(u32 newFlags, u8 effectiveCPL)
+void CPU::set_eflags_respectfully(u32 newFlags, u8 effectiveCPL, bool is_iret)
 {
     u32 oldFlags = get_eflags();
-    u32 flagsToKeep = Flag::VIP | Flag::VIF | Flag::RF;
+    u32 flagsToKeep = Flag::RF;
     if (o16())
         flagsToKeep |= 0xffff0000;
     if (get_vm())
         flagsToKeep |= Flag::IOPL;
+    // POPF/POPFD never touch VIF/VIP. Only a CPL 0 IRET in protected mode loads them, e.g. a PVI kernel resuming a ring 3 task.
+    if (!is_iret || !get_pe() || effectiveCPL != 0)
+        flagsToKeep |= Flag::VIP | Flag::VIF;
     if (get_pe() && effectiveCPL != 0) {
         flagsToKeep |= Flag::IOPL;
         if (effectiveCPL > get_iopl()) {
@@ -23,7 +23,6 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "CPU.h"
-#include "pic.h"
 
 template<typename F>
 void CPU::doOnceOrRepeatedly(Instruction& insn, bool care_about_zf, F func)
@@ -33,7 +32,7 @@ void CPU::doOnceOrRepeatedly(Instruction& insn, bool care_about_zf, F func)
         return;
     }
     while (read_register_for_address_size(RegisterCX)) {
-        if (get_if() && PIC::has_pending_irq() && !PIC::is_ignoring_all_irqs()) {
+        if (get_if() && has_pending_irq()) {
             throw HardwareInterruptDuringREP();
         }
         func();